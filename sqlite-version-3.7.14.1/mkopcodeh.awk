@@ -31,6 +31,16 @@
 # properties apply to that opcode.  Set corresponding flags using the
 # OPFLG_INITIALIZER macro.
 #
+# The "case OP_aaaa:" lines of the big switch in sqlite3VdbeExec() may be
+# indented by 12 spaces.  The cases of the smaller switches nested inside of
+# some opcodes are indented further, and are ignored.
+#
+# Finally, the script generates the OPDISPATCH_INITIALIZER macro, a table of
+# the addresses of the "op_aaaa" labels that the OPLABEL() macro adds to
+# each case when sqlite3VdbeExec() is built with SQLITE_ENABLE_COMPUTED_GOTO.
+# An opcode whose case is inside of an #if, such as OP_Real, is given the
+# address of the default case when that #if is false.
+#
 
 
 # Remember the TK_ values from the parse.h file
@@ -38,8 +48,43 @@
   tk[$2] = 0+$3
 }
 
+# Keep track of the #if, #ifdef and #ifndef blocks that each case is in.
+# cond[i] is the condition of the current branch of the i-th enclosing block
+# and prior[i] that none of the earlier branches of that block were taken.
+/^[ \t]*#[ \t]*(if|ifdef|ifndef|elif|else|endif)/ {
+  line = $0
+  sub(/\/\*.*$/,"",line)
+  sub(/\/\/.*$/,"",line)
+  sub(/^[ \t]*#[ \t]*/,"",line)
+  sub(/[ \t\r]+$/,"",line)
+  dir = line
+  sub(/[ \t(!].*$/,"",dir)
+  expr = substr(line, length(dir)+1)
+  sub(/^[ \t]+/,"",expr)
+  if( dir=="if" ){
+    nIf++
+    prior[nIf] = ""
+    cond[nIf] = "(" expr ")"
+  }else if( dir=="ifdef" ){
+    nIf++
+    prior[nIf] = ""
+    cond[nIf] = "defined(" expr ")"
+  }else if( dir=="ifndef" ){
+    nIf++
+    prior[nIf] = ""
+    cond[nIf] = "!defined(" expr ")"
+  }else if( nIf>0 ){
+    if( dir=="endif" ){
+      nIf--
+    }else{
+      prior[nIf] = prior[nIf] "!" cond[nIf] " && "
+      cond[nIf] = (dir=="else") ? "" : "(" expr ")"
+    }
+  }
+}
+
 # Scan for "case OP_aaaa:" lines in the vdbe.c file
-/^case OP_/ {
+/^(            )?case OP_/ {
   name = $2
   sub(/:/,"",name)
   sub("\r","",name)
@@ -78,6 +123,13 @@
     }
   }
   order[n_op++] = name;
+  hascase[name] = 1
+  guard[name] = ""
+  for(i=1; i<=nIf; i++){
+    x = prior[i] cond[i]
+    sub(/ && $/,"",x)
+    if( x!="" ) guard[name] = guard[name] (guard[name]=="" ? "" : " && ") x
+  }
 }
 
 # Assign numbers to all opcodes and output the result.
@@ -158,4 +210,36 @@ END {
     if( i%8==7 ) printf("\\\n");
   }
   print "}"
+
+  # Generate the dispatch table.  Opcode values that are never used, and
+  # OP_Noop and OP_Explain, which do not have a case of their own, jump to
+  # the default case.
+  #
+  print "\n"
+  print "/* The addresses of the labels of the cases of the switch statement"
+  print "** in sqlite3VdbeExec(), indexed by opcode.  Only used if that"
+  print "** function is built with SQLITE_ENABLE_COMPUTED_GOTO."
+  print "*/"
+  for(i=0; i<=max; i++) lbl[i] = "&&op_default"
+  for(i=0; i<n_op; i++){
+    name = order[i]
+    if( !hascase[name] ) continue
+    x = name
+    sub(/^OP_/,"",x)
+    if( guard[name]!="" ){
+      printf "#if %s\n", guard[name]
+      printf "# define OPDISPATCH_%-14s &&op_%s\n", x, x
+      printf "#else\n"
+      printf "# define OPDISPATCH_%-14s &&op_default\n", x
+      printf "#endif\n"
+      lbl[op[name]] = "OPDISPATCH_" x
+    }else{
+      lbl[op[name]] = "&&op_" x
+    }
+  }
+  print "#define OPDISPATCH_INITIALIZER {\\"
+  for(i=0; i<=max; i++){
+    printf "/* %3d */ %s,\\\n", i, lbl[i]
+  }
+  print "}"
 }
@@ -176,6 +176,7 @@ static void attachFunc(
         }
         pPager = sqlite3BtreePager(aNew->pBt);
         sqlite3PagerLockingMode(pPager, db->dfltLockMode);
+        sqlite3BtreeSetMmapLimit(aNew->pBt, db->szMmap);
         sqlite3BtreeSecureDelete(aNew->pBt,
                                  sqlite3BtreeSecureDelete(db->aDb[0].pBt, -1));
     }
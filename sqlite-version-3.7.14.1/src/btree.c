@@ -15,6 +15,24 @@
 */
 #include "btreeInt.h"
 
+/*
+** Cache warm-up (see sqlite3BtreeWarmup()) loads pages in a background
+** thread in builds that implement threads (see threads.c). Elsewhere it
+** loads them synchronously.
+*/
+#ifdef SQLITE_THREADS_IMPLEMENTED
+# define BTREE_WARMUP_THREAD 1
+#endif
+
+/*
+** PRAGMA integrity_check checks the space usage of b-tree pages on worker
+** threads (see IntckPool) in builds that implement threads (see threads.c).
+*/
+#if defined(SQLITE_THREADS_IMPLEMENTED) && SQLITE_INTCK_THREADS>0 \
+    && !defined(SQLITE_OMIT_INTEGRITY_CHECK)
+# define BTREE_INTCK_THREAD 1
+#endif
+
 /*
 ** The header string that appears at the beginning of every
 ** SQLite database.
@@ -467,6 +485,7 @@ static void downgradeAllSharedCacheTableLocks(Btree *p)
 #endif /* SQLITE_OMIT_SHARED_CACHE */
 
 static void releasePage(MemPage *pPage);  /* Forward reference */
+static void btreeBulkFree(BtCursor *pCur);  /* Forward reference */
 
 /*
 ***** This routine is used inside of assert() only ****
@@ -483,18 +502,57 @@ static int cursorHoldsMutex(BtCursor *p)
 
 #ifndef SQLITE_OMIT_INCRBLOB
 /*
-** Invalidate the overflow page-list cache for cursor pCur, if any.
+** Invalidate the overflow page-list cache for cursor pCur, if any. The
+** list itself belongs to a slot of BtShared.aOvflIndex[] and is kept.
 */
 static void invalidateOverflowCache(BtCursor *pCur)
 {
     assert(cursorHoldsMutex(pCur));
-    sqlite3_free(pCur->aOverflow);
     pCur->aOverflow = 0;
 }
 
+/*
+** Free the overflow page list held by slot p of pBt->aOvflIndex[], if
+** any, and mark the slot as unused. Cursors using the list stop doing so.
+*/
+static void ovflIndexClear(BtShared *pBt, BtOvflIndex *p)
+{
+    BtCursor *pCur;
+    assert(sqlite3_mutex_held(pBt->mutex));
+    if (p->aPgno)
+    {
+        for (pCur = pBt->pCursor; pCur; pCur = pCur->pNext)
+        {
+            if (pCur->aOverflow == p->aPgno) pCur->aOverflow = 0;
+        }
+        sqlite3_free(p->aPgno);
+    }
+    memset(p, 0, sizeof(BtOvflIndex));
+}
+
+/*
+** Clear the slots of pBt->aOvflIndex[] that hold the overflow page list
+** of a row with rowid iRow, in any table. If isClearTable is true, clear
+** all of them.
+*/
+static void ovflIndexInvalidate(BtShared *pBt, i64 iRow, int isClearTable)
+{
+    int i;
+    if (pBt->aOvflIndex == 0) return;
+    for (i = 0; i < SQLITE_BTREE_OVFLINDEX; i++)
+    {
+        BtOvflIndex *p = &pBt->aOvflIndex[i];
+        if (isClearTable || (p->pgnoFirst && p->iKey == iRow))
+        {
+            ovflIndexClear(pBt, p);
+        }
+    }
+}
+
 /*
 ** Invalidate the overflow page-list cache for all cursors opened
-** on the shared btree structure pBt.
+** on the shared btree structure pBt, and all the page lists kept in
+** pBt->aOvflIndex[].
 */
 static void invalidateAllOverflowCache(BtShared *pBt)
 {
@@ -504,6 +562,7 @@ static void invalidateAllOverflowCache(BtShared *pBt)
     {
         invalidateOverflowCache(p);
     }
+    ovflIndexInvalidate(pBt, 0, 1);
 }
 
 /*
@@ -535,6 +594,7 @@ static void invalidateIncrblobCursors(
             p->eState = CURSOR_INVALID;
         }
     }
+    ovflIndexInvalidate(pBt, iRow, isClearTable);
 }
 
 #else
@@ -971,6 +1031,12 @@ static int ptrmapGet(BtShared *pBt, Pgno key, u8 *pEType, Pgno *pPgno)
   ((P)->aData + ((P)->maskPage & get2byte(&(P)->aCellIdx[2*(I)])))
 #define findCellv2(D,M,O,I) (D+(M&get2byte(D+(O+2*(I)))))
 
+/*
+** Discard the key cache copy of the cells on page P, if there is one (see
+** BtKeyCache). This must be done whenever a cell is added or removed.
+*/
+#define keyCacheDiscard(P) ((P)->iKeyCache = 0, (P)->nKeySearch = 0)
+
 
 /*
 ** This a more complex version of findCell() that works for
@@ -1016,6 +1082,7 @@ static void btreeParseCellPtr(
 {
     u16 n;                  /* Number bytes in cell content header */
     u32 nPayload;           /* Number of bytes of cell payload */
+    u32 nShared = 0;        /* Payload bytes taken from the anchor */
 
     assert(sqlite3_mutex_held(pPage->pBt->mutex));
 
@@ -1041,6 +1108,10 @@ static void btreeParseCellPtr(
         pInfo->nData = 0;
         n += getVarint32(&pCell[n], nPayload);
         pInfo->nKey = nPayload;
+        if (pPage->hasPrefix)
+        {
+            n += getVarint32(&pCell[n], nShared);
+        }
     }
     pInfo->nPayload = nPayload;
     pInfo->nHeader = n;
@@ -1090,6 +1161,24 @@ static void btreeParseCellPtr(
         /* 之所以要+4,是因为cell已经overflow了,需要在末尾添加一个4字节值来表示下一个overflow page的页号 */
         pInfo->nSize = pInfo->iOverflow + 4;
     }
+    pInfo->nShared = 0;
+    if (nShared)
+    {
+        /* The shared bytes are part of the local payload but are not stored
+        ** in the cell.  A value too large to be valid is clamped here, and
+        ** reported as corruption when the cell is expanded. */
+        if (nShared > pInfo->nLocal) nShared = pInfo->nLocal;
+        pInfo->nShared = (u16)nShared;
+        if (pInfo->iOverflow)
+        {
+            pInfo->iOverflow -= (u16)nShared;
+            pInfo->nSize = pInfo->iOverflow + 4;
+        }
+        else if ((pInfo->nSize = (u16)(n + nPayload - nShared)) < 4)
+        {
+            pInfo->nSize = 4;
+        }
+    }
 }
 #define parseCell(pPage, iCell, pInfo) \
   btreeParseCellPtr((pPage), findCell((pPage), (iCell)), (pInfo))
@@ -1145,6 +1234,15 @@ static u16 cellSizePtr(MemPage *pPage, u8 *pCell)
     else
     {
         pIter += getVarint32(pIter, nSize);
+        if (pPage->hasPrefix && *pIter != 0)
+        {
+            /* A cell with a non-zero nShared.  Leave the arithmetic to the
+            ** full parse. */
+            CellInfo info;
+            btreeParseCellPtr(pPage, pCell, &info);
+            return info.nSize;
+        }
+        pIter += pPage->hasPrefix;
     }
 
     testcase(nSize == pPage->maxLocal);
@@ -1182,6 +1280,270 @@ static u16 cellSize(MemPage *pPage, int iCell)
 }
 #endif
 
+/*
+** The routines that follow deal with prefix-compressed cells, found on the
+** pages of index b-trees that have the PTF_PREFIX flag set.  See the
+** description of the cell format in btreeInt.h.
+**
+** A cell is only compressed if it shares at least PREFIX_MIN_SHARED bytes
+** with its anchor.  If it shares PREFIX_NEW_ANCHOR or more bytes with the
+** cell before it than with its anchor, it is left as it is to become an
+** anchor for the cells that follow.
+*/
+#define PREFIX_MIN_SHARED 4
+#define PREFIX_NEW_ANCHOR 8
+
+/*
+** Return true if cell pCell of prefix page pPage is an anchor, that is if
+** its nShared is zero.
+*/
+static int prefixIsAnchor(MemPage *pPage, const u8 *pCell)
+{
+    const u8 *p = &pCell[pPage->childPtrSize];
+    u32 nPayload;
+    p += getVarint32(p, nPayload);
+    return *p == 0;
+}
+
+/*
+** Return a pointer to the anchor of the cell that is, or is about to
+** become, cell iCell of prefix page pPage.  That is the nearest cell
+** before it with an nShared of zero.  Return NULL if there is none, which
+** is only the case for cell 0 of a well-formed page.  Cells are counted
+** by findCell(), so any overflow cells are not seen.
+*/
+static u8 *prefixAnchor(MemPage *pPage, int iCell)
+{
+    while (iCell > 0)
+    {
+        u8 *pCell;
+        iCell--;
+        pCell = findCell(pPage, iCell);
+        if (prefixIsAnchor(pPage, pCell)) return pCell;
+    }
+    return 0;
+}
+
+/*
+** aKey[] holds the first nKey bytes of a record.  If the first field of
+** the record is a text or blob value, return its serial type and set *piOff
+** to its offset in aKey[].  Also set *pnField to the number of fields in
+** the record, if pnField is not NULL.  Return 0 if the first field is of
+** any other kind, or if the record header does not fit in nKey bytes.
+*/
+static u32 prefixFirstField(const u8 *aKey, int nKey, int *piOff, int *pnField)
+{
+    u32 nHdr;
+    u32 t;
+    int i;
+
+    i = getVarint32(aKey, nHdr);
+    if (nHdr > (u32)nKey || (u32)i >= nHdr) return 0;
+    i += getVarint32(&aKey[i], t);
+    if (t < 12) return 0;
+    if (pnField)
+    {
+        int nField = 1;
+        while ((u32)i < nHdr)
+        {
+            u32 x;
+            i += getVarint32(&aKey[i], x);
+            nField++;
+        }
+        *pnField = nField;
+    }
+    *piOff = (int)nHdr;
+    return t;
+}
+
+/*
+** pCell is a cell of nCell bytes with an nShared of zero, about to be
+** inserted into prefix page pPage where its anchor will be pAnchor.  If the
+** first fields of the two records begin with enough bytes in common,
+** rewrite pCell in place to leave those bytes out and return its new size.
+** Otherwise return nCell.
+**
+** pPrev is the cell that will be immediately before pCell, if it is not
+** pAnchor, or NULL.  If pCell has much more in common with it than with
+** pAnchor, pCell is not compressed, so that it becomes an anchor itself.
+**
+** Both values must be text, or both blobs.  The number of bytes shared is
+** limited so that, even if the anchor spills to overflow pages, they are
+** always part of its local payload.
+*/
+static int prefixCompress(
+    MemPage *pPage,               /* Page the cell is for */
+    u8 *pCell,                    /* The cell to compress */
+    int nCell,                    /* Size of pCell in bytes */
+    const u8 *pAnchor,            /* Anchor of pCell */
+    const u8 *pPrev               /* Cell before pCell, or NULL */
+)
+{
+    CellInfo info;                /* Parse of pCell */
+    CellInfo anchor;              /* Parse of pAnchor */
+    const u8 *aAnchor;            /* First field of pAnchor */
+    u8 *aKey;                     /* Local payload of pCell */
+    int iOff, iAnchorOff;         /* Offsets of the first fields */
+    int nField;                   /* Number of fields in the record */
+    u32 t, tAnchor;               /* Serial types of the first fields */
+    int nMax;                     /* Most bytes that may be shared */
+    int nShared;                  /* Bytes shared with the anchor */
+    int nHdr;                     /* Size of the new cell header */
+    int n;
+
+    btreeParseCellPtr(pPage, pCell, &info);
+    btreeParseCellPtr(pPage, (u8 *)pAnchor, &anchor);
+    assert(info.nShared == 0);
+    if (anchor.nShared) return nCell;
+    aKey = &pCell[info.nHeader];
+    aAnchor = &pAnchor[anchor.nHeader];
+    t = prefixFirstField(aKey, info.nLocal, &iOff, &nField);
+    tAnchor = prefixFirstField(aAnchor, anchor.nLocal, &iAnchorOff, 0);
+    if (t == 0 || tAnchor == 0 || (t & 1) != (tAnchor & 1)) return nCell;
+
+    nMax = pPage->minLocal - 9 * (nField + 1);
+    if (nMax > info.nLocal - iOff) nMax = info.nLocal - iOff;
+    if (nMax > anchor.nLocal - iAnchorOff) nMax = anchor.nLocal - iAnchorOff;
+    if ((u32)nMax > (t - 12) / 2) nMax = (int)((t - 12) / 2);
+    if ((u32)nMax > (tAnchor - 12) / 2) nMax = (int)((tAnchor - 12) / 2);
+    aAnchor += iAnchorOff;
+    for (nShared = 0; nShared < nMax && aKey[iOff + nShared] == aAnchor[nShared]; nShared++);
+    if (nShared < PREFIX_MIN_SHARED) return nCell;
+
+    if (pPrev && pPrev != pAnchor)
+    {
+        /* The first prev.nShared bytes of pPrev are those of the anchor.  If
+        ** pCell shares at least that many with the anchor, go on to compare
+        ** the rest with the bytes stored in pPrev. */
+        CellInfo prev;
+        const u8 *aPrev;
+        int iPrevOff;
+        u32 tPrev;
+        btreeParseCellPtr(pPage, (u8 *)pPrev, &prev);
+        aPrev = &pPrev[prev.nHeader];
+        tPrev = prefixFirstField(aPrev, prev.nLocal - prev.nShared, &iPrevOff, 0);
+        if (tPrev && (tPrev & 1) == (t & 1) && nShared >= prev.nShared)
+        {
+            int nPrev = prev.nShared;
+            int nMaxPrev = prev.nLocal - iPrevOff;
+            if (nMaxPrev > info.nLocal - iOff) nMaxPrev = info.nLocal - iOff;
+            if ((u32)nMaxPrev > (t - 12) / 2) nMaxPrev = (int)((t - 12) / 2);
+            if ((u32)nMaxPrev > (tPrev - 12) / 2) nMaxPrev = (int)((tPrev - 12) / 2);
+            aPrev += iPrevOff - prev.nShared;
+            while (nPrev < nMaxPrev && aKey[iOff + nPrev] == aPrev[nPrev]) nPrev++;
+            if (nPrev >= nShared + PREFIX_NEW_ANCHOR) return nCell;
+        }
+    }
+
+    /* Move the record header along to make room for a longer nShared, then
+    ** close the gap left by the shared bytes. */
+    nHdr = info.nHeader - 1 + sqlite3VarintLen(nShared);
+    memmove(&pCell[nHdr], aKey, iOff);
+    putVarint32(&pCell[info.nHeader - 1], nShared);
+    memmove(&pCell[nHdr + iOff], &pCell[info.nHeader + iOff + nShared],
+            info.nLocal - iOff - nShared);
+    n = nHdr + info.nLocal - nShared;
+    if (info.iOverflow)
+    {
+        memmove(&pCell[n], &pCell[info.iOverflow], 4);
+        n += 4;
+    }
+    if (n < 4) n = 4;
+    assert(n == cellSizePtr(pPage, pCell));
+    return n;
+}
+
+/*
+** Copy the local payload of a cell of prefix page pPage, parsed into
+** *pInfo, to aOut[], putting back the bytes it shares with its anchor,
+** pAnchor.  pInfo->nLocal bytes are written.  Return SQLITE_CORRUPT if the
+** cell does not fit with its anchor.
+*/
+static int prefixPayload(
+    MemPage *pPage,               /* Page the cell is on */
+    CellInfo *pInfo,              /* Parse of the cell */
+    const u8 *pAnchor,            /* Anchor of the cell */
+    u8 *aOut                      /* Write the local payload here */
+)
+{
+    CellInfo anchor;
+    const u8 *aStored = &pInfo->pCell[pInfo->nHeader];
+    const u8 *aAnchor;
+    int nStored = pInfo->nLocal - pInfo->nShared;
+    int nShared = pInfo->nShared;
+    u32 nHdr;
+    u32 nAnchorHdr;
+
+    if (pAnchor == 0) return SQLITE_CORRUPT_BKPT;
+    btreeParseCellPtr(pPage, (u8 *)pAnchor, &anchor);
+    aAnchor = &pAnchor[anchor.nHeader];
+    getVarint32(aStored, nHdr);
+    getVarint32(aAnchor, nAnchorHdr);
+    if (nHdr > (u32)nStored || anchor.nShared
+        || nAnchorHdr + nShared > anchor.nLocal)
+    {
+        return SQLITE_CORRUPT_BKPT;
+    }
+    memcpy(aOut, aStored, nHdr);
+    memcpy(&aOut[nHdr], &aAnchor[nAnchorHdr], nShared);
+    memcpy(&aOut[nHdr + nShared], &aStored[nHdr], nStored - nHdr);
+    return SQLITE_OK;
+}
+
+/*
+** Write a copy of cell pCell of prefix page pPage to pOut, with the bytes
+** it shares with its anchor, pAnchor, put back so that its nShared is zero.
+** Set *pnOut to the size of the copy.  A cell that is already an anchor
+** is copied as it is.
+*/
+static int prefixExpand(
+    MemPage *pPage,               /* Page the cell is on */
+    u8 *pCell,                    /* Cell to expand */
+    const u8 *pAnchor,            /* Anchor of pCell */
+    u8 *pOut,                     /* Write the expanded cell here */
+    int *pnOut                    /* OUT: Size of the expanded cell */
+)
+{
+    CellInfo info;
+    int n;
+    int rc;
+
+    btreeParseCellPtr(pPage, pCell, &info);
+    if (info.nShared == 0)
+    {
+        memcpy(pOut, pCell, info.nSize);
+        *pnOut = info.nSize;
+        return SQLITE_OK;
+    }
+    n = info.nHeader - sqlite3VarintLen(info.nShared);
+    rc = prefixPayload(pPage, &info, pAnchor, &pOut[n + 1]);
+    if (rc) return rc;
+    memcpy(pOut, pCell, n);
+    pOut[n] = 0;
+    n += 1 + info.nLocal;
+    if (info.iOverflow)
+    {
+        memcpy(&pOut[n], &pCell[info.iOverflow], 4);
+        n += 4;
+    }
+    assert(n >= 4 && n == cellSizePtr(pPage, pOut));
+    *pnOut = n;
+    return SQLITE_OK;
+}
+
+/*
+** Return the size that cell pCell of nCell bytes, of prefix page pPage,
+** would have if it were expanded by prefixExpand().
+*/
+static int prefixExpandedSize(MemPage *pPage, u8 *pCell, int nCell)
+{
+    CellInfo info;
+    btreeParseCellPtr(pPage, pCell, &info);
+    if (info.nShared == 0) return nCell;
+    return info.nHeader - sqlite3VarintLen(info.nShared) + 1 + info.nLocal
+           + (info.iOverflow ? 4 : 0);
+}
+
 #ifndef SQLITE_OMIT_AUTOVACUUM
 /*
 ** If the cell pCell, part of page pPage contains a pointer
@@ -1530,6 +1892,9 @@ static int freeSpace(MemPage *pPage, int start, int size)
 **         PTF_ZERODATA | PTF_LEAF
 **         PTF_LEAFDATA | PTF_INTKEY
 **         PTF_LEAFDATA | PTF_INTKEY | PTF_LEAF
+**
+** PTF_PREFIX may be combined with either of the first two, but only in
+** a database whose file format is 5 or more (BTS_PREFIX_INDEX).
 */
 static int decodeFlags(MemPage *pPage, int flagByte)
 {
@@ -1537,6 +1902,13 @@ static int decodeFlags(MemPage *pPage, int flagByte)
 
     assert(pPage->hdrOffset == (pPage->pgno == 1 ? 100 : 0));
     assert(sqlite3_mutex_held(pPage->pBt->mutex));
+    pPage->hasPrefix = 0;
+    if ((flagByte & ~PTF_LEAF) == (PTF_ZERODATA | PTF_PREFIX)
+            && (pPage->pBt->btsFlags & BTS_PREFIX_INDEX) != 0)
+    {
+        pPage->hasPrefix = 1;
+        flagByte &= ~PTF_PREFIX;
+    }
     pPage->leaf = (u8)(flagByte >> 3);
     assert(PTF_LEAF == 1 << 3);
     flagByte &= ~PTF_LEAF;
@@ -1599,6 +1971,7 @@ static int btreeInitPage(MemPage *pPage)
 
         hdr = pPage->hdrOffset;
         data = pPage->aData;
+        keyCacheDiscard(pPage);
         if (decodeFlags(pPage, data[hdr])) return SQLITE_CORRUPT_BKPT;
         assert(pBt->pageSize >= 512 && pBt->pageSize <= 65536);
         pPage->maskPage = (u16)(pBt->pageSize - 1);
@@ -1728,6 +2101,7 @@ static void zeroPage(MemPage *pPage, int flags)
     pPage->maskPage = (u16)(pBt->pageSize - 1);
     pPage->nCell = 0;
     pPage->isInit = 1;
+    keyCacheDiscard(pPage);
 }
 
 
@@ -1751,26 +2125,30 @@ static MemPage *btreePageFromDbPage(DbPage *pDbPage, Pgno pgno, BtShared *pBt)
 ** Get a page from the pager.  Initialize the MemPage.pBt and
 ** MemPage.aData elements if needed.
 **
-** If the noContent flag is set, it means that we do not care about
-** the content of the page at this time.  So do not go to the disk
-** to fetch the content.  Just fill in the content with zeros for now.
+** If the PAGER_ACQUIRE_NOCONTENT flag is set, it means that we do not
+** care about the content of the page at this time.  So do not go to the
+** disk to fetch the content.  Just fill in the content with zeros for now.
 ** If in the future we call sqlite3PagerWrite() on this page, that
 ** means we have started to be concerned about content and the disk
 ** read should occur at that point.
+**
+** If the PAGER_ACQUIRE_READONLY flag is set, the page will never be
+** written and may be returned as a pointer into a memory mapping.
 ** 从pager中获取一个page
 */
 static int btreeGetPage(
     BtShared *pBt,       /* The btree */
     Pgno pgno,           /* Number of the page to fetch */
     MemPage **ppPage,    /* Return the page in this parameter */
-    int noContent        /* Do not load page content if true */
+    int flags            /* PAGER_ACQUIRE_NOCONTENT or PAGER_ACQUIRE_READONLY */
 )
 {
     int rc;
     DbPage *pDbPage;
 
+    assert(flags == 0 || flags == PAGER_ACQUIRE_NOCONTENT || flags == PAGER_ACQUIRE_READONLY);
     assert(sqlite3_mutex_held(pBt->mutex));
-    rc = sqlite3PagerAcquire(pBt->pPager, pgno, (DbPage**)&pDbPage, noContent);
+    rc = sqlite3PagerAcquire(pBt->pPager, pgno, (DbPage**)&pDbPage, flags);
     if (rc) return rc;
     *ppPage = btreePageFromDbPage(pDbPage, pgno, pBt);
     return SQLITE_OK;
@@ -1824,7 +2202,8 @@ u32 sqlite3BtreeLastPage(Btree *p)
 static int getAndInitPage(
     BtShared *pBt,          /* The database file */
     Pgno pgno,           /* Number of the page to get */
-    MemPage **ppPage     /* Write the page pointer here */
+    MemPage **ppPage,    /* Write the page pointer here */
+    int bReadonly        /* PAGER_ACQUIRE_READONLY or 0 */
 )
 {
     int rc;
@@ -1836,7 +2215,7 @@ static int getAndInitPage(
     }
     else
     {
-        rc = btreeGetPage(pBt, pgno, ppPage, 0);
+        rc = btreeGetPage(pBt, pgno, ppPage, bReadonly);
         if (rc == SQLITE_OK)
         {
             rc = btreeInitPage(*ppPage);
@@ -2316,6 +2695,262 @@ static void freeTempSpace(BtShared *pBt)
     pBt->pTmpSpace = 0;
 }
 
+/*
+** Free the pBt->aOvflIndex allocations
+*/
+static void freeOvflIndex(BtShared *pBt)
+{
+#ifndef SQLITE_OMIT_INCRBLOB
+    if (pBt->aOvflIndex)
+    {
+        int i;
+        for (i = 0; i < SQLITE_BTREE_OVFLINDEX; i++)
+        {
+            sqlite3_free(pBt->aOvflIndex[i].aPgno);
+        }
+        sqlite3_free(pBt->aOvflIndex);
+        pBt->aOvflIndex = 0;
+    }
+#else
+    UNUSED_PARAMETER(pBt);
+#endif
+}
+
+/*
+** Free the pBt->aKeyCache allocations
+*/
+static void freeKeyCache(BtShared *pBt)
+{
+#if SQLITE_BTREE_KEYCACHE>0
+    if (pBt->aKeyCache)
+    {
+        int i;
+        for (i = 0; i < SQLITE_BTREE_KEYCACHE; i++)
+        {
+            sqlite3_free(pBt->aKeyCache[i].aKey);
+        }
+        sqlite3_free(pBt->aKeyCache);
+        pBt->aKeyCache = 0;
+    }
+#else
+    UNUSED_PARAMETER(pBt);
+#endif
+}
+
+/*
+** Number of pages loaded by each step of a cache warm-up, and the number
+** of microseconds the warm-up thread pauses for after each step, or
+** after failing to obtain the database connection mutex or a read lock.
+*/
+#define BTREE_WARMUP_STEP  64
+#define BTREE_WARMUP_PAUSE 100
+#define BTREE_WARMUP_RETRY 10000
+
+/*
+** A cache warm-up in progress. aPgno[] is the list of pages read from the
+** warm-up file, of which the first iNext have been loaded.
+**
+** The warm-up thread only uses the Btree while holding the database
+** connection mutex, which it never waits for. It obtains the mutex with
+** sqlite3_mutex_try() between other uses of the connection and loads one
+** step of pages at a time, so that queries are never delayed by more than
+** a single step. bStop is protected by the mutex of pCond, which is
+** signalled when it is set, so that the thread stops without delay.
+** 后台缓存预热
+*/
+struct BtWarmup
+{
+    Btree *p;                       /* Btree to load pages for */
+    Pgno *aPgno;                    /* Pages to load, in ascending order */
+    int nPgno;                      /* Number of entries in aPgno[] */
+    int iNext;                      /* Index of next entry to load */
+#ifdef BTREE_WARMUP_THREAD
+    u8 bStop;                       /* True to make the thread exit */
+    SQLiteThread *pThread;          /* The warm-up thread */
+    SQLiteCond *pCond;              /* Signalled when bStop is set */
+#endif
+};
+
+/*
+** Load the next step of pages for warm-up pW into the page cache. Return
+** SQLITE_OK if there may be more to load, SQLITE_BUSY (or SQLITE_LOCKED)
+** if the step should be tried again later, or SQLITE_DONE if the warm-up
+** is finished, or cannot continue.
+**
+** The caller must hold the database connection mutex. A read transaction
+** is opened for the step, unless one is already open. The busy-handler
+** is not invoked, as this may be called by the warm-up thread. If there
+** is a write transaction open, nothing is loaded.
+*/
+static int btreeWarmupStep(BtWarmup *pW)
+{
+    Btree *p = pW->p;
+    sqlite3 *db = p->db;
+    int n = pW->nPgno - pW->iNext;
+    int rc = SQLITE_OK;
+
+    assert(sqlite3_mutex_held(db->mutex));
+    if (n <= 0) return SQLITE_DONE;
+    if (n > BTREE_WARMUP_STEP) n = BTREE_WARMUP_STEP;
+    sqlite3BtreeEnter(p);
+    if (p->inTrans == TRANS_WRITE)
+    {
+        rc = SQLITE_BUSY;
+    }
+    else
+    {
+        int bRead = (p->inTrans == TRANS_READ);
+        if (!bRead)
+        {
+            BusyHandler busy = db->busyHandler;
+            db->busyHandler.xFunc = 0;
+            rc = sqlite3BtreeBeginTrans(p, 0);
+            db->busyHandler = busy;
+        }
+        if (rc == SQLITE_OK)
+        {
+            sqlite3PagerPrefetch(p->pBt->pPager, &pW->aPgno[pW->iNext], n);
+            pW->iNext += n;
+            if (!bRead) rc = sqlite3BtreeCommit(p);
+        }
+    }
+    sqlite3BtreeLeave(p);
+    if (rc != SQLITE_OK && (rc & 0xff) != SQLITE_BUSY && (rc & 0xff) != SQLITE_LOCKED)
+    {
+        rc = SQLITE_DONE;
+    }
+    return rc;
+}
+
+#ifdef BTREE_WARMUP_THREAD
+/*
+** Main routine of a warm-up thread.
+*/
+static void *btreeWarmupMain(void *pArg)
+{
+    BtWarmup *pW = (BtWarmup *)pArg;
+    sqlite3 *db = pW->p->db;
+    int rc = SQLITE_OK;
+    sqlite3CondEnter(pW->pCond);
+    while (rc != SQLITE_DONE && pW->bStop == 0)
+    {
+        sqlite3CondLeave(pW->pCond);
+        if (sqlite3_mutex_try(db->mutex) == SQLITE_OK)
+        {
+            rc = btreeWarmupStep(pW);
+            sqlite3_mutex_leave(db->mutex);
+        }
+        else
+        {
+            rc = SQLITE_BUSY;
+        }
+        sqlite3CondEnter(pW->pCond);
+        if (rc != SQLITE_DONE && pW->bStop == 0)
+        {
+            sqlite3CondWait(pW->pCond, rc == SQLITE_OK ? BTREE_WARMUP_PAUSE
+                                                       : BTREE_WARMUP_RETRY);
+        }
+    }
+    sqlite3CondLeave(pW->pCond);
+    return 0;
+}
+#endif
+
+/*
+** Stop the cache warm-up of Btree p, if any, and free it.
+*/
+static void btreeWarmupStop(Btree *p)
+{
+    BtWarmup *pW = p->pWarmup;
+    assert(sqlite3_mutex_held(p->db->mutex));
+    if (pW)
+    {
+        p->pWarmup = 0;
+#ifdef BTREE_WARMUP_THREAD
+        /* The thread cannot be using the Btree, as this thread holds the
+        ** database connection mutex. So it exits without delay. */
+        sqlite3CondEnter(pW->pCond);
+        pW->bStop = 1;
+        sqlite3CondSignal(pW->pCond);
+        sqlite3CondLeave(pW->pCond);
+        sqlite3ThreadJoin(pW->pThread, 0);
+        sqlite3CondFree(pW->pCond);
+#endif
+        sqlite3_free(pW->aPgno);
+        sqlite3_free(pW);
+    }
+}
+
+/*
+** Start loading the pages listed in the warm-up file of Btree p into
+** the page cache. The pages are loaded by a background thread if the
+** database connection has a mutex, or synchronously if it does not.
+** Errors are ignored, as the warm-up is only an optimization.
+*/
+static void btreeWarmupStart(Btree *p)
+{
+    BtWarmup *pW;
+    Pgno *aPgno = 0;
+    int nPgno = 0;
+
+    assert(p->pWarmup == 0);
+    sqlite3PagerWarmupList(p->pBt->pPager, &aPgno, &nPgno);
+    if (nPgno == 0) return;
+    pW = (BtWarmup *)sqlite3MallocZero(sizeof(BtWarmup));
+    if (pW == 0)
+    {
+        sqlite3_free(aPgno);
+        return;
+    }
+    pW->p = p;
+    pW->aPgno = aPgno;
+    pW->nPgno = nPgno;
+#ifdef BTREE_WARMUP_THREAD
+    if (p->db->mutex && (pW->pCond = sqlite3CondAlloc()) != 0)
+    {
+        if (sqlite3ThreadCreate(&pW->pThread, btreeWarmupMain, pW) == SQLITE_OK)
+        {
+            p->pWarmup = pW;
+            return;
+        }
+        sqlite3CondFree(pW->pCond);
+    }
+#endif
+    while (btreeWarmupStep(pW) == SQLITE_OK) {}
+    sqlite3_free(pW->aPgno);
+    sqlite3_free(pW);
+}
+
+/*
+** Enable or disable cache warm-up for the database file, or query the
+** setting if onoff is negative. Return the setting.
+**
+** While enabled, the numbers of the pages in the cache are written to
+** the warm-up file when the database is closed. When it is enabled, the
+** pages listed in the warm-up file are loaded into the cache.
+*/
+int sqlite3BtreeWarmup(Btree *p, int onoff)
+{
+    Pager *pPager = p->pBt->pPager;
+    int bOld;
+    assert(sqlite3_mutex_held(p->db->mutex));
+    sqlite3BtreeEnter(p);
+    bOld = sqlite3PagerWarmupMode(pPager, -1);
+    if (onoff == 0)
+    {
+        btreeWarmupStop(p);
+        sqlite3PagerWarmupMode(pPager, 0);
+    }
+    else if (onoff > 0 && !bOld)
+    {
+        sqlite3PagerWarmupMode(pPager, 1);
+        btreeWarmupStart(p);
+    }
+    bOld = sqlite3PagerWarmupMode(pPager, -1);
+    sqlite3BtreeLeave(p);
+    return bOld;
+}
+
 /*
 ** Close an open database and invalidate all cursors.
 */
@@ -2326,6 +2961,7 @@ int sqlite3BtreeClose(Btree *p)
 
     /* Close all cursors opened via this handle.  */
     assert(sqlite3_mutex_held(p->db->mutex));
+    btreeWarmupStop(p);
     sqlite3BtreeEnter(p);
     pCur = pBt->pCursor;
     while (pCur)
@@ -2365,6 +3001,8 @@ int sqlite3BtreeClose(Btree *p)
         }
         sqlite3DbFree(0, pBt->pSchema);
         freeTempSpace(pBt);
+        freeKeyCache(pBt);
+        freeOvflIndex(pBt);
         sqlite3_free(pBt);
     }
 
@@ -2404,6 +3042,20 @@ int sqlite3BtreeSetCacheSize(Btree *p, int mxPage)
     return SQLITE_OK;
 }
 
+/*
+** Change the limit on the amount of the database file that may be
+** memory mapped.
+*/
+int sqlite3BtreeSetMmapLimit(Btree *p, sqlite3_int64 szMmap)
+{
+    BtShared *pBt = p->pBt;
+    assert(sqlite3_mutex_held(p->db->mutex));
+    sqlite3BtreeEnter(p);
+    sqlite3PagerSetMmapLimit(pBt->pPager, szMmap);
+    sqlite3BtreeLeave(p);
+    return SQLITE_OK;
+}
+
 /*
 ** Change the way data is synced to disk in order to increase or decrease
 ** how well the database resists damage due to OS crashes and power
@@ -2608,12 +3260,28 @@ int sqlite3BtreeGetAutoVacuum(Btree *p)
 
 
 /*
-** Get a reference to pPage1 of the database file.  This will
-** also acquire a readlock on that file.
-** 获取数据库文件的pPage1的一个引用,这个会导致在文件上加上一个读锁.
-**
-** SQLITE_OK is returned on success.  If the file is not a
-** well-formed database file, then SQLITE_CORRUPT is returned.
+** Index b-trees created in a database whose schema file format is
+** iFormat use prefix-compressed pages if it is 5 or more.
+*/
+static void btreeSetPrefixIndex(BtShared *pBt, u32 iFormat)
+{
+    if (iFormat >= SQLITE_PREFIX_FILE_FORMAT)
+    {
+        pBt->btsFlags |= BTS_PREFIX_INDEX;
+    }
+    else
+    {
+        pBt->btsFlags &= ~BTS_PREFIX_INDEX;
+    }
+}
+
+/*
+** Get a reference to pPage1 of the database file.  This will
+** also acquire a readlock on that file.
+** 获取数据库文件的pPage1的一个引用,这个会导致在文件上加上一个读锁.
+**
+** SQLITE_OK is returned on success.  If the file is not a
+** well-formed database file, then SQLITE_CORRUPT is returned.
 ** SQLITE_BUSY is returned if the database is locked.  SQLITE_NOMEM
 ** is returned if we run out of memory.
 **
@@ -2749,6 +3417,7 @@ static int lockBtree(BtShared *pBt)
         pBt->incrVacuum = (get4byte(&page1[36 + 7 * 4]) ? 1 : 0);
 #endif
     }
+    btreeSetPrefixIndex(pBt, get4byte(&pPage1->aData[36 + BTREE_FILE_FORMAT * 4]));
 
     /* maxLocal is the maximum amount of payload to store locally for
     ** a cell.  Make sure it is small enough so that at least minFanout
@@ -2982,6 +3651,15 @@ int sqlite3BtreeBeginTrans(Btree *p, int wrflag)
         */
         while (pBt->pPage1 == 0 && SQLITE_OK == (rc = lockBtree(pBt)));
 
+#ifndef SQLITE_OMIT_WAL
+        /* Within BEGIN CONCURRENT, have the pager record the pages read so
+        ** that conflicts can be detected when the transaction commits. */
+        if (rc == SQLITE_OK && p->db->bConcurrent && !p->db->autoCommit)
+        {
+            rc = sqlite3PagerBeginConcurrent(pBt->pPager);
+        }
+#endif
+
         if (rc == SQLITE_OK && wrflag)
         {
             if ((pBt->btsFlags & BTS_READ_ONLY) != 0)
@@ -3697,6 +4375,17 @@ int sqlite3BtreeCommitPhaseTwo(Btree *p, int bCleanup)
             return rc;
         }
         pBt->inTransaction = TRANS_READ;
+
+#ifndef SQLITE_OMIT_WAL
+        /* A BEGIN CONCURRENT transaction may have been committed on top of
+        ** others that changed the size of the database. */
+        if (p->db->bConcurrent)
+        {
+            int nPage = get4byte(28 + (u8 *)pBt->pPage1->aData);
+            if (nPage == 0) sqlite3PagerPagecount(pBt->pPager, &nPage);
+            pBt->nPage = nPage;
+        }
+#endif
     }
 
     btreeEndTransaction(p);
@@ -3821,6 +4510,7 @@ int sqlite3BtreeRollback(Btree *p, int tripCode)
         int rc2;
 
         assert(TRANS_WRITE == pBt->inTransaction);
+        invalidateAllOverflowCache(pBt);
         rc2 = sqlite3PagerRollback(pBt->pPager); /* 执行回滚操作 */
         if (rc2 != SQLITE_OK)
         {
@@ -3919,6 +4609,7 @@ int sqlite3BtreeSavepoint(Btree *p, int op, int iSavepoint)
         assert(op == SAVEPOINT_RELEASE || op == SAVEPOINT_ROLLBACK);
         assert(iSavepoint >= 0 || (iSavepoint == -1 && op == SAVEPOINT_ROLLBACK));
         sqlite3BtreeEnter(p);
+        if (op == SAVEPOINT_ROLLBACK) invalidateAllOverflowCache(pBt);
         rc = sqlite3PagerSavepoint(pBt->pPager, op, iSavepoint);
         if (rc == SQLITE_OK)
         {
@@ -4013,6 +4704,8 @@ static int btreeCursor(
     pCur->pgnoRoot = (Pgno)iTable;
     pCur->iPage = -1;
     pCur->pKeyInfo = pKeyInfo; /* 比较条件 */
+    pCur->prefixOk = (pKeyInfo && pKeyInfo->nField > 0
+                      && sqlite3IsBinary(pKeyInfo->aColl[0]));
     pCur->pBtree = p;
     pCur->pBt = pBt;
     pCur->wrFlag = (u8)wrFlag;
@@ -4071,6 +4764,15 @@ void sqlite3BtreeCursorZero(BtCursor *p)
     memset(p, 0, offsetof(BtCursor, iPage));
 }
 
+/*
+** Return the number of page descents that seeks on cursor pCur have saved
+** by starting below the root page.
+*/
+u32 sqlite3BtreeSeekSaved(BtCursor *pCur)
+{
+    return pCur->nSeekSaved;
+}
+
 /*
 ** Set the cached rowid value of every cursor in the same database file
 ** as pCur and having the same root page number as pCur.  The value is
@@ -4119,6 +4821,7 @@ int sqlite3BtreeCloseCursor(BtCursor *pCur)
         BtShared *pBt = pCur->pBt;
         sqlite3BtreeEnter(pBtree);
         sqlite3BtreeClearCursor(pCur);
+        btreeBulkFree(pCur);
         if (pCur->pPrev)
         {
             pCur->pPrev->pNext = pCur->pNext;
@@ -4137,6 +4840,8 @@ int sqlite3BtreeCloseCursor(BtCursor *pCur)
         }
         unlockBtreeIfUnused(pBt);
         invalidateOverflowCache(pCur);
+        sqlite3_free(pCur->aPrefix);
+        pCur->aPrefix = 0;
         /* sqlite3_free(pCur); */
         sqlite3BtreeLeave(pBtree);
     }
@@ -4387,6 +5092,91 @@ static int copyPayload(
     return SQLITE_OK;
 }
 
+/*
+** Return pCur->aPrefix[], a buffer of one page, allocating it if need be.
+** Besides holding the payload of the cell the cursor points to, it is
+** used as scratch space to expand cells when the b-tree is modified.
+** Return NULL if out of memory.
+*/
+static u8 *prefixSpace(BtCursor *pCur)
+{
+    if (pCur->aPrefix == 0)
+    {
+        pCur->aPrefix = (u8 *)sqlite3Malloc(pCur->pBt->pageSize);
+    }
+    return pCur->aPrefix;
+}
+
+/*
+** The cursor points to a cell with a non-zero nShared on a prefix page.
+** Put the local payload of the cell back together in pCur->aPrefix[].
+*/
+static int prefixLoad(BtCursor *pCur)
+{
+    MemPage *pPage = pCur->apPage[pCur->iPage];
+    assert(pPage->hasPrefix && pCur->info.nShared > 0);
+    if (prefixSpace(pCur) == 0) return SQLITE_NOMEM;
+    return prefixPayload(pPage, &pCur->info,
+                         prefixAnchor(pPage, pCur->aiIdx[pCur->iPage]),
+                         pCur->aPrefix);
+}
+
+#ifndef SQLITE_OMIT_INCRBLOB
+/*
+** Return the overflow page list (see BtOvflIndex) of the row that
+** incrblob cursor pCur points to, whose overflow chain of nOvfl pages
+** begins with page pgnoFirst. If no slot of pBt->aOvflIndex[] holds the
+** list, the least recently used slot is cleared and given a new list in
+** which no page locations are known. Return NULL if a malloc fails.
+*/
+static Pgno *ovflIndexGet(BtCursor *pCur, Pgno pgnoFirst, int nOvfl)
+{
+    BtShared *pBt = pCur->pBt;
+    u32 iDataVersion = sqlite3PagerDataVersion(pBt->pPager);
+    BtOvflIndex *pVictim = 0;
+    Pgno *aPgno;
+    int i;
+
+    assert(pCur->apPage[pCur->iPage]->intKey);
+    if (pBt->aOvflIndex == 0)
+    {
+        pBt->aOvflIndex = (BtOvflIndex *)sqlite3MallocZero(
+                              sizeof(BtOvflIndex) * SQLITE_BTREE_OVFLINDEX);
+        if (pBt->aOvflIndex == 0) return 0;
+    }
+    pBt->iOvflClock++;
+    for (i = 0; i < SQLITE_BTREE_OVFLINDEX; i++)
+    {
+        BtOvflIndex *p = &pBt->aOvflIndex[i];
+        if (p->pgnoFirst && p->iDataVersion != iDataVersion)
+        {
+            /* The database has changed since the list was made */
+            ovflIndexClear(pBt, p);
+        }
+        if (p->pgnoFirst == pgnoFirst && p->pgnoRoot == pCur->pgnoRoot
+            && p->iKey == pCur->info.nKey && p->nPgno == nOvfl
+           )
+        {
+            p->iUsed = pBt->iOvflClock;
+            return p->aPgno;
+        }
+        if (pVictim == 0 || p->iUsed < pVictim->iUsed) pVictim = p;
+    }
+
+    aPgno = (Pgno *)sqlite3MallocZero(sizeof(Pgno) * nOvfl);
+    if (aPgno == 0) return 0;
+    ovflIndexClear(pBt, pVictim);
+    pVictim->pgnoRoot = pCur->pgnoRoot;
+    pVictim->iKey = pCur->info.nKey;
+    pVictim->pgnoFirst = pgnoFirst;
+    pVictim->iDataVersion = iDataVersion;
+    pVictim->iUsed = pBt->iOvflClock;
+    pVictim->nPgno = nOvfl;
+    pVictim->aPgno = aPgno;
+    return aPgno;
+}
+#endif
+
 /*
 ** This function is used to read or overwrite payload information
 ** for the entry that the pCur cursor is pointing to. If the eOp
@@ -4443,7 +5233,8 @@ static int accessPayload(
     nKey = (pPage->intKey ? 0 : (int)pCur->info.nKey);
 
     if (NEVER(offset + amt > nKey + pCur->info.nData)
-        || &aPayload[pCur->info.nLocal] > &pPage->aData[pBt->usableSize]
+        || &aPayload[pCur->info.nLocal - pCur->info.nShared]
+           > &pPage->aData[pBt->usableSize]
        )
     {
         /* Trying to read or write past the end of the data is an error */
@@ -4458,7 +5249,16 @@ static int accessPayload(
         {
             a = pCur->info.nLocal - offset;
         }
-        rc = copyPayload(&aPayload[offset], pBuf, a, eOp, pPage->pDbPage);
+        if (pCur->info.nShared)
+        {
+            assert(eOp == 0);
+            rc = prefixLoad(pCur);
+            if (rc == SQLITE_OK) memcpy(pBuf, &pCur->aPrefix[offset], a);
+        }
+        else
+        {
+            rc = copyPayload(&aPayload[offset], pBuf, a, eOp, pPage->pDbPage);
+        }
         offset = 0;
         pBuf += a;
         amt -= a;
@@ -4472,8 +5272,12 @@ static int accessPayload(
     {
         const u32 ovflSize = pBt->usableSize - 4;  /* Bytes content per ovfl page */
         Pgno nextPage;
+#ifndef SQLITE_OMIT_INCRBLOB
+        int nOvfl;                                  /* Pages in overflow chain */
+        int iAhead = 0;                             /* Pages before it read ahead */
+#endif
 
-        nextPage = get4byte(&aPayload[pCur->info.nLocal]);
+        nextPage = get4byte(&aPayload[pCur->info.nLocal - pCur->info.nShared]);
 
 #ifndef SQLITE_OMIT_INCRBLOB
         /* If the isIncrblobHandle flag is set and the BtCursor.aOverflow[]
@@ -4483,10 +5287,10 @@ static int accessPayload(
         ** etc. A value of 0 in the aOverflow[] array means "not yet known"
         ** (the cache is lazily populated).
         */
+        nOvfl = (pCur->info.nPayload - pCur->info.nLocal + ovflSize - 1) / ovflSize;
         if (pCur->isIncrblobHandle && !pCur->aOverflow)
         {
-            int nOvfl = (pCur->info.nPayload - pCur->info.nLocal + ovflSize - 1) / ovflSize;
-            pCur->aOverflow = (Pgno *)sqlite3MallocZero(sizeof(Pgno) * nOvfl);
+            pCur->aOverflow = ovflIndexGet(pCur, nextPage, nOvfl);
             /* nOvfl is always positive.  If it were zero, fetchPayload would have
             ** been used instead of this routine. */
             if (ALWAYS(nOvfl) && !pCur->aOverflow)
@@ -4583,7 +5387,27 @@ static int accessPayload(
 
                 {
                     DbPage *pDbPage;
-                    rc = sqlite3PagerGet(pBt->pPager, nextPage, &pDbPage);
+#ifndef SQLITE_OMIT_INCRBLOB
+                    /* If the locations of this page and the pages after it
+                    ** that hold the rest of the range are known, read them
+                    ** together. Runs of adjacent pages are read with a
+                    ** single vectored read. */
+                    if (eOp == 0 && pCur->aOverflow && iIdx >= iAhead)
+                    {
+                        int nNeed = (offset + amt + ovflSize - 1) / ovflSize;
+                        int n = 1;
+                        if (nNeed > BT_OVFL_READAHEAD) nNeed = BT_OVFL_READAHEAD;
+                        if (nNeed > nOvfl - iIdx) nNeed = nOvfl - iIdx;
+                        while (n < nNeed && pCur->aOverflow[iIdx + n]) n++;
+                        if (n > 1)
+                        {
+                            sqlite3PagerPrefetch(pBt->pPager, &pCur->aOverflow[iIdx], n);
+                        }
+                        iAhead = iIdx + n;
+                    }
+#endif
+                    rc = sqlite3PagerAcquire(pBt->pPager, nextPage, &pDbPage,
+                                             (eOp == 0 ? PAGER_ACQUIRE_READONLY : 0));
                     if (rc == SQLITE_OK)
                     {
                         aPayload = sqlite3PagerGetData(pDbPage);
@@ -4711,6 +5535,19 @@ static const unsigned char *fetchPayload(
     }
     aPayload = pCur->info.pCell;
     aPayload += pCur->info.nHeader; /* 跳过头部 */
+    if (pCur->info.nShared)
+    {
+        /* A prefix-compressed cell.  If it cannot be put back together,
+        ** report no bytes available so that the caller uses
+        ** accessPayload(), which returns the error. */
+        assert(!skipKey);
+        if (prefixLoad(pCur))
+        {
+            *pAmt = 0;
+            return 0;
+        }
+        aPayload = pCur->aPrefix;
+    }
     if (pPage->intKey)
     {
         nKey = 0;
@@ -4796,7 +5633,8 @@ static int moveToChild(BtCursor *pCur, u32 newPgno)
     {
         return SQLITE_CORRUPT_BKPT;
     }
-    rc = getAndInitPage(pBt, newPgno, &pNewPage);
+    rc = getAndInitPage(pBt, newPgno, &pNewPage,
+                        (pCur->wrFlag == 0 ? PAGER_ACQUIRE_READONLY : 0));
     if (rc) return rc;
     pCur->apPage[i + 1] = pNewPage; /* 记录下新page */
     pCur->aiIdx[i + 1] = 0; /* 游标初始指向第1个cell */
@@ -4918,6 +5756,7 @@ static int moveToRoot(BtCursor *pCur)
         }
         sqlite3BtreeClearCursor(pCur);
     }
+    pCur->nSeqLeaf = 0;
 
     if (pCur->iPage >= 0)
     {
@@ -4935,7 +5774,8 @@ static int moveToRoot(BtCursor *pCur)
     }
     else
     {
-        rc = getAndInitPage(pBt, pCur->pgnoRoot, &pCur->apPage[0]);
+        rc = getAndInitPage(pBt, pCur->pgnoRoot, &pCur->apPage[0],
+                            (pCur->wrFlag == 0 ? PAGER_ACQUIRE_READONLY : 0));
         if (rc != SQLITE_OK)
         {
             pCur->eState = CURSOR_INVALID;
@@ -5132,6 +5972,416 @@ int sqlite3BtreeLast(BtCursor *pCur, int *pRes)
     return rc;
 }
 
+/*
+** Compare the key of cell pCell, which is on the index page that pCur
+** points to and is the cell pCur->aiIdx[] points to, with pIdxKey.  Set
+** *pRes to the result, as sqlite3VdbeRecordCompare() returns it.  The
+** cell is parsed into pCur->info.  The page may be a prefix page.
+*/
+static int prefixCompare(
+    BtCursor *pCur,               /* Cursor pointing at the cell */
+    u8 *pCell,                    /* The cell, including any child pointer */
+    UnpackedRecord *pIdxKey,      /* Key to compare against */
+    int *pRes                     /* OUT: Result of the comparison */
+)
+{
+    CellInfo *pInfo = &pCur->info;
+    int rc = SQLITE_OK;
+
+    btreeParseCellPtr(pCur->apPage[pCur->iPage], pCell, pInfo);
+    if (pInfo->iOverflow == 0)
+    {
+        const u8 *aKey = &pCell[pInfo->nHeader];
+        if (pInfo->nShared)
+        {
+            rc = prefixLoad(pCur);
+            aKey = pCur->aPrefix;
+        }
+        if (rc == SQLITE_OK)
+        {
+            *pRes = sqlite3VdbeRecordCompare(pInfo->nLocal, aKey, pIdxKey);
+        }
+    }
+    else
+    {
+        int nKey = (int)pInfo->nKey;
+        void *pKey = sqlite3Malloc(nKey);
+        if (pKey == 0) return SQLITE_NOMEM;
+        rc = accessPayload(pCur, 0, nKey, (unsigned char *)pKey, 0);
+        if (rc == SQLITE_OK)
+        {
+            *pRes = sqlite3VdbeRecordCompare(nKey, pKey, pIdxKey);
+        }
+        sqlite3_free(pKey);
+    }
+    return rc;
+}
+
+/*
+** Compare the key of cell iCell of apPage[iLevel], an interior page on the
+** path of cursor pCur, with pIdxKey or intKey.  Set *pRes as for
+** sqlite3VdbeRecordCompare(): negative if the cell is the smaller.
+*/
+static int ancestorCompare(
+    BtCursor *pCur,               /* Cursor whose path the page is on */
+    int iLevel,                   /* Level of the page in pCur->apPage[] */
+    int iCell,                    /* Cell of the page to compare */
+    UnpackedRecord *pIdxKey,      /* Index key, or NULL for a table */
+    i64 intKey,                   /* Table key */
+    int *pRes                     /* OUT: Result of the comparison */
+)
+{
+    MemPage *pPage = pCur->apPage[iLevel];
+    u8 *pCell = findCell(pPage, iCell);
+    int iPage = pCur->iPage;
+    u16 iIdx = pCur->aiIdx[iLevel];
+    int rc;
+
+    assert(!pPage->leaf && iCell < pPage->nCell);
+    if (pIdxKey == 0)
+    {
+        i64 nCellKey;
+        getVarint(&pCell[4], (u64 *)&nCellKey);
+        *pRes = (nCellKey < intKey ? -1 : (nCellKey > intKey ? +1 : 0));
+        return SQLITE_OK;
+    }
+
+    /* prefixCompare() reads the cell the cursor points to */
+    pCur->iPage = (i16)iLevel;
+    pCur->aiIdx[iLevel] = (u16)iCell;
+    rc = prefixCompare(pCur, pCell, pIdxKey, pRes);
+    pCur->iPage = (i16)iPage;
+    pCur->aiIdx[iLevel] = iIdx;
+    pCur->info.nSize = 0;
+    return rc;
+}
+
+/*
+** Cursor pCur is valid and below its root page.  Find the lowest page on
+** its path that the key pIdxKey or intKey belongs under, and move the
+** cursor up to it, so that a seek need not start again from the root.
+** Set *pbMoved to true if it is below the root; otherwise leave the
+** cursor as it is.
+**
+** The key range of a page is bounded by the cells either side of the child
+** pointer followed on its parent, or, if there is no cell on one side,
+** on a page further up.  A key that falls outside one of the bounds
+** belongs under the page the bound was found on, or above it.
+*/
+static int moveToAncestor(
+    BtCursor *pCur,               /* Cursor to move */
+    UnpackedRecord *pIdxKey,      /* Index key, or NULL for a table */
+    i64 intKey,                   /* Table key */
+    int *pbMoved                  /* OUT: True if moved to a page below root */
+)
+{
+    int iLevel = pCur->iPage;     /* Lowest page that may hold the key */
+    int rc;
+
+    *pbMoved = 0;
+    while (iLevel > 0)
+    {
+        int bLower = 0;           /* True once the lower bound is checked */
+        int bUpper = 0;           /* True once the upper bound is checked */
+        int iFail = -1;           /* Level of a bound the key is outside */
+        int j;
+        int c;
+
+        for (j = iLevel - 1; j >= 0 && !(bLower && bUpper); j--)
+        {
+            MemPage *pPage = pCur->apPage[j];
+            int idx = pCur->aiIdx[j];
+            if (!bLower && idx > 0)
+            {
+                rc = ancestorCompare(pCur, j, idx - 1, pIdxKey, intKey, &c);
+                if (rc) return rc;
+                if (c >= 0)
+                {
+                    iFail = j;
+                    break;
+                }
+                bLower = 1;
+            }
+            if (!bUpper && idx < pPage->nCell)
+            {
+                /* On an index page, a key equal to the cell is the cell */
+                rc = ancestorCompare(pCur, j, idx, pIdxKey, intKey, &c);
+                if (rc) return rc;
+                if (c < 0 || (c == 0 && pIdxKey))
+                {
+                    iFail = j;
+                    break;
+                }
+                bUpper = 1;
+            }
+        }
+        if (iFail < 0) break;
+        iLevel = iFail;
+    }
+
+    if (iLevel > 0)
+    {
+        while (pCur->iPage > iLevel)
+        {
+            releasePage(pCur->apPage[pCur->iPage--]);
+        }
+        pCur->info.nSize = 0;
+        pCur->atLast = 0;
+        pCur->validNKey = 0;
+        pCur->nSeqLeaf = 0;
+        pCur->nSeekSaved += iLevel;
+        *pbMoved = 1;
+    }
+    return SQLITE_OK;
+}
+
+#if SQLITE_BTREE_KEYCACHE>0
+/*
+** Read the integer stored with serial type iType at p into *pVal. Return
+** zero if iType is not an integer serial type. This is the integer part
+** of sqlite3VdbeSerialGet().
+*/
+static int keyCacheSerialInt(const u8 *p, u32 iType, i64 *pVal)
+{
+    u64 x;
+    switch (iType)
+    {
+        case 1:   /* 1-byte signed integer */
+            *pVal = (signed char)p[0];
+            return 1;
+        case 2:   /* 2-byte signed integer */
+            *pVal = (((signed char)p[0]) << 8) | p[1];
+            return 1;
+        case 3:   /* 3-byte signed integer */
+            *pVal = (((signed char)p[0]) << 16) | (p[1] << 8) | p[2];
+            return 1;
+        case 4:   /* 4-byte signed integer */
+            *pVal = (i64)(int)get4byte(p);
+            return 1;
+        case 5:   /* 6-byte signed integer */
+            x = (u64)(i64)((((signed char)p[0]) << 8) | p[1]);
+            x = (x << 32) | get4byte(&p[2]);
+            *pVal = (i64)x;
+            return 1;
+        case 6:   /* 8-byte signed integer */
+            x = get4byte(p);
+            x = (x << 32) | get4byte(&p[4]);
+            *pVal = (i64)x;
+            return 1;
+        case 8:   /* Integer 0 */
+        case 9:   /* Integer 1 */
+            *pVal = iType - 8;
+            return 1;
+    }
+    return 0;
+}
+
+/*
+** Write the key of each cell on page pPage to aKey[], as described for
+** BtKeyCache. The first field of each index record is XORed with mask,
+** which is all ones for a descending column. Return zero if the keys
+** cannot be decoded: if the page is an index page and the first field
+** of any record on it is not an integer or does not fit on the page.
+** 解码页上每个cell的key,写入aKey[]数组.
+*/
+static int keyCacheDecode(MemPage *pPage, u64 mask, i64 *aKey)
+{
+    static const u8 aSize[] = { 0, 1, 2, 3, 4, 6, 8, 0, 0, 0 };
+    int i;
+
+    assert(pPage->nOverflow == 0);
+    for (i = 0; i < pPage->nCell; i++)
+    {
+        u8 *pCell = findCell(pPage, i);
+        if (pPage->intKey)
+        {
+            pCell += pPage->childPtrSize;
+            if (pPage->hasData)
+            {
+                u32 dummy;
+                pCell += getVarint32(pCell, dummy);
+            }
+            getVarint(pCell, (u64*)&aKey[i]);
+        }
+        else
+        {
+            CellInfo info;
+            u8 *pRec;
+            u32 nHdr;
+            u32 iType;
+            int n;
+
+            btreeParseCellPtr(pPage, pCell, &info);
+            pRec = &pCell[info.nHeader];
+            if (info.nLocal < 2) return 0;
+            n = getVarint32(pRec, nHdr);
+            if (nHdr <= (u32)n || nHdr > info.nLocal) return 0;
+            getVarint32(&pRec[n], iType);
+            if (iType > 9 || nHdr + aSize[iType] > info.nLocal
+                || !keyCacheSerialInt(&pRec[nHdr], iType, &aKey[i])
+               )
+            {
+                return 0;
+            }
+            aKey[i] = (i64)((u64)aKey[i] ^ mask);
+        }
+    }
+    return 1;
+}
+
+/*
+** Return the key cache slot holding a copy of the keys on page pPage,
+** or NULL if there is none. A slot is assigned to the page, and the keys
+** decoded into it, once the page has been searched BT_KEYCACHE_MINSEARCH
+** times since it was last modified. Slots are reused in clock order.
+**
+** Failing to allocate memory for the key cache is not an error. The
+** search just proceeds without it.
+*/
+static BtKeyCache *keyCacheGet(MemPage *pPage, u64 mask)
+{
+    BtShared *pBt = pPage->pBt;
+    BtKeyCache *p;
+    int nAlloc;
+
+    if (pPage->iKeyCache)
+    {
+        p = &pBt->aKeyCache[pPage->iKeyCache - 1];
+        if (p->pPage == pPage && p->pgno == pPage->pgno)
+        {
+            assert(p->nKey == pPage->nCell);
+            p->bRef = 1;
+            return p;
+        }
+        keyCacheDiscard(pPage);
+    }
+    if (pPage->nCell < 8 || pPage->nKeySearch == 0xff) return 0;
+    if (pPage->nKeySearch < BT_KEYCACHE_MINSEARCH)
+    {
+        if (++pPage->nKeySearch < BT_KEYCACHE_MINSEARCH) return 0;
+    }
+
+    if (pBt->aKeyCache == 0)
+    {
+        sqlite3BeginBenignMalloc();
+        pBt->aKeyCache = (BtKeyCache *)sqlite3MallocZero(
+                             sizeof(BtKeyCache) * SQLITE_BTREE_KEYCACHE);
+        sqlite3EndBenignMalloc();
+        if (pBt->aKeyCache == 0) return 0;
+    }
+    for (;;)
+    {
+        p = &pBt->aKeyCache[pBt->iKeyCacheHand];
+        pBt->iKeyCacheHand = (pBt->iKeyCacheHand + 1) % SQLITE_BTREE_KEYCACHE;
+        if (!p->bRef) break;
+        p->bRef = 0;
+    }
+    /* Size aKey[] for the cells on the page, rounded up so that reusing
+    ** the slot for other pages seldom needs a new allocation, rather than
+    ** for the most cells a page could hold, which would need more memory
+    ** than the page itself.
+    */
+    p->pPage = 0;
+    nAlloc = (pPage->nCell + 31) & ~31;
+    if (p->nAlloc < nAlloc)
+    {
+        i64 *aNew;
+        sqlite3BeginBenignMalloc();
+        aNew = (i64 *)sqlite3Realloc(p->aKey, nAlloc * sizeof(i64));
+        sqlite3EndBenignMalloc();
+        if (aNew == 0) return 0;
+        p->aKey = aNew;
+        p->nAlloc = nAlloc;
+    }
+    if (!keyCacheDecode(pPage, mask, p->aKey))
+    {
+        pPage->nKeySearch = 0xff;
+        return 0;
+    }
+    p->pPage = pPage;
+    p->pgno = pPage->pgno;
+    p->nKey = pPage->nCell;
+    p->bRef = 1;
+    pPage->iKeyCache = (u8)(p - pBt->aKeyCache + 1);
+    return p;
+}
+
+/*
+** Return the number of the n values in aKey[], which are in ascending
+** order, that are less than iKey. n must be at least 1. The loop has no
+** data-dependent branches, so the compiler may use conditional moves
+** instead of branches that the processor would mispredict.
+*/
+static int keyCacheBound(const i64 *aKey, int n, i64 iKey)
+{
+    const i64 *pBase = aKey;
+    while (n > 1)
+    {
+        int nHalf = n / 2;
+        pBase = (pBase[nHalf] < iKey) ? &pBase[nHalf] : pBase;
+        n -= nHalf;
+    }
+    return (int)(pBase - aKey) + (*pBase < iKey);
+}
+
+/*
+** The cursor is on an intkey page, or on an index page and the first
+** field of pIdxKey is an integer. If the page has a key cache slot, use
+** it to narrow the range of cells [*pLwr, *pUpr] that the binary search
+** in sqlite3BtreeMovetoUnpacked() must compare against the key.
+**
+** The range is narrowed to the cells whose key or first field is equal
+** to that of the search key. If there are none, it is narrowed to the
+** single cell after which the key would be inserted, or the last cell
+** on the page. Either way, the range holds at least one cell, so the
+** binary search still sets the cursor state as it does without a key
+** cache, using at most one comparison unless there are ties.
+*/
+static void keyCacheSearch(
+    BtCursor *pCur,               /* Cursor to search */
+    UnpackedRecord *pIdxKey,      /* Index key, or NULL for a table */
+    i64 intKey,                   /* Table key */
+    int *pLwr,                    /* IN/OUT: First cell to compare */
+    int *pUpr                     /* IN/OUT: Last cell to compare */
+)
+{
+    MemPage *pPage = pCur->apPage[pCur->iPage];
+    BtKeyCache *p;
+    u64 mask = 0;
+
+    if (pIdxKey)
+    {
+        KeyInfo *pKeyInfo = pIdxKey->pKeyInfo;
+        if (pPage->hasPrefix || !sqlite3VdbeRecordIntKey(pIdxKey, &intKey))
+        {
+            return;
+        }
+        if (pKeyInfo->nField > 0 && pKeyInfo->aSortOrder && pKeyInfo->aSortOrder[0])
+        {
+            mask = ~(u64)0;
+            intKey = (i64)((u64)intKey ^ mask);
+        }
+    }
+    p = keyCacheGet(pPage, mask);
+    if (p)
+    {
+        int lo = keyCacheBound(p->aKey, p->nKey, intKey);
+        int hi = p->nKey;
+        if (intKey < LARGEST_INT64)
+        {
+            hi = keyCacheBound(p->aKey, p->nKey, intKey + 1);
+        }
+        if (lo == hi)
+        {
+            if (lo == p->nKey) lo--;
+            hi = lo + 1;
+        }
+        *pLwr = lo;
+        *pUpr = hi - 1;
+    }
+}
+#endif /* SQLITE_BTREE_KEYCACHE>0 */
+
 /* Move the cursor so that it points to an entry near the key
 ** specified by pIdxKey or intKey.   Return a success code.
 ** 移动游标,使得它靠近一条记录(entry)(此记录被pIdxKey或者intkey索引)
@@ -5166,6 +6416,10 @@ int sqlite3BtreeLast(BtCursor *pCur, int *pRes)
 **     *pRes>0      The cursor is left pointing at an entry that
 **                  is larger than intKey/pIdxKey.
 **
+** A cursor that is already positioned starts the search from the lowest
+** page on its path whose key range holds the key, not from the root.
+** Within a page that is searched often, the search is narrowed using a
+** decoded copy of its keys (see BtKeyCache) before any cell is parsed.
 */
 int sqlite3BtreeMovetoUnpacked(
     BtCursor *pCur,          /* The cursor to be moved */
@@ -5176,6 +6430,7 @@ int sqlite3BtreeMovetoUnpacked(
 )
 {
     int rc;
+    int bMoved = 0;
 
     assert(cursorHoldsMutex(pCur));
     assert(sqlite3_mutex_held(pCur->pBtree->db->mutex));
@@ -5200,17 +6455,25 @@ int sqlite3BtreeMovetoUnpacked(
         }
     }
 
-    rc = moveToRoot(pCur);
-    if (rc)
+    if (pCur->eState == CURSOR_VALID && pCur->iPage > 0)
     {
-        return rc;
+        rc = moveToAncestor(pCur, pIdxKey, intKey, &bMoved);
+        if (rc) return rc;
     }
-    assert(pCur->pgnoRoot == 0 || pCur->apPage[pCur->iPage]);
-    assert(pCur->pgnoRoot == 0 || pCur->apPage[pCur->iPage]->isInit);
-    assert(pCur->eState == CURSOR_INVALID || pCur->apPage[pCur->iPage]->nCell > 0);
-    if (pCur->eState == CURSOR_INVALID)
+    if (!bMoved)
     {
-        *pRes = -1;
+        rc = moveToRoot(pCur);
+        if (rc)
+        {
+            return rc;
+        }
+    }
+    assert(pCur->pgnoRoot == 0 || pCur->apPage[pCur->iPage]);
+    assert(pCur->pgnoRoot == 0 || pCur->apPage[pCur->iPage]->isInit);
+    assert(pCur->eState == CURSOR_INVALID || pCur->apPage[pCur->iPage]->nCell > 0);
+    if (pCur->eState == CURSOR_INVALID)
+    {
+        *pRes = -1;
         assert(pCur->pgnoRoot == 0 || pCur->apPage[pCur->iPage]->nCell == 0);
         return SQLITE_OK;
     }
@@ -5236,6 +6499,9 @@ int sqlite3BtreeMovetoUnpacked(
         assert(pPage->intKey == (pIdxKey == 0));
         lwr = 0;
         upr = pPage->nCell - 1; /* 二分查找 */
+#if SQLITE_BTREE_KEYCACHE>0
+        keyCacheSearch(pCur, pIdxKey, intKey, &lwr, &upr);
+#endif
         if (biasRight)
         {
             pCur->aiIdx[pCur->iPage] = (u16)(idx = upr);
@@ -5288,7 +6554,12 @@ int sqlite3BtreeMovetoUnpacked(
                 ** 2 bytes of the cell.
                 */
                 int nCell = pCell[0];
-                if (nCell <= pPage->max1bytePayload
+                if (pPage->hasPrefix)
+                {
+                    rc = prefixCompare(pCur, pCell - pPage->childPtrSize, pIdxKey, &c);
+                    if (rc) goto moveto_finish;
+                }
+                else if (nCell <= pPage->max1bytePayload
                     /* && (pCell+nCell)<pPage->aDataEnd */
                    )
                 {
@@ -5413,6 +6684,77 @@ int sqlite3BtreeEof(BtCursor *pCur)
     return (CURSOR_VALID != pCur->eState);
 }
 
+/*
+** Number of sibling leaf pages that a cursor scanning a b-tree in order
+** asks the pager to read ahead.
+*/
+#ifndef SQLITE_BTREE_READAHEAD
+# define SQLITE_BTREE_READAHEAD 16
+#endif
+
+/*
+** The cursor has just stepped from one leaf page to the next (or, if
+** bPrev is true, to the previous) leaf in the tree. Once this has happened
+** twice in a row, ask the pager to read the following SQLITE_BTREE_READAHEAD
+** siblings, found in the parent page's cell array, into the page cache.
+** The request is repeated each time the cursor enters a new parent page
+** and after every SQLITE_BTREE_READAHEAD/2 leaves, so that pages are read
+** well before they are needed. The pager skips pages that are already
+** cached.
+** 顺序扫描叶子节点时预读后续的兄弟页
+*/
+static void btreeReadAhead(BtCursor *pCur, int bPrev)
+{
+    Pgno aPgno[SQLITE_BTREE_READAHEAD];
+    MemPage *pParent;
+    int iIdx;
+    int nPgno = 0;
+    int i;
+
+    if (pCur->iPage < 1 || !pCur->apPage[pCur->iPage]->leaf) return;
+    if (pCur->nSeqLeaf < 0xff) pCur->nSeqLeaf++;
+    if (pCur->nSeqLeaf < 2) return;
+
+    pParent = pCur->apPage[pCur->iPage - 1];
+    iIdx = pCur->aiIdx[pCur->iPage - 1];
+    if (pCur->nSeqLeaf != 2
+            && iIdx != (bPrev ? pParent->nCell : 0)
+            && (iIdx % (SQLITE_BTREE_READAHEAD / 2)) != 0)
+    {
+        return;
+    }
+
+    for (i = 1; i <= SQLITE_BTREE_READAHEAD; i++)
+    {
+        int iChild = (bPrev ? iIdx - i : iIdx + i);
+        if (iChild < 0 || iChild > pParent->nCell) break;
+        if (iChild == pParent->nCell)
+        {
+            aPgno[nPgno++] = get4byte(&pParent->aData[pParent->hdrOffset + 8]);
+        }
+        else
+        {
+            aPgno[nPgno++] = get4byte(findCell(pParent, iChild));
+        }
+    }
+
+    /* Present the pages in file order, so that runs of adjacent pages can
+    ** be read together even when scanning backwards. */
+    if (bPrev)
+    {
+        for (i = 0; i < nPgno / 2; i++)
+        {
+            Pgno t = aPgno[i];
+            aPgno[i] = aPgno[nPgno - 1 - i];
+            aPgno[nPgno - 1 - i] = t;
+        }
+    }
+    if (nPgno > 0)
+    {
+        sqlite3PagerPrefetch(pCur->pBt->pPager, aPgno, nPgno);
+    }
+}
+
 /*
 ** Advance the cursor to the next entry in the database.  If
 ** successful then set *pRes=0.  If the cursor
@@ -5468,6 +6810,7 @@ int sqlite3BtreeNext(BtCursor *pCur, int *pRes)
             rc = moveToChild(pCur, get4byte(&pPage->aData[pPage->hdrOffset + 8]));
             if (rc) return rc;
             rc = moveToLeftmost(pCur);
+            if (rc == SQLITE_OK) btreeReadAhead(pCur, 0);
             *pRes = 0;
             return rc;
         }
@@ -5499,6 +6842,7 @@ int sqlite3BtreeNext(BtCursor *pCur, int *pRes)
         return SQLITE_OK;
     }
     rc = moveToLeftmost(pCur);
+    if (rc == SQLITE_OK) btreeReadAhead(pCur, 0);
     return rc;
 }
 
@@ -5547,6 +6891,7 @@ int sqlite3BtreePrevious(BtCursor *pCur, int *pRes)
             return rc;
         }
         rc = moveToRightmost(pCur); /* 移动到最右边 */
+        if (rc == SQLITE_OK) btreeReadAhead(pCur, 1);
     }
     else /* page为叶子节点,包含实际的记录 */
     {
@@ -5860,7 +7205,7 @@ static int allocateBtreePage(
                         memcpy(&aData[8 + closest * 4], &aData[4 + k * 4], 4);
                     }
                     put4byte(&aData[4], k - 1);
-                    noContent = !btreeGetHasContent(pBt, *pPgno);
+                    noContent = !btreeGetHasContent(pBt, *pPgno) ? PAGER_ACQUIRE_NOCONTENT : 0;
                     rc = btreeGetPage(pBt, *pPgno, ppPage, noContent);
                     if (rc == SQLITE_OK)
                     {
@@ -5897,7 +7242,7 @@ static int allocateBtreePage(
             MemPage *pPg = 0;
             TRACE(("ALLOCATE: %d from end of file (pointer-map page)\n", pBt->nPage));
             assert(pBt->nPage != PENDING_BYTE_PAGE(pBt));
-            rc = btreeGetPage(pBt, pBt->nPage, &pPg, 1); /* 获取一个新的页 */
+            rc = btreeGetPage(pBt, pBt->nPage, &pPg, PAGER_ACQUIRE_NOCONTENT); /* 获取一个新的页 */
             if (rc == SQLITE_OK)
             {
                 rc = sqlite3PagerWrite(pPg->pDbPage);
@@ -5915,7 +7260,7 @@ static int allocateBtreePage(
         *pPgno = pBt->nPage;
 
         assert(*pPgno != PENDING_BYTE_PAGE(pBt));
-        rc = btreeGetPage(pBt, *pPgno, ppPage, 1);
+        rc = btreeGetPage(pBt, *pPgno, ppPage, PAGER_ACQUIRE_NOCONTENT);
         if (rc) return rc;
         rc = sqlite3PagerWrite((*ppPage)->pDbPage);
         if (rc != SQLITE_OK)
@@ -6251,6 +7596,12 @@ static int fillInCell(
         nData = nZero = 0;
     }
     nHeader += putVarint(&pCell[nHeader], *(u64*)&nKey); /* key所占用的字节数 */
+    if (pPage->hasPrefix)
+    {
+        /* nShared is zero.  The cell may be compressed once it is known
+        ** where on the page it goes. */
+        pCell[nHeader++] = 0;
+    }
     btreeParseCellPtr(pPage, pCell, &info);
     assert(info.nHeader == nHeader);
     assert(info.nKey == nKey);
@@ -6407,6 +7758,7 @@ static void dropCell(MemPage *pPage, int idx, int sz, int *pRC)
 
     assert(idx >= 0 && idx < pPage->nCell);
     assert(sz == cellSize(pPage, idx));
+    keyCacheDiscard(pPage);
     assert(sqlite3PagerIswriteable(pPage->pDbPage));
     assert(sqlite3_mutex_held(pPage->pBt->mutex));
     data = pPage->aData;
@@ -6496,6 +7848,7 @@ static void insertCell(
     ** might be less than 8 (leaf-size + pointer) on the interior node.  Hence
     ** the term after the || in the following assert(). */
     assert(sz == cellSizePtr(pPage, pCell) || (sz == 8 && iChild > 0));
+    keyCacheDiscard(pPage);
     /* page已经没有多余空间了,需要溢出 */
     if (pPage->nOverflow || sz + 2 > pPage->nFree)
     {
@@ -6568,6 +7921,45 @@ static void insertCell(
     }
 }
 
+/*
+** Remove the idx-th cell, of sz bytes, from page pPage, as dropCell()
+** does.  On a prefix page, if the cell is the anchor of the cell after it,
+** that cell is expanded in aSpace[] and put back in its place, so that it
+** becomes an anchor instead.  This never needs more space than the two
+** cells used, as the anchor holds all the bytes that were shared.
+*/
+static void prefixDropCell(MemPage *pPage, int idx, int sz, u8 *aSpace, int *pRC)
+{
+    if (*pRC) return;
+    if (pPage->hasPrefix && idx + 1 < pPage->nCell)
+    {
+        u8 *pCell = findCell(pPage, idx);
+        u8 *pNext = findCell(pPage, idx + 1);
+        if (prefixIsAnchor(pPage, pCell) && !prefixIsAnchor(pPage, pNext))
+        {
+            int szNext = cellSizePtr(pPage, pNext);
+            int szNew;
+            u8 nOverflow = pPage->nOverflow;
+            *pRC = prefixExpand(pPage, pNext, pCell, aSpace, &szNew);
+            dropCell(pPage, idx + 1, szNext, pRC);
+            dropCell(pPage, idx, sz, pRC);
+            if (*pRC) return;
+            if (szNew + 2 > pPage->nFree)
+            {
+                *pRC = SQLITE_CORRUPT_BKPT;
+                return;
+            }
+            /* szNew fits, so the cell goes straight onto the page.  Any
+            ** overflow cells keep their indexes. */
+            pPage->nOverflow = 0;
+            insertCell(pPage, idx, aSpace, szNew, 0, 0, pRC);
+            pPage->nOverflow = nOverflow;
+            return;
+        }
+    }
+    dropCell(pPage, idx, sz, pRC);
+}
+
 /*
 ** Add a list of cells to a page.  The page should be initially empty.
 ** The cells are guaranteed to fit on the page.
@@ -6631,6 +8023,19 @@ static void assemblePage(
 #define NN 1             /* Number of neighbors on either side of pPage */
 #define NB (NN*2+1)      /* Total pages involved in the balance */
 
+/*
+** When balancing prefix pages, balance_nonroot() keeps expanded copies of
+** cells in slots of one buffer: the dividers taken from the parent, the
+** first cell of each new sibling (there may be two more siblings than
+** usual, as these cells take more space when expanded), the divider being
+** inserted into the parent, and scratch space for prefixDropCell().
+*/
+#define PREFIX_SLOT_DIV(i)    (i)
+#define PREFIX_SLOT_FIRST(i)  (NB - 1 + (i))
+#define PREFIX_SLOT_UP        (2 * NB + 2)
+#define PREFIX_SLOT_DROP      (2 * NB + 3)
+#define PREFIX_NSLOT          (2 * NB + 4)
+
 
 #ifndef SQLITE_OMIT_QUICKBALANCE
 /*
@@ -6935,7 +8340,8 @@ static int balance_nonroot(
     int iParentIdx,                 /* Index of "the page" in pParent */
     u8 *aOvflSpace,                 /* page-size bytes of space for parent ovfl */
     int isRoot,                     /* True if pParent is a root-page */
-    int bBulk                       /* True if this call is part of a bulk load */
+    int bBulk,                      /* True if this call is part of a bulk load */
+    int bCompress                   /* True to prefix-compress new dividers */
 )
 {
     BtShared *pBt;               /* The whole database */
@@ -6961,20 +8367,25 @@ static int balance_nonroot(
     MemPage *apOld[NB];          /* pPage and up to two siblings */
     MemPage *apCopy[NB];         /* Private copies of apOld[] pages */
     /* 当前页(pPage)以及最多NB个兄弟页面(平衡之后) */
-    MemPage *apNew[NB + 2];      /* pPage and up to NB siblings after balancing */
+    MemPage *apNew[NB + 4];      /* pPage and up to NB+3 siblings after balancing */
     /* 右兄弟的页号 */
     u8 *pRight;                  /* Location in parent of right-sibling pointer */
+    int iRight = -1;             /* Index of the cell pRight is in, if any */
     /* 在pParent中分割cell */
     u8 *apDiv[NB - 1];           /* Divider cells in pParent */
-    int cntNew[NB + 2];          /* Index in aCell[] of cell after i-th page */
+    int cntNew[NB + 4];          /* Index in aCell[] of cell after i-th page */
     /* 第i个page中 cell的总大小 */
-    int szNew[NB + 2];           /* Combined size of cells place on i-th page */
+    int szNew[NB + 4];           /* Combined size of cells place on i-th page */
     /* 指向还未平衡之前的cell */
     u8 **apCell = 0;             /* All cells begin balanced */
     /* cell大小 */
     u16 *szCell;                 /* Local size of all cells in apCell[] */
+    u16 *szFull;                 /* Size of each cell of apCell[] if expanded */
     u8 *aSpace1;                 /* Space for copies of dividers cells */
     Pgno pgno;                   /* Temp var to store a page number in */
+    u8 *aPrefix = 0;             /* PREFIX_NSLOT slots for expanded cells */
+    int szPrefix = 0;            /* Size of each slot in aPrefix[] */
+    int mxNew = NB + 1;          /* Largest allowed index in apNew[] */
 
     pBt = pParent->pBt;
     assert(sqlite3_mutex_held(pBt->mutex));
@@ -6998,6 +8409,16 @@ static int balance_nonroot(
     {
         return SQLITE_NOMEM;
     }
+    if (pParent->hasPrefix)
+    {
+        szPrefix = ROUND8(pBt->maxLocal + 23);
+        aPrefix = (u8 *)sqlite3Malloc(szPrefix * PREFIX_NSLOT);
+        if (!aPrefix)
+        {
+            return SQLITE_NOMEM;
+        }
+        mxNew = NB + 3;
+    }
 
     /* Find the sibling pages to balance. Also locate the cells in pParent
     ** that divide the siblings. An attempt is made to find NN siblings on
@@ -7084,17 +8505,24 @@ static int balance_nonroot(
         ** 我们可以看到,无论从那一页开始读,肯定会读取到当前页
         */
         /* 找到cell,cell的头4个字节记录的是左兄弟页面的页号 */
-        pRight = findCell(pParent, i + nxDiv - pParent->nOverflow);
+        iRight = i + nxDiv - pParent->nOverflow;
+        pRight = findCell(pParent, iRight);
     }
     pgno = get4byte(pRight); /* 获取子页面的页号 */
     while (1)
     {
-        rc = getAndInitPage(pBt, pgno, &apOld[i]); /* 获得页 */
+        rc = getAndInitPage(pBt, pgno, &apOld[i], 0); /* 获得页 */
         if (rc)
         {
             memset(apOld, 0, (i + 1)*sizeof(MemPage*));
             goto balance_cleanup;
         }
+        if (apOld[i]->hasPrefix != pParent->hasPrefix)
+        {
+            rc = SQLITE_CORRUPT_BKPT;
+            memset(apOld, 0, i * sizeof(MemPage*));
+            goto balance_cleanup;
+        }
         nMaxCells += 1 + apOld[i]->nCell + apOld[i]->nOverflow; /* 累加cell的个数 */
         if ((i--) == 0) break; /* 拷贝i个页面  */
         if (i + nxDiv == pParent->aiOvfl[0] && pParent->nOverflow)
@@ -7105,6 +8533,19 @@ static int balance_nonroot(
             apDiv[i] = pParent->apOvfl[0];
             pgno = get4byte(apDiv[i]); /* 左兄弟页面的页号 */
             szNew[i] = cellSizePtr(pParent, apDiv[i]); /* cell大小 */
+            if (aPrefix)
+            {
+                u8 *pSlot = &aPrefix[PREFIX_SLOT_DIV(i) * szPrefix];
+                rc = prefixExpand(pParent, apDiv[i],
+                                  prefixAnchor(pParent, pParent->aiOvfl[0]),
+                                  pSlot, &szNew[i]);
+                apDiv[i] = pSlot;
+                if (rc)
+                {
+                    memset(apOld, 0, (i + 1)*sizeof(MemPage*));
+                    goto balance_cleanup;
+                }
+            }
             pParent->nOverflow = 0;
         }
         else /* i + nxDiv != pParent->nOverflow || !pParent->nOverfow */
@@ -7114,6 +8555,28 @@ static int balance_nonroot(
             pgno = get4byte(apDiv[i]); /* 左兄弟页面的页号 */
             szNew[i] = cellSizePtr(pParent, apDiv[i]);
 
+            if (aPrefix)
+            {
+                /* Keep an expanded copy of the divider, then remove it from
+                ** pParent without leaving the cell after it without an
+                ** anchor. */
+                int iDiv = i + nxDiv - pParent->nOverflow;
+                int szDiv = szNew[i];
+                u8 *pSlot = &aPrefix[PREFIX_SLOT_DIV(i) * szPrefix];
+                rc = prefixExpand(pParent, apDiv[i], prefixAnchor(pParent, iDiv),
+                                  pSlot, &szNew[i]);
+                apDiv[i] = pSlot;
+                prefixDropCell(pParent, iDiv, szDiv,
+                               &aPrefix[PREFIX_SLOT_DROP * szPrefix], &rc);
+                iRight--;
+                if (rc)
+                {
+                    memset(apOld, 0, (i + 1)*sizeof(MemPage*));
+                    goto balance_cleanup;
+                }
+                continue;
+            }
+
             /* Drop the cell from the parent page. apDiv[i] still points to
             ** the cell within the parent, even though it has been dropped.
             ** This is safe because dropping a cell only overwrites the first
@@ -7153,6 +8616,9 @@ static int balance_nonroot(
         }
     }
 
+    /* prefixDropCell() may have moved the cell that pRight points into */
+    if (aPrefix && iRight >= 0) pRight = findCell(pParent, iRight);
+
     /* Make nMaxCells a multiple of 4 in order to preserve 8-byte
     ** alignment */
     nMaxCells = (nMaxCells + 3) & ~3;
@@ -7164,6 +8630,7 @@ static int balance_nonroot(
     szScratch =
         nMaxCells * sizeof(u8*)                     /* apCell */
         + nMaxCells * sizeof(u16)                     /* szCell */
+        + (aPrefix ? nMaxCells * sizeof(u16) : 0)     /* szFull */
         + pBt->pageSize                               /* aSpace1 */
         + k * nOld;                                   /* Page copies (apCopy) */
     apCell = sqlite3ScratchMalloc(szScratch);
@@ -7173,7 +8640,11 @@ static int balance_nonroot(
         goto balance_cleanup;
     }
     szCell = (u16*)&apCell[nMaxCells];
-    aSpace1 = (u8*)&szCell[nMaxCells];
+    /* Without prefix compression a cell is the same size wherever it is,
+    ** so szFull[] is just szCell[].
+    */
+    szFull = aPrefix ? &szCell[nMaxCells] : szCell;
+    aSpace1 = (u8*)&szFull[nMaxCells];
     assert(EIGHT_BYTE_ALIGNMENT(aSpace1));
 
     /*
@@ -7297,16 +8768,31 @@ static int balance_nonroot(
     **
     */
     usableSpace = pBt->usableSize - 12 + leafCorrection;
+
+    /* The first cell on each sibling page must be an anchor.  On prefix
+    ** pages, szFull[] is the size each cell would be if it were first, so
+    ** that the loops below can account for that.
+    */
+    for (i = 0; i < nCell; i++)
+    {
+        szFull[i] = szCell[i];
+        if (aPrefix && !prefixIsAnchor(apCopy[0], apCell[i]))
+        {
+            szFull[i] = (u16)prefixExpandedSize(apCopy[0], apCell[i], szCell[i]);
+        }
+    }
+
     /* 非常简单的一个循环
     **
     */
     for (subtotal = k = i = 0; i < nCell; i++)
     {
+        int sz = (subtotal ? szCell[i] : szFull[i]);
         assert(i < nMaxCells);
-        subtotal += szCell[i] + 2;
+        subtotal += sz + 2;
         if (subtotal > usableSpace) /* 一个page已经满了 */
         {
-            szNew[k] = subtotal - szCell[i];
+            szNew[k] = subtotal - sz;
             cntNew[k] = i; /* [cntNew[k-1], cntNew[k])这个索引范围内的cell都要放入第k个页面 */
             if (leafData)
             {
@@ -7314,7 +8800,7 @@ static int balance_nonroot(
             }
             subtotal = 0; /* 重新开始统计 */
             k++; /* 需要额外分配一个页 */
-            if (k > NB + 1)
+            if (k > mxNew)
             {
                 rc = SQLITE_CORRUPT_BKPT;
                 goto balance_cleanup;
@@ -7349,17 +8835,25 @@ static int balance_nonroot(
         /* 左兄弟或者右兄弟 中第一个cell的索引 */
         int d;              /* Index of first cell to the left of right sibling */
 
+        int iFirst = (i == 1 ? 0 : cntNew[i - 2] + !leafData); /* First on left */
+        int szD;            /* Growth of the right sibling if d is moved */
+        int szR;            /* Shrinkage of the left sibling */
+
         r = cntNew[i - 1] - 1;
         d = r + 1 - leafData;
         assert(d < nMaxCells);
         assert(r < nMaxCells);
-        while (szRight == 0
-               || (!bBulk && szRight + szCell[d] + 2 <= szLeft - (szCell[r] + 2))
-              )
-        {
+        while (1)
+        {
+            /* Cell d becomes the first cell of the right sibling, and the
+            ** cell that was first no longer has to be an anchor. */
+            szD = szFull[d] + 2;
+            if (szRight) szD += szCell[d + 1] - szFull[d + 1];
+            szR = (r == iFirst ? szFull[r] : szCell[r]) + 2;
+            if (szRight != 0 && (bBulk || szRight + szD > szLeft - szR)) break;
             /* 关于这里的代码,其实只是一种策略而已,细微调整,尽量保证兄弟页的平衡 */
-            szRight += szCell[d] + 2; /* 添加至右 */
-            szLeft -= szCell[r] + 2;
+            szRight += szD; /* 添加至右 */
+            szLeft -= szR;
             cntNew[i - 1]--;
             r = cntNew[i - 1] - 1;
             d = r + 1 - leafData;
@@ -7486,6 +8980,33 @@ static int balance_nonroot(
     assert(sqlite3PagerIswriteable(pParent->pDbPage));
     put4byte(pRight, apNew[nNew - 1]->pgno); /* pRight的 */
 
+    /* On prefix pages, replace the first cell of each sibling that is not
+    ** an anchor by an expanded copy.  Cells that come after it on the same
+    ** sibling and shared bytes with an anchor further left share the same
+    ** bytes with it, as the keys are in order.
+    */
+    if (aPrefix)
+    {
+        for (i = 0; i < nNew; i++)
+        {
+            int iFirst = (i == 0 ? 0 : cntNew[i - 1] + 1);
+            if (iFirst < cntNew[i] && !prefixIsAnchor(apCopy[0], apCell[iFirst]))
+            {
+                u8 *pSlot = &aPrefix[PREFIX_SLOT_FIRST(i) * szPrefix];
+                u8 *pAnchor = 0;
+                int sz;
+                for (j = iFirst - 1; j >= 0 && pAnchor == 0; j--)
+                {
+                    if (prefixIsAnchor(apCopy[0], apCell[j])) pAnchor = apCell[j];
+                }
+                rc = prefixExpand(apCopy[0], apCell[iFirst], pAnchor, pSlot, &sz);
+                if (rc) goto balance_cleanup;
+                apCell[iFirst] = pSlot;
+                szCell[iFirst] = (u16)sz;
+            }
+        }
+    }
+
     /*
     ** Evenly distribute the data in apCell[] across the new pages.
     ** Insert divider cells into pParent as necessary.
@@ -7561,9 +9082,34 @@ static int balance_nonroot(
                     sz = cellSizePtr(pParent, pCell);
                 }
             }
+            if (aPrefix)
+            {
+                /* Expand the divider against its anchor in apCell[], then
+                ** compress it against its anchor in pParent. */
+                u8 *pSlot = &aPrefix[PREFIX_SLOT_UP * szPrefix];
+                u8 *pAnchor = 0;
+                int iCell;
+                for (iCell = j - 1; iCell >= 0 && pAnchor == 0; iCell--)
+                {
+                    if (prefixIsAnchor(apCopy[0], apCell[iCell])) pAnchor = apCell[iCell];
+                }
+                rc = prefixExpand(apCopy[0], apCell[j], pAnchor, &pSlot[leafCorrection], &sz);
+                if (rc) goto balance_cleanup;
+                pCell = pSlot;
+                sz += leafCorrection;
+                if (bCompress && nxDiv > pParent->nOverflow)
+                {
+                    pAnchor = prefixAnchor(pParent, nxDiv - pParent->nOverflow);
+                    if (pAnchor)
+                    {
+                        sz = prefixCompress(pParent, pCell, sz, pAnchor,
+                                            pParent->nOverflow ? 0 : findCell(pParent, nxDiv - 1));
+                    }
+                }
+            }
             iOvflSpace += sz;
             assert(sz <= pBt->maxLocal + 23);
-            assert(iOvflSpace <= (int)pBt->pageSize);
+            assert(iOvflSpace <= (int)pBt->pageSize * (aPrefix ? 2 : 1));
             /* 插入一个cell,插入到父页 */
             insertCell(pParent, nxDiv, pCell, sz, pTemp, pNew->pgno, &rc);
             if (rc != SQLITE_OK) goto balance_cleanup;
@@ -7698,7 +9244,7 @@ static int balance_nonroot(
                 {
                     ptrmapPut(pBt, get4byte(apCell[i]), PTRMAP_BTREE, pNew->pgno, &rc);
                 }
-                if (szCell[i] > pNew->minLocal)
+                if (szCell[i] > pNew->minLocal || pNew->hasPrefix)
                 {
                     ptrmapPutOvflPtr(pNew, apCell[i], &rc);
                 }
@@ -7733,6 +9279,7 @@ static int balance_nonroot(
     */
 balance_cleanup:
     sqlite3ScratchFree(apCell);
+    sqlite3_free(aPrefix);
     for (i = 0; i < nOld; i++)
     {
         releasePage(apOld[i]);
@@ -7810,6 +9357,8 @@ static int balance_deeper(MemPage *pRoot, MemPage **ppChild)
 
     /* Copy the overflow cells from pRoot to pChild */
     /* 将溢出的cell从pRoot中拷贝至pChild */
+    memcpy(pChild->aiOvfl, pRoot->aiOvfl,
+           pRoot->nOverflow * sizeof(pRoot->aiOvfl[0]));
     memcpy(pChild->apOvfl, pRoot->apOvfl,
            pRoot->nOverflow * sizeof(pRoot->apOvfl[0]));
     pChild->nOverflow = pRoot->nOverflow;
@@ -7948,8 +9497,9 @@ static int balance(BtCursor *pCur)
                     **
                     */
                     /* 分配一个页大小的buffer */
-                    u8 *pSpace = sqlite3PageMalloc(pCur->pBt->pageSize);
-                    rc = balance_nonroot(pParent, iIdx, pSpace, iPage == 1, pCur->hints);
+                    u8 *pSpace = sqlite3PageMalloc(pCur->pBt->pageSize * (pPage->hasPrefix ? 2 : 1));
+                    rc = balance_nonroot(pParent, iIdx, pSpace, iPage == 1, pCur->hints,
+                                         pCur->prefixOk);
                     if (pFree)
                     {
                         /* If pFree is not NULL, it points to the pSpace buffer used
@@ -8113,7 +9663,11 @@ int sqlite3BtreeInsert(
         }
         szOld = cellSizePtr(pPage, oldCell);
         rc = clearCell(pPage, oldCell);
-        dropCell(pPage, idx, szOld, &rc);
+        if (pPage->hasPrefix && rc == SQLITE_OK && prefixSpace(pCur) == 0)
+        {
+            rc = SQLITE_NOMEM;
+        }
+        prefixDropCell(pPage, idx, szOld, pCur->aPrefix, &rc);
         if (rc) goto end_insert;
     }
     else if (loc < 0 && pPage->nCell > 0)
@@ -8125,6 +9679,15 @@ int sqlite3BtreeInsert(
     {
         assert(pPage->leaf);
     }
+    if (pPage->hasPrefix && pCur->prefixOk && idx > 0)
+    {
+        u8 *pAnchor = prefixAnchor(pPage, idx);
+        if (pAnchor)
+        {
+            szNew = prefixCompress(pPage, newCell, szNew, pAnchor,
+                                   findCell(pPage, idx - 1));
+        }
+    }
     insertCell(pPage, idx, newCell, szNew, 0, 0, &rc); /* 插入一个cell */
     assert(rc != SQLITE_OK || pPage->nCell > 0 || pPage->nOverflow > 0);
 
@@ -8168,6 +9731,422 @@ end_insert:
     return rc;
 }
 
+/*
+** State of a bulk load started by sqlite3BtreeBulkInsert().  The keys
+** arrive in sorted order, so each one is appended to the rightmost leaf
+** and the tree is built from the bottom up without calling balance().
+**
+** aLevel[0] describes the leaves, aLevel[1] their parents and so on.  When
+** the page being filled on some level is full, the cell that did not fit
+** is held back in aPending[] as the divider between that page and the next
+** page on the same level.  It is passed up to the level above once the
+** next page has been started.  The root page is always the first page of
+** the topmost level.
+*/
+struct BtBulk
+{
+    int nLevel;                   /* Number of levels in aLevel[] */
+    int nReserve;                 /* Bytes of each page to leave unused */
+    u8 bDisabled;                 /* Use sqlite3BtreeInsert() instead */
+    u8 ptfFlags;                  /* Flags of the root page, less PTF_LEAF */
+    struct BtBulkLevel
+    {
+        MemPage *pPage;           /* Page being filled, or NULL */
+        Pgno iPrev;               /* Last full page on this level */
+        u8 *aPending;             /* Child pointer and held-back cell */
+        u8 bPending;              /* True if aPending[] holds a cell */
+    } aLevel[BTCURSOR_MAX_DEPTH];
+};
+
+/*
+** Release all resources held by the bulk load in progress on cursor pCur.
+*/
+static void btreeBulkFree(BtCursor *pCur)
+{
+    BtBulk *pBulk = pCur->pBulk;
+    if (pBulk)
+    {
+        int i;
+        for (i = 0; i < BTCURSOR_MAX_DEPTH; i++)
+        {
+            releasePage(pBulk->aLevel[i].pPage);
+            sqlite3_free(pBulk->aLevel[i].aPending);
+        }
+        sqlite3_free(pBulk);
+        pCur->pBulk = 0;
+    }
+}
+
+/*
+** Start a bulk load on cursor pCur.  A bulk load is only possible if the
+** tree is empty and no other cursor is open on it.  Otherwise the keys
+** are inserted one at a time as usual.
+*/
+static int btreeBulkStart(BtCursor *pCur)
+{
+    BtShared *pBt = pCur->pBt;
+    BtBulk *pBulk;
+    BtCursor *p;
+    int rc = SQLITE_OK;
+
+    pBulk = (BtBulk *)sqlite3MallocZero(sizeof(BtBulk));
+    if (pBulk == 0) return SQLITE_NOMEM;
+    pCur->pBulk = pBulk;
+    pBulk->nReserve = pBt->usableSize * (100 - SQLITE_BULKLOAD_FILL) / 100;
+
+    for (p = pBt->pCursor; p; p = p->pNext)
+    {
+        if (p != pCur && p->pgnoRoot == pCur->pgnoRoot) pBulk->bDisabled = 1;
+    }
+    if (!pBulk->bDisabled)
+    {
+        MemPage *pRoot;
+        rc = getAndInitPage(pBt, pCur->pgnoRoot, &pRoot, 0);
+        if (rc) return rc;
+        if (!pRoot->leaf || pRoot->intKey || pRoot->nCell > 0)
+        {
+            pBulk->bDisabled = 1;
+        }
+        pBulk->ptfFlags = pRoot->aData[pRoot->hdrOffset] & ~PTF_LEAF;
+        releasePage(pRoot);
+    }
+    if (!pBulk->bDisabled)
+    {
+        /* The cursor does not move while the tree is built. */
+        int i;
+        for (i = 0; i <= pCur->iPage; i++)
+        {
+            releasePage(pCur->apPage[i]);
+        }
+        pCur->iPage = -1;
+        pCur->eState = CURSOR_INVALID;
+    }
+    return rc;
+}
+
+/*
+** Make sure there is a page being filled on level iLevel of the bulk load
+** in progress on pCur.  The first page of a new topmost level is the
+** root page.  Other pages are newly allocated.
+*/
+static int btreeBulkPage(BtCursor *pCur, int iLevel)
+{
+    BtBulk *pBulk = pCur->pBulk;
+    struct BtBulkLevel *pLvl = &pBulk->aLevel[iLevel];
+    int rc = SQLITE_OK;
+
+    if (pLvl->pPage == 0)
+    {
+        BtShared *pBt = pCur->pBt;
+        MemPage *pPage = 0;
+        if (iLevel == pBulk->nLevel)
+        {
+            rc = btreeGetPage(pBt, pCur->pgnoRoot, &pPage, 0);
+            if (rc == SQLITE_OK)
+            {
+                rc = sqlite3PagerWrite(pPage->pDbPage);
+                if (rc)
+                {
+                    releasePage(pPage);
+                    return rc;
+                }
+            }
+            pBulk->nLevel++;
+        }
+        else
+        {
+            /* As in balance_nonroot() for a bulk insert, ask for the lowest
+            ** free page, so that the pages are allocated, and written, in
+            ** ascending order. */
+            Pgno pgno;
+            rc = allocateBtreePage(pBt, &pPage, &pgno, 1, 0);
+        }
+        if (rc) return rc;
+        zeroPage(pPage, pBulk->ptfFlags | (iLevel == 0 ? PTF_LEAF : 0));
+        pLvl->pPage = pPage;
+    }
+    return rc;
+}
+
+/*
+** Append a cell to the page being filled on level iLevel of the bulk load
+** in progress on pCur.  On the leaf level, pCell is a leaf cell of nCell
+** bytes.  On other levels pCell points to four bytes of space for the
+** child page number, iChild, followed by the rest of the cell.
+**
+** If the cell does not fit, the page is finished and the cell is held
+** back until the next page on the same level is started.
+*/
+static int btreeBulkAppend(
+    BtCursor *pCur,               /* Cursor doing the bulk load */
+    int iLevel,                   /* Level to append to.  0 for leaves */
+    u8 *pCell,                    /* Cell to append */
+    int nCell,                    /* Size of pCell, if iLevel is 0 */
+    Pgno iChild                   /* Child page, if iLevel is not 0 */
+)
+{
+    BtBulk *pBulk = pCur->pBulk;
+    struct BtBulkLevel *pLvl;
+    BtShared *pBt = pCur->pBt;
+    MemPage *pPage;
+    u8 *pIns;                     /* Cell to insert: pCell or a compressed copy */
+    int nIns;                     /* Size of pIns */
+    int rc = SQLITE_OK;
+
+    if (iLevel >= BTCURSOR_MAX_DEPTH) return SQLITE_CORRUPT_BKPT;
+    pLvl = &pBulk->aLevel[iLevel];
+    if (pLvl->bPending)
+    {
+        /* A new page is started on this level.  The held-back cell divides
+        ** it from the last full page. */
+        pLvl->bPending = 0;
+        rc = btreeBulkAppend(pCur, iLevel + 1, pLvl->aPending, 0, pLvl->iPrev);
+        if (rc) return rc;
+    }
+    rc = btreeBulkPage(pCur, iLevel);
+    if (rc) return rc;
+    pPage = pLvl->pPage;
+    if (iLevel > 0) nCell = cellSizePtr(pPage, pCell);
+    pIns = pCell;
+    nIns = nCell;
+    if (pPage->hasPrefix && pCur->prefixOk && pPage->nCell > 0)
+    {
+        /* Compress a copy of the cell, as pCell is held back as it is if
+        ** it does not fit. */
+        u8 *pAnchor = prefixAnchor(pPage, pPage->nCell);
+        u8 *aSpace = prefixSpace(pCur);
+        if (aSpace == 0) return SQLITE_NOMEM;
+        if (pAnchor)
+        {
+            memcpy(aSpace, pCell, nCell);
+            nIns = prefixCompress(pPage, aSpace, nCell, pAnchor,
+                                  findCell(pPage, pPage->nCell - 1));
+            if (nIns < nCell) pIns = aSpace;
+        }
+    }
+
+    if (pPage->nCell == 0 || nIns + 2 + pBulk->nReserve <= pPage->nFree)
+    {
+        insertCell(pPage, pPage->nCell, pIns, nIns, 0, iChild, &rc);
+        if (iChild && ISAUTOVACUUM)
+        {
+            ptrmapPut(pBt, iChild, PTRMAP_BTREE, pPage->pgno, &rc);
+        }
+        return rc;
+    }
+
+    /* The page is full.  The child of the cell that did not fit becomes its
+    ** right-child.  If it is the root page, move its content elsewhere as
+    ** the root is needed for the level above. */
+    if (iChild)
+    {
+        put4byte(&pPage->aData[pPage->hdrOffset + 8], iChild);
+        if (ISAUTOVACUUM)
+        {
+            ptrmapPut(pBt, iChild, PTRMAP_BTREE, pPage->pgno, &rc);
+            if (rc) return rc;
+        }
+    }
+    if (pPage->pgno == pCur->pgnoRoot)
+    {
+        MemPage *pNew = 0;
+        Pgno pgnoNew;
+        rc = allocateBtreePage(pBt, &pNew, &pgnoNew, 1, 0);
+        copyNodeContent(pPage, pNew, &rc);
+        if (rc)
+        {
+            releasePage(pNew);
+            return rc;
+        }
+        releasePage(pPage);
+        pPage = pNew;
+    }
+    pLvl->iPrev = pPage->pgno;
+    pLvl->pPage = 0;
+    releasePage(pPage);
+
+    if (pLvl->aPending == 0)
+    {
+        pLvl->aPending = (u8 *)sqlite3Malloc(pBt->pageSize);
+        if (pLvl->aPending == 0) return SQLITE_NOMEM;
+    }
+    memcpy(&pLvl->aPending[iLevel ? 0 : 4], pCell, nCell);
+    pLvl->bPending = 1;
+    return SQLITE_OK;
+}
+
+/*
+** Level iLevel of the bulk load in progress on pCur ends with a held-back
+** cell that has no page to its right.  Move it to a new page of its own,
+** and pass the last cell of the last full page up to the level above as
+** the divider between the two.
+*/
+static int btreeBulkSplitLast(BtCursor *pCur, int iLevel)
+{
+    BtBulk *pBulk = pCur->pBulk;
+    struct BtBulkLevel *pLvl = &pBulk->aLevel[iLevel];
+    BtShared *pBt = pCur->pBt;
+    MemPage *pPrev = 0;
+    u8 *pTmp = pBt->pTmpSpace;
+    u8 *pCell;
+    Pgno iChild = 0;
+    int nCell;
+    int rc;
+
+    assert(pLvl->bPending && pLvl->pPage == 0 && pTmp);
+    rc = getAndInitPage(pBt, pLvl->iPrev, &pPrev, 0);
+    if (rc) return rc;
+    rc = sqlite3PagerWrite(pPrev->pDbPage);
+    if (rc == SQLITE_OK && pPrev->nCell < 2)
+    {
+        rc = SQLITE_CORRUPT_BKPT;
+    }
+    if (rc)
+    {
+        releasePage(pPrev);
+        return rc;
+    }
+    pCell = findCell(pPrev, pPrev->nCell - 1);
+    nCell = cellSizePtr(pPrev, pCell);
+    if (pPrev->hasPrefix)
+    {
+        /* The cell becomes a divider on the level above.  It may not share
+        ** any bytes with a cell of pPrev there. */
+        int nOut;
+        rc = prefixExpand(pPrev, pCell, prefixAnchor(pPrev, pPrev->nCell - 1),
+                          &pTmp[iLevel ? 0 : 4], &nOut);
+        if (rc)
+        {
+            releasePage(pPrev);
+            return rc;
+        }
+    }
+    else
+    {
+        memcpy(&pTmp[iLevel ? 0 : 4], pCell, nCell);
+    }
+    if (iLevel > 0)
+    {
+        u8 *pRight = &pPrev->aData[pPrev->hdrOffset + 8];
+        iChild = get4byte(pRight);
+        put4byte(pRight, get4byte(pCell));
+    }
+    dropCell(pPrev, pPrev->nCell - 1, nCell, &rc);
+    releasePage(pPrev);
+    if (rc) return rc;
+
+    pLvl->bPending = 0;
+    rc = btreeBulkPage(pCur, iLevel);
+    if (rc == SQLITE_OK)
+    {
+        MemPage *pPage = pLvl->pPage;
+        pCell = &pLvl->aPending[iLevel ? 0 : 4];
+        nCell = cellSizePtr(pPage, pCell);
+        insertCell(pPage, 0, pCell, nCell, 0, iChild, &rc);
+        if (iChild && ISAUTOVACUUM)
+        {
+            ptrmapPut(pBt, iChild, PTRMAP_BTREE, pPage->pgno, &rc);
+        }
+    }
+    if (rc == SQLITE_OK)
+    {
+        rc = btreeBulkAppend(pCur, iLevel + 1, pTmp, 0, pLvl->iPrev);
+    }
+    return rc;
+}
+
+/*
+** Insert a key into the index b-tree that cursor pCur is open on.  Keys
+** must be inserted in sorted order, and sqlite3BtreeBulkEnd() called
+** once the last has been inserted.  The b-tree is not valid until then,
+** and the cursor may not be used for anything else.
+**
+** If the b-tree is empty and no other cursor is open on it, leaf pages are
+** filled left to right and the interior pages are built on top of them,
+** never calling balance().  Otherwise this is the same as calling
+** sqlite3BtreeInsert() with the appendBias flag set.
+*/
+int sqlite3BtreeBulkInsert(BtCursor *pCur, const void *pKey, i64 nKey)
+{
+    BtShared *pBt = pCur->pBt;
+    u8 *pCell;
+    int nCell;
+    int rc;
+
+    assert(cursorHoldsMutex(pCur));
+    assert(pCur->wrFlag && pBt->inTransaction == TRANS_WRITE
+           && (pBt->btsFlags & BTS_READ_ONLY) == 0);
+    assert(pCur->pKeyInfo != 0);
+
+    if (pCur->pBulk == 0)
+    {
+        rc = btreeBulkStart(pCur);
+        if (rc) return rc;
+    }
+    if (pCur->pBulk->bDisabled)
+    {
+        return sqlite3BtreeInsert(pCur, pKey, nKey, 0, 0, 0, 1, 0);
+    }
+
+    allocateTempSpace(pBt);
+    pCell = pBt->pTmpSpace;
+    if (pCell == 0) return SQLITE_NOMEM;
+    rc = btreeBulkPage(pCur, 0);
+    if (rc == SQLITE_OK)
+    {
+        rc = fillInCell(pCur->pBulk->aLevel[0].pPage, pCell, pKey, nKey, 0, 0, 0, &nCell);
+    }
+    if (rc == SQLITE_OK)
+    {
+        rc = btreeBulkAppend(pCur, 0, pCell, nCell, 0);
+    }
+    return rc;
+}
+
+/*
+** Complete the bulk load in progress on cursor pCur, if any.  Each level
+** of the tree is finished, bottom up, by setting the right-child of its
+** last page to the last page on the level below.  The last level is the
+** root page.
+*/
+int sqlite3BtreeBulkEnd(BtCursor *pCur)
+{
+    BtBulk *pBulk = pCur->pBulk;
+    int rc = SQLITE_OK;
+
+    assert(cursorHoldsMutex(pCur));
+    if (pBulk && !pBulk->bDisabled)
+    {
+        BtShared *pBt = pCur->pBt;
+        Pgno iRight = 0;
+        int i;
+        for (i = 0; rc == SQLITE_OK && i < pBulk->nLevel; i++)
+        {
+            struct BtBulkLevel *pLvl = &pBulk->aLevel[i];
+            MemPage *pPage;
+            if (pLvl->bPending)
+            {
+                rc = btreeBulkSplitLast(pCur, i);
+                if (rc) break;
+            }
+            pPage = pLvl->pPage;
+            assert(pPage);
+            if (i > 0)
+            {
+                put4byte(&pPage->aData[pPage->hdrOffset + 8], iRight);
+                if (ISAUTOVACUUM)
+                {
+                    ptrmapPut(pBt, iRight, PTRMAP_BTREE, pPage->pgno, &rc);
+                }
+            }
+            iRight = pPage->pgno;
+        }
+        assert(rc || pBulk->nLevel == 0 || iRight == pCur->pgnoRoot);
+    }
+    btreeBulkFree(pCur);
+    return rc;
+}
+
 /*
 ** Delete the entry that the cursor is pointing to.  The cursor
 ** is left pointing at a arbitrary location.
@@ -8237,7 +10216,11 @@ int sqlite3BtreeDelete(BtCursor *pCur)
     rc = sqlite3PagerWrite(pPage->pDbPage);
     if (rc) return rc;
     rc = clearCell(pPage, pCell);
-    dropCell(pPage, iCellIdx, cellSizePtr(pPage, pCell), &rc); /* 移除cell */
+    if (pPage->hasPrefix && rc == SQLITE_OK && prefixSpace(pCur) == 0)
+    {
+        rc = SQLITE_NOMEM;
+    }
+    prefixDropCell(pPage, iCellIdx, cellSizePtr(pPage, pCell), pCur->aPrefix, &rc); /* 移除cell */
     if (rc) return rc;
 
     /* If the cell deleted was not located on a leaf page, then the cursor
@@ -8264,7 +10247,31 @@ int sqlite3BtreeDelete(BtCursor *pCur)
         pTmp = pBt->pTmpSpace;
 
         rc = sqlite3PagerWrite(pLeaf->pDbPage);
-        insertCell(pPage, iCellIdx, pCell - 4, nCell + 4, pTmp, n, &rc); /* 插入新的cell */
+        if (pPage->hasPrefix && rc == SQLITE_OK)
+        {
+            /* The cell may share bytes with an anchor on the leaf.  Expand it
+            ** and compress it again against its new anchor. */
+            u8 *aSpace = pCur->aPrefix;
+            int nNew;
+            assert(aSpace);
+            rc = prefixExpand(pLeaf, pCell, prefixAnchor(pLeaf, pLeaf->nCell - 1),
+                              &aSpace[4], &nNew);
+            nNew += 4;
+            if (rc == SQLITE_OK && pCur->prefixOk && iCellIdx > 0)
+            {
+                u8 *pAnchor = prefixAnchor(pPage, iCellIdx);
+                if (pAnchor)
+                {
+                    nNew = prefixCompress(pPage, aSpace, nNew, pAnchor,
+                                          findCell(pPage, iCellIdx - 1));
+                }
+            }
+            insertCell(pPage, iCellIdx, aSpace, nNew, pTmp, n, &rc);
+        }
+        else
+        {
+            insertCell(pPage, iCellIdx, pCell - 4, nCell + 4, pTmp, n, &rc); /* 插入新的cell */
+        }
         dropCell(pLeaf, pLeaf->nCell - 1, nCell, &rc); /* 从叶子节点移除 */
         if (rc) return rc;
     }
@@ -8468,6 +10475,10 @@ static int btreeCreateTable(Btree *p, int *piTable, int createTabFlags)
     else
     {
         ptfFlags = PTF_ZERODATA | PTF_LEAF;
+        if (pBt->btsFlags & BTS_PREFIX_INDEX)
+        {
+            ptfFlags |= PTF_PREFIX;
+        }
     }
     zeroPage(pRoot, ptfFlags);
     sqlite3PagerUnref(pRoot->pDbPage);
@@ -8511,7 +10522,7 @@ static int clearDatabasePage(
         return SQLITE_CORRUPT_BKPT;
     }
 
-    rc = getAndInitPage(pBt, pgno, &pPage);
+    rc = getAndInitPage(pBt, pgno, &pPage, 0);
     if (rc) return rc;
     for (i = 0; i < pPage->nCell; i++) /* 所谓的cell,更确切的说,是记录 */
     {
@@ -8807,6 +10818,10 @@ int sqlite3BtreeUpdateMeta(Btree *p, int idx, u32 iMeta)
             pBt->incrVacuum = (u8)iMeta;
         }
 #endif
+        if (idx == BTREE_FILE_FORMAT)
+        {
+            btreeSetPrefixIndex(pBt, iMeta);
+        }
     }
     sqlite3BtreeLeave(p);
     return rc;
@@ -8907,9 +10922,50 @@ Pager *sqlite3BtreePager(Btree *p)
     return p->pBt->pPager;
 }
 
+#ifdef BTREE_INTCK_THREAD
+/*
+** The pool of worker threads used by an integrity-check. The pager may
+** only be used by the thread running the check, so that thread walks the
+** b-trees and fetches every page. Once it has checked the cells of a page
+** and its children, it queues a copy of the page, with the size of each
+** cell, for a worker to check that the cells and free blocks cover the
+** page exactly. The page itself is released at once, so that the queue
+** does not hold pages in the page cache.
+**
+** Queued pages form a ring of BT_INTCK_QUEUE jobs, run by the threads of
+** pThreads. Jobs are retired by the checking thread in the order they were
+** queued. Retiring a job appends the messages of the worker to the error
+** message, followed by those that the checking thread produced after
+** queueing the job and before queueing the next. So the messages are the
+** same, in the same order, as when every page is checked on the calling
+** thread.
+** 完整性检查的工作线程池,负责检查页内空间的使用情况.
+*/
+typedef struct IntckJob IntckJob;
+struct IntckJob
+{
+    MemPage *pPage;               /* Private copy of the page to check */
+    u8 *aData;                    /* Page image for pPage->aData */
+    u32 *aSize;                   /* Size of each cell on pPage */
+    IntegrityCk sCheck;           /* Check context for the worker */
+    StrAccum after;               /* Messages of the checking thread */
+    int nAfter;                   /* Number of messages in after */
+};
+struct IntckPool
+{
+    SQLiteThreadPool *pThreads;   /* The worker threads */
+    int iLast;                    /* Slot of the most recently queued job */
+    int nPendMsg;                 /* Total of IntckJob.nAfter for the jobs */
+    IntckJob *apJob[BT_INTCK_QUEUE];  /* Jobs, indexed by slot */
+};
+#endif
+
 #ifndef SQLITE_OMIT_INTEGRITY_CHECK
 /*
 ** Append a message to the error message string.
+**
+** While pages queued for worker threads have not yet been retired, the
+** message is held back to follow theirs (see IntckPool).
 */
 static void checkAppendMsg(
     IntegrityCk *pCheck,
@@ -8919,21 +10975,37 @@ static void checkAppendMsg(
 )
 {
     va_list ap;
+    StrAccum *pAcc = &pCheck->errMsg;
     if (!pCheck->mxErr) return;
-    pCheck->mxErr--;
-    pCheck->nErr++;
+#ifdef BTREE_INTCK_THREAD
+    if (pCheck->pPool && sqlite3ThreadPoolJobs(pCheck->pPool->pThreads) > 0)
+    {
+        IntckPool *pPool = pCheck->pPool;
+        IntckJob *pJob = pPool->apJob[pPool->iLast];
+        /* Messages beyond mxErr are discarded when the job is retired */
+        if (pPool->nPendMsg >= pCheck->mxErr) return;
+        pPool->nPendMsg++;
+        pJob->nAfter++;
+        pAcc = &pJob->after;
+    }
+    else
+#endif
+    {
+        pCheck->mxErr--;
+        pCheck->nErr++;
+    }
     va_start(ap, zFormat);
-    if (pCheck->errMsg.nChar)
+    if (pAcc->nChar)
     {
-        sqlite3StrAccumAppend(&pCheck->errMsg, "\n", 1);
+        sqlite3StrAccumAppend(pAcc, "\n", 1);
     }
     if (zMsg1)
     {
-        sqlite3StrAccumAppend(&pCheck->errMsg, zMsg1, -1);
+        sqlite3StrAccumAppend(pAcc, zMsg1, -1);
     }
-    sqlite3VXPrintf(&pCheck->errMsg, 1, zFormat, ap);
+    sqlite3VXPrintf(pAcc, 1, zFormat, ap);
     va_end(ap);
-    if (pCheck->errMsg.mallocFailed)
+    if (pAcc->mallocFailed)
     {
         pCheck->mallocFailed = 1;
     }
@@ -9107,6 +11179,311 @@ static void checkList(
 #endif /* SQLITE_OMIT_INTEGRITY_CHECK */
 
 #ifndef SQLITE_OMIT_INTEGRITY_CHECK
+/*
+** Write the size of each cell on page pPage to pCheck->aSize[], as used by
+** checkPageSpace(). The size of a cell that does not begin within the
+** usable part of the page is written as 65536. The sizes are not written
+** if pCheck->aSize could not be allocated.
+*/
+static void checkCellSizes(IntegrityCk *pCheck, MemPage *pPage)
+{
+    u8 *data = pPage->aData;
+    int usableSize = pPage->pBt->usableSize;
+    int cellStart = pPage->hdrOffset + 12 - 4 * pPage->leaf;
+    int nCell = get2byte(&data[pPage->hdrOffset + 3]);
+    int i;
+
+    if (pCheck->aSize == 0) return;
+    assert(nCell <= (int)MX_CELL(pPage->pBt));  /* Enforced by btreeInitPage() */
+    for (i = 0; i < nCell; i++)
+    {
+        int pc = get2byte(&data[cellStart + i * 2]);
+        u32 size = 65536;
+        if (pc <= usableSize - 4)
+        {
+            size = cellSizePtr(pPage, &data[pc]);
+        }
+        pCheck->aSize[i] = size;
+    }
+}
+
+/*
+** Check that the cells and free blocks of page pPage, which have been
+** checked by btreeInitPage(), do not overlap and together with the
+** fragmented bytes cover the page exactly. aSize[] holds the cell sizes
+** written by checkCellSizes() and hit[] is space for one page.
+**
+** This only reads the page, so it may run on an integrity-check worker
+** thread. pCheck is then the check context of the job.
+*/
+static void checkPageSpace(
+    IntegrityCk *pCheck,  /* Context for the sanity check */
+    MemPage *pPage,       /* Page to check */
+    const u32 *aSize,     /* Size of each cell on pPage */
+    u8 *hit               /* Space for the byte use counts */
+)
+{
+    u8 *data = pPage->aData;
+    int hdr = pPage->hdrOffset;
+    int usableSize = pPage->pBt->usableSize;
+    int iPage = pPage->pgno;
+    int contentOffset = get2byteNotZero(&data[hdr + 5]);
+    int cellStart = hdr + 12 - 4 * pPage->leaf;
+    int nCell = get2byte(&data[hdr + 3]);
+    int i, cnt;
+
+    assert(contentOffset <= usableSize);  /* Enforced by btreeInitPage() */
+    memset(hit + contentOffset, 0, usableSize - contentOffset);
+    memset(hit, 1, contentOffset);
+    for (i = 0; i < nCell; i++)
+    {
+        int pc = get2byte(&data[cellStart + i * 2]);
+        u32 size = aSize[i];
+        int j;
+        if ((int)(pc + size - 1) >= usableSize)
+        {
+            checkAppendMsg(pCheck, 0,
+                           "Corruption detected in cell %d on page %d", i, iPage);
+        }
+        else
+        {
+            for (j = pc + size - 1; j >= pc; j--) hit[j]++;
+        }
+    }
+    i = get2byte(&data[hdr + 1]);
+    while (i > 0)
+    {
+        int size, j;
+        assert(i <= usableSize - 4);   /* Enforced by btreeInitPage() */
+        size = get2byte(&data[i + 2]);
+        assert(i + size <= usableSize); /* Enforced by btreeInitPage() */
+        for (j = i + size - 1; j >= i; j--) hit[j]++;
+        j = get2byte(&data[i]);
+        assert(j == 0 || j > i + size); /* Enforced by btreeInitPage() */
+        assert(j <= usableSize - 4); /* Enforced by btreeInitPage() */
+        i = j;
+    }
+    for (i = cnt = 0; i < usableSize; i++)
+    {
+        if (hit[i] == 0)
+        {
+            cnt++;
+        }
+        else if (hit[i] > 1)
+        {
+            checkAppendMsg(pCheck, 0,
+                           "Multiple uses for byte %d of page %d", i, iPage);
+            break;
+        }
+    }
+    if (cnt != data[hdr + 7])
+    {
+        checkAppendMsg(pCheck, 0,
+                       "Fragmentation of %d bytes reported as %d on page %d",
+                       cnt, data[hdr + 7], iPage);
+    }
+}
+
+#ifdef BTREE_INTCK_THREAD
+/*
+** Check the space usage of the page queued in slot iSlot of integrity-check
+** pool pArg on a worker thread. *ppScratch holds the buffer of one byte
+** per byte of the page that the thread uses for the check.
+*/
+static void intckWork(void *pArg, int iSlot, void **ppScratch)
+{
+    IntckPool *pPool = (IntckPool *)pArg;
+    IntckJob *pJob = pPool->apJob[iSlot];
+
+    if (*ppScratch == 0)
+    {
+        *ppScratch = sqlite3Malloc(pJob->sCheck.pBt->pageSize);
+    }
+    if (*ppScratch)
+    {
+        checkPageSpace(&pJob->sCheck, pJob->pPage, pJob->aSize, (u8 *)*ppScratch);
+    }
+    else
+    {
+        pJob->sCheck.mallocFailed = 1;
+    }
+}
+
+/*
+** Append the messages accumulated in pAcc, separated by newlines, to the
+** error message of pCheck, as far as pCheck->mxErr allows. Reset pAcc.
+*/
+static void intckAppendList(IntegrityCk *pCheck, StrAccum *pAcc)
+{
+    char *zList;
+    char *zMsg;
+
+    if (pAcc->mallocFailed) pCheck->mallocFailed = 1;
+    zList = sqlite3StrAccumFinish(pAcc);
+    for (zMsg = zList; zMsg && *zMsg && pCheck->mxErr; )
+    {
+        char *zEnd = strchr(zMsg, '\n');
+        int n = zEnd ? (int)(zEnd - zMsg) : sqlite3Strlen30(zMsg);
+        pCheck->mxErr--;
+        pCheck->nErr++;
+        if (pCheck->errMsg.nChar)
+        {
+            sqlite3StrAccumAppend(&pCheck->errMsg, "\n", 1);
+        }
+        sqlite3StrAccumAppend(&pCheck->errMsg, zMsg, n);
+        zMsg = zEnd ? &zEnd[1] : 0;
+    }
+    if (pCheck->errMsg.mallocFailed) pCheck->mallocFailed = 1;
+    sqlite3_free(zList);
+}
+
+/*
+** Retire finished jobs of the integrity-check worker pool in order, until
+** no more than nMax jobs remain, waiting for workers as required. Then
+** retire any further jobs that are already finished.
+*/
+static void intckRetire(IntegrityCk *pCheck, int nMax)
+{
+    IntckPool *pPool = pCheck->pPool;
+    int iSlot;
+    while ((iSlot = sqlite3ThreadPoolRetire(pPool->pThreads, nMax)) >= 0)
+    {
+        IntckJob *pJob = pPool->apJob[iSlot];
+        if (pJob->sCheck.mallocFailed) pCheck->mallocFailed = 1;
+        intckAppendList(pCheck, &pJob->sCheck.errMsg);
+        intckAppendList(pCheck, &pJob->after);
+        pPool->nPendMsg -= pJob->nAfter;
+    }
+}
+
+/*
+** Queue a copy of page pPage, whose cell sizes have been written to
+** pCheck->aSize[], for the space usage check on a worker thread. The
+** caller keeps its reference to pPage.
+*/
+static void intckQueue(IntegrityCk *pCheck, MemPage *pPage)
+{
+    IntckPool *pPool = pCheck->pPool;
+    IntckJob *pJob;
+    int nCell = get2byte(&pPage->aData[pPage->hdrOffset + 3]);
+
+    intckRetire(pCheck, BT_INTCK_QUEUE - 1);
+    pPool->iLast = sqlite3ThreadPoolNext(pPool->pThreads);
+    pJob = pPool->apJob[pPool->iLast];
+    memcpy(pJob->aSize, pCheck->aSize, nCell * sizeof(u32));
+    memcpy(pJob->pPage, pPage, sizeof(MemPage));
+    pJob->pPage->aData = pJob->aData;
+    memcpy(pJob->aData, pPage->aData, pCheck->pBt->pageSize);
+    pJob->sCheck.mxErr = pCheck->mxErr;
+    pJob->sCheck.nErr = 0;
+    pJob->sCheck.mallocFailed = 0;
+    sqlite3StrAccumInit(&pJob->sCheck.errMsg, 0, 0, 20000);
+    pJob->sCheck.errMsg.useMalloc = 2;
+    sqlite3StrAccumInit(&pJob->after, 0, 0, 20000);
+    pJob->after.useMalloc = 2;
+    pJob->nAfter = 0;
+    sqlite3ThreadPoolSubmit(pPool->pThreads);
+}
+
+/*
+** Stop the worker threads of pCheck->pPool, once every job has been
+** retired, and free the pool.
+*/
+static void intckStop(IntegrityCk *pCheck)
+{
+    IntckPool *pPool = pCheck->pPool;
+    int i;
+
+    if (pPool == 0) return;
+    if (pPool->pThreads)
+    {
+        intckRetire(pCheck, 0);
+        sqlite3ThreadPoolFree(pPool->pThreads);
+    }
+    for (i = 0; i < BT_INTCK_QUEUE; i++)
+    {
+        IntckJob *pJob = pPool->apJob[i];
+        if (pJob)
+        {
+            sqlite3_free(pJob->aData);
+            sqlite3_free(pJob->aSize);
+            sqlite3_free(pJob);
+        }
+    }
+    sqlite3_free(pPool);
+    pCheck->pPool = 0;
+}
+
+/*
+** Start the worker threads for integrity-check pCheck. If the threads or
+** the memory for them cannot be had, the pages are checked on the calling
+** thread instead.
+*/
+static void intckStart(IntegrityCk *pCheck)
+{
+    BtShared *pBt = pCheck->pBt;
+    IntckPool *pPool;
+    int szJob = ROUND8(sizeof(IntckJob));
+    int i;
+
+    assert(pCheck->pPool == 0);
+    if (!sqlite3GlobalConfig.bCoreMutex || pCheck->nPage < BT_INTCK_MINPAGE)
+    {
+        return;
+    }
+    pPool = (IntckPool *)sqlite3MallocZero(sizeof(IntckPool));
+    if (pPool == 0) return;
+    for (i = 0; i < BT_INTCK_QUEUE; i++)
+    {
+        IntckJob *pJob = (IntckJob *)sqlite3MallocZero(szJob + sizeof(MemPage));
+        if (pJob == 0) break;
+        pPool->apJob[i] = pJob;
+        pJob->pPage = (MemPage *)&((u8 *)pJob)[szJob];
+        pJob->aData = (u8 *)sqlite3Malloc(pBt->pageSize);
+        pJob->aSize = (u32 *)sqlite3Malloc(MX_CELL(pBt) * sizeof(u32));
+        if (pJob->aData == 0 || pJob->aSize == 0) break;
+        pJob->sCheck.pBt = pBt;
+        pJob->sCheck.pPager = pCheck->pPager;
+        pJob->sCheck.nPage = pCheck->nPage;
+    }
+    pCheck->pPool = pPool;
+    if (i < BT_INTCK_QUEUE
+        || sqlite3ThreadPoolCreate(&pPool->pThreads, SQLITE_INTCK_THREADS,
+                                   BT_INTCK_QUEUE, intckWork, pPool)
+       )
+    {
+        intckStop(pCheck);
+    }
+}
+#endif /* BTREE_INTCK_THREAD */
+
+/*
+** Ask the pager to read child pages iFirst and up of interior page pPage,
+** SQLITE_BTREE_READAHEAD of them at most, and the right-child if it is
+** among them, into the page cache. Runs of adjacent pages are read
+** together with vectored reads.
+*/
+static void checkReadAhead(IntegrityCk *pCheck, MemPage *pPage, int iFirst)
+{
+    Pgno aPgno[SQLITE_BTREE_READAHEAD];
+    int nPgno = 0;
+    int i;
+
+    assert(!pPage->leaf);
+    for (i = iFirst; i <= pPage->nCell && nPgno < SQLITE_BTREE_READAHEAD; i++)
+    {
+        if (i == pPage->nCell)
+        {
+            aPgno[nPgno++] = get4byte(&pPage->aData[pPage->hdrOffset + 8]);
+        }
+        else
+        {
+            aPgno[nPgno++] = get4byte(findCell(pPage, i));
+        }
+    }
+    sqlite3PagerPrefetch(pCheck->pPager, aPgno, nPgno);
+}
+
 /*
 ** Do various sanity checks on a single page of a tree.  Return
 ** the tree depth.  Root pages return 0.  Parents of root pages
@@ -9134,14 +11511,11 @@ static int checkTreePage(
 )
 {
     MemPage *pPage;
-    int i, rc, depth, d2, pgno, cnt;
-    int hdr, cellStart;
-    int nCell;
-    u8 *data;
+    int i, rc, depth, d2, pgno;
     BtShared *pBt;
     int usableSize;
     char zContext[100];
-    char *hit = 0;
+    u8 *aExpand = 0;
     i64 nMinKey = 0;
     i64 nMaxKey = 0;
 
@@ -9202,6 +11576,22 @@ static int checkTreePage(
             nMaxKey = info.nKey;
         }
         assert(sz == info.nPayload);
+
+        /* Check that a prefix-compressed cell decodes against its anchor
+        */
+        if (info.nShared)
+        {
+            if (aExpand == 0) aExpand = sqlite3PageMalloc(pBt->pageSize);
+            if (aExpand == 0)
+            {
+                pCheck->mallocFailed = 1;
+            }
+            else if (prefixPayload(pPage, &info, prefixAnchor(pPage, i), aExpand))
+            {
+                checkAppendMsg(pCheck, zContext,
+                               "Prefix-compressed cell does not match its anchor");
+            }
+        }
         if ((sz > info.nLocal)
             && (&pCell[info.iOverflow] <= &pPage->aData[pBt->usableSize])
            )
@@ -9221,6 +11611,10 @@ static int checkTreePage(
         */
         if (!pPage->leaf)
         {
+            if ((i % SQLITE_BTREE_READAHEAD) == 0)
+            {
+                checkReadAhead(pCheck, pPage, i);
+            }
             pgno = get4byte(pCell);
 #ifndef SQLITE_OMIT_AUTOVACUUM
             if (pBt->autoVacuum)
@@ -9300,74 +11694,33 @@ static int checkTreePage(
 
     /* Check for complete coverage of the page
     */
-    data = pPage->aData;
-    hdr = pPage->hdrOffset;
-    hit = sqlite3PageMalloc(pBt->pageSize);
-    if (hit == 0)
+    sqlite3PageFree(aExpand);
+    checkCellSizes(pCheck, pPage);
+#ifdef BTREE_INTCK_THREAD
+    /* A leaf page that is the root of its b-tree, usually a small table or
+    ** index, is checked on this thread, as handing it to a worker would
+    ** cost about as much as checking it.
+    */
+    if (pCheck->pPool && pCheck->aSize
+        && (!pPage->leaf || pnParentMinKey || pnParentMaxKey))
     {
-        pCheck->mallocFailed = 1;
+        intckQueue(pCheck, pPage);
     }
     else
+#endif
+    if (pCheck->aSize)
     {
-        int contentOffset = get2byteNotZero(&data[hdr + 5]);
-        assert(contentOffset <= usableSize);  /* Enforced by btreeInitPage() */
-        memset(hit + contentOffset, 0, usableSize - contentOffset);
-        memset(hit, 1, contentOffset);
-        nCell = get2byte(&data[hdr + 3]);
-        cellStart = hdr + 12 - 4 * pPage->leaf;
-        for (i = 0; i < nCell; i++)
-        {
-            int pc = get2byte(&data[cellStart + i * 2]);
-            u32 size = 65536;
-            int j;
-            if (pc <= usableSize - 4)
-            {
-                size = cellSizePtr(pPage, &data[pc]);
-            }
-            if ((int)(pc + size - 1) >= usableSize)
-            {
-                checkAppendMsg(pCheck, 0,
-                               "Corruption detected in cell %d on page %d", i, iPage);
-            }
-            else
-            {
-                for (j = pc + size - 1; j >= pc; j--) hit[j]++;
-            }
-        }
-        i = get2byte(&data[hdr + 1]);
-        while (i > 0)
+        u8 *hit = (u8 *)sqlite3PageMalloc(pBt->pageSize);
+        if (hit == 0)
         {
-            int size, j;
-            assert(i <= usableSize - 4);   /* Enforced by btreeInitPage() */
-            size = get2byte(&data[i + 2]);
-            assert(i + size <= usableSize); /* Enforced by btreeInitPage() */
-            for (j = i + size - 1; j >= i; j--) hit[j]++;
-            j = get2byte(&data[i]);
-            assert(j == 0 || j > i + size); /* Enforced by btreeInitPage() */
-            assert(j <= usableSize - 4); /* Enforced by btreeInitPage() */
-            i = j;
+            pCheck->mallocFailed = 1;
         }
-        for (i = cnt = 0; i < usableSize; i++)
-        {
-            if (hit[i] == 0)
-            {
-                cnt++;
-            }
-            else if (hit[i] > 1)
-            {
-                checkAppendMsg(pCheck, 0,
-                               "Multiple uses for byte %d of page %d", i, iPage);
-                break;
-            }
-        }
-        if (cnt != data[hdr + 7])
+        else
         {
-            checkAppendMsg(pCheck, 0,
-                           "Fragmentation of %d bytes reported as %d on page %d",
-                           cnt, data[hdr + 7], iPage);
+            checkPageSpace(pCheck, pPage, pCheck->aSize, hit);
+            sqlite3PageFree(hit);
         }
     }
-    sqlite3PageFree(hit);
     releasePage(pPage);
     return depth + 1;
 }
@@ -9410,6 +11763,8 @@ char *sqlite3BtreeIntegrityCheck(
     sCheck.mxErr = mxErr;
     sCheck.nErr = 0;
     sCheck.mallocFailed = 0;
+    sCheck.aSize = 0;
+    sCheck.pPool = 0;
     *pnErr = 0;
     if (sCheck.nPage == 0)
     {
@@ -9428,6 +11783,17 @@ char *sqlite3BtreeIntegrityCheck(
     if (i <= sCheck.nPage) setPageReferenced(&sCheck, i);
     sqlite3StrAccumInit(&sCheck.errMsg, zErr, sizeof(zErr), 20000);
     sCheck.errMsg.useMalloc = 2;
+    sCheck.aSize = (u32 *)sqlite3Malloc(MX_CELL(pBt) * sizeof(u32));
+    if (sCheck.aSize == 0)
+    {
+        sCheck.mallocFailed = 1;
+    }
+#ifdef BTREE_INTCK_THREAD
+    else
+    {
+        intckStart(&sCheck);
+    }
+#endif
 
     /* Check the integrity of the freelist
     */
@@ -9447,6 +11813,9 @@ char *sqlite3BtreeIntegrityCheck(
 #endif
         checkTreePage(&sCheck, aRoot[i], "List of tree roots: ", NULL, NULL);
     }
+#ifdef BTREE_INTCK_THREAD
+    intckStop(&sCheck);
+#endif
 
     /* Make sure every page in the file is referenced
     */
@@ -9490,6 +11859,7 @@ char *sqlite3BtreeIntegrityCheck(
     */
     sqlite3BtreeLeave(p);
     sqlite3_free(sCheck.aPgRef);
+    sqlite3_free(sCheck.aSize);
     if (sCheck.mallocFailed)
     {
         sqlite3StrAccumReset(&sCheck.errMsg);
@@ -9700,6 +12070,17 @@ int sqlite3BtreePutData(BtCursor *pCsr, u32 offset, u32 amt, void *z)
     **   (d) there are no conflicting read-locks, and
     **   (e) the cursor points at a valid row of an intKey table.
     */
+    /* Save the positions of all other cursors open on this table. This is
+    ** required in case any of them are holding references to an xFetch
+    ** version of the b-tree page modified by the accessPayload call below.
+    **
+    ** Note that pCsr must be open on a BTREE_INTKEY table and saveCursorPosition()
+    ** and hence saveAllCursors() cannot fail on a BTREE_INTKEY table, hence
+    ** saveAllCursors can only return SQLITE_OK.
+    */
+    VVA_ONLY(rc =) saveAllCursors(pCsr->pBt, pCsr->pgnoRoot, pCsr);
+    assert(rc == SQLITE_OK);
+
     if (!pCsr->wrFlag)
     {
         return SQLITE_READONLY;
@@ -64,6 +64,8 @@ int sqlite3BtreeOpen(
 
 int sqlite3BtreeClose(Btree*);
 int sqlite3BtreeSetCacheSize(Btree*, int);
+int sqlite3BtreeSetMmapLimit(Btree*, sqlite3_int64);
+int sqlite3BtreeWarmup(Btree*, int);
 int sqlite3BtreeSetSafetyLevel(Btree*, int, int, int);
 int sqlite3BtreeSyncDisabled(Btree*);
 int sqlite3BtreeSetPageSize(Btree *p, int nPagesize, int nReserve, int eFix);
@@ -166,6 +168,8 @@ int sqlite3BtreeDelete(BtCursor*);
 int sqlite3BtreeInsert(BtCursor*, const void *pKey, i64 nKey,
                        const void *pData, int nData,
                        int nZero, int bias, int seekResult);
+int sqlite3BtreeBulkInsert(BtCursor*, const void *pKey, i64 nKey);
+int sqlite3BtreeBulkEnd(BtCursor*);
 int sqlite3BtreeFirst(BtCursor*, int *pRes);
 int sqlite3BtreeLast(BtCursor*, int *pRes);
 int sqlite3BtreeNext(BtCursor*, int *pRes);
@@ -188,6 +192,7 @@ void sqlite3BtreeCacheOverflow(BtCursor *);
 void sqlite3BtreeClearCursor(BtCursor *);
 int sqlite3BtreeSetVersion(Btree *pBt, int iVersion);
 void sqlite3BtreeCursorHints(BtCursor *, unsigned int mask);
+u32 sqlite3BtreeSeekSaved(BtCursor*);
 
 #ifndef NDEBUG
 int sqlite3BtreeCursorIsValid(BtCursor*);
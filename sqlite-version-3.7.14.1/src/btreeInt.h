@@ -125,7 +125,8 @@
 ** The page headers looks like this:
 **
 **   OFFSET   SIZE     DESCRIPTION
-**      0       1      Flags. 1: intkey, 2: zerodata, 4: leafdata, 8: leaf
+**      0       1      Flags. 1: intkey, 2: zerodata, 4: leafdata, 8: leaf,
+**                     16: prefix
 **      1       2      byte offset to the first freeblock
 **      3       2      number of cells on this page
 **      5       2      first byte of the cell content area
@@ -136,7 +137,9 @@
 ** this page has no children.  The zerodata flag means that this page carries
 ** only keys and no data.  The intkey flag means that the key is a integer
 ** which is stored in the key size entry of the cell header rather than in
-** the payload area.
+** the payload area.  The prefix flag is only used together with zerodata,
+** on the pages of an index b-tree in a database of schema file format 5
+** or later.  See "prefix-compressed cells" below.
 **
 ** The cell pointer array begins on the first byte after the page header.
 ** The cell pointer array contains zero or more 2-byte numbers which are
@@ -194,6 +197,25 @@
 **      *     Payload
 **      4     First page of the overflow chain.  Omitted if no overflow
 **
+** On a page with the prefix flag set (prefix-compressed cells), the key
+** size is followed by a second variable length integer, nShared.  The
+** payload stored in the cell leaves out nShared bytes from the start of
+** the first field of the record, which must be a text or blob value.
+** They are the same as the first nShared bytes of the first field of the
+** anchor of the cell: the nearest cell before it on the same page that
+** has an nShared of zero.  The first cell of a page is always an anchor.
+** nShared is counted as part of the local payload when deciding how much
+** of the payload spills to overflow pages, so the overflow chain holds
+** the same bytes as it would for an uncompressed cell.
+**
+**    SIZE    DESCRIPTION
+**      4     Page number of the left child. Omitted if leaf flag is set.
+**     var    Number of bytes of key.
+**     var    nShared.  Bytes of the first field taken from the anchor.
+**     var    Record header (as for an uncompressed cell)
+**      *     Remainder of the local payload
+**      4     First page of the overflow chain.  Omitted if no overflow
+**
 ** Overflow pages form a linked list.  Each page except the last is completely
 ** filled with data (pagesize - 4 bytes).  The last page can have as little
 ** as 1 byte of data.
@@ -227,9 +249,42 @@
 */
 #define MX_CELL(pBt) ((pBt->pageSize-8)/6)
 
+/*
+** The percentage of the usable space on each page that is filled by a
+** bulk load (see sqlite3BtreeBulkInsert()).  The remainder is left free
+** for later inserts.  Values below 50 are not supported.
+*/
+#ifndef SQLITE_BULKLOAD_FILL
+# define SQLITE_BULKLOAD_FILL 100
+#endif
+
+/*
+** The number of pages for which a decoded copy of the cell keys is kept
+** (see BtKeyCache), and the number of times a page must be searched before
+** it is given a copy. Zero disables the key cache.
+*/
+#ifndef SQLITE_BTREE_KEYCACHE
+# define SQLITE_BTREE_KEYCACHE 16
+#endif
+#define BT_KEYCACHE_MINSEARCH 4
+
+/*
+** The number of overflow chains whose page lists are kept (see
+** BtOvflIndex) for incremental blob I/O, and the largest number of
+** overflow pages read ahead at once by such I/O.
+*/
+#ifndef SQLITE_BTREE_OVFLINDEX
+# define SQLITE_BTREE_OVFLINDEX 4
+#endif
+#define BT_OVFL_READAHEAD 32
+
 /* Forward declarations */
 typedef struct MemPage MemPage;
 typedef struct BtLock BtLock;
+typedef struct BtWarmup BtWarmup;
+typedef struct BtBulk BtBulk;
+typedef struct BtKeyCache BtKeyCache;
+typedef struct BtOvflIndex BtOvflIndex;
 
 /*
 ** This is a magic string that appears at the beginning of every
@@ -255,6 +310,7 @@ typedef struct BtLock BtLock;
 #define PTF_ZERODATA  0x02
 #define PTF_LEAFDATA  0x04
 #define PTF_LEAF      0x08
+#define PTF_PREFIX    0x10
 
 /*
 ** As each page of the file is loaded into memory, an instance of the following
@@ -285,6 +341,9 @@ struct MemPage
     /* 头部偏移,page1有一个100字节的文件头,其他page没有 */
     u8 hdrOffset;        /* 100 for page 1.  0 otherwise */
     u8 childPtrSize;     /* 0 if leaf==1.  4 if leaf==0 */
+    u8 hasPrefix;        /* True if cells are prefix-compressed (PTF_PREFIX) */
+    u8 iKeyCache;        /* 1 more than the BtShared.aKeyCache[] slot, or 0 */
+    u8 nKeySearch;       /* Searches since modified, or 0xff if no key cache */
     u8 max1bytePayload;  /* min(maxLocal,127) */
     u16 maxLocal;        /* Copy of BtShared.maxLocal or BtShared.maxLeaf */
     u16 minLocal;        /* Copy of BtShared.minLocal or BtShared.minLeaf */
@@ -373,6 +432,7 @@ struct Btree
 #ifndef SQLITE_OMIT_SHARED_CACHE
     BtLock lock;       /* Object used to lock page 1 */
 #endif
+    BtWarmup *pWarmup; /* Cache warm-up in progress, or NULL */
 };
 
 /*
@@ -459,6 +519,62 @@ struct BtShared /* BtShared代表Btree中可以共享的部分 */
     Btree *pWriter;       /* Btree with currently open write transaction */
 #endif
     u8 *pTmpSpace;        /* BtShared.pageSize bytes of space for tmp use */
+#if SQLITE_BTREE_KEYCACHE>0
+    int iKeyCacheHand;    /* Next aKeyCache[] slot to consider for reuse */
+    BtKeyCache *aKeyCache;  /* SQLITE_BTREE_KEYCACHE slots, or NULL */
+#endif
+#ifndef SQLITE_OMIT_INCRBLOB
+    u32 iOvflClock;       /* Incremented each time aOvflIndex[] is used */
+    BtOvflIndex *aOvflIndex;  /* SQLITE_BTREE_OVFLINDEX slots, or NULL */
+#endif
+};
+
+/*
+** The list of pages in the overflow chain of a table row that is read
+** or written with incremental blob I/O. aPgno[i] is the page number of
+** overflow page i, or 0 if it is not yet known. The list is filled in
+** as the chain is followed, and is shared by all cursors that access
+** the same row, so that a blob handle that is reopened or moved back to
+** a row it has visited before can seek to any offset directly.
+** 增量blob I/O所访问的行的溢出页链表,由访问同一行的所有游标共享.
+**
+** A slot is used only if pgnoFirst is not zero and iDataVersion matches
+** the current sqlite3PagerDataVersion(). Slots are cleared when the row
+** or its table is modified, when any transaction is rolled back, and
+** whenever overflow pages may be relocated.
+*/
+struct BtOvflIndex
+{
+    Pgno pgnoRoot;        /* Root page of the table */
+    i64 iKey;             /* Rowid of the row */
+    Pgno pgnoFirst;       /* First overflow page, or 0 if the slot is unused */
+    u32 iDataVersion;     /* sqlite3PagerDataVersion() when slot was filled */
+    u32 iUsed;            /* BtShared.iOvflClock value when last used */
+    int nPgno;            /* Number of overflow pages in the chain */
+    Pgno *aPgno;          /* Overflow page numbers, 0 where not yet known */
+};
+
+/*
+** A decoded copy of the keys on a b-tree page that is searched often.
+** For an intkey page, aKey[i] is the integer key of cell i. For an index
+** page whose cells all begin with an integer, aKey[i] is the first field
+** of cell i, bitwise inverted if that column sorts in descending order,
+** so that aKey[] is in ascending order either way.
+** 一个频繁查找的页上所有cell的key的解码副本,使得页内查找无需解析cell.
+**
+** MemPage.iKeyCache refers to the slot holding the copy for a page. The
+** copy is discarded whenever the page is initialized or a cell is added or
+** removed. A slot belongs to page pPage only while pPage->iKeyCache also
+** refers to it, as the slot may have been reused for another page since.
+*/
+struct BtKeyCache
+{
+    MemPage *pPage;       /* Page the keys were copied from */
+    Pgno pgno;            /* Page number of pPage */
+    u8 bRef;              /* Searched since the slot was last considered */
+    int nKey;             /* Number of entries in aKey[] */
+    int nAlloc;           /* Allocated size of aKey[] */
+    i64 *aKey;            /* Decoded keys, one for each cell */
 };
 
 /*
@@ -471,6 +587,7 @@ struct BtShared /* BtShared代表Btree中可以共享的部分 */
 #define BTS_NO_WAL           0x0010   /* Do not open write-ahead-log files */
 #define BTS_EXCLUSIVE        0x0020   /* pWriter has an exclusive lock */
 #define BTS_PENDING          0x0040   /* Waiting for read-locks to clear */
+#define BTS_PREFIX_INDEX     0x0080   /* New index b-trees use PTF_PREFIX */
 
 /*
 ** An instance of the following structure is used to hold information
@@ -494,6 +611,7 @@ struct CellInfo
     u16 iOverflow; /* Offset to overflow page number.  Zero if no overflow */
     /* cell在main b-tree page中占用的字节数 */
     u16 nSize;     /* Size of the cell content on the main b-tree page */
+    u16 nShared;   /* Payload bytes taken from the anchor (PTF_PREFIX only) */
 };
 
 /*
@@ -531,7 +649,7 @@ struct BtCursor
     BtCursor *pNext, *pPrev;  /* Forms a linked list of all cursors */
     struct KeyInfo *pKeyInfo; /* Argument passed to comparison function */
 #ifndef SQLITE_OMIT_INCRBLOB
-    Pgno *aOverflow;          /* Cache of overflow page locations */
+    Pgno *aOverflow;          /* Overflow page list (BtOvflIndex.aPgno) */
 #endif
     /* root页的页号 */
     Pgno pgnoRoot;            /* The root page of this tree */
@@ -539,6 +657,9 @@ struct BtCursor
     CellInfo info;            /* A parse of the cell we are pointing at */
     i64 nKey;        /* Size of pKey, or last integer key */
     void *pKey;      /* Saved key that was cursor's last known position */
+    BtBulk *pBulk;   /* Bulk load in progress, or NULL */
+    u8 *aPrefix;     /* Local payload of a prefix-compressed cell, or NULL */
+    u32 nSeekSaved;  /* Page descents saved by seeks that did not start at root */
     int skipNext;    /* Prev() is noop if negative. Next() is noop if positive */
     u8 wrFlag;                /* True if writable */
     /* 游标是否指向了表的最后一条记录(entry) */
@@ -551,6 +672,8 @@ struct BtCursor
     u8 isIncrblobHandle;      /* True if this cursor is an incr. io handle */
 #endif
     u8 hints;                             /* As configured by CursorSetHints() */
+    u8 prefixOk;                          /* True to prefix-compress new cells */
+    u8 nSeqLeaf;                          /* Leaf-to-leaf steps since last seek */
     /* apPage[iPage]记录了游标现在处在数据库文件中的页 */
     i16 iPage;                            /* Index of current page in apPage */
     /* 关于aiIdx以及apPage两个数组
@@ -692,6 +815,7 @@ struct BtCursor
 ** indicate corruption).
 */
 typedef struct IntegrityCk IntegrityCk;
+typedef struct IntckPool IntckPool;
 struct IntegrityCk
 {
     BtShared *pBt;    /* The tree being checked out */
@@ -702,8 +826,23 @@ struct IntegrityCk
     int nErr;         /* Number of messages written to zErrMsg so far */
     int mallocFailed; /* A memory allocation error has occurred */
     StrAccum errMsg;  /* Accumulate the error message text here */
+    u32 *aSize;       /* Space for the cell sizes of one page, or NULL */
+    IntckPool *pPool; /* Worker threads checking page space, or NULL */
 };
 
+/*
+** The number of worker threads that an integrity-check uses to check the
+** space usage of b-tree pages, the number of pages that may wait for them
+** (each as a private copy of the page), and the smallest database, in pages,
+** for which they are started. Zero threads checks each page on the
+** calling thread.
+*/
+#ifndef SQLITE_INTCK_THREADS
+# define SQLITE_INTCK_THREADS 4
+#endif
+#define BT_INTCK_QUEUE 64
+#define BT_INTCK_MINPAGE 64
+
 /*
 ** Routines to read or write a two- and four-byte big-endian integer values.
 */
@@ -1010,8 +1010,18 @@ void sqlite3StartTable(
         sqlite3VdbeAddOp3(v, OP_ReadCookie, iDb, reg3, BTREE_FILE_FORMAT);
         sqlite3VdbeUsesBtree(v, iDb);
         j1 = sqlite3VdbeAddOp1(v, OP_If, reg3);
-        fileFormat = (db->flags & SQLITE_LegacyFileFmt) != 0 ?
-                     1 : SQLITE_MAX_FILE_FORMAT;
+        if (db->flags & SQLITE_LegacyFileFmt)
+        {
+            fileFormat = 1;
+        }
+        else if (db->flags & SQLITE_PrefixIndex)
+        {
+            fileFormat = SQLITE_PREFIX_FILE_FORMAT;
+        }
+        else
+        {
+            fileFormat = 4;
+        }
         sqlite3VdbeAddOp2(v, OP_Integer, fileFormat, reg3);
         sqlite3VdbeAddOp3(v, OP_SetCookie, iDb, BTREE_FILE_FORMAT, reg3);
         sqlite3VdbeAddOp2(v, OP_Integer, ENC(db), reg3);
@@ -2753,7 +2763,7 @@ static void sqlite3RefillIndex(Parse *pParse, Index *pIndex, int memRootPage)
     }
     sqlite3VdbeAddOp2(v, OP_SorterData, iSorter, regRecord);
     sqlite3VdbeAddOp3(v, OP_IdxInsert, iIdx, regRecord, 1); /* 往索引所在的地方插入数据 */
-    sqlite3VdbeChangeP5(v, OPFLAG_USESEEKRESULT);
+    sqlite3VdbeChangeP5(v, OPFLAG_BULKINSERT);
 #else
     regIdxKey = sqlite3GenerateIndexKey(pParse, pIndex, iTab, regRecord, 1);
     addr2 = addr1 + 1;
@@ -2782,6 +2792,9 @@ static void sqlite3RefillIndex(Parse *pParse, Index *pIndex, int memRootPage)
     sqlite3ReleaseTempReg(pParse, regRecord);
     sqlite3VdbeAddOp2(v, OP_SorterNext, iSorter, addr2);
     sqlite3VdbeJumpHere(v, addr1);
+#ifndef SQLITE_OMIT_MERGE_SORT
+    sqlite3VdbeAddOp1(v, OP_IdxBulkEnd, iIdx);
+#endif
 
     sqlite3VdbeAddOp1(v, OP_Close, iTab);
     sqlite3VdbeAddOp1(v, OP_Close, iIdx);
@@ -3893,7 +3906,7 @@ void sqlite3BeginTransaction(Parse *pParse, int type)
     }
     v = sqlite3GetVdbe(pParse);
     if (!v) return;
-    if (type != TK_DEFERRED)
+    if (type != TK_DEFERRED && type != TK_CONCURRENT)
     {
         for (i = 0; i < db->nDb; i++)
         {
@@ -3901,7 +3914,7 @@ void sqlite3BeginTransaction(Parse *pParse, int type)
             sqlite3VdbeUsesBtree(v, i);
         }
     }
-    sqlite3VdbeAddOp2(v, OP_AutoCommit, 0, 0);
+    sqlite3VdbeAddOp3(v, OP_AutoCommit, 0, 0, (type == TK_CONCURRENT));
 }
 
 /*
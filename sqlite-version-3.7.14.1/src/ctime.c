@@ -73,6 +73,9 @@ static const char * const azCompileOpt[] =
 #ifdef SQLITE_ENABLE_COLUMN_METADATA
     "ENABLE_COLUMN_METADATA",
 #endif
+#ifdef SQLITE_ENABLE_COMPUTED_GOTO
+    "ENABLE_COMPUTED_GOTO",
+#endif
 #ifdef SQLITE_ENABLE_EXPENSIVE_ASSERT
     "ENABLE_EXPENSIVE_ASSERT",
 #endif
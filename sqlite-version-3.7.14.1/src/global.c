@@ -162,6 +162,13 @@ SQLITE_WSD struct Sqlite3Config sqlite3Config =
     0,                         /* nPage */
     0,                         /* mxParserStack */
     0,                         /* sharedCacheEnabled */
+    SQLITE_DEFAULT_MMAP_SIZE,  /* szMmap */
+    SQLITE_MAX_MMAP_SIZE,      /* mxMmap */
+    SQLITE_DEFAULT_PCACHE_SHARDS, /* nPcacheShard */
+    SQLITE_DEFAULT_PCACHE_POLICY, /* ePcachePolicy */
+    0,                         /* szHugePage */
+    0,                         /* nHugePage */
+    SQLITE_DEFAULT_PCACHE_TIER, /* nPcacheTier */
     /* All the rest should always be initialized to zero */
     0,                         /* isInit */
     0,                         /* inProgress */
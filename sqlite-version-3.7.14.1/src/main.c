@@ -228,8 +228,16 @@ int sqlite3_initialize(void)
         }
         if (rc == SQLITE_OK)
         {
-            sqlite3PCacheBufferSetup(sqlite3GlobalConfig.pPage,
-                                     sqlite3GlobalConfig.szPage, sqlite3GlobalConfig.nPage);
+            if (sqlite3GlobalConfig.pPage == 0 && sqlite3GlobalConfig.szHugePage > 0)
+            {
+                sqlite3PCacheArenaSetup(sqlite3GlobalConfig.szHugePage,
+                                        sqlite3GlobalConfig.nHugePage);
+            }
+            else
+            {
+                sqlite3PCacheBufferSetup(sqlite3GlobalConfig.pPage,
+                                         sqlite3GlobalConfig.szPage, sqlite3GlobalConfig.nPage);
+            }
             sqlite3GlobalConfig.isInit = 1;
         }
         sqlite3GlobalConfig.inProgress = 0;
@@ -534,6 +542,63 @@ int sqlite3_config(int op, ...)
             break;
         }
 
+        case SQLITE_CONFIG_MMAP_SIZE:
+        {
+            sqlite3_int64 szMmap = va_arg(ap, sqlite3_int64);
+            sqlite3_int64 mxMmap = va_arg(ap, sqlite3_int64);
+            if (mxMmap < 0 || mxMmap > SQLITE_MAX_MMAP_SIZE)
+            {
+                mxMmap = SQLITE_MAX_MMAP_SIZE;
+            }
+            sqlite3GlobalConfig.mxMmap = mxMmap;
+            if (szMmap < 0) szMmap = SQLITE_DEFAULT_MMAP_SIZE;
+            if (szMmap > mxMmap) szMmap = mxMmap;
+            sqlite3GlobalConfig.szMmap = szMmap;
+            break;
+        }
+
+        case SQLITE_CONFIG_PCACHE_SHARDS:
+        {
+            int nShard = va_arg(ap, int);
+            if (nShard < 0) nShard = SQLITE_DEFAULT_PCACHE_SHARDS;
+            if (nShard > SQLITE_MAX_PCACHE_SHARDS) nShard = SQLITE_MAX_PCACHE_SHARDS;
+            sqlite3GlobalConfig.nPcacheShard = nShard;
+            break;
+        }
+
+        case SQLITE_CONFIG_PCACHE_POLICY:
+        {
+            int ePolicy = va_arg(ap, int);
+            if (ePolicy != SQLITE_PCACHE_POLICY_LRU && ePolicy != SQLITE_PCACHE_POLICY_2Q)
+            {
+                rc = SQLITE_ERROR;
+            }
+            else
+            {
+                sqlite3GlobalConfig.ePcachePolicy = ePolicy;
+            }
+            break;
+        }
+
+        case SQLITE_CONFIG_PAGECACHE_HUGEPAGE:
+        {
+            /* Have the page cache map an arena for its page buffers */
+            int sz = va_arg(ap, int);
+            int n = va_arg(ap, int);
+            if (n <= 0) n = SQLITE_DEFAULT_CACHE_SIZE;
+            sqlite3GlobalConfig.szHugePage = (sz > 0 ? sz : 0);
+            sqlite3GlobalConfig.nHugePage = n;
+            break;
+        }
+
+        case SQLITE_CONFIG_PCACHE_TIER:
+        {
+            int nPercent = va_arg(ap, int);
+            if (nPercent < 0) nPercent = SQLITE_DEFAULT_PCACHE_TIER;
+            sqlite3GlobalConfig.nPcacheTier = nPercent;
+            break;
+        }
+
         default:
         {
             rc = SQLITE_ERROR;
@@ -762,6 +827,15 @@ static int binCollFunc(
     return rc;
 }
 
+/*
+** Return true if pColl is the built-in BINARY collating sequence.  A NULL
+** pointer, which also compares with memcmp(), counts as BINARY.
+*/
+int sqlite3IsBinary(const CollSeq *pColl)
+{
+    return pColl == 0 || (pColl->xCmp == binCollFunc && pColl->pUser == 0);
+}
+
 /*
 ** Another built-in collating sequence: NOCASE.
 **
@@ -1681,6 +1755,13 @@ int sqlite3WalDefaultHook(
     int nFrame             /* Size of WAL */
 )
 {
+    int iDb = sqlite3FindDbName(db, zDb);
+
+    /* A background checkpointer takes care of this database. */
+    if (iDb >= 0 && sqlite3PagerCkptThreadActive(sqlite3BtreePager(db->aDb[iDb].pBt)))
+    {
+        return SQLITE_OK;
+    }
     if (nFrame >= SQLITE_PTR_TO_INT(pClientData))
     {
         sqlite3BeginBenignMalloc();
@@ -1794,6 +1875,74 @@ int sqlite3_wal_checkpoint_v2(
 }
 
 
+/*
+** Configure the background checkpointer for database zDb, or for all
+** attached databases if zDb is NULL or a zero-length string.
+*/
+int sqlite3_wal_checkpoint_thread(
+    sqlite3 *db,                    /* Database handle */
+    const char *zDb,                /* Name of attached database (or NULL) */
+    int nFrame,                     /* Checkpoint threshold, or 0 to disable */
+    int nPagePerSec,                /* Maximum pages written per second */
+    int eSync                       /* 0, SQLITE_SYNC_NORMAL or SQLITE_SYNC_FULL */
+)
+{
+#ifdef SQLITE_OMIT_WAL
+    return SQLITE_OK;
+#else
+    int rc = SQLITE_OK;             /* Return code */
+    int iDb = SQLITE_MAX_ATTACHED;  /* sqlite3.aDb[] index of db to configure */
+    int i;
+
+    if (eSync != 0 && eSync != SQLITE_SYNC_NORMAL && eSync != SQLITE_SYNC_FULL)
+    {
+        return SQLITE_MISUSE;
+    }
+
+    sqlite3_mutex_enter(db->mutex);
+    if (zDb && zDb[0])
+    {
+        iDb = sqlite3FindDbName(db, zDb);
+    }
+    if (iDb < 0)
+    {
+        rc = SQLITE_ERROR;
+        sqlite3Error(db, SQLITE_ERROR, "unknown database: %s", zDb);
+    }
+#if SQLITE_THREADSAFE && SQLITE_OS_UNIX
+    else if (nFrame > 0 && sqlite3GlobalConfig.bCoreMutex == 0)
+#else
+    else if (nFrame > 0)
+#endif
+    {
+        /* The checkpointer thread allocates memory, so it needs the
+        ** library to be threadsafe. 需要多线程支持 */
+        rc = SQLITE_ERROR;
+        sqlite3Error(db, SQLITE_ERROR, "background checkpoints not available");
+    }
+    else
+    {
+        for (i = 0; i < db->nDb && rc == SQLITE_OK; i++)
+        {
+            Btree *pBt = db->aDb[i].pBt;
+            if (pBt && (iDb == SQLITE_MAX_ATTACHED || iDb == i))
+            {
+                sqlite3BtreeEnter(pBt);
+                rc = sqlite3PagerWalCkptThread(sqlite3BtreePager(pBt),
+                                               nFrame, nPagePerSec, eSync
+                                              );
+                sqlite3BtreeLeave(pBt);
+            }
+        }
+        sqlite3Error(db, rc, 0);
+    }
+    rc = sqlite3ApiExit(db, rc);
+    sqlite3_mutex_leave(db->mutex);
+    return rc;
+#endif
+}
+
+
 /*
 ** Checkpoint database zDb. If zDb is NULL, or if the buffer zDb points
 ** to contains a zero-length string, all attached databases are
@@ -2582,6 +2731,7 @@ static int openDatabase(
     db->autoCommit = 1;
     db->nextAutovac = -1;
     db->nextPagesize = 0;
+    db->szMmap = sqlite3GlobalConfig.szMmap;
     db->flags |= SQLITE_ShortColNames | SQLITE_AutoIndex | SQLITE_EnableTrigger
 #if SQLITE_DEFAULT_FILE_FORMAT<4
                  | SQLITE_LegacyFileFmt
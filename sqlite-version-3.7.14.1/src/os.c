@@ -167,6 +167,56 @@ int sqlite3OsShmMap(
     return id->pMethods->xShmMap(id, iPage, pgsz, bExtend, pp);
 }
 
+#if SQLITE_MAX_MMAP_SIZE>0
+/*
+** Obtain a pointer to iAmt bytes of the file starting at offset iOff
+** directly from a memory mapping, or set *pp to NULL if the VFS cannot
+** provide one.  Release a non-NULL pointer with sqlite3OsUnfetch().
+*/
+int sqlite3OsFetch(sqlite3_file *id, i64 iOff, int iAmt, void **pp)
+{
+    return id->pMethods->xFetch(id, iOff, iAmt, pp);
+}
+int sqlite3OsUnfetch(sqlite3_file *id, i64 iOff, void *p)
+{
+    return id->pMethods->xUnfetch(id, iOff, p);
+}
+#else
+/* No-op stubs to use when memory-mapped I/O is disabled */
+int sqlite3OsFetch(sqlite3_file *id, i64 iOff, int iAmt, void **pp)
+{
+    UNUSED_PARAMETER(id);
+    UNUSED_PARAMETER(iOff);
+    UNUSED_PARAMETER(iAmt);
+    *pp = 0;
+    return SQLITE_OK;
+}
+int sqlite3OsUnfetch(sqlite3_file *id, i64 iOff, void *p)
+{
+    UNUSED_PARAMETER(id);
+    UNUSED_PARAMETER(iOff);
+    UNUSED_PARAMETER(p);
+    return SQLITE_OK;
+}
+#endif
+
+/*
+** Fill the nBuf buffers in apBuf[], each szBuf bytes in size, with data
+** read from consecutive offsets starting at iOfst, using a single vectored
+** read.  SQLITE_NOTFOUND is returned if the VFS does not provide the
+** xReadv() method, in which case nothing is read.
+*/
+int sqlite3OsReadv(sqlite3_file *id, i64 iOfst, int szBuf, int nBuf, void **apBuf)
+{
+    assert(nBuf > 0 && nBuf <= SQLITE_MAX_READV);
+    if (id->pMethods->iVersion < 4 || id->pMethods->xReadv == 0)
+    {
+        return SQLITE_NOTFOUND;
+    }
+    DO_OS_MALLOC_TEST(id);
+    return id->pMethods->xReadv(id, iOfst, szBuf, nBuf, apBuf);
+}
+
 /*
 ** The next group of routines are convenience wrappers around the
 ** VFS methods.
@@ -123,6 +123,32 @@
 #include <sys/mman.h>
 #endif
 
+/*
+** Use preadv() to read runs of pages ahead of need where it is available.
+*/
+#if !defined(HAVE_PREADV)
+# if defined(__linux__) || defined(__FreeBSD__)
+#   define HAVE_PREADV 1
+# else
+#   define HAVE_PREADV 0
+# endif
+#endif
+#if HAVE_PREADV
+# include <sys/uio.h>
+#endif
+
+/*
+** The "unix-uring" VFS is only available on Linux.
+*/
+#if defined(SQLITE_ENABLE_IO_URING) && !defined(__linux__)
+# undef SQLITE_ENABLE_IO_URING
+#endif
+#ifdef SQLITE_ENABLE_IO_URING
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include <linux/io_uring.h>
+#endif
+
 
 #if SQLITE_ENABLE_LOCKING_STYLE
 # include <sys/ioctl.h>
@@ -187,6 +213,10 @@ typedef struct unixShm unixShm;               /* Connection shared memory */
 typedef struct unixShmNode unixShmNode;       /* Shared memory instance */
 typedef struct unixInodeInfo unixInodeInfo;   /* An i-node */
 typedef struct UnixUnusedFd UnixUnusedFd;     /* An unused file descriptor */
+typedef struct UnixSyncWait UnixSyncWait;     /* A WAL sync request */
+#ifdef SQLITE_ENABLE_IO_URING
+typedef struct unixUring unixUring;           /* io_uring submission state */
+#endif
 
 /*
 ** Sometimes, after a file handle is closed by SQLite, the file descriptor
@@ -222,6 +252,16 @@ struct unixFile
     const char *zPath;                  /* Name of the file */
     unixShm *pShm;                      /* Shared memory segment information */
     int szChunk;                        /* Configured by FCNTL_CHUNK_SIZE */
+#if SQLITE_MAX_MMAP_SIZE>0
+    int nFetchOut;                      /* Number of outstanding xFetch refs */
+    sqlite3_int64 mmapSize;             /* Usable size of mapping at pMapRegion */
+    sqlite3_int64 mmapSizeActual;       /* Actual size of mapping at pMapRegion */
+    sqlite3_int64 mmapSizeMax;          /* Configured FCNTL_MMAP_SIZE value */
+    void *pMapRegion;                   /* Memory mapped region (只读映射) */
+#endif
+#ifdef SQLITE_ENABLE_IO_URING
+    unixUring *pUring;                  /* io_uring state, or NULL */
+#endif
 #if SQLITE_ENABLE_LOCKING_STYLE
     int openFlags;                      /* The flags specified at open() */
 #endif
@@ -266,6 +306,7 @@ struct unixFile
 #define UNIXFILE_DELETE      0x20     /* Delete on close */
 #define UNIXFILE_URI         0x40     /* Filename might have query parameters */
 #define UNIXFILE_NOLOCK      0x80     /* Do no file locking */
+#define UNIXFILE_URING      0x100     /* Submit I/O through io_uring */
 
 /*
 ** Include code that is common to all os_*.c files
@@ -442,6 +483,28 @@ static struct unix_syscall
     { "umask", (sqlite3_syscall_ptr)umask,           0 },
 #define osUmask     ((mode_t(*)(mode_t))aSyscall[21].pCurrent)
 
+#if SQLITE_MAX_MMAP_SIZE>0
+    { "mmap",       (sqlite3_syscall_ptr)mmap,     0 },
+#else
+    { "mmap",       (sqlite3_syscall_ptr)0,        0 },
+#endif
+#define osMmap ((void*(*)(void*,size_t,int,int,int,off_t))aSyscall[22].pCurrent)
+
+#if SQLITE_MAX_MMAP_SIZE>0
+    { "munmap",     (sqlite3_syscall_ptr)munmap,   0 },
+#else
+    { "munmap",     (sqlite3_syscall_ptr)0,        0 },
+#endif
+#define osMunmap ((int(*)(void*,size_t))aSyscall[23].pCurrent)
+
+#if HAVE_PREADV
+    { "preadv",     (sqlite3_syscall_ptr)preadv,   0 },
+#else
+    { "preadv",     (sqlite3_syscall_ptr)0,        0 },
+#endif
+#define osPreadv ((ssize_t(*)(int,const struct iovec*,int,off_t))\
+                  aSyscall[24].pCurrent)
+
 }; /* End of the overrideable system calls */
 
 /*
@@ -1982,6 +2045,20 @@ static int unixUnlock(sqlite3_file *id, int eFileLock)
     return posixUnlock(id, eFileLock, 0);
 }
 
+#if SQLITE_MAX_MMAP_SIZE>0
+/* Forward references to the memory-mapping routines defined below */
+static int unixMapfile(unixFile *pFd, i64 nByte);
+static void unixUnmapfile(unixFile *pFd);
+#endif
+
+#ifdef SQLITE_ENABLE_IO_URING
+/* Forward references to the io_uring routines defined below */
+static int uringSetup(unixFile *pFile);
+static int uringRead(unixFile *pFile, i64 iOfst, void *pBuf, int cnt);
+static int uringFlush(unixFile *pFile);
+static void uringDestroy(unixFile *pFile);
+#endif
+
 /*
 ** This function performs the parts of the "close file" operation
 ** common to all locking schemes. It closes the directory and file
@@ -1995,6 +2072,13 @@ static int unixUnlock(sqlite3_file *id, int eFileLock)
 static int closeUnixFile(sqlite3_file *id)
 {
     unixFile *pFile = (unixFile*)id;
+#if SQLITE_MAX_MMAP_SIZE>0
+    unixUnmapfile(pFile);
+#endif
+#ifdef SQLITE_ENABLE_IO_URING
+    uringFlush(pFile);
+    uringDestroy(pFile);
+#endif
     if (pFile->h >= 0)
     {
         robust_close(pFile, pFile->h, __LINE__);
@@ -3336,6 +3420,12 @@ static int seekAndRead(unixFile *id, sqlite3_int64 offset, void *pBuf, int cnt)
     int prior = 0;
 #if (!defined(USE_PREAD) && !defined(USE_PREAD64))
     i64 newOffset;
+#endif
+#ifdef SQLITE_ENABLE_IO_URING
+    if ((id->ctrlFlags & UNIXFILE_URING) && uringSetup(id) == SQLITE_OK)
+    {
+        return uringRead(id, offset, pBuf, cnt);
+    }
 #endif
     TIMER_START;
     do
@@ -3434,6 +3524,76 @@ static int unixRead(
     }
 }
 
+/*
+** Read nBuf consecutive blocks of szBuf bytes, starting at offset iOfst,
+** into the buffers in apBuf[] with a single preadv() call.  Return
+** SQLITE_NOTFOUND if preadv() is not available.
+*/
+static int unixReadv(
+    sqlite3_file *id,
+    sqlite3_int64 iOfst,
+    int szBuf,
+    int nBuf,
+    void **apBuf
+)
+{
+#if HAVE_PREADV
+    unixFile *pFile = (unixFile *)id;
+    struct iovec aIov[SQLITE_MAX_READV];
+    int nByte = szBuf * nBuf;
+    int got;
+    int i;
+
+    assert(nBuf > 0 && nBuf <= SQLITE_MAX_READV);
+#ifdef SQLITE_ENABLE_IO_URING
+    got = uringFlush(pFile);
+    if (got != SQLITE_OK) return got;
+#endif
+    for (i = 0; i < nBuf; i++)
+    {
+        aIov[i].iov_base = apBuf[i];
+        aIov[i].iov_len = szBuf;
+    }
+    TIMER_START;
+    do
+    {
+        got = (int)osPreadv(pFile->h, aIov, nBuf, iOfst);
+    }
+    while (got < 0 && errno == EINTR);
+    SimulateIOError(got = -1);
+    TIMER_END;
+    OSTRACE(("READV   %-3d %5d %7lld %llu\n", pFile->h, got, iOfst, TIMER_ELAPSED));
+
+    if (got == nByte)
+    {
+        return SQLITE_OK;
+    }
+    else if (got < 0)
+    {
+        pFile->lastErrno = errno;
+        return SQLITE_IOERR_READ;
+    }
+    else
+    {
+        /* Unread parts of the buffers must be zero-filled */
+        pFile->lastErrno = 0; /* not a system error */
+        for (i = got / szBuf; i < nBuf; i++)
+        {
+            int nGot = (i == got / szBuf) ? got % szBuf : 0;
+            memset(&((char*)apBuf[i])[nGot], 0, szBuf - nGot);
+        }
+        return SQLITE_IOERR_SHORT_READ;
+    }
+#else
+    UNUSED_PARAMETER(id);
+    UNUSED_PARAMETER(iOfst);
+    UNUSED_PARAMETER(szBuf);
+    UNUSED_PARAMETER(nBuf);
+    UNUSED_PARAMETER(apBuf);
+    return SQLITE_NOTFOUND;
+#endif
+}
+
 /*
 ** Seek to the offset in id->offset then read cnt bytes into pBuf.
 ** Return the number of bytes actually read.  Update the offset.
@@ -3492,6 +3652,429 @@ static int seekAndWrite(unixFile *id, i64 offset, const void *pBuf, int cnt)
 }
 
 
+#ifdef SQLITE_ENABLE_IO_URING
+/*
+** The "unix-uring" VFS.
+**
+** Files opened through "unix-uring" are marked with UNIXFILE_URING.  The
+** first time such a file is read or written, a small io_uring instance is
+** created for it and from then on reads and writes are submitted through
+** the ring instead of being issued as one pread() or pwrite() each.  If
+** the kernel does not support io_uring the flag is cleared and the file
+** uses the ordinary system calls, so "unix-uring" always works.
+**
+** Outside of a write batch, each write is submitted on its own and waited
+** for before xWrite returns, just like pwrite().  Between the
+** SQLITE_FCNTL_WRITE_BATCH_BEGIN and SQLITE_FCNTL_WRITE_BATCH_END file
+** controls, writes are copied into private buffers and queued instead.  The
+** queue is submitted with a single io_uring_enter() call when it fills up,
+** when the batch ends, when a queued write overlaps a new one, or before
+** any operation that must see the data on disk (xRead, xSync, xTruncate,
+** xFileSize or xClose).  A queued write that the kernel fails or only
+** partly completes is finished with pwrite(), so the error code reported
+** for it is the same one that unixWrite() would have returned.
+*/
+
+/*
+** Maximum number of writes that may be queued on a ring before it is
+** submitted.
+*/
+#ifndef SQLITE_URING_ENTRIES
+# define SQLITE_URING_ENTRIES 64
+#endif
+
+/*
+** A write queued on a unixUring.  If bOwn is true, aData is a private copy
+** of the caller's buffer obtained from sqlite3_malloc().
+*/
+typedef struct UringWrite UringWrite;
+struct UringWrite
+{
+    const char *aData;                  /* Data to write */
+    int nData;                          /* Number of bytes at aData */
+    int bOwn;                           /* True if aData must be freed */
+    i64 iOfst;                          /* Offset to write to */
+};
+
+/*
+** An io_uring instance attached to a single unixFile.
+*/
+struct unixUring
+{
+    int fd;                             /* Returned by io_uring_setup() */
+    unsigned *pSqHead;                  /* Submission ring head (kernel) */
+    unsigned *pSqTail;                  /* Submission ring tail (ours) */
+    unsigned sqMask;                    /* Submission ring index mask */
+    unsigned *aSqIndex;                 /* Submission ring index array */
+    struct io_uring_sqe *aSqe;          /* Submission queue entries */
+    unsigned *pCqHead;                  /* Completion ring head (ours) */
+    unsigned *pCqTail;                  /* Completion ring tail (kernel) */
+    unsigned cqMask;                    /* Completion ring index mask */
+    struct io_uring_cqe *aCqe;          /* Completion queue entries */
+    void *pSqRing;                      /* Mapping of the submission ring */
+    size_t szSqRing;                    /* Size of mapping at pSqRing */
+    void *pCqRing;                      /* Mapping of the completion ring */
+    size_t szCqRing;                    /* Size of mapping at pCqRing */
+    size_t szSqe;                       /* Size of mapping at aSqe */
+    int nEntry;                         /* Capacity of aWrite[] in use */
+    int bBatch;                         /* True inside a write batch */
+    int nQueued;                        /* Number of entries in aWrite[] */
+    UringWrite aWrite[SQLITE_URING_ENTRIES];  /* Queued writes */
+};
+
+/*
+** Release the io_uring instance attached to pFile, if any.  Queued writes
+** are discarded, so the caller must flush them first if they matter.
+*/
+static void uringDestroy(unixFile *pFile)
+{
+    unixUring *p = pFile->pUring;
+    int i;
+    if (p == 0) return;
+    for (i = 0; i < p->nQueued; i++)
+    {
+        if (p->aWrite[i].bOwn) sqlite3_free((void*)p->aWrite[i].aData);
+    }
+    if (p->aSqe) munmap(p->aSqe, p->szSqe);
+    if (p->pCqRing) munmap(p->pCqRing, p->szCqRing);
+    if (p->pSqRing) munmap(p->pSqRing, p->szSqRing);
+    if (p->fd >= 0) robust_close(pFile, p->fd, __LINE__);
+    sqlite3_free(p);
+    pFile->pUring = 0;
+}
+
+/*
+** Make sure pFile has an io_uring instance.  Return SQLITE_OK if it does.
+**
+** If the kernel refuses to create one, clear UNIXFILE_URING so that the
+** file uses ordinary system calls from now on and return SQLITE_ERROR.
+** SQLITE_NOMEM is returned if a malloc() fails; in that case only the
+** current operation falls back to the ordinary system calls.
+*/
+static int uringSetup(unixFile *pFile)
+{
+    struct io_uring_params prm;
+    unixUring *p;
+    void *pMap;
+    u8 *aSq;
+    u8 *aCq;
+
+    if (pFile->pUring) return SQLITE_OK;
+    p = (unixUring*)sqlite3_malloc(sizeof(unixUring));
+    if (p == 0) return SQLITE_NOMEM;
+    memset(p, 0, sizeof(unixUring));
+    pFile->pUring = p;
+
+    memset(&prm, 0, sizeof(prm));
+    p->fd = (int)syscall(__NR_io_uring_setup, SQLITE_URING_ENTRIES, &prm);
+    if (p->fd < 0) goto uring_setup_failed;
+    p->szSqRing = prm.sq_off.array + prm.sq_entries * sizeof(unsigned);
+    p->szCqRing = prm.cq_off.cqes + prm.cq_entries * sizeof(struct io_uring_cqe);
+    p->szSqe = prm.sq_entries * sizeof(struct io_uring_sqe);
+
+    pMap = mmap(0, p->szSqRing, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                p->fd, IORING_OFF_SQ_RING);
+    if (pMap == MAP_FAILED) goto uring_setup_failed;
+    p->pSqRing = pMap;
+    pMap = mmap(0, p->szCqRing, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                p->fd, IORING_OFF_CQ_RING);
+    if (pMap == MAP_FAILED) goto uring_setup_failed;
+    p->pCqRing = pMap;
+    pMap = mmap(0, p->szSqe, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                p->fd, IORING_OFF_SQES);
+    if (pMap == MAP_FAILED) goto uring_setup_failed;
+    p->aSqe = (struct io_uring_sqe*)pMap;
+
+    aSq = (u8*)p->pSqRing;
+    p->pSqHead = (unsigned*)&aSq[prm.sq_off.head];
+    p->pSqTail = (unsigned*)&aSq[prm.sq_off.tail];
+    p->sqMask = *(unsigned*)&aSq[prm.sq_off.ring_mask];
+    p->aSqIndex = (unsigned*)&aSq[prm.sq_off.array];
+    aCq = (u8*)p->pCqRing;
+    p->pCqHead = (unsigned*)&aCq[prm.cq_off.head];
+    p->pCqTail = (unsigned*)&aCq[prm.cq_off.tail];
+    p->cqMask = *(unsigned*)&aCq[prm.cq_off.ring_mask];
+    p->aCqe = (struct io_uring_cqe*)&aCq[prm.cq_off.cqes];
+    p->nEntry = SQLITE_URING_ENTRIES;
+    if (prm.sq_entries < SQLITE_URING_ENTRIES) p->nEntry = (int)prm.sq_entries;
+    OSTRACE(("URING   %-3d ring %d entries\n", pFile->h, p->nEntry));
+    return SQLITE_OK;
+
+uring_setup_failed:
+    OSTRACE(("URING   %-3d unavailable (errno %d)\n", pFile->h, errno));
+    uringDestroy(pFile);
+    pFile->ctrlFlags &= ~UNIXFILE_URING;
+    return SQLITE_ERROR;
+}
+
+/*
+** Add a read or write of nByte bytes at offset iOfst to the submission
+** ring.  The entry is not submitted until uringSubmit() is called.
+*/
+static void uringPrepare(
+    unixFile *pFile,
+    int op,                             /* IORING_OP_READ or IORING_OP_WRITE */
+    const void *pBuf,                   /* Buffer to read into or write from */
+    int nByte,                          /* Number of bytes */
+    i64 iOfst,                          /* File offset */
+    int iSlot                           /* Passed back in the completion */
+)
+{
+    unixUring *p = pFile->pUring;
+    unsigned iTail = *p->pSqTail;
+    unsigned iIdx = iTail & p->sqMask;
+    struct io_uring_sqe *pSqe = &p->aSqe[iIdx];
+
+    memset(pSqe, 0, sizeof(*pSqe));
+    pSqe->opcode = (u8)op;
+    pSqe->fd = pFile->h;
+    pSqe->addr = (unsigned long)pBuf;
+    pSqe->len = (unsigned)nByte;
+    pSqe->off = (sqlite3_uint64)iOfst;
+    pSqe->user_data = (sqlite3_uint64)iSlot;
+    p->aSqIndex[iIdx] = iIdx;
+    __atomic_store_n(p->pSqTail, iTail + 1, __ATOMIC_RELEASE);
+}
+
+/*
+** Submit the nSqe entries prepared by uringPrepare() and ask the kernel to
+** wait until they have all completed, all in one system call where
+** possible.  Return the number of entries the kernel accepted.  Entries it
+** did not accept are removed from the ring again, so the caller must
+** perform them some other way.
+*/
+static int uringSubmit(unixFile *pFile, int nSqe)
+{
+    unixUring *p = pFile->pUring;
+    int nDone = 0;
+    while (nDone < nSqe)
+    {
+        int rc = (int)syscall(__NR_io_uring_enter, p->fd, nSqe - nDone,
+                              nSqe - nDone, IORING_ENTER_GETEVENTS, (void*)0, 0);
+        if (rc < 0 && errno == EINTR) continue;
+        if (rc <= 0)
+        {
+            pFile->lastErrno = errno;
+            __atomic_store_n(p->pSqTail,
+                             __atomic_load_n(p->pSqHead, __ATOMIC_ACQUIRE),
+                             __ATOMIC_RELEASE);
+            break;
+        }
+        nDone += rc;
+    }
+    return nDone;
+}
+
+/*
+** Remove the next completion from the completion ring, waiting for one to
+** arrive if necessary.  Return 0 and set *piSlot and *pRes, or return -1 if
+** the kernel cannot be waited on.
+*/
+static int uringReap(unixFile *pFile, int *piSlot, int *pRes)
+{
+    unixUring *p = pFile->pUring;
+    unsigned iHead = *p->pCqHead;
+    struct io_uring_cqe *pCqe;
+
+    while (iHead == __atomic_load_n(p->pCqTail, __ATOMIC_ACQUIRE))
+    {
+        int rc = (int)syscall(__NR_io_uring_enter, p->fd, 0, 1,
+                              IORING_ENTER_GETEVENTS, (void*)0, 0);
+        if (rc < 0 && errno != EINTR)
+        {
+            pFile->lastErrno = errno;
+            return -1;
+        }
+    }
+    pCqe = &p->aCqe[iHead & p->cqMask];
+    *piSlot = (int)pCqe->user_data;
+    *pRes = pCqe->res;
+    __atomic_store_n(p->pCqHead, iHead + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+** Write amt bytes to pFile with pwrite(), mapping errors exactly as
+** unixWrite() does.
+*/
+static int uringWriteSync(unixFile *pFile, const void *pBuf, int amt, i64 offset)
+{
+    int wrote = 0;
+    while (amt > 0 && (wrote = seekAndWrite(pFile, offset, pBuf, amt)) > 0)
+    {
+        amt -= wrote;
+        offset += wrote;
+        pBuf = &((char*)pBuf)[wrote];
+    }
+    if (amt > 0)
+    {
+        if (wrote < 0 && pFile->lastErrno != ENOSPC)
+        {
+            return SQLITE_IOERR_WRITE;
+        }
+        pFile->lastErrno = 0; /* not a system error */
+        return SQLITE_FULL;
+    }
+    return SQLITE_OK;
+}
+
+/*
+** Submit all writes queued on the ring of pFile and wait for them to
+** complete.  Return SQLITE_OK, or the error code of the first write that
+** could not be completed.
+*/
+static int uringFlush(unixFile *pFile)
+{
+    unixUring *p = pFile->pUring;
+    int rc = SQLITE_OK;
+    int nSubmit;
+    int nReap;
+    int i;
+    u8 aDone[SQLITE_URING_ENTRIES];
+
+    if (p == 0 || p->nQueued == 0) return SQLITE_OK;
+    OSTRACE(("URING   %-3d submit %d writes\n", pFile->h, p->nQueued));
+
+    memset(aDone, 0, sizeof(aDone));
+    for (i = 0; i < p->nQueued; i++)
+    {
+        UringWrite *pW = &p->aWrite[i];
+        uringPrepare(pFile, IORING_OP_WRITE, pW->aData, pW->nData, pW->iOfst, i);
+    }
+    nSubmit = uringSubmit(pFile, p->nQueued);
+    for (nReap = 0; nReap < nSubmit; nReap++)
+    {
+        int iSlot;
+        int res;
+        if (uringReap(pFile, &iSlot, &res))
+        {
+            /* The kernel may still be using the buffers of the writes that
+            ** have not been reaped. Leak them rather than free them. */
+            for (i = 0; i < p->nQueued; i++) p->aWrite[i].bOwn = 0;
+            p->nQueued = 0;
+            uringDestroy(pFile);
+            pFile->ctrlFlags &= ~UNIXFILE_URING;
+            return SQLITE_IOERR_WRITE;
+        }
+        assert(iSlot >= 0 && iSlot < p->nQueued);
+        if (res == p->aWrite[iSlot].nData) aDone[iSlot] = 1;
+    }
+
+    /* Finish any write the ring did not complete with pwrite(). Queued
+    ** writes never overlap, so the order in which this happens does not
+    ** matter. */
+    for (i = 0; i < p->nQueued; i++)
+    {
+        UringWrite *pW = &p->aWrite[i];
+        if (aDone[i] == 0 && rc == SQLITE_OK)
+        {
+            rc = uringWriteSync(pFile, pW->aData, pW->nData, pW->iOfst);
+        }
+        if (pW->bOwn) sqlite3_free((void*)pW->aData);
+    }
+    p->nQueued = 0;
+
+    /* If the kernel would not accept submissions, stop using the ring. */
+    if (nSubmit == 0)
+    {
+        uringDestroy(pFile);
+        pFile->ctrlFlags &= ~UNIXFILE_URING;
+    }
+    return rc;
+}
+
+/*
+** Read cnt bytes from offset iOfst of pFile through the ring.  The return
+** value and error handling are the same as for seekAndRead().
+*/
+static int uringRead(unixFile *pFile, i64 iOfst, void *pBuf, int cnt)
+{
+    int got = 0;
+
+    /* Queued writes must reach the file before it is read back */
+    if (pFile->pUring->nQueued && uringFlush(pFile) != SQLITE_OK) return -1;
+    if (pFile->pUring == 0) return seekAndRead(pFile, iOfst, pBuf, cnt);
+
+    while (got < cnt)
+    {
+        int iSlot;
+        int res;
+        uringPrepare(pFile, IORING_OP_READ, &((char*)pBuf)[got], cnt - got,
+                     iOfst + got, 0);
+        if (uringSubmit(pFile, 1) != 1)
+        {
+            /* The ring is unusable. Read the rest with pread(). */
+            int rc;
+            uringDestroy(pFile);
+            pFile->ctrlFlags &= ~UNIXFILE_URING;
+            rc = seekAndRead(pFile, iOfst + got, &((char*)pBuf)[got], cnt - got);
+            return rc < 0 ? rc : got + rc;
+        }
+        if (uringReap(pFile, &iSlot, &res)) return -1;
+        if (res < 0)
+        {
+            if (res == -EINTR || res == -EAGAIN) continue;
+            pFile->lastErrno = -res;
+            return -1;
+        }
+        if (res == 0) break;    /* End of file */
+        got += res;
+    }
+    OSTRACE(("READ    %-3d %5d %7lld uring\n", pFile->h, got, iOfst));
+    return got;
+}
+
+/*
+** Write amt bytes to pFile through the ring.  Inside a write batch the
+** data is copied and queued; otherwise it is written before returning.
+*/
+static int uringWrite(unixFile *pFile, const void *pBuf, int amt, i64 offset)
+{
+    unixUring *p = pFile->pUring;
+    UringWrite *pW;
+    int rc = SQLITE_OK;
+    int i;
+
+    /* A queued write that overlaps this one must reach the file first,
+    ** as must the queue itself once it is full. */
+    for (i = 0; i < p->nQueued; i++)
+    {
+        pW = &p->aWrite[i];
+        if (pW->iOfst < offset + amt && offset < pW->iOfst + pW->nData) break;
+    }
+    if (i < p->nQueued || p->nQueued == p->nEntry)
+    {
+        rc = uringFlush(pFile);
+        if (rc != SQLITE_OK) return rc;
+        p = pFile->pUring;
+        if (p == 0) return uringWriteSync(pFile, pBuf, amt, offset);
+    }
+
+    pW = &p->aWrite[p->nQueued];
+    pW->bOwn = 0;
+    pW->aData = (const char*)pBuf;
+    if (p->bBatch)
+    {
+        char *aCopy = (char*)sqlite3_malloc(amt);
+        if (aCopy == 0)
+        {
+            rc = uringFlush(pFile);
+            if (rc == SQLITE_OK) rc = uringWriteSync(pFile, pBuf, amt, offset);
+            return rc;
+        }
+        memcpy(aCopy, pBuf, amt);
+        pW->aData = aCopy;
+        pW->bOwn = 1;
+    }
+    pW->nData = amt;
+    pW->iOfst = offset;
+    p->nQueued++;
+
+    if (p->bBatch == 0) rc = uringFlush(pFile);
+    return rc;
+}
+#endif /* SQLITE_ENABLE_IO_URING */
+
 /*
 ** Write data from a buffer into a file.  Return SQLITE_OK on success
 ** or some other error code on failure.
@@ -3542,6 +4125,15 @@ static int unixWrite(
     }
 #endif
 
+#ifdef SQLITE_ENABLE_IO_URING
+    if ((pFile->ctrlFlags & UNIXFILE_URING) && uringSetup(pFile) == SQLITE_OK)
+    {
+        SimulateIOError(return SQLITE_IOERR_WRITE);
+        SimulateDiskfullError(return SQLITE_FULL);
+        return uringWrite(pFile, pBuf, amt, offset);
+    }
+#endif
+
     while (amt > 0 && (wrote = seekAndWrite(pFile, offset, pBuf, amt)) > 0)
     {
         amt -= wrote;
@@ -3775,6 +4367,11 @@ static int unixSync(sqlite3_file *id, int flags)
     SimulateDiskfullError(return SQLITE_FULL);
 
     assert(pFile);
+#ifdef SQLITE_ENABLE_IO_URING
+    /* Writes still queued on the ring must be complete before the sync */
+    rc = uringFlush(pFile);
+    if (rc != SQLITE_OK) return rc;
+#endif
     OSTRACE(("SYNC    %-3d\n", pFile->h));
     rc = full_fsync(pFile->h, isFullsync, isDataOnly);
     SimulateIOError(rc = 1);
@@ -3817,6 +4414,10 @@ static int unixTruncate(sqlite3_file *id, i64 nByte)
     int rc;
     assert(pFile);
     SimulateIOError(return SQLITE_IOERR_TRUNCATE);
+#ifdef SQLITE_ENABLE_IO_URING
+    rc = uringFlush(pFile);
+    if (rc != SQLITE_OK) return rc;
+#endif
 
     /* If the user has configured a chunk-size for this file, truncate the
     ** file so that it consists of an integer number of chunks (i.e. the
@@ -3850,6 +4451,17 @@ static int unixTruncate(sqlite3_file *id, i64 nByte)
         }
 #endif
 
+#if SQLITE_MAX_MMAP_SIZE>0
+        /* If the file was just truncated to a size smaller than the currently
+        ** mapped region, reduce the effective mapping size as well. SQLite will
+        ** use read() and write() to access data beyond this point from now on.
+        */
+        if (nByte < pFile->mmapSize)
+        {
+            pFile->mmapSize = nByte;
+        }
+#endif
+
         return SQLITE_OK;
     }
 }
@@ -3862,6 +4474,10 @@ static int unixFileSize(sqlite3_file *id, i64 *pSize)
     int rc;
     struct stat buf;
     assert(id);
+#ifdef SQLITE_ENABLE_IO_URING
+    rc = uringFlush((unixFile*)id);
+    if (rc != SQLITE_OK) return rc;
+#endif
     rc = osFstat(((unixFile*)id)->h, &buf);
     SimulateIOError(rc = 1);
     if (rc != 0)
@@ -3972,6 +4588,11 @@ static void unixModeBit(unixFile *pFile, unsigned char mask, int *pArg)
     }
 }
 
+#if !defined(SQLITE_OMIT_WAL) && SQLITE_THREADSAFE
+static void unixWalSyncBegin(unixFile *pFile, int *aSync);
+static void unixWalSyncEnd(unixFile *pFile, int rc);
+#endif
+
 /*
 ** Information and control of an open file handle.
 */
@@ -4018,6 +4639,60 @@ static int unixFileControl(sqlite3_file *id, int op, void *pArg)
             *(char**)pArg = sqlite3_mprintf("%s", pFile->pVfs->zName);
             return SQLITE_OK;
         }
+        case SQLITE_FCNTL_MMAP_SIZE:
+        {
+            i64 newLimit = *(i64*)pArg;
+            int rc = SQLITE_OK;
+#if SQLITE_MAX_MMAP_SIZE>0
+            if (newLimit > sqlite3GlobalConfig.mxMmap)
+            {
+                newLimit = sqlite3GlobalConfig.mxMmap;
+            }
+            *(i64*)pArg = pFile->mmapSizeMax;
+            if (newLimit >= 0 && newLimit != pFile->mmapSizeMax && pFile->nFetchOut == 0)
+            {
+                pFile->mmapSizeMax = newLimit;
+                if (pFile->mmapSize > 0)
+                {
+                    unixUnmapfile(pFile);
+                    rc = unixMapfile(pFile, -1);
+                }
+            }
+#else
+            UNUSED_PARAMETER(newLimit);
+            *(i64*)pArg = 0;
+#endif
+            return rc;
+        }
+#ifdef SQLITE_ENABLE_IO_URING
+        case SQLITE_FCNTL_WRITE_BATCH_BEGIN:
+        {
+            if ((pFile->ctrlFlags & UNIXFILE_URING) && uringSetup(pFile) == SQLITE_OK)
+            {
+                pFile->pUring->bBatch = 1;
+            }
+            return SQLITE_OK;
+        }
+        case SQLITE_FCNTL_WRITE_BATCH_END:
+        {
+            int rc = uringFlush(pFile);
+            if (pFile->pUring) pFile->pUring->bBatch = 0;
+            if (pArg) *(int*)pArg = rc;
+            return rc;
+        }
+#endif
+#if !defined(SQLITE_OMIT_WAL) && SQLITE_THREADSAFE
+        case SQLITE_FCNTL_WAL_SYNC_BEGIN:
+        {
+            unixWalSyncBegin(pFile, (int*)pArg);
+            return SQLITE_OK;
+        }
+        case SQLITE_FCNTL_WAL_SYNC_END:
+        {
+            unixWalSyncEnd(pFile, *(int*)pArg);
+            return SQLITE_OK;
+        }
+#endif
 #ifdef SQLITE_DEBUG
         /* The pager calls this method to signal that it has done
         ** a rollback and that the database is therefore unchanged and
@@ -4127,6 +4802,14 @@ struct unixShmNode
     char **apRegion;           /* Array of mapped shared-memory regions */
     int nRef;                  /* Number of unixShm objects pointing to this */
     unixShm *pFirst;           /* All unixShm objects pointing to this */
+#if SQLITE_THREADSAFE
+    /* WAL group sync state (see unixWalSyncBegin()). Protected by mutex. */
+    sqlite3_mutex *syncMutex;  /* Held while the WAL file is being synced */
+    u32 iSyncReq;              /* Number of WAL sync requests made */
+    u32 iSyncStart;            /* Requests covered by the sync in progress */
+    u8 bSyncFull;              /* True if the sync in progress is a full sync */
+    UnixSyncWait *pSyncWait;   /* Requests waiting for the sync in progress */
+#endif
 #ifdef SQLITE_DEBUG
     u8 exclMask;               /* Mask of exclusive locks held */
     u8 sharedMask;             /* Mask of shared locks held */
@@ -4153,8 +4836,8 @@ struct unixShm
     unixShm *pNext;            /* Next unixShm with the same unixShmNode */
     u8 hasMutex;               /* True if holding the unixShmNode mutex */
     u8 id;                     /* Id of this connection within its unixShmNode */
-    u16 sharedMask;            /* Mask of shared locks held */
-    u16 exclMask;              /* Mask of exclusive locks held */
+    u32 sharedMask;            /* Mask of shared locks held */
+    u32 exclMask;              /* Mask of exclusive locks held */
 };
 
 /*
@@ -4162,6 +4845,7 @@ struct unixShm
 */
 #define UNIX_SHM_BASE   ((22+SQLITE_SHM_NLOCK)*4)         /* first lock byte */
 #define UNIX_SHM_DMS    (UNIX_SHM_BASE+SQLITE_SHM_NLOCK)  /* deadman switch */
+#define UNIX_SHM_XBASE  (UNIX_SHM_DMS+1)                  /* first extra lock byte */
 
 /*
 ** Apply posix advisory locks for all bytes from ofst through ofst+n-1.
@@ -4169,6 +4853,47 @@ struct unixShm
 ** Locks block if the mask is exactly UNIX_SHM_C and are non-blocking
 ** otherwise.
 */
+static int unixShmSystemLock(unixShmNode*, int, int, int);
+
+/*
+** Apply posix advisory locks for shared-memory locks ofst through
+** ofst+n-1. The first SQLITE_SHM_NLOCK locks use the standard bytes
+** starting at UNIX_SHM_BASE. Builds with more than the standard number of
+** WAL readers (SQLITE_WAL_NREADER) need more locks, and use the bytes
+** following the deadman switch for them.
+*/
+static int unixShmLockRange(
+    unixShmNode *pShmNode, /* Apply locks to this open shared-memory segment */
+    int lockType,          /* F_UNLCK, F_RDLCK, or F_WRLCK */
+    int ofst,              /* First lock */
+    int n                  /* Number of locks */
+)
+{
+    int rc = SQLITE_OK;
+    int n1 = 0;            /* Number of locks within the standard range */
+    if (ofst < SQLITE_SHM_NLOCK)
+    {
+        n1 = (ofst + n > SQLITE_SHM_NLOCK) ? SQLITE_SHM_NLOCK - ofst : n;
+    }
+    if (n1 > 0)
+    {
+        rc = unixShmSystemLock(pShmNode, lockType, UNIX_SHM_BASE + ofst, n1);
+    }
+    if (rc == SQLITE_OK && n > n1)
+    {
+        rc = unixShmSystemLock(pShmNode, lockType,
+                               UNIX_SHM_XBASE + ofst + n1 - SQLITE_SHM_NLOCK, n - n1);
+        if (rc != SQLITE_OK && n1 > 0 && lockType != F_UNLCK)
+        {
+            unixShmSystemLock(pShmNode, F_UNLCK, UNIX_SHM_BASE + ofst, n1);
+        }
+    }
+    return rc;
+}
+
+/*
+** Apply posix advisory locks for all bytes from ofst through ofst+n-1.
+*/
 static int unixShmSystemLock(
     unixShmNode *pShmNode, /* Apply locks to this open shared-memory segment */
     int lockType,          /* F_UNLCK, F_RDLCK, or F_WRLCK */
@@ -4186,7 +4911,7 @@ static int unixShmSystemLock(
     assert(n == 1 || lockType != F_RDLCK);
 
     /* Locks are within range */
-    assert(n >= 1 && n < SQLITE_SHM_NLOCK);
+    assert(n >= 1 && n < SQLITE_WAL_NLOCK);
 
     if (pShmNode->h >= 0)
     {
@@ -4269,6 +4994,9 @@ static void unixShmPurge(unixFile *pFd)
         int i;
         assert(p->pInode == pFd->pInode);
         sqlite3_mutex_free(p->mutex);
+#if SQLITE_THREADSAFE
+        sqlite3_mutex_free(p->syncMutex);
+#endif
         for (i = 0; i < p->nRegion; i++)
         {
             if (p->h >= 0)
@@ -4391,6 +5119,14 @@ static int unixOpenSharedMemory(unixFile *pDbFd)
             rc = SQLITE_NOMEM;
             goto shm_open_err;
         }
+#if SQLITE_THREADSAFE
+        pShmNode->syncMutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+        if (pShmNode->syncMutex == 0)
+        {
+            rc = SQLITE_NOMEM;
+            goto shm_open_err;
+        }
+#endif
 
         if (pInode->bProcessLock == 0)
         {
@@ -4621,11 +5357,11 @@ static int unixShmLock(
     unixShm *pX;                          /* For looping over all siblings */
     unixShmNode *pShmNode = p->pShmNode;  /* The underlying file iNode */
     int rc = SQLITE_OK;                   /* Result code */
-    u16 mask;                             /* Mask of locks to take or release */
+    u32 mask;                             /* Mask of locks to take or release */
 
     assert(pShmNode == pDbFd->pInode->pShmNode);
     assert(pShmNode->pInode == pDbFd->pInode);
-    assert(ofst >= 0 && ofst + n <= SQLITE_SHM_NLOCK);
+    assert(ofst >= 0 && ofst + n <= SQLITE_WAL_NLOCK);
     assert(n >= 1);
     assert(flags == (SQLITE_SHM_LOCK | SQLITE_SHM_SHARED)
            || flags == (SQLITE_SHM_LOCK | SQLITE_SHM_EXCLUSIVE)
@@ -4640,7 +5376,7 @@ static int unixShmLock(
     sqlite3_mutex_enter(pShmNode->mutex);
     if (flags & SQLITE_SHM_UNLOCK)
     {
-        u16 allMask = 0; /* Mask of locks held by siblings */
+        u32 allMask = 0; /* Mask of locks held by siblings */
 
         /* See if any siblings hold this same lock */
         for (pX = pShmNode->pFirst; pX; pX = pX->pNext)
@@ -4653,7 +5389,7 @@ static int unixShmLock(
         /* Unlock the system-level locks */
         if ((mask & allMask) == 0)
         {
-            rc = unixShmSystemLock(pShmNode, F_UNLCK, ofst + UNIX_SHM_BASE, n);
+            rc = unixShmLockRange(pShmNode, F_UNLCK, ofst, n);
         }
         else
         {
@@ -4669,7 +5405,7 @@ static int unixShmLock(
     }
     else if (flags & SQLITE_SHM_SHARED)
     {
-        u16 allShared = 0;  /* Union of locks held by connections other than "p" */
+        u32 allShared = 0;  /* Union of locks held by connections other than "p" */
 
         /* Find out which shared locks are already held by sibling connections.
         ** If any sibling already holds an exclusive lock, go ahead and return
@@ -4690,7 +5426,7 @@ static int unixShmLock(
         {
             if ((allShared & mask) == 0)
             {
-                rc = unixShmSystemLock(pShmNode, F_RDLCK, ofst + UNIX_SHM_BASE, n);
+                rc = unixShmLockRange(pShmNode, F_RDLCK, ofst, n);
             }
             else
             {
@@ -4723,7 +5459,7 @@ static int unixShmLock(
         */
         if (rc == SQLITE_OK)
         {
-            rc = unixShmSystemLock(pShmNode, F_WRLCK, ofst + UNIX_SHM_BASE, n);
+            rc = unixShmLockRange(pShmNode, F_WRLCK, ofst, n);
             if (rc == SQLITE_OK)
             {
                 assert((p->sharedMask & mask) == 0);
@@ -4803,6 +5539,101 @@ static int unixShmUnmap(
     return SQLITE_OK;
 }
 
+#if SQLITE_THREADSAFE
+/*
+** An instance of this structure is allocated on the stack of each
+** connection waiting in unixWalSyncBegin(), and linked into the
+** unixShmNode.pSyncWait list. The first sync that covers the request
+** stores its result in the rc field, so that a later sync cannot hide
+** the failure of the one that covered the request.
+*/
+struct UnixSyncWait
+{
+    u32 iTicket;               /* Value of unixShmNode.iSyncReq for request */
+    u8 isFull;                 /* True if a full sync was requested */
+    int rc;                    /* Result of covering sync, or -1 */
+    UnixSyncWait *pNext;       /* Next request waiting */
+};
+
+/*
+** Implementation of SQLITE_FCNTL_WAL_SYNC_BEGIN. The WAL file is synced
+** by one connection on behalf of all connections to the database in
+** this process that request a sync while it is in progress.
+**
+** aSync[0] holds the sync flags the caller is about to use. If a sync
+** that started after this call was made has already completed by the
+** time it returns, aSync[1] is set to the result of that sync and the
+** caller does not need to sync the WAL file itself. Otherwise, aSync[1]
+** is left set to -1 and the caller must sync the WAL file and then
+** report the result with SQLITE_FCNTL_WAL_SYNC_END.
+**
+** The connection that syncs the WAL file holds the syncMutex of the
+** unixShmNode from this call until SQLITE_FCNTL_WAL_SYNC_END. So callers
+** that arrive while a sync is in progress wait here for it to finish, and
+** are then all covered by the next one.
+**
+** A request for a full sync is only satisfied by another full sync.
+** 同一进程内对同一个WAL文件的并发同步请求合并为一次同步
+*/
+static void unixWalSyncBegin(unixFile *pDbFd, int *aSync)
+{
+    unixShmNode *pShmNode;
+    UnixSyncWait sWait;
+    UnixSyncWait **pp;
+
+    if (pDbFd->pShm == 0) return;
+    pShmNode = pDbFd->pShm->pShmNode;
+    sWait.isFull = (aSync[0] & 0x0F) == SQLITE_SYNC_FULL;
+    sWait.rc = -1;
+    sqlite3_mutex_enter(pShmNode->mutex);
+    sWait.iTicket = ++pShmNode->iSyncReq;
+    sWait.pNext = pShmNode->pSyncWait;
+    pShmNode->pSyncWait = &sWait;
+    sqlite3_mutex_leave(pShmNode->mutex);
+
+    sqlite3_mutex_enter(pShmNode->syncMutex);
+    sqlite3_mutex_enter(pShmNode->mutex);
+    for (pp = &pShmNode->pSyncWait; *pp != &sWait; pp = &(*pp)->pNext) {}
+    *pp = sWait.pNext;
+    if (sWait.rc >= 0)
+    {
+        aSync[1] = sWait.rc;
+    }
+    else
+    {
+        pShmNode->bSyncFull = sWait.isFull;
+        pShmNode->iSyncStart = pShmNode->iSyncReq;
+    }
+    sqlite3_mutex_leave(pShmNode->mutex);
+    if (aSync[1] >= 0) sqlite3_mutex_leave(pShmNode->syncMutex);
+}
+
+/*
+** Implementation of SQLITE_FCNTL_WAL_SYNC_END. Give the result of a WAL
+** sync started by a call to unixWalSyncBegin() to each waiting request
+** that it covers and that no earlier sync has covered, and let the
+** waiting connections proceed.
+*/
+static void unixWalSyncEnd(unixFile *pDbFd, int rc)
+{
+    unixShmNode *pShmNode;
+    UnixSyncWait *p;
+    if (pDbFd->pShm == 0) return;
+    pShmNode = pDbFd->pShm->pShmNode;
+    assert(sqlite3_mutex_held(pShmNode->syncMutex));
+    sqlite3_mutex_enter(pShmNode->mutex);
+    for (p = pShmNode->pSyncWait; p; p = p->pNext)
+    {
+        if (p->rc < 0 && (int)(pShmNode->iSyncStart - p->iTicket) >= 0
+            && (pShmNode->bSyncFull || !p->isFull))
+        {
+            p->rc = rc;
+        }
+    }
+    sqlite3_mutex_leave(pShmNode->mutex);
+    sqlite3_mutex_leave(pShmNode->syncMutex);
+}
+#endif /* SQLITE_THREADSAFE */
 
 #else
 # define unixShmMap     0
@@ -4811,6 +5642,173 @@ static int unixShmUnmap(
 # define unixShmUnmap   0
 #endif /* #ifndef SQLITE_OMIT_WAL */
 
+#if SQLITE_MAX_MMAP_SIZE>0
+/*
+** If it is currently memory mapped, unmap file pFd.
+*/
+static void unixUnmapfile(unixFile *pFd)
+{
+    assert(pFd->nFetchOut == 0);
+    if (pFd->pMapRegion)
+    {
+        osMunmap(pFd->pMapRegion, pFd->mmapSizeActual);
+        pFd->pMapRegion = 0;
+        pFd->mmapSize = 0;
+        pFd->mmapSizeActual = 0;
+    }
+}
+
+/*
+** Memory map or remap the file opened by file-descriptor pFd (if the file
+** is already mapped, the existing mapping is replaced by the new). Or, if
+** there are still outstanding xFetch() references to the existing mapping,
+** this function is a no-op.
+**
+** If parameter nByte is non-negative, then it is the requested size of
+** the mapping to create. Otherwise, if nByte is less than zero, then the
+** requested size is the size of the file on disk. The actual size of the
+** created mapping is either the requested size or the value configured
+** using SQLITE_FCNTL_MMAP_SIZE, whichever is smaller.
+**
+** The mapping is read-only.  All writes continue to go through write(),
+** and because the mapping is MAP_SHARED they are immediately visible to
+** readers of the mapped region.
+**
+** Failure to create a mapping is not an error: the file is simply left
+** unmapped and xFetch() returns NULL pointers, which causes SQLite to
+** fall back to xRead().  SQLITE_OK is returned unless the size of the
+** file cannot be determined.
+*/
+static int unixMapfile(unixFile *pFd, i64 nByte)
+{
+    i64 nMap = nByte;
+    void *pNew;
+
+    if (pFd->nFetchOut > 0) return SQLITE_OK;
+
+    if (nMap < 0)
+    {
+        struct stat statbuf;        /* Low-level file information */
+        if (osFstat(pFd->h, &statbuf))
+        {
+            return SQLITE_IOERR_FSTAT;
+        }
+        nMap = statbuf.st_size;
+    }
+    if (nMap > pFd->mmapSizeMax)
+    {
+        nMap = pFd->mmapSizeMax;
+    }
+    if (nMap == pFd->mmapSize && pFd->mmapSize == pFd->mmapSizeActual)
+    {
+        return SQLITE_OK;
+    }
+
+    unixUnmapfile(pFd);
+    if (nMap > 0)
+    {
+        pNew = osMmap(0, (size_t)nMap, PROT_READ, MAP_SHARED, pFd->h, 0);
+        if (pNew == MAP_FAILED)
+        {
+            /* Do not try again for this file.  Reads use read() from now on. */
+            pFd->lastErrno = errno;
+            pFd->mmapSizeMax = 0;
+            return SQLITE_OK;
+        }
+        pFd->pMapRegion = pNew;
+        pFd->mmapSize = nMap;
+        pFd->mmapSizeActual = nMap;
+    }
+    return SQLITE_OK;
+}
+#endif /* SQLITE_MAX_MMAP_SIZE>0 */
+
+/*
+** If possible, return a pointer to a mapping of file fd starting at offset
+** iOff. The mapping must be valid for at least nAmt bytes.
+**
+** If such a pointer can be obtained, store it in *pp and return SQLITE_OK.
+** Or, if one cannot but no error occurs, set *pp to 0 and return SQLITE_OK.
+** Finally, if an error does occur, return an SQLite error code. The final
+** value of *pp is undefined in this case.
+**
+** If this function does return a pointer, the caller must eventually
+** release the reference by calling unixUnfetch().
+*/
+static int unixFetch(sqlite3_file *fd, i64 iOff, int nAmt, void **pp)
+{
+#if SQLITE_MAX_MMAP_SIZE>0
+    unixFile *pFd = (unixFile *)fd;   /* The underlying database file */
+#endif
+    *pp = 0;
+
+#if SQLITE_MAX_MMAP_SIZE>0
+    if (pFd->mmapSizeMax > 0 && iOff + nAmt <= pFd->mmapSizeMax)
+    {
+        /* Grow (or create) the mapping if the requested range lies beyond
+        ** it.  This can only happen while no other references are
+        ** outstanding, otherwise existing pointers would be invalidated. */
+        if (iOff + nAmt > pFd->mmapSize && pFd->nFetchOut == 0)
+        {
+            int rc = unixMapfile(pFd, -1);
+            if (rc != SQLITE_OK) return rc;
+        }
+        if (pFd->mmapSize >= iOff + nAmt)
+        {
+            *pp = &((u8 *)pFd->pMapRegion)[iOff];
+            pFd->nFetchOut++;
+        }
+    }
+#else
+    UNUSED_PARAMETER(fd);
+    UNUSED_PARAMETER(iOff);
+    UNUSED_PARAMETER(nAmt);
+#endif
+    return SQLITE_OK;
+}
+
+/*
+** If the third argument is non-NULL, then this function releases a
+** reference obtained by an earlier call to unixFetch(). The second
+** argument passed to this function must be the same as the corresponding
+** argument that was passed to the unixFetch() invocation.
+**
+** Or, if the third argument is NULL, then this function is being called
+** to inform the VFS layer that, according to POSIX, any existing mapping
+** may now be invalid and should be unmapped.
+*/
+static int unixUnfetch(sqlite3_file *fd, i64 iOff, void *p)
+{
+#if SQLITE_MAX_MMAP_SIZE>0
+    unixFile *pFd = (unixFile *)fd;   /* The underlying database file */
+    UNUSED_PARAMETER(iOff);
+
+    /* If p==0 (unmap the entire file) then there must be no outstanding
+    ** xFetch references. Or, if p!=0 (meaning it is an xFetch reference),
+    ** then there must be at least one outstanding.  */
+    assert((p == 0) == (pFd->nFetchOut == 0));
+
+    /* If p!=0, it must match the iOff value. */
+    assert(p == 0 || p == &((u8 *)pFd->pMapRegion)[iOff]);
+
+    if (p)
+    {
+        pFd->nFetchOut--;
+    }
+    else
+    {
+        unixUnmapfile(pFd);
+    }
+
+    assert(pFd->nFetchOut >= 0);
+#else
+    UNUSED_PARAMETER(fd);
+    UNUSED_PARAMETER(p);
+    UNUSED_PARAMETER(iOff);
+#endif
+    return SQLITE_OK;
+}
+
 /*
 ** Here ends the implementation of all sqlite3_file methods.
 **
@@ -4850,8 +5848,11 @@ static int unixShmUnmap(
 **
 **   *  An I/O method finder function called FINDER that returns a pointer
 **      to the METHOD object in the previous bullet.
+**
+** IOMETHODS_OBJECT generates only the first of the two, for methods that
+** are not selected through a finder.
 */
-#define IOMETHODS(FINDER, METHOD, VERSION, CLOSE, LOCK, UNLOCK, CKLOCK)      \
+#define IOMETHODS_OBJECT(METHOD, VERSION, CLOSE, LOCK, UNLOCK, CKLOCK)       \
 static const sqlite3_io_methods METHOD = {                                   \
    VERSION,                    /* iVersion */                                \
    CLOSE,                      /* xClose */                                  \
@@ -4869,8 +5870,13 @@ static const sqlite3_io_methods METHOD = {                                   \
    unixShmMap,                 /* xShmMap */                                 \
    unixShmLock,                /* xShmLock */                                \
    unixShmBarrier,             /* xShmBarrier */                             \
-   unixShmUnmap                /* xShmUnmap */                               \
-};                                                                           \
+   unixShmUnmap,               /* xShmUnmap */                               \
+   unixFetch,                  /* xFetch */                                  \
+   unixUnfetch,                /* xUnfetch */                                \
+   unixReadv,                  /* xReadv */                                  \
+};
+#define IOMETHODS(FINDER, METHOD, VERSION, CLOSE, LOCK, UNLOCK, CKLOCK)      \
+IOMETHODS_OBJECT(METHOD, VERSION, CLOSE, LOCK, UNLOCK, CKLOCK)               \
 static const sqlite3_io_methods *FINDER##Impl(const char *z, unixFile *p){   \
   UNUSED_PARAMETER(z); UNUSED_PARAMETER(p);                                  \
   return &METHOD;                                                            \
@@ -4886,7 +5892,7 @@ static const sqlite3_io_methods *(*const FINDER)(const char*,unixFile *p)    \
 IOMETHODS(
     posixIoFinder,            /* Finder function name */
     posixIoMethods,           /* sqlite3_io_methods object name */
-    2,                        /* shared memory is enabled */
+    4,                        /* shared memory, mmap and readv are enabled */
     unixClose,                /* xClose method */
     unixLock,                 /* xLock method */
     unixUnlock,               /* xUnlock method */
@@ -4901,6 +5907,14 @@ IOMETHODS(
     nolockUnlock,             /* xUnlock method */
     nolockCheckReservedLock   /* xCheckReservedLock method */
 )
+IOMETHODS_OBJECT(
+    nolockTempIoMethods,      /* sqlite3_io_methods object name */
+    3,                        /* mmap is enabled, for temp files only */
+    nolockClose,              /* xClose method */
+    nolockLock,               /* xLock method */
+    nolockUnlock,             /* xUnlock method */
+    nolockCheckReservedLock   /* xCheckReservedLock method */
+)
 IOMETHODS(
     dotlockIoFinder,          /* Finder function name */
     dotlockIoMethods,         /* sqlite3_io_methods object name */
@@ -5155,6 +6169,9 @@ static int fillInUnixFile(
     OSTRACE(("OPEN    %-3d %s\n", h, zFilename));
     pNew->h = h;
     pNew->pVfs = pVfs;
+#if SQLITE_MAX_MMAP_SIZE>0
+    pNew->mmapSizeMax = sqlite3GlobalConfig.szMmap;
+#endif
     pNew->zPath = zFilename;
     pNew->ctrlFlags = (u8)ctrlFlags;
     if (sqlite3_uri_boolean(((ctrlFlags & UNIXFILE_URI) ? zFilename : 0),
@@ -5166,6 +6183,12 @@ static int fillInUnixFile(
     {
         pNew->ctrlFlags |= UNIXFILE_EXCL;
     }
+#ifdef SQLITE_ENABLE_IO_URING
+    if (strcmp(pVfs->zName, "unix-uring") == 0)
+    {
+        pNew->ctrlFlags |= UNIXFILE_URING;
+    }
+#endif
 
 #if OS_VXWORKS
     pNew->pId = vxworksFindFileId(zFilename);
@@ -5178,7 +6201,17 @@ static int fillInUnixFile(
 
     if (ctrlFlags & UNIXFILE_NOLOCK)
     {
-        pLockingStyle = &nolockIoMethods;
+        /* Temp files, such as those the sorter reads back, may be memory
+        ** mapped. They are never used in WAL mode, so their xShmMap() is
+        ** never called. */
+        if (ctrlFlags & UNIXFILE_DELETE)
+        {
+            pLockingStyle = &nolockTempIoMethods;
+        }
+        else
+        {
+            pLockingStyle = &nolockIoMethods;
+        }
     }
     else
     {
@@ -7667,6 +8700,9 @@ int sqlite3_os_init(void)
         UNIXVFS("unix-none",     nolockIoFinder),
         UNIXVFS("unix-dotfile",  dotlockIoFinder),
         UNIXVFS("unix-excl",     posixIoFinder),
+#ifdef SQLITE_ENABLE_IO_URING
+        UNIXVFS("unix-uring",    posixIoFinder),
+#endif
 #if OS_VXWORKS
         UNIXVFS("unix-namedsem", semIoFinder),
 #endif
@@ -7686,7 +8722,7 @@ int sqlite3_os_init(void)
 
     /* Double-check that the aSyscall[] array has been constructed
     ** correctly.  See ticket [bb3a86e890c8e96ab] */
-    assert(ArraySize(aSyscall) == 22);
+    assert(ArraySize(aSyscall) == 25);
 
     /* Register all VFSes defined in the aVfs[] array */
     for (i = 0; i < (sizeof(aVfs) / sizeof(sqlite3_vfs)); i++) /* 注册vfs层 */
@@ -607,6 +607,16 @@ struct PagerSavepoint /* 保存点 */
 **   size-hint passed to the method call. See pager_write_pagelist() for
 **   details.
 **
+** pReadSet
+**
+**   In WAL mode, while a BEGIN CONCURRENT transaction is open, pReadSet
+**   records the number of each page (other than page 1) acquired since the
+**   transaction began. Such a transaction does not take the WAL write lock
+**   until it commits, and cache spills are disabled until then. At commit,
+**   the transaction conflicts with any other committed since its snapshot
+**   that wrote a page in pReadSet. See pagerLockForCommit(). pReadSet is
+**   NULL at all other times.
+**
 ** errCode
 **
 **   The Pager.errCode variable is only ever used in PAGER_ERROR state. It
@@ -631,6 +641,12 @@ struct Pager
     u8 tempFile;                /* zFilename is a temporary file */
     u8 readOnly;                /* True for a read-only database */
     u8 memDb;                   /* True to inhibit all file I/O */
+    u8 bUseFetch;               /* True to use xFetch() */
+    u8 walGroupCommit;          /* True for WAL group-commit mode */
+    u8 ckptThreadSync;          /* Sync flags for background checkpoints */
+    int nCkptThreadFrame;       /* Background checkpoint threshold, or 0 */
+    int nCkptThreadRate;        /* Background checkpoint pages/second, or 0 */
+    u8 bWarmup;                 /* Save the cache warm-up list on close */
 
     /**************************************************************************
     ** The following block contains those class members that change during
@@ -663,6 +679,7 @@ struct Pager
     u32 cksumInit;              /* Quasi-random value added to every checksum */
     u32 nSubRec;                /* Number of records written to sub-journal */
     Bitvec *pInJournal;         /* One bit for each page in the database file */
+    Bitvec *pReadSet;           /* Pages read by a BEGIN CONCURRENT transaction */
     /* 数据库文件 */
     sqlite3_file *fd;           /* File descriptor for database */
     /* 主日志 */
@@ -678,6 +695,7 @@ struct Pager
     /* savepoint的个数 */
     int nSavepoint;             /* Number of elements in aSavepoint[] */
     char dbFileVers[16];        /* Changes whenever database file changes */
+    u32 iDataVersion;           /* Incremented each time the cache is reset */
     /*
     ** End of the routinely-changing class members
     ***************************************************************************/
@@ -689,6 +707,10 @@ struct Pager
     u32 sectorSize;             /* Assumed sector size during rollback */
     /* 页大小 */
     int pageSize;               /* Number of bytes in a page */
+    /* 当前借出的mmap页个数 */
+    int nMmapOut;               /* Number of mmap pages currently outstanding */
+    sqlite3_int64 szMmap;       /* Desired maximum mmap size */
+    PgHdr *pMmapFreelist;       /* List of free mmap page headers (pDirty) */
 
     Pgno mxPgno;                /* Maximum allowed size of the database */
     /* 日志文件大小限制 */
@@ -797,6 +819,16 @@ static const unsigned char aJournalMagic[] =
 # define MEMDB pPager->memDb
 #endif
 
+/*
+** The macro USEFETCH is true if we are allowed to use the xFetch and xUnfetch
+** interfaces to access the database using memory-mapped I/O.
+*/
+#if SQLITE_MAX_MMAP_SIZE>0
+# define USEFETCH(x) ((x)->bUseFetch)
+#else
+# define USEFETCH(x) 0
+#endif
+
 /*
 ** The maximum legal page number is (2^31 - 1).
 */
@@ -1806,6 +1838,7 @@ static PgHdr *pager_lookup(Pager *pPager, Pgno pgno)
 */
 static void pager_reset(Pager *pPager)
 {
+    pPager->iDataVersion++;
     sqlite3BackupRestart(pPager->pBackup);
     sqlite3PcacheClear(pPager->pPCache);
 }
@@ -1885,6 +1918,8 @@ static void pager_unlock(Pager *pPager)
 
     sqlite3BitvecDestroy(pPager->pInJournal);
     pPager->pInJournal = 0;
+    sqlite3BitvecDestroy(pPager->pReadSet);
+    pPager->pReadSet = 0;
     releaseAllSavepoints(pPager);
 
     if (pagerUseWal(pPager))
@@ -2139,6 +2174,8 @@ static int pager_end_transaction(Pager *pPager, int hasMaster)
 
     sqlite3BitvecDestroy(pPager->pInJournal);
     pPager->pInJournal = 0;
+    sqlite3BitvecDestroy(pPager->pReadSet);
+    pPager->pReadSet = 0;
     pPager->nRec = 0;
     sqlite3PcacheCleanAll(pPager->pPCache);
     sqlite3PcacheTruncate(pPager->pPCache, pPager->dbSize);
@@ -2147,10 +2184,11 @@ static int pager_end_transaction(Pager *pPager, int hasMaster)
     {
         /* Drop the WAL write-lock, if any. Also, if the connection was in
         ** locking_mode=exclusive mode but is no longer, drop the EXCLUSIVE
-        ** lock held on the database file.
+        ** lock held on the database file. In WAL group-commit mode, this
+        ** is also where a committed transaction is synced.
         */
         rc2 = sqlite3WalEndWriteTransaction(pPager->pWal);
-        assert(rc2 == SQLITE_OK);
+        if (rc == SQLITE_OK) rc = rc2;
     }
     if (!pPager->exclusiveMode
         && (!pagerUseWal(pPager) || sqlite3WalExclusiveMode(pPager->pWal, 0))
@@ -2435,6 +2473,11 @@ static int pager_playback_one_page(
     {
         pPg = pager_lookup(pPager, pgno); /* 在缓存中查找对应的页 */
     }
+    if (pPg == 0)
+    {
+        /* The page cache may hold a compressed copy of the page */
+        sqlite3PcacheForget(pPager->pPCache, pgno);
+    }
     assert(pPg || !MEMDB);
     assert(pPager->eState != PAGER_OPEN || pPg == 0);
     PAGERTRACE(("PLAYBACK %d page %d hash(%08x) %s\n",
@@ -2491,7 +2534,7 @@ static int pager_playback_one_page(
         assert(isSavepnt);
         assert(pPager->doNotSpill == 0);
         pPager->doNotSpill++;
-        rc = sqlite3PagerAcquire(pPager, pgno, &pPg, 1);
+        rc = sqlite3PagerAcquire(pPager, pgno, &pPg, PAGER_ACQUIRE_NOCONTENT);
         assert(pPager->doNotSpill == 1);
         pPager->doNotSpill--;
         if (rc != SQLITE_OK) return rc;
@@ -3094,10 +3137,15 @@ end_playback:
 
 
 /*
-** Read the content for page pPg out of the database file and into
-** pPg->pData. A shared lock or greater must be held on the database
+** Read the content for page pPg out of the database file (or out of
+** the WAL if that is where the most recent copy of the page is) and
+** into pPg->pData. A shared lock or greater must be held on the database
 ** file before this function is called.
 **
+** If page pgno is stored in the WAL, iFrame is the frame that contains
+** it (as returned by sqlite3WalFindFrame()). Otherwise iFrame is zero
+** and the page is read from the database file.
+**
 ** If page 1 is read, then the value of Pager.dbFileVers[] is set to
 ** the value read from the database file.
 **
@@ -3105,12 +3153,11 @@ end_playback:
 ** Otherwise, SQLITE_OK is returned.
 ** 读取数据库文件到pPg中
 */
-static int readDbPage(PgHdr *pPg)
+static int readDbPage(PgHdr *pPg, u32 iFrame)
 {
     Pager *pPager = pPg->pPager; /* Pager object associated with page pPg */
     Pgno pgno = pPg->pgno;       /* Page number to read */
     int rc = SQLITE_OK;          /* Return code */
-    int isInWal = 0;             /* True if page is in log file */
     int pgsz = pPager->pageSize; /* Number of bytes to read */
 
     assert(pPager->eState >= PAGER_READER && !MEMDB);
@@ -3123,12 +3170,12 @@ static int readDbPage(PgHdr *pPg)
         return SQLITE_OK;
     }
 
-    if (pagerUseWal(pPager))
+    if (iFrame)
     {
-        /* Try to pull the page from the write-ahead log. */
-        rc = sqlite3WalRead(pPager->pWal, pgno, &isInWal, pgsz, pPg->pData);
+        /* Pull the page from the write-ahead log. */
+        rc = sqlite3WalReadFrame(pPager->pWal, iFrame, pgsz, pPg->pData);
     }
-    if (rc == SQLITE_OK && !isInWal)
+    else
     {
         i64 iOffset = (pgno - 1) * (i64)pPager->pageSize; /* 计算偏移 */
         rc = sqlite3OsRead(pPager->fd, pPg->pData, pgsz, iOffset);
@@ -3225,7 +3272,12 @@ static int pagerUndoCallback(void *pCtx, Pgno iPg)
         }
         else
         {
-            rc = readDbPage(pPg);
+            u32 iFrame = 0;
+            rc = sqlite3WalFindFrame(pPager->pWal, pPg->pgno, &iFrame);
+            if (rc == SQLITE_OK)
+            {
+                rc = readDbPage(pPg, iFrame);
+            }
             if (rc == SQLITE_OK)
             {
                 pPager->xReiniter(pPg);
@@ -3233,6 +3285,10 @@ static int pagerUndoCallback(void *pCtx, Pgno iPg)
             sqlite3PagerUnref(pPg);
         }
     }
+    else
+    {
+        sqlite3PcacheForget(pPager->pPCache, iPg);
+    }
 
     /* Normally, if a transaction is rolled back, any backup processes are
     ** updated as data is copied out of the rollback journal and into the
@@ -3359,6 +3415,74 @@ static int pagerWalFrames(
     return rc;
 }
 
+/*
+** This function is called when a BEGIN CONCURRENT transaction is being
+** committed, before its dirty pages (pList, sorted by page number) are
+** written to the log. It takes the WAL write lock, invoking the
+** busy-handler if it is held by another connection, and checks that no
+** page read by the transaction has been modified since its snapshot was
+** taken. Page 1 gets special treatment: it is read by every transaction,
+** so a change to it by another connection is a conflict only if this
+** transaction also modified it, or if the schema cookie has changed.
+**
+** If the transaction does not conflict, the connection's snapshot is
+** moved to the end of the log and SQLITE_OK returned. Cached copies of
+** pages modified by other connections are discarded or reloaded.
+** Otherwise SQLITE_BUSY_SNAPSHOT is returned.
+** 乐观并发:提交时才检查冲突
+*/
+static int pagerLockForCommit(Pager *pPager, PgHdr *pList)
+{
+    int rc;
+    u32 iPage1 = 0;                 /* Frame with newer copy of page 1, or 0 */
+
+    do
+    {
+        rc = sqlite3WalLockForCommit(pPager->pWal, pPager->pReadSet, &iPage1);
+    }
+    while (rc == SQLITE_BUSY && pPager->xBusyHandler(pPager->pBusyHandlerArg));
+
+    if (rc == SQLITE_OK && iPage1)
+    {
+        if (pList->pgno == 1)
+        {
+            rc = SQLITE_BUSY_SNAPSHOT;
+        }
+        else
+        {
+            u8 aHdr[44];
+            PgHdr *pPg1 = sqlite3PagerLookup(pPager, 1);
+            rc = sqlite3WalReadFrame(pPager->pWal, iPage1, sizeof(aHdr), aHdr);
+            if (rc == SQLITE_OK
+                && (pPg1 == 0 || memcmp(&aHdr[40], &((u8 *)pPg1->pData)[40], 4))
+               )
+            {
+                rc = SQLITE_BUSY_SNAPSHOT;
+            }
+            sqlite3PagerUnref(pPg1);
+        }
+        if (rc != SQLITE_OK)
+        {
+            sqlite3WalEndWriteTransaction(pPager->pWal);
+        }
+    }
+
+    if (rc == SQLITE_OK)
+    {
+        rc = sqlite3WalUpgradeSnapshot(pPager->pWal, pagerUndoCallback, (void *)pPager);
+        if (rc == SQLITE_OK && iPage1)
+        {
+            /* Since this transaction did not modify page 1, it did not change
+            ** the size of the database. But others may have. */
+            pPager->dbSize = sqlite3WalDbsize(pPager->pWal);
+            pPager->dbHintSize = pPager->dbSize;
+            pPager->dbFileSize = pPager->dbSize;
+            pPager->dbOrigSize = pPager->dbSize;
+        }
+    }
+    return rc;
+}
+
 /*
 ** Begin a read transaction on the WAL.
 **
@@ -3386,6 +3510,7 @@ static int pagerBeginReadTransaction(Pager *pPager)
     if (rc != SQLITE_OK || changed)
     {
         pager_reset(pPager);
+        if (USEFETCH(pPager)) sqlite3OsUnfetch(pPager->fd, 0, 0);
     }
 
     return rc;
@@ -3700,6 +3825,34 @@ void sqlite3PagerSetCachesize(Pager *pPager, int mxPage)
     sqlite3PcacheSetCachesize(pPager->pPCache, mxPage);
 }
 
+/*
+** Invoke SQLITE_FCNTL_MMAP_SIZE based on the current value of szMmap.
+** Memory mapped reads are only used if the VFS supports xFetch() (that
+** is, if its io_methods are version 3 or later).
+*/
+static void pagerFixMaplimit(Pager *pPager)
+{
+#if SQLITE_MAX_MMAP_SIZE>0
+    sqlite3_file *fd = pPager->fd;
+    if (isOpen(fd) && fd->pMethods->iVersion >= 3)
+    {
+        sqlite3_int64 sz;
+        sz = pPager->szMmap;
+        pPager->bUseFetch = (sz > 0);
+        sqlite3OsFileControlHint(pPager->fd, SQLITE_FCNTL_MMAP_SIZE, &sz);
+    }
+#endif
+}
+
+/*
+** Change the maximum size of any memory mapping made of the database file.
+*/
+void sqlite3PagerSetMmapLimit(Pager *pPager, sqlite3_int64 szMmap)
+{
+    pPager->szMmap = szMmap;
+    pagerFixMaplimit(pPager);
+}
+
 /*
 ** Free as much memory as possible from the pager.
 */
@@ -4183,6 +4336,22 @@ static int pagerSyncHotJournal(Pager *pPager)
     return rc;
 }
 
+/*
+** Free all PgHdr objects stored in the Pager.pMmapFreelist list.
+*/
+static void pagerFreeMapHdrs(Pager *pPager)
+{
+    PgHdr *p;
+    PgHdr *pNext;
+    for (p = pPager->pMmapFreelist; p; p = pNext)
+    {
+        pNext = p->pDirty;
+        sqlite3_free(p);
+    }
+}
+
+static void pagerWarmupSave(Pager *pPager);
+
 /*
 ** Shutdown the page cache.  Free all memory and close all files.
 **
@@ -4205,6 +4374,7 @@ int sqlite3PagerClose(Pager *pPager)
     assert(assert_pager_state(pPager));
     disable_simulated_io_errors();
     sqlite3BeginBenignMalloc();
+    pagerWarmupSave(pPager);
     /* pPager->errCode = 0; */
     pPager->exclusiveMode = 0;
 #ifndef SQLITE_OMIT_WAL
@@ -4241,6 +4411,7 @@ int sqlite3PagerClose(Pager *pPager)
     IOTRACE(("CLOSE %p\n", pPager))
     sqlite3OsClose(pPager->jfd);
     sqlite3OsClose(pPager->fd);
+    pagerFreeMapHdrs(pPager);
     sqlite3PageFree(pTmp);
     sqlite3PcacheClose(pPager->pPCache);
 
@@ -4271,7 +4442,14 @@ Pgno sqlite3PagerPagenumber(DbPage *pPg)
 */
 void sqlite3PagerRef(DbPage *pPg)
 {
-    sqlite3PcacheRef(pPg);
+    if (pPg->flags & PGHDR_MMAP)
+    {
+        pPg->nRef++;
+    }
+    else
+    {
+        sqlite3PcacheRef(pPg);
+    }
 }
 
 /*
@@ -4469,6 +4647,7 @@ static int syncJournal(Pager *pPager, int newHdr)
 static int pager_write_pagelist(Pager *pPager, PgHdr *pList)
 {
     int rc = SQLITE_OK;                  /* Return code */
+    int inBatch = 0;                     /* True once WRITE_BATCH_BEGIN sent */
 
     /* This function is only called for rollback pagers in WRITER_DBMOD state. */
     assert(!pagerUseWal(pPager));
@@ -4497,6 +4676,13 @@ static int pager_write_pagelist(Pager *pPager, PgHdr *pList)
         pPager->dbHintSize = pPager->dbSize;
     }
 
+    /* Let the VFS submit the page writes below as a single batch. */
+    if (rc == SQLITE_OK)
+    {
+        sqlite3OsFileControlHint(pPager->fd, SQLITE_FCNTL_WRITE_BATCH_BEGIN, 0);
+        inBatch = 1;
+    }
+
     while (rc == SQLITE_OK && pList)
     {
         Pgno pgno = pList->pgno;
@@ -4519,7 +4705,7 @@ static int pager_write_pagelist(Pager *pPager, PgHdr *pList)
             if (pList->pgno == 1) pager_write_changecounter(pList);
 
             /* Encode the database */
-            CODEC2(pPager, pList->pData, pgno, 6, return SQLITE_NOMEM, pData);
+            CODEC2(pPager, pList->pData, pgno, 6, rc = SQLITE_NOMEM; break, pData);
 
             /* Write out the page data. */
             rc = sqlite3OsWrite(pPager->fd, pData, pPager->pageSize, offset);
@@ -4554,6 +4740,13 @@ static int pager_write_pagelist(Pager *pPager, PgHdr *pList)
         pList = pList->pDirty; /* 下一个page */
     }
 
+    /* Only end the batch if it was begun above. */
+    if (inBatch)
+    {
+        int rcBatch = SQLITE_OK;
+        sqlite3OsFileControlHint(pPager->fd, SQLITE_FCNTL_WRITE_BATCH_END, &rcBatch);
+        if (rc == SQLITE_OK) rc = rcBatch;
+    }
     return rc;
 }
 
@@ -4683,6 +4876,10 @@ static int pagerStress(void *p, PgHdr *pPg)
     */
     if (NEVER(pPager->errCode)) return SQLITE_OK;
     if (pPager->doNotSpill) return SQLITE_OK;
+
+    /* A BEGIN CONCURRENT transaction cannot write to the log until it
+    ** has taken the write lock at commit time. */
+    if (pPager->pReadSet) return SQLITE_OK;
     if (pPager->doNotSyncSpill && (pPg->flags & PGHDR_NEED_SYNC) != 0)
     {
         return SQLITE_OK;
@@ -5106,6 +5303,8 @@ int sqlite3PagerOpen(
     /* pPager->pBusyHandlerArg = 0; */
     pPager->xReiniter = xReinit;
     /* memset(pPager->aHash, 0, sizeof(pPager->aHash)); */
+    pPager->szMmap = sqlite3GlobalConfig.szMmap;
+    pagerFixMaplimit(pPager);
 
     *ppPager = pPager;
     return SQLITE_OK;
@@ -5291,6 +5490,7 @@ int sqlite3PagerSharedLock(Pager *pPager)
     ** exclusive access mode.
     */
     assert(sqlite3PcacheRefCount(pPager->pPCache) == 0);
+    assert(pPager->nMmapOut == 0);
     assert(assert_pager_state(pPager));
     assert(pPager->eState == PAGER_OPEN || pPager->eState == PAGER_READER);
     if (NEVER(MEMDB && pPager->errCode))
@@ -5433,12 +5633,14 @@ int sqlite3PagerSharedLock(Pager *pPager)
         }
 
         if (!pPager->tempFile
-            && (pPager->pBackup || sqlite3PcachePagecount(pPager->pPCache) > 0)
+            && (pPager->pBackup || sqlite3PcachePagecount(pPager->pPCache) > 0
+                || sqlite3PcacheTiered(pPager->pPCache) > 0)
            )
         {
             /* The shared-lock has just been acquired on the database file
             ** and there are already pages in the cache (from a previous
-            ** read or write transaction).  Check to see if the database
+            ** read or write transaction), or page images held by the cache
+            ** outside of the cache itself.  Check to see if the database
             ** has been modified.  If the database has changed, flush the
             ** cache.
             **
@@ -5475,6 +5677,17 @@ int sqlite3PagerSharedLock(Pager *pPager)
             if (memcmp(pPager->dbFileVers, dbFileVers, sizeof(dbFileVers)) != 0)
             {
                 pager_reset(pPager);
+
+                /* Unmap the database file. It is possible that external processes
+                ** may have truncated the database file and then extended it back
+                ** to its original size while this process was not holding a lock.
+                ** In this case there may exist a Pager.pMap mapping that appears
+                ** to be the right size but is not actually valid. Avoid this
+                ** possibility by unmapping the db here. */
+                if (USEFETCH(pPager))
+                {
+                    sqlite3OsUnfetch(pPager->fd, 0, 0);
+                }
             }
         }
 
@@ -5512,6 +5725,81 @@ failed:
     return rc;
 }
 
+/*
+** Obtain a page header for page pgno whose content is the pointer pData,
+** which points directly into a memory mapping of the database file
+** obtained from sqlite3OsFetch(). The header is taken from the
+** Pager.pMmapFreelist list if possible, otherwise allocated. Such pages
+** are never added to the page cache and are read-only: they are marked
+** with the PGHDR_MMAP flag and released by pagerReleaseMapPage().
+**
+** If successful, *ppPage is set to point to the new page header and
+** SQLITE_OK returned. If an error (OOM) occurs, the mapping reference is
+** released, *ppPage is set to NULL and SQLITE_NOMEM returned.
+*/
+static int pagerAcquireMapPage(
+    Pager *pPager,                  /* Pager object */
+    Pgno pgno,                      /* Page number */
+    void *pData,                    /* xFetch()'d data for this page */
+    PgHdr **ppPage                  /* OUT: Acquired page object */
+)
+{
+    PgHdr *p;                       /* Memory mapped page to return */
+
+    if (pPager->pMmapFreelist)
+    {
+        *ppPage = p = pPager->pMmapFreelist;
+        pPager->pMmapFreelist = p->pDirty;
+        p->pDirty = 0;
+        memset(p->pExtra, 0, pPager->nExtra);
+    }
+    else
+    {
+        *ppPage = p = (PgHdr *)sqlite3MallocZero(sizeof(PgHdr) + pPager->nExtra);
+        if (p == 0)
+        {
+            sqlite3OsUnfetch(pPager->fd, (i64)(pgno - 1) * pPager->pageSize, pData);
+            return SQLITE_NOMEM;
+        }
+        p->pExtra = (void *)&p[1];
+        p->flags = PGHDR_MMAP;
+        p->nRef = 1;
+        p->pPager = pPager;
+    }
+
+    assert(p->pExtra == (void *)&p[1]);
+    assert(p->pPage == 0);
+    assert(p->flags == PGHDR_MMAP);
+    assert(p->pPager == pPager);
+    assert(p->nRef == 1);
+
+    p->pgno = pgno;
+    p->pData = pData;
+    pPager->nMmapOut++;
+
+    return SQLITE_OK;
+}
+
+/*
+** Release a reference to page pPg. pPg must have been returned by an
+** earlier call to pagerAcquireMapPage(). Once the last reference is
+** dropped the mapping reference is returned to the VFS and the header
+** is added to the free-list for reuse.
+*/
+static void pagerReleaseMapPage(PgHdr *pPg)
+{
+    Pager *pPager = pPg->pPager;
+    assert(pPg->nRef > 0);
+    if (--pPg->nRef > 0) return;
+    pPg->nRef = 1;
+    pPager->nMmapOut--;
+    pPg->pDirty = pPager->pMmapFreelist;
+    pPager->pMmapFreelist = pPg;
+
+    assert(pPager->fd->pMethods->iVersion >= 3);
+    sqlite3OsUnfetch(pPager->fd, (i64)(pPg->pgno - 1) * pPager->pageSize, pPg->pData);
+}
+
 /*
 ** If the reference count has reached zero, rollback any active
 ** transaction and unlock the pager.
@@ -5522,7 +5810,7 @@ failed:
 */
 static void pagerUnlockIfUnused(Pager *pPager)
 {
-    if ((sqlite3PcacheRefCount(pPager->pPCache) == 0))
+    if (pPager->nMmapOut == 0 && (sqlite3PcacheRefCount(pPager->pPCache) == 0))
     {
         pagerUnlockAndRollback(pPager);
     }
@@ -5559,14 +5847,22 @@ static void pagerUnlockIfUnused(Pager *pPager)
 **      a new page into the cache to be filled with the data read
 **      from the savepoint journal.
 **
-** If noContent is true, then the data returned is zeroed instead of
-** being read from the database. Additionally, the bits corresponding
+** The flags argument is a combination of the PAGER_ACQUIRE_XXX values.
+** If PAGER_ACQUIRE_NOCONTENT is set, then the data returned is zeroed
+** instead of being read from the database. Additionally, the bits corresponding
 ** to pgno in Pager.pInJournal (bitvec of pages already written to the
 ** journal file) and the PagerSavepoint.pInSavepoint bitvecs of any open
 ** savepoints are set. This means if the page is made writable at any
 ** point in the future, using a call to sqlite3PagerWrite(), its contents
 ** will not be journaled. This saves IO.
 **
+** If PAGER_ACQUIRE_READONLY is set, the caller promises never to pass the
+** page to sqlite3PagerWrite(). Such pages, and any page fetched while the
+** pager is in the READER state, may be returned as pointers directly into
+** a memory mapping of the database file (see pagerAcquireMapPage()) if
+** memory-mapped reads are enabled. Page 1, pages that have a newer copy
+** in the WAL and pages that are already in the cache are never mapped.
+**
 ** The acquisition might fail for several reasons.  In all cases,
 ** an appropriate error code is returned and *ppPage is set to NULL.
 **
@@ -5582,14 +5878,28 @@ int sqlite3PagerAcquire(
     Pager *pPager,      /* The pager open on the database file */
     Pgno pgno,          /* Page number to fetch */
     DbPage **ppPage,    /* Write a pointer to the page here */
-    int noContent       /* Do not bother reading content from disk if true */
+    int flags           /* PAGER_ACQUIRE_XXX flags */
 )
 {
-    int rc;
-    PgHdr *pPg;
+    int rc = SQLITE_OK;
+    PgHdr *pPg = 0;
+    u32 iFrame = 0;                 /* Frame to read from WAL file */
+    const int noContent = (flags & PAGER_ACQUIRE_NOCONTENT);
+
+    /* It is acceptable to use a read-only (mmap) page for any page except
+    ** page 1 if there is no write-transaction open or the ACQUIRE_READONLY
+    ** flag was specified by the caller. And so long as the db is not a
+    ** temporary or in-memory database.  */
+    const int bMmapOk = (pgno != 1 && USEFETCH(pPager)
+                         && (pPager->eState == PAGER_READER || (flags & PAGER_ACQUIRE_READONLY))
+#ifdef SQLITE_HAS_CODEC
+                         && pPager->xCodec == 0
+#endif
+                        );
 
     assert(pPager->eState >= PAGER_READER);
     assert(assert_pager_state(pPager));
+    assert(noContent == 0 || bMmapOk == 0);
 
     if (pgno == 0)
     {
@@ -5604,6 +5914,55 @@ int sqlite3PagerAcquire(
     }
     else
     {
+        if (pPager->pReadSet && pgno > 1)
+        {
+            rc = sqlite3BitvecSet(pPager->pReadSet, pgno);
+            if (rc != SQLITE_OK) goto pager_acquire_err;
+        }
+
+        if (bMmapOk && pgno <= pPager->dbSize && pagerUseWal(pPager))
+        {
+            rc = sqlite3WalFindFrame(pPager->pWal, pgno, &iFrame);
+            if (rc != SQLITE_OK) goto pager_acquire_err;
+        }
+
+        if (iFrame == 0 && bMmapOk && pgno <= pPager->dbSize)
+        {
+            void *pData = 0;
+
+            rc = sqlite3OsFetch(pPager->fd,
+                                (i64)(pgno - 1) * pPager->pageSize, pPager->pageSize, &pData
+                               );
+
+            if (rc == SQLITE_OK && pData)
+            {
+                /* A write transaction may have a newer, dirty copy of the
+                ** page in the cache. Prefer that copy if it exists. */
+                if (pPager->eState > PAGER_READER)
+                {
+                    (void)sqlite3PcacheFetch(pPager->pPCache, pgno, 0, &pPg);
+                }
+                if (pPg == 0)
+                {
+                    rc = pagerAcquireMapPage(pPager, pgno, pData, &pPg);
+                }
+                else
+                {
+                    sqlite3OsUnfetch(pPager->fd, (i64)(pgno - 1) * pPager->pageSize, pData);
+                }
+                if (pPg)
+                {
+                    assert(rc == SQLITE_OK);
+                    *ppPage = pPg;
+                    return SQLITE_OK;
+                }
+            }
+            if (rc != SQLITE_OK)
+            {
+                goto pager_acquire_err;
+            }
+        }
+
         rc = sqlite3PcacheFetch(pPager->pPCache, pgno, 1, ppPage);
     }
 
@@ -5671,11 +6030,28 @@ int sqlite3PagerAcquire(
             memset(pPg->pData, 0, pPager->pageSize);
             IOTRACE(("ZERO %p %d\n", pPager, pgno));
         }
+        else if (sqlite3PcacheRestored(pPg))
+        {
+            /* The page cache restored the content of the page from its
+            ** compressed tier. There is no need to read it. As in readDbPage(),
+            ** Pager.dbFileVers[] is set from the content of page 1.  */
+            if (pgno == 1)
+            {
+                memcpy(&pPager->dbFileVers, &((u8*)pPg->pData)[24], sizeof(pPager->dbFileVers));
+            }
+            pPager->aStat[PAGER_STAT_MISS]++;
+            IOTRACE(("TIER %p %d\n", pPager, pgno));
+        }
         else
         {
+            if (bMmapOk == 0 && pagerUseWal(pPager))
+            {
+                rc = sqlite3WalFindFrame(pPager->pWal, pgno, &iFrame);
+                if (rc != SQLITE_OK) goto pager_acquire_err;
+            }
             assert(pPg->pPager == pPager);
             pPager->aStat[PAGER_STAT_MISS]++;
-            rc = readDbPage(pPg);
+            rc = readDbPage(pPg, iFrame);
             if (rc != SQLITE_OK)
             {
                 goto pager_acquire_err;
@@ -5720,6 +6096,344 @@ DbPage *sqlite3PagerLookup(Pager *pPager, Pgno pgno)
     return pPg;
 }
 
+/*
+** Read the nRun pages in apPg[], which have consecutive page numbers and
+** have just been added to the page cache, from the database file with a
+** single vectored read. Then release them, leaving them in the cache. If
+** the read fails the pages are dropped instead.
+*/
+static void pagerReadRun(Pager *pPager, PgHdr **apPg, int nRun)
+{
+    void *apBuf[SQLITE_MAX_READV];
+    i64 iOffset = (apPg[0]->pgno - 1) * (i64)pPager->pageSize;
+    int rc;
+    int i;
+
+    for (i = 0; i < nRun; i++)
+    {
+        assert(i == 0 || apPg[i]->pgno == apPg[i - 1]->pgno + 1);
+        apBuf[i] = apPg[i]->pData;
+    }
+    rc = sqlite3OsReadv(pPager->fd, iOffset, pPager->pageSize, nRun, apBuf);
+    for (i = 0; i < nRun; i++)
+    {
+        PgHdr *pPg = apPg[i];
+        if (rc == SQLITE_OK)
+        {
+            pPg->pPager = pPager;
+            pager_set_pagehash(pPg);
+            PAGER_INCR(sqlite3_pager_readdb_count);
+            PAGER_INCR(pPager->nRead);
+            IOTRACE(("PGIN %p %d\n", pPager, pPg->pgno));
+            sqlite3PcacheRelease(pPg);
+        }
+        else
+        {
+            sqlite3PcacheDrop(pPg);
+        }
+    }
+}
+
+/*
+** Load the pages listed in aPgno[] into the page cache ahead of need,
+** without taking a reference to any of them. Pages that are already cached
+** are skipped, and runs of consecutive page numbers among the rest are
+** each read with a single sqlite3OsReadv() call.
+**
+** This is only a hint. It is ignored unless the pager is in the READER
+** state and reads pages from the database file with xRead() (not through
+** a memory mapping or a codec). In WAL mode, pages that have a copy in
+** the WAL are skipped. Errors are not reported: a page that could not be
+** read ahead is read on demand later instead. For the same reason, a
+** failure to allocate a page cache entry is a benign malloc failure.
+** Nothing is read ahead if the heap is close to the soft heap limit, as
+** the pages of a run are pinned and so cannot be released to stay
+** under it.
+** 预读:将aPgno[]中的页读入缓存
+*/
+void sqlite3PagerPrefetch(Pager *pPager, const Pgno *aPgno, int nPgno)
+{
+    PgHdr *apRun[SQLITE_MAX_READV];   /* Pages in the current run */
+    int nRun = 0;                     /* Number of entries in apRun[] */
+    int i;
+
+    if (pPager->eState != PAGER_READER || pPager->errCode != SQLITE_OK
+            || MEMDB || !isOpen(pPager->fd) || USEFETCH(pPager)
+            || pPager->fd->pMethods->iVersion < 4 || sqlite3HeapNearlyFull())
+    {
+        return;
+    }
+#ifdef SQLITE_HAS_CODEC
+    if (pPager->xCodec) return;
+#endif
+
+    sqlite3BeginBenignMalloc();
+    for (i = 0; i <= nPgno; i++)
+    {
+        Pgno pgno = (i < nPgno ? aPgno[i] : 0);
+        PgHdr *pPg = 0;
+
+        /* Read the current run if pgno does not extend it */
+        if (nRun > 0 && (pgno != apRun[nRun - 1]->pgno + 1 || nRun == SQLITE_MAX_READV))
+        {
+            pagerReadRun(pPager, apRun, nRun);
+            nRun = 0;
+        }
+        if (pgno <= 1 || pgno > pPager->dbSize || pgno == PAGER_MJ_PGNO(pPager))
+        {
+            continue;
+        }
+        if (pagerUseWal(pPager))
+        {
+            u32 iFrame = 0;
+            if (sqlite3WalFindFrame(pPager->pWal, pgno, &iFrame) != SQLITE_OK || iFrame)
+            {
+                continue;
+            }
+        }
+        if (sqlite3PcacheFetch(pPager->pPCache, pgno, 1, &pPg) != SQLITE_OK || pPg == 0)
+        {
+            continue;
+        }
+        if (pPg->pPager)
+        {
+            /* Already in the cache */
+            sqlite3PcacheRelease(pPg);
+            continue;
+        }
+        apRun[nRun++] = pPg;
+    }
+    sqlite3EndBenignMalloc();
+    assert(nRun == 0);
+}
+
+/*
+** The warm-up file of a database is named after it, with "-warmup"
+** appended. It lists the pages that were in the cache when the database
+** was last closed with PRAGMA cache_warmup enabled:
+**
+**     0: Magic number (PAGER_WARMUP_MAGIC)
+**     4: Number of page numbers that follow (N)
+**     8: N page numbers, in ascending order
+**
+** All values are 32-bit big-endian. The file is only a hint, so a file
+** that is damaged or out of date is harmless.
+** 缓存预热文件:关闭时缓存中的页号列表
+*/
+#define PAGER_WARMUP_MAGIC 0x5157a7e1
+
+/*
+** The warm-up file is not a journal, so it is opened as a temporary file.
+** The VFS then neither syncs its directory nor looks for the database to
+** copy its permissions from.
+*/
+#define PAGER_WARMUP_OPEN SQLITE_OPEN_TEMP_JOURNAL
+
+/*
+** Return true if pPager may have a warm-up file.
+*/
+static int pagerWarmupOk(Pager *pPager)
+{
+    return !MEMDB && !pPager->tempFile && pPager->zFilename[0] != 0;
+}
+
+/* Page numbers collected by pagerWarmupAdd() */
+typedef struct PagerWarmup PagerWarmup;
+struct PagerWarmup
+{
+    Pgno *aPgno;                /* Page numbers */
+    int nPgno;                  /* Number of entries in aPgno[] */
+    int nAlloc;                 /* Allocated size of aPgno[] */
+    Pgno mxPgno;                /* Ignore pages beyond this one */
+};
+
+/*
+** sqlite3PcacheIterate() callback used by pagerWarmupSave(). Add the
+** number of page pPg to the list, unless the page has not been loaded.
+*/
+static void pagerWarmupAdd(void *pArg, PgHdr *pPg)
+{
+    PagerWarmup *p = (PagerWarmup *)pArg;
+    if (pPg->pPager && pPg->pgno <= p->mxPgno && p->nPgno < p->nAlloc)
+    {
+        p->aPgno[p->nPgno++] = pPg->pgno;
+    }
+}
+
+/*
+** Move entry i of the binary max-heap of n page numbers in a[] down until
+** it is no smaller than either of its children.
+*/
+static void pagerWarmupSift(Pgno *a, int i, int n)
+{
+    Pgno v = a[i];
+    for (;;)
+    {
+        int j = i * 2 + 1;
+        if (j >= n) break;
+        if (j + 1 < n && a[j + 1] > a[j]) j++;
+        if (a[j] <= v) break;
+        a[i] = a[j];
+        i = j;
+    }
+    a[i] = v;
+}
+
+/*
+** Sort the n page numbers in a[] in ascending order (heapsort, so that
+** no memory is needed).
+*/
+static void pagerWarmupSort(Pgno *a, int n)
+{
+    int i;
+    for (i = n / 2 - 1; i >= 0; i--)
+    {
+        pagerWarmupSift(a, i, n);
+    }
+    for (i = n - 1; i > 0; i--)
+    {
+        Pgno t = a[0];
+        a[0] = a[i];
+        a[i] = t;
+        pagerWarmupSift(a, 0, i);
+    }
+}
+
+/*
+** If cache warm-up is enabled, write the numbers of the pages currently
+** in the cache to the warm-up file. Errors are ignored.
+**
+** Nothing is written for a read-only database, or if the page cache
+** implementation cannot list its pages.
+*/
+static void pagerWarmupSave(Pager *pPager)
+{
+    PagerWarmup sList;
+    u8 *aBuf;
+    char *zName;
+    int i;
+
+    if (!pPager->bWarmup || !pagerWarmupOk(pPager) || pPager->readOnly) return;
+    sList.nAlloc = sqlite3PcachePagecount(pPager->pPCache);
+    sList.nPgno = 0;
+    sList.mxPgno = pPager->dbSize;
+    aBuf = (u8 *)sqlite3Malloc(8 + sList.nAlloc * 4);
+    sList.aPgno = (Pgno *)&aBuf[8];
+    zName = sqlite3_mprintf("%s-warmup", pPager->zFilename);
+    if (aBuf && zName
+        && sqlite3PcacheIterate(pPager->pPCache, pagerWarmupAdd, &sList) == SQLITE_OK)
+    {
+        sqlite3_file *pFd = 0;
+        int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | PAGER_WARMUP_OPEN;
+
+        pagerWarmupSort(sList.aPgno, sList.nPgno);
+        for (i = 0; i < sList.nPgno; i++)
+        {
+            put32bits(&aBuf[8 + i * 4], sList.aPgno[i]);
+        }
+        put32bits(&aBuf[0], PAGER_WARMUP_MAGIC);
+        put32bits(&aBuf[4], sList.nPgno);
+        if (sqlite3OsOpenMalloc(pPager->pVfs, zName, &pFd, flags, 0) == SQLITE_OK)
+        {
+            if (sqlite3OsTruncate(pFd, 0) == SQLITE_OK)
+            {
+                sqlite3OsWrite(pFd, aBuf, 8 + sList.nPgno * 4, 0);
+            }
+            sqlite3OsCloseFree(pFd);
+        }
+    }
+    sqlite3_free(zName);
+    sqlite3_free(aBuf);
+}
+
+/*
+** Read the list of pages from the warm-up file of pPager. If successful,
+** set *paPgno to point to an array of page numbers in ascending order
+** obtained from sqlite3_malloc(), and *pnPgno to its size. If there is no
+** usable warm-up file, set both to zero and return SQLITE_OK.
+*/
+int sqlite3PagerWarmupList(Pager *pPager, Pgno **paPgno, int *pnPgno)
+{
+    int rc = SQLITE_OK;
+    char *zName;
+    sqlite3_file *pFd = 0;
+    Pgno *aPgno = 0;
+    int nPgno = 0;
+    int bExists = 0;
+
+    *paPgno = 0;
+    *pnPgno = 0;
+    if (!pagerWarmupOk(pPager)) return SQLITE_OK;
+    zName = sqlite3_mprintf("%s-warmup", pPager->zFilename);
+    if (zName == 0) return SQLITE_NOMEM;
+    rc = sqlite3OsAccess(pPager->pVfs, zName, SQLITE_ACCESS_EXISTS, &bExists);
+    if (rc == SQLITE_OK && bExists)
+    {
+        int flags = SQLITE_OPEN_READONLY | PAGER_WARMUP_OPEN;
+        rc = sqlite3OsOpenMalloc(pPager->pVfs, zName, &pFd, flags, 0);
+    }
+    if (pFd)
+    {
+        u8 aHdr[8];
+        i64 sz = 0;
+        rc = sqlite3OsFileSize(pFd, &sz);
+        if (rc == SQLITE_OK && sz >= 8)
+        {
+            rc = sqlite3OsRead(pFd, aHdr, 8, 0);
+        }
+        if (rc == SQLITE_OK && sz >= 8 && sqlite3Get4byte(aHdr) == PAGER_WARMUP_MAGIC
+                && sqlite3Get4byte(&aHdr[4]) <= (u32)((sz - 8) / 4))
+        {
+            nPgno = (int)sqlite3Get4byte(&aHdr[4]);
+            aPgno = (Pgno *)sqlite3Malloc(nPgno * sizeof(Pgno) + 1);
+            if (aPgno == 0)
+            {
+                rc = SQLITE_NOMEM;
+            }
+            else
+            {
+                rc = sqlite3OsRead(pFd, aPgno, nPgno * 4, 8);
+            }
+        }
+        sqlite3OsCloseFree(pFd);
+    }
+    if (rc == SQLITE_OK && aPgno)
+    {
+        /* Keep the entries up to the first that is out of order */
+        int i;
+        for (i = 0; i < nPgno; i++)
+        {
+            Pgno pgno = sqlite3Get4byte((u8 *)&aPgno[i]);
+            if (pgno == 0 || (i > 0 && pgno <= aPgno[i - 1])) break;
+            aPgno[i] = pgno;
+        }
+        nPgno = i;
+    }
+    if (rc != SQLITE_OK || nPgno == 0)
+    {
+        sqlite3_free(aPgno);
+        aPgno = 0;
+        nPgno = 0;
+    }
+    sqlite3_free(zName);
+    *paPgno = aPgno;
+    *pnPgno = nPgno;
+    return rc;
+}
+
+/*
+** Enable or disable saving the cache warm-up list when the pager is
+** closed, or query the setting if onoff is negative. Return the setting.
+*/
+int sqlite3PagerWarmupMode(Pager *pPager, int onoff)
+{
+    if (onoff >= 0)
+    {
+        pPager->bWarmup = (u8)(onoff != 0);
+    }
+    return pPager->bWarmup;
+}
+
 /*
 ** Release a page reference.
 **
@@ -5733,7 +6447,14 @@ void sqlite3PagerUnref(DbPage *pPg)
     if (pPg)
     {
         Pager *pPager = pPg->pPager;
-        sqlite3PcacheRelease(pPg);
+        if (pPg->flags & PGHDR_MMAP)
+        {
+            pagerReleaseMapPage(pPg);
+        }
+        else
+        {
+            sqlite3PcacheRelease(pPg);
+        }
         pagerUnlockIfUnused(pPager);
     }
 }
@@ -5838,6 +6559,29 @@ static int pager_open_journal(Pager *pPager)
     return rc;
 }
 
+#ifndef SQLITE_OMIT_WAL
+/*
+** Called by the btree layer when a read or write transaction is opened
+** within a BEGIN CONCURRENT transaction. If the pager is in WAL mode, and
+** not in locking_mode=exclusive, start recording the pages read so that a
+** subsequent write transaction can be checked for conflicts when it is
+** committed instead of taking the WAL write lock up front. Otherwise this
+** is a no-op, and any write transaction is an ordinary one.
+*/
+int sqlite3PagerBeginConcurrent(Pager *pPager)
+{
+    assert(pPager->eState >= PAGER_READER);
+    if (pPager->pReadSet == 0 && pPager->eState == PAGER_READER
+        && pagerUseWal(pPager) && pPager->exclusiveMode == 0
+       )
+    {
+        pPager->pReadSet = sqlite3BitvecCreate(pPager->mxPgno);
+        if (pPager->pReadSet == 0) return SQLITE_NOMEM;
+    }
+    return SQLITE_OK;
+}
+#endif
+
 /*
 ** Begin a write-transaction on the specified pager object. If a
 ** write-transaction has already been opened, this function is a no-op.
@@ -5888,8 +6632,14 @@ int sqlite3PagerBegin(Pager *pPager, int exFlag, int subjInMemory)
             ** PAGER_RESERVED state. Otherwise, return an error code to the caller.
             ** The busy-handler is not invoked if another connection already
             ** holds the write-lock. If possible, the upper layer will call it.
+            **
+            ** A BEGIN CONCURRENT transaction does not take the write lock
+            ** until it commits.
             */
-            rc = sqlite3WalBeginWriteTransaction(pPager->pWal);
+            if (pPager->pReadSet == 0)
+            {
+                rc = sqlite3WalBeginWriteTransaction(pPager->pWal);
+            }
         }
         else
         {
@@ -6115,6 +6865,7 @@ int sqlite3PagerWrite(DbPage *pDbPage)
     /* 计算每一个扇区可以包含多少page */
     Pgno nPagePerSector = (pPager->sectorSize / pPager->pageSize);
 
+    assert((pPg->flags & PGHDR_MMAP) == 0);
     assert(pPager->eState >= PAGER_WRITER_LOCKED);
     assert(pPager->eState != PAGER_ERROR);
     assert(assert_pager_state(pPager));
@@ -6499,16 +7250,25 @@ int sqlite3PagerCommitPhaseOne(
         {
             PgHdr *pList = sqlite3PcacheDirtyList(pPager->pPCache);
             PgHdr *pPageOne = 0;
-            if (pList == 0)
+            if (pPager->pReadSet)
+            {
+                /* A BEGIN CONCURRENT transaction. If it modified nothing
+                ** there is nothing to commit. */
+                if (pList)
+                {
+                    rc = pagerLockForCommit(pPager, pList);
+                }
+            }
+            else if (pList == 0)
             {
                 /* Must have at least one page for the WAL commit flag.
                 ** Ticket [2d1a5c67dfc2363e44f29d9bbd57f] 2011-05-18 */
                 rc = sqlite3PagerGet(pPager, 1, &pPageOne);
                 pList = pPageOne;
                 pList->pDirty = 0;
+                assert(rc == SQLITE_OK);
             }
-            assert(rc == SQLITE_OK);
-            if (ALWAYS(pList))
+            if (rc == SQLITE_OK && pList)
             {
                 rc = pagerWalFrames(pPager, pList, pPager->dbSize, 1);
             }
@@ -6828,7 +7588,7 @@ u8 sqlite3PagerIsreadonly(Pager *pPager)
 */
 int sqlite3PagerRefcount(Pager *pPager)
 {
-    return sqlite3PcacheRefCount(pPager->pPCache);
+    return sqlite3PcacheRefCount(pPager->pPCache) + pPager->nMmapOut;
 }
 
 /*
@@ -6901,6 +7661,35 @@ void sqlite3PagerCacheStat(Pager *pPager, int eStat, int reset, int *pnVal)
     }
 }
 
+/*
+** Implementation of SQLITE_DBSTATUS_WAL_WRITE. Before returning, *pnWrite
+** is incremented by the number of writes this pager has used to append
+** frames to its WAL file, and *pnFrame by the number of frames appended
+** by those writes. If the reset parameter is non-zero, both counters are
+** zeroed before returning.
+*/
+void sqlite3PagerWalWriteStat(Pager *pPager, int reset, int *pnWrite, int *pnFrame)
+{
+#ifndef SQLITE_OMIT_WAL
+    sqlite3WalWriteStat(pPager->pWal, reset, pnWrite, pnFrame);
+#endif
+}
+
+/*
+** Implementation of SQLITE_DBSTATUS_WAL_CHECKPOINT. Before returning,
+** *pnPage is incremented by the number of pages this pager's checkpoints
+** have written back into the database file, and *pnPageSec is set to the
+** larger of its current value and the pages per second achieved by the
+** most recent checkpoint. If the reset parameter is non-zero, both
+** counters are zeroed before returning.
+*/
+void sqlite3PagerWalCkptStat(Pager *pPager, int reset, int *pnPage, int *pnPageSec)
+{
+#ifndef SQLITE_OMIT_WAL
+    sqlite3WalCkptStat(pPager->pWal, reset, pnPage, pnPageSec);
+#endif
+}
+
 /*
 ** Return true if this is an in-memory pager.
 */
@@ -7119,6 +7908,17 @@ sqlite3_file *sqlite3PagerFile(Pager *pPager)
     return pPager->fd;
 }
 
+/*
+** Return a value that changes each time the contents of the page cache
+** are discarded, for example because another connection has modified
+** the database file. Information derived from page content and kept
+** outside of the page cache is stale once this value changes.
+*/
+u32 sqlite3PagerDataVersion(Pager *pPager)
+{
+    return pPager->iDataVersion;
+}
+
 /*
 ** Return the full pathname of the journal file.
 ** 返回日志(journal)文件的全路径名称
@@ -7535,6 +8335,50 @@ i64 sqlite3PagerJournalSizeLimit(Pager *pPager, i64 iLimit)
     return pPager->journalSizeLimit;
 }
 
+/*
+** Enable or disable WAL group-commit mode if onoff is 0 or 1. Return the
+** current setting. See sqlite3WalGroupCommit() for details.
+*/
+int sqlite3PagerWalGroupCommit(Pager *pPager, int onoff)
+{
+    if (onoff >= 0)
+    {
+        pPager->walGroupCommit = (u8)(onoff != 0);
+        sqlite3WalGroupCommit(pPager->pWal, pPager->walGroupCommit);
+    }
+    return pPager->walGroupCommit;
+}
+
+/*
+** Configure the background checkpointer for the database file. The
+** settings are remembered and applied each time the WAL file is opened.
+** If nFrame is zero or less, background checkpointing is disabled. See
+** sqlite3WalCkptThread() for details.
+*/
+int sqlite3PagerWalCkptThread(Pager *pPager, int nFrame, int nRate, int eSync)
+{
+    int rc = SQLITE_OK;
+    pPager->nCkptThreadFrame = nFrame > 0 ? nFrame : 0;
+    pPager->nCkptThreadRate = nRate > 0 ? nRate : 0;
+    pPager->ckptThreadSync = (u8)eSync;
+    if (pPager->pWal)
+    {
+        rc = sqlite3WalCkptThread(pPager->pWal, pPager->zFilename,
+                                  pPager->nCkptThreadFrame, pPager->nCkptThreadRate, eSync
+                                 );
+    }
+    return rc;
+}
+
+/*
+** Return true if a background checkpointer is running on behalf of this
+** pager, in which case the pager need not checkpoint after commits.
+*/
+int sqlite3PagerCkptThreadActive(Pager *pPager)
+{
+    return sqlite3WalCkptThreadActive(pPager->pWal);
+}
+
 /*
 ** Return a pointer to the pPager->pBackup variable. The backup module
 ** in backup.c maintains the content of this variable. This module
@@ -7646,6 +8490,20 @@ static int pagerOpenWal(Pager *pPager)
                             pPager->journalSizeLimit, &pPager->pWal
                            );
     }
+    if (rc == SQLITE_OK)
+    {
+        sqlite3WalGroupCommit(pPager->pWal, pPager->walGroupCommit);
+
+        /* Failure to start the background checkpointer is not fatal. The
+        ** connection checkpoints from the commit hook instead. */
+        if (pPager->nCkptThreadFrame > 0)
+        {
+            sqlite3WalCkptThread(pPager->pWal, pPager->zFilename,
+                                 pPager->nCkptThreadFrame, pPager->nCkptThreadRate,
+                                 pPager->ckptThreadSync
+                                );
+        }
+    }
 
     return rc;
 }
@@ -7741,6 +8599,7 @@ int sqlite3PagerCloseWal(Pager *pPager)
     */
     if (rc == SQLITE_OK && pPager->pWal)
     {
+        sqlite3WalCkptThread(pPager->pWal, pPager->zFilename, 0, 0, 0);
         rc = pagerExclusiveLock(pPager);
         if (rc == SQLITE_OK)
         {
@@ -80,6 +80,12 @@ typedef struct PgHdr DbPage;
 #define PAGER_JOURNALMODE_MEMORY      4   /* In-memory journal file */
 #define PAGER_JOURNALMODE_WAL         5   /* Use write-ahead logging */
 
+/*
+** Flags that make up the mask passed to sqlite3PagerAcquire().
+*/
+#define PAGER_ACQUIRE_NOCONTENT     0x01  /* Do not load data from disk */
+#define PAGER_ACQUIRE_READONLY      0x02  /* Read-only page is acceptable */
+
 /*
 ** The remainder of this file contains the declarations of the functions
 ** that make up the Pager sub-system API. See source code comments for
@@ -104,6 +110,7 @@ void sqlite3PagerSetBusyhandler(Pager*, int(*)(void *), void *);
 int sqlite3PagerSetPagesize(Pager*, u32*, int);
 int sqlite3PagerMaxPageCount(Pager*, int);
 void sqlite3PagerSetCachesize(Pager*, int);
+void sqlite3PagerSetMmapLimit(Pager *, sqlite3_int64);
 void sqlite3PagerShrink(Pager*);
 void sqlite3PagerSetSafetyLevel(Pager*, int, int, int);
 int sqlite3PagerLockingMode(Pager *, int);
@@ -114,9 +121,12 @@ i64 sqlite3PagerJournalSizeLimit(Pager *, i64);
 sqlite3_backup **sqlite3PagerBackupPtr(Pager*);
 
 /* Functions used to obtain and release page references. */
-int sqlite3PagerAcquire(Pager *pPager, Pgno pgno, DbPage **ppPage, int clrFlag);
+int sqlite3PagerAcquire(Pager *pPager, Pgno pgno, DbPage **ppPage, int flags);
 #define sqlite3PagerGet(A,B,C) sqlite3PagerAcquire(A,B,C,0)
 DbPage *sqlite3PagerLookup(Pager *pPager, Pgno pgno);
+void sqlite3PagerPrefetch(Pager *pPager, const Pgno *aPgno, int nPgno);
+int sqlite3PagerWarmupList(Pager *pPager, Pgno **paPgno, int *pnPgno);
+int sqlite3PagerWarmupMode(Pager *pPager, int onoff);
 void sqlite3PagerRef(DbPage*);
 void sqlite3PagerUnref(DbPage*);
 
@@ -131,6 +141,7 @@ void *sqlite3PagerGetExtra(DbPage *);
 /* Functions used to manage pager transactions and savepoints. */
 void sqlite3PagerPagecount(Pager*, int*);
 int sqlite3PagerBegin(Pager*, int exFlag, int);
+int sqlite3PagerBeginConcurrent(Pager*);
 int sqlite3PagerCommitPhaseOne(Pager*, const char *zMaster, int);
 int sqlite3PagerExclusiveLock(Pager*);
 int sqlite3PagerSync(Pager *pPager);
@@ -145,6 +156,9 @@ int sqlite3PagerWalSupported(Pager *pPager);
 int sqlite3PagerWalCallback(Pager *pPager);
 int sqlite3PagerOpenWal(Pager *pPager, int *pisOpen);
 int sqlite3PagerCloseWal(Pager *pPager);
+int sqlite3PagerWalGroupCommit(Pager *pPager, int onoff);
+int sqlite3PagerWalCkptThread(Pager *pPager, int nFrame, int nRate, int eSync);
+int sqlite3PagerCkptThreadActive(Pager *pPager);
 #ifdef SQLITE_ENABLE_ZIPVFS
 int sqlite3PagerWalFramesize(Pager *pPager);
 #endif
@@ -156,11 +170,14 @@ int sqlite3PagerMemUsed(Pager*);
 const char *sqlite3PagerFilename(Pager*, int);
 const sqlite3_vfs *sqlite3PagerVfs(Pager*);
 sqlite3_file *sqlite3PagerFile(Pager*);
+u32 sqlite3PagerDataVersion(Pager*);
 const char *sqlite3PagerJournalname(Pager*);
 int sqlite3PagerNosync(Pager*);
 void *sqlite3PagerTempSpace(Pager*);
 int sqlite3PagerIsMemdb(Pager*);
 void sqlite3PagerCacheStat(Pager *, int, int, int *);
+void sqlite3PagerWalWriteStat(Pager *, int, int *, int *);
+void sqlite3PagerWalCkptStat(Pager *, int, int *, int *);
 void sqlite3PagerClearCache(Pager *);
 
 /* Functions used to truncate the database file. */
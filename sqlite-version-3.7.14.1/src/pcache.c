@@ -535,6 +535,80 @@ void sqlite3PcacheTruncate(PCache *pCache, Pgno pgno)
     }
 }
 
+/*
+** Discard any copy of page pgno that the page cache implementation holds
+** outside of the cache itself. This is called before the content of a
+** page that is not in the cache is changed, so that the old content is
+** not returned the next time the page is fetched.
+*/
+void sqlite3PcacheForget(PCache *pCache, Pgno pgno)
+{
+    if (pCache->pCache)
+    {
+        sqlite3PCacheTierForget(pCache->pCache, pgno);
+    }
+}
+
+/*
+** Return the number of page images that the page cache implementation
+** holds outside of the cache itself.
+*/
+int sqlite3PcacheTiered(PCache *pCache)
+{
+    int n = 0;
+    if (pCache->pCache)
+    {
+        n = sqlite3PCacheTierCount(pCache->pCache);
+    }
+    return n;
+}
+
+/* Context for pcacheIterateCb() */
+typedef struct PCacheIter PCacheIter;
+struct PCacheIter
+{
+    void (*xIter)(void *, PgHdr *);   /* Callback of sqlite3PcacheIterate() */
+    void *pArg;                       /* First argument for xIter */
+};
+
+/*
+** Callback used by sqlite3PcacheIterate(). Pages that have been allocated
+** by the page cache implementation but not yet initialized by
+** sqlite3PcacheFetch() are skipped.
+*/
+static void pcacheIterateCb(void *pCtx, sqlite3_pcache_page *pPage)
+{
+    PCacheIter *p = (PCacheIter *)pCtx;
+    PgHdr *pPg = (PgHdr *)pPage->pExtra;
+    if (pPg->pPage)
+    {
+        p->xIter(p->pArg, pPg);
+    }
+}
+
+/*
+** Invoke xIter(pArg, pPg) for each page held in the cache, referenced or
+** not, in no particular order. xIter must not call any sqlite3Pcache
+** function. Return SQLITE_OK, or SQLITE_NOTFOUND if the page cache
+** implementation cannot list its pages.
+*/
+int sqlite3PcacheIterate(
+    PCache *pCache,
+    void (*xIter)(void *, PgHdr *),
+    void *pArg
+)
+{
+    int rc = SQLITE_OK;
+    if (pCache->pCache)
+    {
+        PCacheIter sIter;
+        sIter.xIter = xIter;
+        sIter.pArg = pArg;
+        rc = sqlite3PCacheIterate(pCache->pCache, pcacheIterateCb, &sIter);
+    }
+    return rc;
+}
+
 /*
 ** Close a cache.
 */
@@ -57,6 +57,7 @@ struct PgHdr /* 对页(page)的抽象 */
 #define PGHDR_NEED_READ         0x008  /* Content is unread */
 #define PGHDR_REUSE_UNLIKELY    0x010  /* A hint that reuse is unlikely */
 #define PGHDR_DONT_WRITE        0x020  /* Do not write content to disk */
+#define PGHDR_MMAP              0x040  /* This is an mmap page object */
 
 /* Initialize and shutdown the page cache subsystem */
 int sqlite3PcacheInitialize(void);
@@ -66,6 +67,7 @@ void sqlite3PcacheShutdown(void);
 ** These routines implement SQLITE_CONFIG_PAGECACHE.
 */
 void sqlite3PCacheBufferSetup(void *, int sz, int n);
+void sqlite3PCacheArenaSetup(int sz, int n);
 
 /* Create a new pager cache.
 ** Under memory stress, invoke xStress to try to make pages clean.
@@ -105,6 +107,15 @@ void sqlite3PcacheMove(PgHdr*, Pgno);
 /* Remove all pages with pgno>x.  Reset the cache if x==0 */
 void sqlite3PcacheTruncate(PCache*, Pgno x);
 
+/* Discard copies of page x held outside of the cache itself */
+void sqlite3PcacheForget(PCache*, Pgno x);
+
+/* Number of page images held outside of the cache itself */
+int sqlite3PcacheTiered(PCache*);
+
+/* Invoke a callback for every page in the cache */
+int sqlite3PcacheIterate(PCache*, void (*xIter)(void*, PgHdr*), void*);
+
 /* Get a list of all dirty pages in the cache, sorted by page number */
 PgHdr *sqlite3PcacheDirtyList(PCache*);
 
@@ -155,6 +166,16 @@ void sqlite3PcacheShrink(PCache*);
 int sqlite3PcacheReleaseMemory(int);
 #endif
 
+/* Return the SQLITE_STATUS_PAGECACHE_HIT, _MISS or _TIER_HIT count */
+void sqlite3PcacheCounters(int op, int *pnCount, int bReset);
+
+/* True if a new page was restored from the compressed tier of the cache */
+int sqlite3PcacheRestored(PgHdr*);
+void sqlite3PCacheTierForget(sqlite3_pcache*, unsigned int);
+int sqlite3PCacheTierCount(sqlite3_pcache*);
+int sqlite3PCacheIterate(sqlite3_pcache*,
+                         void (*)(void*, sqlite3_pcache_page*), void*);
+
 #ifdef SQLITE_TEST
 void sqlite3PcacheStats(int*, int*, int*, int*);
 #endif
@@ -18,11 +18,16 @@
 */
 
 #include "sqliteInt.h"
+#if SQLITE_OS_UNIX
+# include <sys/mman.h>
+#endif
 
 typedef struct PCache1 PCache1;
 typedef struct PgHdr1 PgHdr1;
 typedef struct PgFreeslot PgFreeslot;
 typedef struct PGroup PGroup;
+typedef struct PCache1Tier PCache1Tier;
+typedef struct PgTierRec PgTierRec;
 
 /* pcache1是pcache的一个实现 */
 
@@ -44,21 +49,57 @@ typedef struct PGroup PGroup;
 ** and is therefore often faster.  Mode 2 requires a mutex in order to be
 ** threadsafe, but recycles pages more efficiently.
 **
-** For mode (1), PGroup.mutex is NULL.  For mode (2) there is only a single
-** PGroup which is the pcache1.grp global variable and its mutex is
+** For mode (1), PGroup.mutex is NULL.  For mode (2) there is normally only
+** a single PGroup which is pcache1.aGroup[0] and its mutex is
 ** SQLITE_MUTEX_STATIC_LRU.
+**
+** If SQLITE_CONFIG_PCACHE_SHARDS is used to configure N shards, mode (2)
+** is used and the global group is split into N PGroups, pcache1.aGroup[0]
+** through aGroup[N-1].  Each PCache is assigned to one of them when it is
+** created and only ever recycles pages within it, so that connections
+** assigned to different shards do not contend for the same mutex.  The
+** mutexes of aGroup[1] and later are dynamically allocated.  The budget
+** of each shard is the sum of nMax for its own caches, so the total
+** number of pages held never exceeds the sum of nMax over all caches.
+**
+** Each PGroup recycles unpinned pages according to the policy selected
+** with SQLITE_CONFIG_PCACHE_POLICY. With the default LRU policy, all
+** unpinned pages are kept on the pLruHead/pLruTail list and the least
+** recently used is recycled first. The 2Q policy (after Johnson and
+** Shasha) keeps two lists:
+**
+**   *  A new page is "cold". Once unpinned it is added to the pLru list,
+**      which serves as the 2Q "A1in" queue. Fetching it again does not
+**      make it hot: a table scan often fetches the same page several
+**      times in quick succession.
+**
+**   *  When a cold page is recycled, a hash of its key is added to the
+**      aGhost[] ring (the "A1out" queue), which remembers at least as
+**      many keys as there are pages in the group. A page that is read
+**      back into the cache while its key is still in aGhost[] is "hot",
+**      and is kept on the pHot list (the "Am" queue) when unpinned.
+**
+**   *  Cold pages are recycled first, unless there are fewer than
+**      nMaxPage/4 of them. So a scan of a large table, whose pages are
+**      all cold, recycles its own pages and not the hot working set.
 ** 每一个page cache属于一个PGroup
 */
 struct PGroup
 {
-    sqlite3_mutex *mutex;          /* MUTEX_STATIC_LRU or NULL */
+    sqlite3_mutex *mutex;          /* MUTEX_STATIC_LRU, MUTEX_FAST or NULL */
     unsigned int nMaxPage;         /* Sum of nMax for purgeable caches */
     unsigned int nMinPage;         /* Sum of nMin for purgeable caches */
     unsigned int mxPinned;         /* nMaxpage + 10 - nMinPage */
     /* 可回收的页的个数 */
     unsigned int nCurrentPage;     /* Number of purgeable pages allocated */
     /* 指向链表 */
-    PgHdr1 *pLruHead, *pLruTail;   /* LRU list of unpinned pages */
+    PgHdr1 *pLruHead, *pLruTail;   /* LRU list of unpinned (cold) pages */
+    PgHdr1 *pHotHead, *pHotTail;   /* 2Q: LRU list of unpinned hot pages */
+    unsigned int nCold;            /* 2Q: Number of pages on the pLru list */
+    u32 *aGhost;                   /* 2Q: Keys of recently recycled cold pages */
+    u8 *aGhostCnt;                 /* 2Q: Count of aGhost[] keys by hash */
+    unsigned int nGhost;           /* 2Q: Size of aGhost[], a power of two */
+    unsigned int iGhost;           /* 2Q: Next aGhost[] slot to overwrite */
 };
 
 /* Each page cache is an instance of the following object.  Every
@@ -95,6 +136,19 @@ struct PCache1
     unsigned int nPage;                 /* Total number of pages in apHash */
     unsigned int nHash;                 /* Number of slots in apHash[] */
     PgHdr1 **apHash;                    /* Hash table for fast lookup by key */
+
+    /* Counters for SQLITE_STATUS_PAGECACHE_HIT and _MISS. These are only
+    ** modified by the owner of the cache while holding the PGroup mutex.
+    ** The list of caches is protected by pcache1.mutex.
+    */
+    unsigned int nHit;                  /* Number of pages found in the cache */
+    unsigned int nMiss;                 /* Number of pages added to the cache */
+    unsigned int nTierHit;              /* Pages restored from pTier */
+    PCache1 *pNextCache, *pPrevCache;   /* List of all caches */
+
+    /* Compressed tier of recycled pages, or NULL. Protected by the PGroup
+    ** mutex. */
+    PCache1Tier *pTier;
 };
 
 /*
@@ -107,12 +161,62 @@ struct PgHdr1
 {
     sqlite3_pcache_page page;
     unsigned int iKey;             /* Key value (page number) */
+    u8 isHot;                      /* 2Q: True for a hot page */
+    u8 isRestored;                 /* True if restored from PCache1.pTier */
     PgHdr1 *pNext;                 /* Next in hash table chain */
     PCache1 *pCache;               /* Cache that currently owns this page */
     PgHdr1 *pLruNext;              /* Next in LRU list of unpinned pages */
     PgHdr1 *pLruPrev;              /* Previous in LRU list of unpinned pages */
 };
 
+/*
+** The compressed tier of a cache (SQLITE_CONFIG_PCACHE_TIER).
+**
+** When a clean page of a purgeable cache is recycled, and the cache has a
+** tier, the content of the page is compressed into the aRing[] buffer of
+** the tier. aRing[] is used as a circular log: each image is written after
+** the last one, and if there is no space for it the oldest images are
+** discarded. An image is removed from the tier when its page is added back
+** to the cache, or when the page is discarded by xTruncate or replaced by
+** xRekey, so a key is never in both the cache and its tier. The space
+** used by a removed image is reclaimed once it is the oldest in aRing[].
+**
+** Images are looked up by key using the aHash[] table. Each aHash[] slot,
+** and the iNext field of each image, is either 0 or one more than the
+** offset in aRing[] of the next image in the hash chain.
+**
+** The whole tier is a single allocation, made by pcache1ResizeTier() when
+** the cache size is set, so that nothing is allocated while the PGroup
+** mutex is held.
+*/
+struct PCache1Tier
+{
+    u8 *aRing;                     /* Circular log of compressed images */
+    u32 nRing;                     /* Size of aRing[] in bytes */
+    u32 iHead;                     /* Offset in aRing[] of the next image */
+    u32 iTail;                     /* Offset in aRing[] of the oldest image */
+    u32 iWrap;                     /* End of the images from iTail onwards */
+    u32 nRec;                      /* Images in aRing[], removed or not */
+    u32 nLive;                     /* Images in aHash[] */
+    u32 nByte;                     /* Bytes of aRing[] used by live images */
+    u32 *aHash;                    /* Hash table of live images */
+    u32 nHash;                     /* Number of aHash[] slots, a power of 2 */
+    u16 *aLz;                      /* Hash table for pcache1LzCompress() */
+    u8 *aOut;                      /* Buffer to compress a page into */
+};
+
+/*
+** Each image in PCache1Tier.aRing[] starts with the following header. It is
+** followed by nData bytes of compressed data, padded to a multiple of 8.
+*/
+struct PgTierRec
+{
+    u32 iKey;                      /* Key value (page number) */
+    u32 nData;                     /* Bytes of compressed data, 0 if removed */
+    u32 nRec;                      /* Total size of this image in aRing[] */
+    u32 iNext;                     /* Next image in the hash chain */
+};
+
 /*
 ** Free slots in the allocator used to divide up the buffer provided using
 ** the SQLITE_CONFIG_PAGECACHE mechanism.
@@ -128,7 +232,13 @@ struct PgFreeslot
 */
 static SQLITE_WSD struct PCacheGlobal
 {
-    PGroup grp;                    /* The global PGroup for mode (2) */
+    PGroup aGroup[SQLITE_MAX_PCACHE_SHARDS];  /* Global PGroups for mode (2) */
+    int nGroup;                    /* Number of aGroup[] entries in use */
+    int bSharded;                  /* Use mode (2) even if mode (1) is usual */
+    unsigned int iNextGroup;       /* aGroup[] to assign to the next PCache */
+    unsigned int iReleaseGroup;    /* aGroup[] to release memory from first */
+    int ePolicy;                   /* SQLITE_PCACHE_POLICY_* value */
+    int nTier;                     /* Compressed tier size, percent of nMax */
 
     /* Variables related to SQLITE_CONFIG_PAGECACHE settings.  The
     ** szSlot, nSlot, pStart, pEnd, nReserve, and isInit values are all
@@ -140,10 +250,16 @@ static SQLITE_WSD struct PCacheGlobal
     int nSlot;                     /* The number of pcache slots */
     int nReserve;                  /* Try to keep nFreeSlot above this */
     void *pStart, *pEnd;           /* Bounds of pagecache malloc range */
+    void *pArena;                  /* Mapping for SQLITE_CONFIG_PAGECACHE_HUGEPAGE */
+    sqlite3_int64 szArena;         /* Size of the pArena mapping in bytes */
     /* Above requires no mutex.  Use mutex below for variable that follow. */
     sqlite3_mutex *mutex;          /* Mutex for accessing the following: */
     PgFreeslot *pFree;             /* Free page blocks */
     int nFreeSlot;                 /* Number of unused pcache slots */
+    PCache1 *pCacheList;           /* List of all PCache1 objects */
+    unsigned int nHitDone;         /* Hits of destroyed caches, less resets */
+    unsigned int nMissDone;        /* Misses of destroyed caches, less resets */
+    unsigned int nTierHitDone;     /* Tier hits of destroyed caches, ditto */
     /* The following value requires a mutex to change.  We skip the mutex on
     ** reading because (1) most platforms read a 32-bit integer atomically and
     ** (2) even if an incorrect value is read, no great harm is done since this
@@ -164,6 +280,22 @@ static SQLITE_WSD struct PCacheGlobal
 #define pcache1EnterMutex(X) sqlite3_mutex_enter((X)->mutex)
 #define pcache1LeaveMutex(X) sqlite3_mutex_leave((X)->mutex)
 
+#ifdef SQLITE_DEBUG
+/*
+** Return true if the calling thread holds none of the global PGroup
+** mutexes. Used within assert() statements only.
+*/
+static int pcache1NoGroupHeld(void)
+{
+    int i;
+    for (i = 0; i < pcache1.nGroup; i++)
+    {
+        if (!sqlite3_mutex_notheld(pcache1.aGroup[i].mutex)) return 0;
+    }
+    return 1;
+}
+#endif
+
 /******************************************************************************/
 /******** Page Allocation/SQLITE_CONFIG_PCACHE Related Functions **************/
 
@@ -199,6 +331,69 @@ void sqlite3PCacheBufferSetup(void *pBuf, int sz, int n)
     }
 }
 
+/*
+** Size of a huge page. The arena mapped for SQLITE_CONFIG_PAGECACHE_HUGEPAGE
+** is a whole number of huge pages, aligned to a huge page boundary.
+*/
+#define PCACHE1_HUGEPAGE_SZ (2*1024*1024)
+
+/*
+** Map an arena of nByte bytes, a multiple of PCACHE1_HUGEPAGE_SZ. Explicit
+** huge pages are used if any are available. If not, map ordinary pages,
+** trim the mapping so that it is aligned to a huge page boundary, and ask
+** for transparent huge pages. Return NULL if the arena cannot be mapped.
+*/
+static void *pcache1ArenaMap(sqlite3_int64 nByte)
+{
+#if SQLITE_OS_UNIX && defined(MAP_ANONYMOUS)
+    char *p;
+    sqlite3_int64 nHead;
+#ifdef MAP_HUGETLB
+    p = (char *)mmap(0, (size_t)nByte, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != (char *)MAP_FAILED) return (void *)p;
+#endif
+    p = (char *)mmap(0, (size_t)(nByte + PCACHE1_HUGEPAGE_SZ), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == (char *)MAP_FAILED) return 0;
+    nHead = (PCACHE1_HUGEPAGE_SZ - (SQLITE_PTR_TO_INT(p) & (PCACHE1_HUGEPAGE_SZ - 1)))
+            & (PCACHE1_HUGEPAGE_SZ - 1);
+    if (nHead) munmap(p, (size_t)nHead);
+    munmap(&p[nHead + nByte], (size_t)(PCACHE1_HUGEPAGE_SZ - nHead));
+    p += nHead;
+#ifdef MADV_HUGEPAGE
+    madvise(p, (size_t)nByte, MADV_HUGEPAGE);
+#endif
+    return (void *)p;
+#else
+    UNUSED_PARAMETER(nByte);
+    return 0;
+#endif
+}
+
+/*
+** This function is called during initialization in place of
+** sqlite3PCacheBufferSetup() if SQLITE_CONFIG_PAGECACHE_HUGEPAGE is
+** configured. Map an arena large enough for n buffers of sz bytes each
+** and use it as if it had been supplied by SQLITE_CONFIG_PAGECACHE. If
+** the arena cannot be mapped, page buffers are allocated from the heap.
+*/
+void sqlite3PCacheArenaSetup(int sz, int n)
+{
+    if (pcache1.isInit)
+    {
+        sqlite3_int64 nByte = (sqlite3_int64)ROUNDDOWN8(sz) * n;
+        nByte = (nByte + PCACHE1_HUGEPAGE_SZ - 1) & ~(sqlite3_int64)(PCACHE1_HUGEPAGE_SZ - 1);
+        assert(pcache1.pArena == 0);
+        pcache1.pArena = pcache1ArenaMap(nByte);
+        if (pcache1.pArena)
+        {
+            pcache1.szArena = nByte;
+            sqlite3PCacheBufferSetup(pcache1.pArena, sz, n);
+        }
+    }
+}
+
 /*
 ** Malloc function used within this file to allocate space from the buffer
 ** configured using sqlite3_config(SQLITE_CONFIG_PAGECACHE) option. If no
@@ -211,7 +406,7 @@ void sqlite3PCacheBufferSetup(void *pBuf, int sz, int n)
 static void *pcache1Alloc(int nByte)
 {
     void *p = 0;
-    assert(sqlite3_mutex_notheld(pcache1.grp.mutex));
+    assert(pcache1NoGroupHeld());
     sqlite3StatusSet(SQLITE_STATUS_PAGECACHE_SIZE, nByte);
     if (nByte <= pcache1.szSlot)
     {
@@ -490,12 +685,16 @@ static void pcache1PinPage(PgHdr1 *pPage)
 {
     PCache1 *pCache;
     PGroup *pGroup;
+    PgHdr1 **ppHead;
+    PgHdr1 **ppTail;
 
     if (pPage == 0) return;
     pCache = pPage->pCache;
     pGroup = pCache->pGroup; /* 得到group */
     assert(sqlite3_mutex_held(pGroup->mutex));
-    if (pPage->pLruNext || pPage == pGroup->pLruTail)
+    ppHead = (pPage->isHot ? &pGroup->pHotHead : &pGroup->pLruHead);
+    ppTail = (pPage->isHot ? &pGroup->pHotTail : &pGroup->pLruTail);
+    if (pPage->pLruNext || pPage == *ppTail)
     {
         if (pPage->pLruPrev)
         {
@@ -505,18 +704,603 @@ static void pcache1PinPage(PgHdr1 *pPage)
         {
             pPage->pLruNext->pLruPrev = pPage->pLruPrev;
         }
-        if (pGroup->pLruHead == pPage)
+        if (*ppHead == pPage)
         {
-            pGroup->pLruHead = pPage->pLruNext;
+            *ppHead = pPage->pLruNext;
         }
-        if (pGroup->pLruTail == pPage)
+        if (*ppTail == pPage)
         {
-            pGroup->pLruTail = pPage->pLruPrev;
+            *ppTail = pPage->pLruPrev;
         }
         pPage->pLruNext = 0;
         pPage->pLruPrev = 0;
         pPage->pCache->nRecyclable--;
+        if (!pPage->isHot)
+        {
+            assert(pGroup->nCold > 0);
+            pGroup->nCold--;
+        }
+    }
+}
+
+/*
+** Return the unpinned page that should be recycled next, or NULL if there
+** are no unpinned pages in the group. With the LRU policy there are never
+** any hot pages, so this is always the tail of the pLru list.
+**
+** The PGroup mutex must be held when this function is called.
+*/
+static PgHdr1 *pcache1Victim(PGroup *pGroup)
+{
+    assert(sqlite3_mutex_held(pGroup->mutex));
+    if (pGroup->pHotTail && (pGroup->pLruTail == 0 || pGroup->nCold <= pGroup->nMaxPage / 4))
+    {
+        return pGroup->pHotTail;
+    }
+    return pGroup->pLruTail;
+}
+
+/*
+** Return the aGhost[] key for page iKey of cache pCache. Zero marks an
+** unused aGhost[] slot, so is never returned.
+*/
+static u32 pcache1GhostKey(PCache1 *pCache, unsigned int iKey)
+{
+    u32 h = (u32)SQLITE_PTR_TO_INT(pCache);
+    h = (h ^ (h >> 16)) * 0x45d9f3b;
+    h ^= iKey * 0x9e3779b1;
+    h ^= (h >> 15);
+    return (h ? h : 1);
+}
+
+/*
+** Page pPage is about to be recycled. If the group keeps a 2Q ghost list
+** and the page is cold, add its key to the ghost list.
+**
+** The aGhostCnt[] array, twice the size of aGhost[], counts the keys in
+** aGhost[] by their low-order bits. So a key may be looked up without
+** searching aGhost[]. Keys that share a slot may cause a page to be
+** treated as hot when it is not, which is harmless.
+**
+** The PGroup mutex must be held when this function is called.
+*/
+static void pcache1GhostAdd(PGroup *pGroup, PgHdr1 *pPage)
+{
+    assert(sqlite3_mutex_held(pGroup->mutex));
+    if (pGroup->aGhost && !pPage->isHot)
+    {
+        u32 mask = pGroup->nGhost * 2 - 1;
+        u32 iOld = pGroup->aGhost[pGroup->iGhost];
+        u32 iNew = pcache1GhostKey(pPage->pCache, pPage->iKey);
+        if (iOld && pGroup->aGhostCnt[iOld & mask] < 0xff)
+        {
+            pGroup->aGhostCnt[iOld & mask]--;
+        }
+        if (pGroup->aGhostCnt[iNew & mask] < 0xff)
+        {
+            pGroup->aGhostCnt[iNew & mask]++;
+        }
+        pGroup->aGhost[pGroup->iGhost] = iNew;
+        pGroup->iGhost = (pGroup->iGhost + 1) & (pGroup->nGhost - 1);
+    }
+}
+
+/*
+** Return true if page iKey of cache pCache was recently recycled as a
+** cold page, and so should be hot when it is read back into the cache.
+**
+** The PGroup mutex must be held when this function is called.
+*/
+static int pcache1GhostTest(PGroup *pGroup, PCache1 *pCache, unsigned int iKey)
+{
+    assert(sqlite3_mutex_held(pGroup->mutex));
+    if (pGroup->aGhost)
+    {
+        u32 mask = pGroup->nGhost * 2 - 1;
+        return pGroup->aGhostCnt[pcache1GhostKey(pCache, iKey) & mask] > 0;
+    }
+    return 0;
+}
+
+/*
+** If the group uses the 2Q policy, make sure its ghost list can hold the
+** keys of at least nMaxPage pages. If the allocation fails, the ghost
+** list is left as it is.
+**
+** The PGroup mutex must be held when this function is called.
+*/
+static void pcache1ResizeGhost(PGroup *pGroup)
+{
+    unsigned int nNew = 16;
+    assert(sqlite3_mutex_held(pGroup->mutex));
+    if (pcache1.ePolicy != SQLITE_PCACHE_POLICY_2Q) return;
+    while (nNew < pGroup->nMaxPage && nNew < (1 << 20))
+    {
+        nNew *= 2;
+    }
+    if (nNew > pGroup->nGhost)
+    {
+        u32 *aNew;
+        pcache1LeaveMutex(pGroup);
+        sqlite3BeginBenignMalloc();
+        aNew = (u32 *)sqlite3MallocZero(nNew * (sizeof(u32) + 2));
+        sqlite3EndBenignMalloc();
+        pcache1EnterMutex(pGroup);
+        if (aNew && nNew > pGroup->nGhost && pGroup->nMaxPage > 0)
+        {
+            sqlite3_free(pGroup->aGhost);
+            pGroup->aGhost = aNew;
+            pGroup->aGhostCnt = (u8 *)&aNew[nNew];
+            pGroup->nGhost = nNew;
+            pGroup->iGhost = 0;
+        }
+        else
+        {
+            sqlite3_free(aNew);
+        }
+    }
+}
+
+/*
+** Free the ghost list of a group.
+*/
+static void pcache1FreeGhost(PGroup *pGroup)
+{
+    sqlite3_free(pGroup->aGhost);
+    pGroup->aGhost = 0;
+    pGroup->aGhostCnt = 0;
+    pGroup->nGhost = 0;
+    pGroup->iGhost = 0;
+}
+
+/*
+** The compressed tier uses a simple LZ77 compressor. Its output is a series
+** of sequences, each of which starts with a token byte. The high 4 bits of
+** the token are a count of literal bytes, and the low 4 bits the length of
+** a match less PCACHE1_LZ_MINMATCH. A value of 15 in either is extended by
+** adding the bytes that follow, up to and including the first that is not
+** 255. The literal count (and its extension) is followed by the literals,
+** then a 2-byte little-endian offset back to the start of the match, then
+** the extension of the match length. The last sequence has no match.
+*/
+#define PCACHE1_LZ_HASHBITS 12
+#define PCACHE1_LZ_MINMATCH 4
+#define pcache1LzGet4(a) \
+    ((u32)(a)[0] | ((u32)(a)[1] << 8) | ((u32)(a)[2] << 16) | ((u32)(a)[3] << 24))
+
+/*
+** Write the extension of a literal count or match length, less 15, to
+** z[i]. Return the offset following it.
+*/
+static int pcache1LzPutCount(u8 *z, int i, int n)
+{
+    while (n >= 255)
+    {
+        z[i++] = 255;
+        n -= 255;
     }
+    z[i++] = (u8)n;
+    return i;
+}
+
+/*
+** Read the extension of a literal count or match length from z[i], and
+** add it to *pn. Return the offset following it, or -1 if it runs past
+** the nIn bytes of z[].
+*/
+static int pcache1LzGetCount(const u8 *z, int i, int nIn, int *pn)
+{
+    int c;
+    do
+    {
+        if (i >= nIn) return -1;
+        c = z[i++];
+        *pn += c;
+    }
+    while (c == 255);
+    return i;
+}
+
+/*
+** Write a sequence of nLit literals from aLit[], followed by a match of
+** nMatch bytes iOff bytes back (or no match if nMatch is 0), to z[i].
+** Return the offset following it, or -1 if it does not fit in mx bytes.
+*/
+static int pcache1LzPut(
+    u8 *z, int i, int mx,
+    const u8 *aLit, int nLit,
+    int iOff, int nMatch
+)
+{
+    int nExtra = (nMatch ? nMatch - PCACHE1_LZ_MINMATCH : 0);
+    if (i + 1 + nLit + nLit / 255 + 1 + 2 + nExtra / 255 + 1 > mx) return -1;
+    z[i++] = (u8)(((nLit < 15 ? nLit : 15) << 4) | (nExtra < 15 ? nExtra : 15));
+    if (nLit >= 15) i = pcache1LzPutCount(z, i, nLit - 15);
+    memcpy(&z[i], aLit, nLit);
+    i += nLit;
+    if (nMatch)
+    {
+        z[i++] = (u8)(iOff & 0xff);
+        z[i++] = (u8)(iOff >> 8);
+        if (nExtra >= 15) i = pcache1LzPutCount(z, i, nExtra - 15);
+    }
+    return i;
+}
+
+/*
+** Compress the n bytes of a[] into z[]. Return the size of the compressed
+** data, or 0 if it is larger than mx bytes. Array aLz[] is used as a hash
+** table of recent offsets in a[], keyed by the 4 bytes found there. Since
+** it holds 16-bit offsets, n may not be greater than 65536.
+*/
+static int pcache1LzCompress(const u8 *a, int n, u8 *z, int mx, u16 *aLz)
+{
+    int i = 0;                     /* Current offset in a[] */
+    int iLit = 0;                  /* Offset of first literal not yet written */
+    int nOut = 0;                  /* Bytes written to z[] */
+
+    assert(n <= 65536);
+    memset(aLz, 0, sizeof(u16) << PCACHE1_LZ_HASHBITS);
+    while (i + PCACHE1_LZ_MINMATCH <= n)
+    {
+        u32 v = pcache1LzGet4(&a[i]);
+        u32 h = (v * 2654435761u) >> (32 - PCACHE1_LZ_HASHBITS);
+        int iRef = aLz[h];
+        aLz[h] = (u16)i;
+        if (iRef < i && pcache1LzGet4(&a[iRef]) == v)
+        {
+            int nMatch = PCACHE1_LZ_MINMATCH;
+            while (i + nMatch < n && a[iRef + nMatch] == a[i + nMatch]) nMatch++;
+            nOut = pcache1LzPut(z, nOut, mx, &a[iLit], i - iLit, i - iRef, nMatch);
+            if (nOut < 0) return 0;
+            i += nMatch;
+            iLit = i;
+        }
+        else
+        {
+            i++;
+        }
+    }
+    if (iLit < n)
+    {
+        nOut = pcache1LzPut(z, nOut, mx, &a[iLit], n - iLit, 0, 0);
+        if (nOut < 0) return 0;
+    }
+    return nOut;
+}
+
+/*
+** Decompress the nIn bytes of z[] into the n bytes of a[]. Return true if
+** exactly n bytes are decompressed, or false if z[] is not valid.
+*/
+static int pcache1LzDecompress(const u8 *z, int nIn, u8 *a, int n)
+{
+    int i = 0;                     /* Current offset in z[] */
+    int o = 0;                     /* Bytes written to a[] */
+    while (i < nIn)
+    {
+        int iTok = z[i++];
+        int nLit = iTok >> 4;
+        int nMatch = iTok & 0x0f;
+        int iOff;
+        if (nLit == 15) i = pcache1LzGetCount(z, i, nIn, &nLit);
+        if (i < 0 || nLit > nIn - i || nLit > n - o) return 0;
+        memcpy(&a[o], &z[i], nLit);
+        i += nLit;
+        o += nLit;
+        if (i == nIn) break;
+        if (nIn - i < 2) return 0;
+        iOff = z[i] | (z[i + 1] << 8);
+        i += 2;
+        if (nMatch == 15) i = pcache1LzGetCount(z, i, nIn, &nMatch);
+        nMatch += PCACHE1_LZ_MINMATCH;
+        if (i < 0 || iOff == 0 || iOff > o || nMatch > n - o) return 0;
+        if (iOff >= nMatch)
+        {
+            memcpy(&a[o], &a[o - iOff], nMatch);
+            o += nMatch;
+        }
+        else
+        {
+            /* The match overlaps the bytes it produces */
+            while (nMatch--)
+            {
+                a[o] = a[o - iOff];
+                o++;
+            }
+        }
+    }
+    return o == n;
+}
+
+/*
+** Largest aRing[] allocated for the compressed tier of a cache.
+*/
+#define PCACHE1_TIER_MAX (1 << 30)
+
+/*
+** Report the change in the number of bytes used by tier p since it was
+** nBefore to SQLITE_STATUS_PAGECACHE_TIER_USED.
+*/
+static void pcache1TierUsed(PCache1Tier *p, u32 nBefore)
+{
+    if (p->nByte != nBefore)
+    {
+        sqlite3_mutex_enter(pcache1.mutex);
+        sqlite3StatusAdd(SQLITE_STATUS_PAGECACHE_TIER_USED, (int)(p->nByte - nBefore));
+        sqlite3_mutex_leave(pcache1.mutex);
+    }
+}
+
+/*
+** Return a pointer to the link (aHash[] slot or iNext field) that refers to
+** the image of key iKey in tier p, or to the zero link at the end of its
+** hash chain if there is no such image.
+*/
+static u32 *pcache1TierLink(PCache1Tier *p, unsigned int iKey)
+{
+    u32 *pLink = &p->aHash[iKey & (p->nHash - 1)];
+    while (*pLink)
+    {
+        PgTierRec *pRec = (PgTierRec *)&p->aRing[*pLink - 1];
+        if (pRec->iKey == iKey) break;
+        pLink = &pRec->iNext;
+    }
+    return pLink;
+}
+
+/*
+** Remove the image that *pLink refers to from the hash table of tier p.
+*/
+static void pcache1TierUnlink(PCache1Tier *p, u32 *pLink)
+{
+    PgTierRec *pRec = (PgTierRec *)&p->aRing[*pLink - 1];
+    *pLink = pRec->iNext;
+    pRec->nData = 0;
+    p->nByte -= pRec->nRec;
+    p->nLive--;
+}
+
+/*
+** Discard the oldest image in tier p, which must not be empty.
+*/
+static void pcache1TierEvict(PCache1Tier *p)
+{
+    PgTierRec *pRec = (PgTierRec *)&p->aRing[p->iTail];
+    assert(p->nRec > 0);
+    if (pRec->nData)
+    {
+        u32 *pLink = pcache1TierLink(p, pRec->iKey);
+        assert(*pLink == p->iTail + 1);
+        pcache1TierUnlink(p, pLink);
+    }
+    p->iTail += pRec->nRec;
+    p->nRec--;
+    if (p->iTail == p->iWrap)
+    {
+        p->iTail = 0;
+        p->iWrap = p->nRing;
+    }
+}
+
+/*
+** Make space for an image of n bytes at aRing[iHead] of tier p, discarding
+** the oldest images as required. Return a pointer to the space, or NULL if
+** n is larger than aRing[].
+*/
+static PgTierRec *pcache1TierSpace(PCache1Tier *p, u32 n)
+{
+    PgTierRec *pRec;
+    if (n > p->nRing) return 0;
+    while (1)
+    {
+        if (p->nRec == 0)
+        {
+            p->iHead = p->iTail = 0;
+            p->iWrap = p->nRing;
+        }
+        if (p->iHead > p->iTail || p->nRec == 0)
+        {
+            /* The free space runs from iHead to the end of aRing[], and then
+            ** from the start of aRing[] to iTail. */
+            if (p->nRing - p->iHead >= n) break;
+            p->iWrap = p->iHead;
+            p->iHead = 0;
+        }
+        if (p->iTail - p->iHead >= n) break;
+        pcache1TierEvict(p);
+    }
+    pRec = (PgTierRec *)&p->aRing[p->iHead];
+    pRec->nRec = n;
+    p->iHead += n;
+    p->nRec++;
+    return pRec;
+}
+
+/*
+** Page pPage is about to be recycled. If its cache has a compressed tier,
+** and the page compresses to less than 7/8 of its size, add an image of it
+** to the tier. The page must be clean, which is always true of an unpinned
+** page.
+**
+** The PGroup mutex must be held when this function is called.
+*/
+static void pcache1TierAdd(PgHdr1 *pPage)
+{
+    PCache1 *pCache = pPage->pCache;
+    PCache1Tier *p = pCache->pTier;
+    if (p)
+    {
+        u32 nBefore = p->nByte;
+        int nData;
+        assert(sqlite3_mutex_held(pCache->pGroup->mutex));
+        assert(*pcache1TierLink(p, pPage->iKey) == 0);
+        nData = pcache1LzCompress((u8 *)pPage->page.pBuf, pCache->szPage,
+                                  p->aOut, pCache->szPage - pCache->szPage / 8, p->aLz);
+        if (nData > 0)
+        {
+            u32 n = ROUND8(sizeof(PgTierRec) + nData);
+            PgTierRec *pRec = pcache1TierSpace(p, n);
+            if (pRec)
+            {
+                u32 *pLink = &p->aHash[pPage->iKey & (p->nHash - 1)];
+                pRec->iKey = pPage->iKey;
+                pRec->nData = (u32)nData;
+                pRec->iNext = *pLink;
+                memcpy(&pRec[1], p->aOut, nData);
+                *pLink = (u32)((u8 *)pRec - p->aRing) + 1;
+                p->nByte += n;
+                p->nLive++;
+            }
+        }
+        pcache1TierUsed(p, nBefore);
+    }
+}
+
+/*
+** Page pPage has just been added to cache pCache, which has a compressed
+** tier. If the tier holds an image of the page, decompress it into the
+** page buffer and set PgHdr1.isRestored. Either way, remove the image
+** from the tier.
+**
+** The PGroup mutex must be held when this function is called.
+*/
+static void pcache1TierRestore(PCache1 *pCache, PgHdr1 *pPage)
+{
+    PCache1Tier *p = pCache->pTier;
+    u32 *pLink;
+    assert(sqlite3_mutex_held(pCache->pGroup->mutex));
+    pLink = pcache1TierLink(p, pPage->iKey);
+    if (*pLink)
+    {
+        PgTierRec *pRec = (PgTierRec *)&p->aRing[*pLink - 1];
+        u32 nBefore = p->nByte;
+        if (pcache1LzDecompress((u8 *)&pRec[1], (int)pRec->nData,
+                                (u8 *)pPage->page.pBuf, pCache->szPage))
+        {
+            pPage->isRestored = 1;
+            pCache->nTierHit++;
+        }
+        pcache1TierUnlink(p, pLink);
+        pcache1TierUsed(p, nBefore);
+    }
+}
+
+/*
+** Remove the image of page iKey, if there is one, from the compressed
+** tier of cache pCache.
+**
+** The PGroup mutex must be held when this function is called.
+*/
+static void pcache1TierRemove(PCache1 *pCache, unsigned int iKey)
+{
+    PCache1Tier *p = pCache->pTier;
+    u32 *pLink;
+    assert(sqlite3_mutex_held(pCache->pGroup->mutex));
+    pLink = pcache1TierLink(p, iKey);
+    if (*pLink)
+    {
+        u32 nBefore = p->nByte;
+        pcache1TierUnlink(p, pLink);
+        pcache1TierUsed(p, nBefore);
+    }
+}
+
+/*
+** Remove all images of pages with keys greater than or equal to iLimit
+** from the compressed tier of cache pCache.
+**
+** The PGroup mutex must be held when this function is called.
+*/
+static void pcache1TierTruncate(PCache1 *pCache, unsigned int iLimit)
+{
+    PCache1Tier *p = pCache->pTier;
+    u32 nBefore = p->nByte;
+    assert(sqlite3_mutex_held(pCache->pGroup->mutex));
+    if (p->nLive == 0) return;
+    if (iLimit == 0)
+    {
+        memset(p->aHash, 0, p->nHash * sizeof(u32));
+        p->nRec = 0;
+        p->nLive = 0;
+        p->nByte = 0;
+    }
+    else
+    {
+        u32 h;
+        for (h = 0; h < p->nHash; h++)
+        {
+            u32 *pLink = &p->aHash[h];
+            while (*pLink)
+            {
+                PgTierRec *pRec = (PgTierRec *)&p->aRing[*pLink - 1];
+                if (pRec->iKey >= iLimit)
+                {
+                    pcache1TierUnlink(p, pLink);
+                }
+                else
+                {
+                    pLink = &pRec->iNext;
+                }
+            }
+        }
+    }
+    pcache1TierUsed(p, nBefore);
+}
+
+/*
+** Make sure that the compressed tier of cache pCache is the size required
+** for its nMax. If it is resized, the images it held are lost. If the
+** allocation fails, the cache is left without a tier.
+**
+** The PGroup mutex must be held when this function is called. It is
+** released while memory is allocated.
+*/
+static void pcache1ResizeTier(PCache1 *pCache)
+{
+    PGroup *pGroup = pCache->pGroup;
+    sqlite3_int64 nRing;
+    PCache1Tier *pNew = 0;
+
+    assert(sqlite3_mutex_held(pGroup->mutex));
+    nRing = (sqlite3_int64)pCache->nMax * pCache->szPage * pcache1.nTier / 100;
+    if (nRing > PCACHE1_TIER_MAX) nRing = PCACHE1_TIER_MAX;
+    nRing = ROUNDDOWN8(nRing);
+    if (nRing < 2 * pCache->szPage) nRing = 0;
+    if (nRing == (pCache->pTier ? pCache->pTier->nRing : 0)) return;
+
+    if (nRing)
+    {
+        /* The hash table has a slot for each 1/4 page of aRing[] */
+        u32 nHash = 64;
+        while (nHash < nRing / (pCache->szPage / 4)) nHash *= 2;
+        pcache1LeaveMutex(pGroup);
+        sqlite3BeginBenignMalloc();
+        pNew = (PCache1Tier *)sqlite3Malloc(ROUND8(sizeof(PCache1Tier))
+                                            + nHash * sizeof(u32)
+                                            + (sizeof(u16) << PCACHE1_LZ_HASHBITS)
+                                            + pCache->szPage + (int)nRing);
+        sqlite3EndBenignMalloc();
+        pcache1EnterMutex(pGroup);
+        if (pNew)
+        {
+            memset(pNew, 0, sizeof(PCache1Tier));
+            pNew->aHash = (u32 *)&((u8 *)pNew)[ROUND8(sizeof(PCache1Tier))];
+            pNew->nHash = nHash;
+            pNew->aLz = (u16 *)&pNew->aHash[nHash];
+            pNew->aOut = (u8 *)&pNew->aLz[1 << PCACHE1_LZ_HASHBITS];
+            pNew->aRing = &pNew->aOut[pCache->szPage];
+            pNew->nRing = (u32)nRing;
+            pNew->iWrap = pNew->nRing;
+            memset(pNew->aHash, 0, nHash * sizeof(u32));
+        }
+    }
+    if (pCache->pTier)
+    {
+        pcache1TierTruncate(pCache, 0);
+        sqlite3_free(pCache->pTier);
+    }
+    pCache->pTier = pNew;
 }
 
 
@@ -548,11 +1332,13 @@ static void pcache1RemoveFromHash(PgHdr1 *pPage)
 */
 static void pcache1EnforceMaxPage(PGroup *pGroup)
 {
+    PgHdr1 *p;
     assert(sqlite3_mutex_held(pGroup->mutex));
-    while (pGroup->nCurrentPage > pGroup->nMaxPage && pGroup->pLruTail)
+    while (pGroup->nCurrentPage > pGroup->nMaxPage && (p = pcache1Victim(pGroup)) != 0)
     {
-        PgHdr1 *p = pGroup->pLruTail;
         assert(p->pCache->pGroup == pGroup);
+        pcache1GhostAdd(pGroup, p);
+        pcache1TierAdd(p);
         pcache1PinPage(p);
         pcache1RemoveFromHash(p);
         pcache1FreePage(p);
@@ -574,6 +1360,10 @@ static void pcache1TruncateUnsafe(
     TESTONLY(unsigned int nPage = 0;)    /* To assert pCache->nPage is correct */
     unsigned int h;
     assert(sqlite3_mutex_held(pCache->pGroup->mutex));
+    if (pCache->pTier)
+    {
+        pcache1TierTruncate(pCache, iLimit);
+    }
     for (h = 0; h < pCache->nHash; h++)
     {
         PgHdr1 **pp = &pCache->apHash[h];
@@ -600,34 +1390,94 @@ static void pcache1TruncateUnsafe(
 /******************************************************************************/
 /******** sqlite3_pcache Methods **********************************************/
 
+/*
+** Free the ghost lists of the global PGroups and the mutexes of those
+** other than the first, which use dynamically allocated mutexes. Then
+** zero the global state.
+*/
+static void pcache1FreeShards(void)
+{
+    int i;
+    for (i = 0; i < pcache1.nGroup; i++)
+    {
+        pcache1FreeGhost(&pcache1.aGroup[i]);
+        if (i > 0) sqlite3_mutex_free(pcache1.aGroup[i].mutex);
+    }
+    memset(&pcache1, 0, sizeof(pcache1));
+}
+
 /*
 ** Implementation of the sqlite3_pcache.xInit method.
 */
 static int pcache1Init(void *NotUsed)
 {
+    int i;
     UNUSED_PARAMETER(NotUsed);
     assert(pcache1.isInit == 0);
     memset(&pcache1, 0, sizeof(pcache1));
+    pcache1.nGroup = 1;
+    pcache1.ePolicy = sqlite3GlobalConfig.ePcachePolicy;
+    pcache1.nTier = sqlite3GlobalConfig.nPcacheTier;
     if (sqlite3GlobalConfig.bCoreMutex)
     {
-        pcache1.grp.mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_LRU);
+        pcache1.aGroup[0].mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_LRU);
         pcache1.mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_PMEM);
+        if (sqlite3GlobalConfig.nPcacheShard > 0)
+        {
+            pcache1.bSharded = 1;
+            while (pcache1.nGroup < sqlite3GlobalConfig.nPcacheShard)
+            {
+                sqlite3_mutex *pMutex = sqlite3MutexAlloc(SQLITE_MUTEX_FAST);
+                if (pMutex == 0)
+                {
+                    pcache1FreeShards();
+                    return SQLITE_NOMEM;
+                }
+                pcache1.aGroup[pcache1.nGroup++].mutex = pMutex;
+            }
+        }
+    }
+    for (i = 0; i < pcache1.nGroup; i++)
+    {
+        pcache1.aGroup[i].mxPinned = 10;
     }
-    pcache1.grp.mxPinned = 10;
     pcache1.isInit = 1;
     return SQLITE_OK;
 }
 
 /*
 ** Implementation of the sqlite3_pcache.xShutdown method.
-** Note that the static mutex allocated in xInit does
+** Note that the static mutexes allocated in xInit do
 ** not need to be freed.
 */
 static void pcache1Shutdown(void *NotUsed)
 {
     UNUSED_PARAMETER(NotUsed);
     assert(pcache1.isInit != 0);
-    memset(&pcache1, 0, sizeof(pcache1));
+#if SQLITE_OS_UNIX && defined(MAP_ANONYMOUS)
+    if (pcache1.pArena)
+    {
+        munmap(pcache1.pArena, (size_t)pcache1.szArena);
+    }
+#endif
+    pcache1FreeShards();
+}
+
+/*
+** Return the global PGroup that the next mode (2) PCache should belong
+** to. Pages never move between PCaches, so a cache is assigned to a shard
+** as a whole. Shards are handed out in turn to keep them evenly loaded.
+*/
+static PGroup *pcache1NextGroup(void)
+{
+    unsigned int iGroup = 0;
+    if (pcache1.nGroup > 1)
+    {
+        sqlite3_mutex_enter(pcache1.mutex);
+        iGroup = pcache1.iNextGroup++ % pcache1.nGroup;
+        sqlite3_mutex_leave(pcache1.mutex);
+    }
+    return &pcache1.aGroup[iGroup];
 }
 
 /*
@@ -651,13 +1501,16 @@ static sqlite3_pcache *pcache1Create(int szPage, int szExtra, int bPurgeable)
     **
     **   *  Always use a unified cache in single-threaded applications
     **
+    **   *  Always use a unified cache if SQLITE_CONFIG_PCACHE_SHARDS was
+    **      used to split it into shards
+    **
     **   *  Otherwise (if multi-threaded and ENABLE_MEMORY_MANAGEMENT is off)
     **      use separate caches (mode-1)
     */
 #if defined(SQLITE_ENABLE_MEMORY_MANAGEMENT) || SQLITE_THREADSAFE==0
     const int separateCache = 0;
 #else
-    int separateCache = sqlite3GlobalConfig.bCoreMutex > 0;
+    int separateCache = sqlite3GlobalConfig.bCoreMutex > 0 && !pcache1.bSharded;
 #endif
 
     assert((szPage & (szPage - 1)) == 0 && szPage >= 512 && szPage <= 65536);
@@ -674,7 +1527,7 @@ static sqlite3_pcache *pcache1Create(int szPage, int szExtra, int bPurgeable)
         }
         else
         {
-            pGroup = &pcache1.grp;
+            pGroup = pcache1NextGroup();
         }
         pCache->pGroup = pGroup;
         pCache->szPage = szPage; /* page大小 */
@@ -688,6 +1541,11 @@ static sqlite3_pcache *pcache1Create(int szPage, int szExtra, int bPurgeable)
             pGroup->mxPinned = pGroup->nMaxPage + 10 - pGroup->nMinPage;
             pcache1LeaveMutex(pGroup);
         }
+        sqlite3_mutex_enter(pcache1.mutex);
+        pCache->pNextCache = pcache1.pCacheList;
+        if (pCache->pNextCache) pCache->pNextCache->pPrevCache = pCache;
+        pcache1.pCacheList = pCache;
+        sqlite3_mutex_leave(pcache1.mutex);
     }
     return (sqlite3_pcache *)pCache;
 }
@@ -708,6 +1566,8 @@ static void pcache1Cachesize(sqlite3_pcache *p, int nMax)
         pGroup->mxPinned = pGroup->nMaxPage + 10 - pGroup->nMinPage;
         pCache->nMax = nMax;
         pCache->n90pct = pCache->nMax * 9 / 10;
+        pcache1ResizeGhost(pGroup);
+        pcache1ResizeTier(pCache);
         pcache1EnforceMaxPage(pGroup);
         pcache1LeaveMutex(pGroup);
     }
@@ -829,6 +1689,7 @@ static sqlite3_pcache_page *pcache1Fetch(
     /* Step 2: Abort if no existing page is found and createFlag is 0 */
     if (pPage || createFlag == 0)
     {
+        if (pPage) pCache->nHit++;
         pcache1PinPage(pPage);
         goto fetch_out;
     }
@@ -864,14 +1725,16 @@ static sqlite3_pcache_page *pcache1Fetch(
     }
 
     /* Step 4. Try to recycle a page. */
-    if (pCache->bPurgeable && pGroup->pLruTail && (
+    if (pCache->bPurgeable && pcache1Victim(pGroup) && (
             (pCache->nPage + 1 >= pCache->nMax)
             || pGroup->nCurrentPage >= pGroup->nMaxPage
             || pcache1UnderMemoryPressure(pCache)
         ))
     {
         PCache1 *pOther;
-        pPage = pGroup->pLruTail;
+        pPage = pcache1Victim(pGroup);
+        pcache1GhostAdd(pGroup, pPage);
+        pcache1TierAdd(pPage);
         pcache1RemoveFromHash(pPage);
         pcache1PinPage(pPage);
         pOther = pPage->pCache;
@@ -913,8 +1776,15 @@ static sqlite3_pcache_page *pcache1Fetch(
         pPage->pCache = pCache;
         pPage->pLruPrev = 0;
         pPage->pLruNext = 0;
+        pPage->isHot = (u8)pcache1GhostTest(pGroup, pCache, iKey);
+        pPage->isRestored = 0;
         *(void **)pPage->page.pExtra = 0;
         pCache->apHash[h] = pPage;
+        pCache->nMiss++;
+        if (pCache->pTier)
+        {
+            pcache1TierRestore(pCache, pPage);
+        }
     }
 
 fetch_out:
@@ -950,26 +1820,34 @@ static void pcache1Unpin(
     */
     assert(pPage->pLruPrev == 0 && pPage->pLruNext == 0);
     assert(pGroup->pLruHead != pPage && pGroup->pLruTail != pPage);
+    assert(pGroup->pHotHead != pPage && pGroup->pHotTail != pPage);
 
     if (reuseUnlikely || pGroup->nCurrentPage > pGroup->nMaxPage)
     {
+        /* A page discarded with reuseUnlikely set may not hold valid
+        ** content, so is not added to the compressed tier. */
+        if (!reuseUnlikely) pcache1TierAdd(pPage);
         pcache1RemoveFromHash(pPage);
         pcache1FreePage(pPage);
     }
     else
     {
-        /* Add the page to the PGroup LRU list. */
-        if (pGroup->pLruHead)
+        /* Add the page to the PGroup LRU list, or to the list of hot pages
+        ** if it is a hot page. */
+        PgHdr1 **ppHead = (pPage->isHot ? &pGroup->pHotHead : &pGroup->pLruHead);
+        PgHdr1 **ppTail = (pPage->isHot ? &pGroup->pHotTail : &pGroup->pLruTail);
+        if (*ppHead)
         {
-            pGroup->pLruHead->pLruPrev = pPage;
-            pPage->pLruNext = pGroup->pLruHead;
-            pGroup->pLruHead = pPage;
+            (*ppHead)->pLruPrev = pPage;
+            pPage->pLruNext = *ppHead;
+            *ppHead = pPage;
         }
         else
         {
-            pGroup->pLruTail = pPage;
-            pGroup->pLruHead = pPage;
+            *ppTail = pPage;
+            *ppHead = pPage;
         }
+        if (!pPage->isHot) pGroup->nCold++;
         pCache->nRecyclable++;
     }
 
@@ -1003,6 +1881,11 @@ static void pcache1Rekey(
     }
     *pp = pPage->pNext;
 
+    if (pCache->pTier)
+    {
+        pcache1TierRemove(pCache, iNew);
+    }
+
     h = iNew % pCache->nHash;
     pPage->iKey = iNew;
     pPage->pNext = pCache->apHash[h];
@@ -1052,7 +1935,26 @@ static void pcache1Destroy(sqlite3_pcache *p)
     pGroup->nMinPage -= pCache->nMin;
     pGroup->mxPinned = pGroup->nMaxPage + 10 - pGroup->nMinPage;
     pcache1EnforceMaxPage(pGroup);
+    if (pGroup->nMaxPage == 0)
+    {
+        pcache1FreeGhost(pGroup);
+    }
     pcache1LeaveMutex(pGroup);
+    sqlite3_mutex_enter(pcache1.mutex);
+    if (pCache->pNextCache) pCache->pNextCache->pPrevCache = pCache->pPrevCache;
+    if (pCache->pPrevCache)
+    {
+        pCache->pPrevCache->pNextCache = pCache->pNextCache;
+    }
+    else
+    {
+        pcache1.pCacheList = pCache->pNextCache;
+    }
+    pcache1.nHitDone += pCache->nHit;
+    pcache1.nMissDone += pCache->nMiss;
+    pcache1.nTierHitDone += pCache->nTierHit;
+    sqlite3_mutex_leave(pcache1.mutex);
+    sqlite3_free(pCache->pTier);
     sqlite3_free(pCache->apHash);
     sqlite3_free(pCache);
 }
@@ -1096,28 +1998,175 @@ void sqlite3PCacheSetDefault(void)
 int sqlite3PcacheReleaseMemory(int nReq)
 {
     int nFree = 0;
-    assert(sqlite3_mutex_notheld(pcache1.grp.mutex));
+    assert(pcache1NoGroupHeld());
     assert(sqlite3_mutex_notheld(pcache1.mutex));
     if (pcache1.pStart == 0)
     {
-        PgHdr1 *p;
-        pcache1EnterMutex(&pcache1.grp);
-        while ((nReq < 0 || nFree < nReq) && ((p = pcache1.grp.pLruTail) != 0))
+        /* Each shard is visited in turn, holding only its own mutex. The
+        ** first shard visited rotates from one call to the next so that
+        ** the same shard is not always the one to lose its pages. The
+        ** iReleaseGroup counter is only a hint, so it is not protected
+        ** by a mutex. */
+        unsigned int iStart = pcache1.iReleaseGroup++;
+        int i;
+        for (i = 0; i < pcache1.nGroup && (nReq < 0 || nFree < nReq); i++)
         {
-            nFree += pcache1MemSize(p->page.pBuf);
+            PGroup *pGroup = &pcache1.aGroup[(iStart + i) % pcache1.nGroup];
+            PgHdr1 *p;
+            pcache1EnterMutex(pGroup);
+            while ((nReq < 0 || nFree < nReq) && ((p = pcache1Victim(pGroup)) != 0))
+            {
+                nFree += pcache1MemSize(p->page.pBuf);
 #ifdef SQLITE_PCACHE_SEPARATE_HEADER
-            nFree += sqlite3MemSize(p);
+                nFree += sqlite3MemSize(p);
 #endif
-            pcache1PinPage(p);
-            pcache1RemoveFromHash(p);
-            pcache1FreePage(p);
+                pcache1GhostAdd(pGroup, p);
+                pcache1TierAdd(p);
+                pcache1PinPage(p);
+                pcache1RemoveFromHash(p);
+                pcache1FreePage(p);
+            }
+            pcache1LeaveMutex(pGroup);
         }
-        pcache1LeaveMutex(&pcache1.grp);
     }
     return nFree;
 }
 #endif /* SQLITE_ENABLE_MEMORY_MANAGEMENT */
 
+/*
+** Write the SQLITE_STATUS_PAGECACHE_HIT, _MISS or _TIER_HIT count, as
+** selected by op, to *pnCount. If bReset is true, reset the count to zero.
+**
+** The counters of caches that are in use are read without holding their
+** PGroup mutexes. This is harmless, as they only ever increase and the
+** result is only a statistic.
+*/
+void sqlite3PcacheCounters(int op, int *pnCount, int bReset)
+{
+    PCache1 *p;
+    unsigned int *pnDone;
+    unsigned int n;
+    sqlite3_mutex_enter(pcache1.mutex);
+    switch (op)
+    {
+        case SQLITE_STATUS_PAGECACHE_HIT:
+            pnDone = &pcache1.nHitDone;
+            break;
+        case SQLITE_STATUS_PAGECACHE_MISS:
+            pnDone = &pcache1.nMissDone;
+            break;
+        default:
+            assert(op == SQLITE_STATUS_PAGECACHE_TIER_HIT);
+            pnDone = &pcache1.nTierHitDone;
+            break;
+    }
+    n = *pnDone;
+    for (p = pcache1.pCacheList; p; p = p->pNextCache)
+    {
+        if (op == SQLITE_STATUS_PAGECACHE_HIT)
+        {
+            n += p->nHit;
+        }
+        else if (op == SQLITE_STATUS_PAGECACHE_MISS)
+        {
+            n += p->nMiss;
+        }
+        else
+        {
+            n += p->nTierHit;
+        }
+    }
+    if (bReset)
+    {
+        *pnDone -= n;
+    }
+    sqlite3_mutex_leave(pcache1.mutex);
+    *pnCount = (int)n;
+}
+
+/*
+** Remove the image of page iKey, if there is one, from the compressed tier
+** of cache p. The pager calls this when it changes the content of a page
+** that is not in the cache, as when a transaction is rolled back. This is
+** a no-op if the application has configured its own page cache.
+*/
+void sqlite3PCacheTierForget(sqlite3_pcache *p, unsigned int iKey)
+{
+    PCache1 *pCache = (PCache1 *)p;
+    if (sqlite3GlobalConfig.pcache2.xFetch == pcache1Fetch)
+    {
+        pcache1EnterMutex(pCache->pGroup);
+        if (pCache->pTier)
+        {
+            pcache1TierRemove(pCache, iKey);
+        }
+        pcache1LeaveMutex(pCache->pGroup);
+    }
+}
+
+/*
+** Return the number of page images in the compressed tier of cache p.
+*/
+int sqlite3PCacheTierCount(sqlite3_pcache *p)
+{
+    PCache1 *pCache = (PCache1 *)p;
+    int n = 0;
+    if (sqlite3GlobalConfig.pcache2.xFetch == pcache1Fetch)
+    {
+        pcache1EnterMutex(pCache->pGroup);
+        if (pCache->pTier)
+        {
+            n = (int)pCache->pTier->nLive;
+        }
+        pcache1LeaveMutex(pCache->pGroup);
+    }
+    return n;
+}
+
+/*
+** Invoke xIter(pArg, pPage) for each page held by cache p, in no
+** particular order. The PGroup mutex is held meanwhile, so xIter must not
+** call back into the page cache. If the application has configured its
+** own page cache, which has no way to list its pages, return
+** SQLITE_NOTFOUND without invoking xIter.
+*/
+int sqlite3PCacheIterate(
+    sqlite3_pcache *p,
+    void (*xIter)(void *, sqlite3_pcache_page *),
+    void *pArg
+)
+{
+    PCache1 *pCache = (PCache1 *)p;
+    unsigned int h;
+
+    if (sqlite3GlobalConfig.pcache2.xFetch != pcache1Fetch)
+    {
+        return SQLITE_NOTFOUND;
+    }
+    pcache1EnterMutex(pCache->pGroup);
+    for (h = 0; h < pCache->nHash; h++)
+    {
+        PgHdr1 *pPage;
+        for (pPage = pCache->apHash[h]; pPage; pPage = pPage->pNext)
+        {
+            xIter(pArg, &pPage->page);
+        }
+    }
+    pcache1LeaveMutex(pCache->pGroup);
+    return SQLITE_OK;
+}
+
+/*
+** Return true if page pPg, just added to the cache by xFetch, was restored
+** from the compressed tier of the cache. This is always false if the
+** application has configured its own page cache implementation.
+*/
+int sqlite3PcacheRestored(PgHdr *pPg)
+{
+    if (sqlite3GlobalConfig.pcache2.xFetch != pcache1Fetch) return 0;
+    return ((PgHdr1 *)pPg->pPage)->isRestored;
+}
+
 #ifdef SQLITE_TEST
 /*
 ** This function is used by test procedures to inspect the internal state
@@ -1132,13 +2181,28 @@ void sqlite3PcacheStats(
 {
     PgHdr1 *p;
     int nRecyclable = 0;
-    for (p = pcache1.grp.pLruHead; p; p = p->pLruNext)
+    int nCurrent = 0;
+    int nMax = 0;
+    int nMin = 0;
+    int i;
+    for (i = 0; i < pcache1.nGroup; i++)
     {
-        nRecyclable++;
+        PGroup *pGroup = &pcache1.aGroup[i];
+        for (p = pGroup->pLruHead; p; p = p->pLruNext)
+        {
+            nRecyclable++;
+        }
+        for (p = pGroup->pHotHead; p; p = p->pLruNext)
+        {
+            nRecyclable++;
+        }
+        nCurrent += pGroup->nCurrentPage;
+        nMax += (int)pGroup->nMaxPage;
+        nMin += (int)pGroup->nMinPage;
     }
-    *pnCurrent = pcache1.grp.nCurrentPage;
-    *pnMax = (int)pcache1.grp.nMaxPage;
-    *pnMin = (int)pcache1.grp.nMinPage;
+    *pnCurrent = nCurrent;
+    *pnMax = nMax;
+    *pnMin = nMin;
     *pnRecyclable = nRecyclable;
 }
 #endif
@@ -200,6 +200,7 @@ static int flagPragma(Parse *pParse, const char *zLeft, const char *zRight)
         { "count_changes",            SQLITE_CountRows     },
         { "empty_result_callbacks",   SQLITE_NullCallback  },
         { "legacy_file_format",       SQLITE_LegacyFileFmt },
+        { "prefix_compression",       SQLITE_PrefixIndex   },
         { "fullfsync",                SQLITE_FullFSync     },
         { "checkpoint_fullfsync",     SQLITE_CkptFullFSync },
         { "reverse_unordered_selects", SQLITE_ReverseOrder  },
@@ -867,6 +868,58 @@ void sqlite3Pragma(
                                             }
                                             else
 
+                                                /*
+                                                **  PRAGMA [database.]mmap_size
+                                                **  PRAGMA [database.]mmap_size=N
+                                                **
+                                                ** Used to set or query the mapping size limit. The mapping size limit is
+                                                ** used to limit the aggregate size of all memory mapped regions of the
+                                                ** database file. If this parameter is set to zero, then memory mapping
+                                                ** is not used at all.  If N is negative, then the default memory map
+                                                ** limit determined by sqlite3_config(SQLITE_CONFIG_MMAP_SIZE) is set.
+                                                ** The parameter N is measured in bytes.
+                                                **
+                                                ** This value is advisory.  The underlying VFS is free to memory map
+                                                ** as little or as much as it wants.  Except, if N is set to 0 then the
+                                                ** upper layers will never invoke the xFetch interfaces to the VFS.
+                                                */
+                                                if (sqlite3StrICmp(zLeft, "mmap_size") == 0)
+                                                {
+                                                    sqlite3_int64 sz;
+#if SQLITE_MAX_MMAP_SIZE>0
+                                                    assert(sqlite3SchemaMutexHeld(db, iDb, 0));
+                                                    if (zRight)
+                                                    {
+                                                        int ii;
+                                                        sqlite3Atoi64(zRight, &sz, sqlite3Strlen30(zRight), SQLITE_UTF8);
+                                                        if (sz < 0) sz = sqlite3GlobalConfig.szMmap;
+                                                        if (pId2->n == 0) db->szMmap = sz;
+                                                        for (ii = db->nDb - 1; ii >= 0; ii--)
+                                                        {
+                                                            if (db->aDb[ii].pBt && (ii == iDb || pId2->n == 0))
+                                                            {
+                                                                sqlite3BtreeSetMmapLimit(db->aDb[ii].pBt, sz);
+                                                            }
+                                                        }
+                                                    }
+                                                    sz = -1;
+                                                    rc = sqlite3_file_control(db, zDb, SQLITE_FCNTL_MMAP_SIZE, &sz);
+#else
+                                                    sz = 0;
+                                                    rc = SQLITE_OK;
+#endif
+                                                    if (rc == SQLITE_OK)
+                                                    {
+                                                        returnSingleInt(pParse, "mmap_size", sz);
+                                                    }
+                                                    else if (rc != SQLITE_NOTFOUND)
+                                                    {
+                                                        pParse->nErr++;
+                                                        pParse->rc = rc;
+                                                    }
+                                                }
+                                                else
+
                                                 /*
                                                 **   PRAGMA temp_store
                                                 **   PRAGMA temp_store = "default"|"memory"|"file"
@@ -1784,6 +1837,30 @@ void sqlite3Pragma(
                                                                                                                                                 SQLITE_PTR_TO_INT(db->pWalArg) : 0);
                                                                                                                             }
                                                                                                                             else
+
+                                                                                                                                /*
+                                                                                                                                **   PRAGMA [database.]wal_group_commit
+                                                                                                                                **   PRAGMA [database.]wal_group_commit = boolean
+                                                                                                                                **
+                                                                                                                                ** Query or set WAL group-commit mode. In this mode a commit that must
+                                                                                                                                ** be synced (synchronous=FULL) is synced after the WAL write lock is
+                                                                                                                                ** released, so that concurrent commits may share a single sync.
+                                                                                                                                **
+                                                                                                                                ** If the deferred sync fails, the commit fails with SQLITE_IOERR even
+                                                                                                                                ** though the transaction is committed and may be seen by later readers.
+                                                                                                                                */
+                                                                                                                                if (sqlite3StrICmp(zLeft, "wal_group_commit") == 0)
+                                                                                                                                {
+                                                                                                                                    Pager *pPager = sqlite3BtreePager(pDb->pBt);
+                                                                                                                                    int b = -1;
+                                                                                                                                    if (zRight)
+                                                                                                                                    {
+                                                                                                                                        b = sqlite3GetBoolean(zRight, 0);
+                                                                                                                                    }
+                                                                                                                                    b = sqlite3PagerWalGroupCommit(pPager, b);
+                                                                                                                                    returnSingleInt(pParse, "wal_group_commit", b);
+                                                                                                                                }
+                                                                                                                                else
 #endif
 
                                                                                                                                 /*
@@ -1798,6 +1875,27 @@ void sqlite3Pragma(
                                                                                                                                 }
                                                                                                                                 else
 
+                                                                                                                                /*
+                                                                                                                                **   PRAGMA [database.]cache_warmup
+                                                                                                                                **   PRAGMA [database.]cache_warmup = boolean
+                                                                                                                                **
+                                                                                                                                ** Query or set cache warm-up. While it is enabled, the numbers of the
+                                                                                                                                ** pages in the cache are saved to the file "<database>-warmup" when the
+                                                                                                                                ** database is closed. Enabling it loads the pages listed in that file
+                                                                                                                                ** into the cache, in the background if the connection is threadsafe.
+                                                                                                                                */
+                                                                                                                                if (sqlite3StrICmp(zLeft, "cache_warmup") == 0)
+                                                                                                                                {
+                                                                                                                                    int b = -1;
+                                                                                                                                    if (zRight)
+                                                                                                                                    {
+                                                                                                                                        b = sqlite3GetBoolean(zRight, 0);
+                                                                                                                                    }
+                                                                                                                                    b = (pDb->pBt ? sqlite3BtreeWarmup(pDb->pBt, b) : 0);
+                                                                                                                                    returnSingleInt(pParse, "cache_warmup", b);
+                                                                                                                                }
+                                                                                                                                else
+
 #if defined(SQLITE_DEBUG) || defined(SQLITE_TEST)
                                                                                                                                     /*
                                                                                                                                     ** Report the current state of file logs for all databases
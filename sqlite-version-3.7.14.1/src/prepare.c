@@ -351,6 +351,7 @@ static int sqlite3InitOne(sqlite3 *db, int iDb, char **pzErrMsg)
     ** file_format==2    Version 3.1.3.  // ALTER TABLE ADD COLUMN
     ** file_format==3    Version 3.1.4.  // ditto but with non-NULL defaults
     ** file_format==4    Version 3.3.0.  // DESC indices.  Boolean constants
+    ** file_format==5    Prefix-compressed index pages
     */
     pDb->pSchema->file_format = (u8)meta[BTREE_FILE_FORMAT - 1];
     if (pDb->pSchema->file_format == 0)
@@ -374,6 +375,14 @@ static int sqlite3InitOne(sqlite3 *db, int iDb, char **pzErrMsg)
         db->flags &= ~SQLITE_LegacyFileFmt;
     }
 
+    /* Likewise, a VACUUM of a database with prefix-compressed index pages
+    ** keeps them unless PRAGMA prefix_compression is turned off.
+    */
+    if (iDb == 0 && meta[BTREE_FILE_FORMAT - 1] >= SQLITE_PREFIX_FILE_FORMAT)
+    {
+        db->flags |= SQLITE_PrefixIndex;
+    }
+
     /* Read the schema information out of the schema tables
     ** 读取表信息
     */
@@ -496,6 +496,13 @@ static int sqliteProcessJoin(Parse *pParse, Select *p)
 /*
 ** Insert code into "v" that will push the record on the top of the
 ** stack into the sorter.
+**
+** If the SELECT has a LIMIT, only the first LIMIT+OFFSET records in sort
+** order are kept. A sorter is told how many that is when the first record
+** is inserted, and discards the others itself. Otherwise the last record
+** of the sorting index is deleted whenever it holds one record too many.
+** Either way the LIMIT counter is decremented for each record, as the
+** arms of a UNION ALL share it.
 */
 static void pushOntoSorter(
     Parse *pParse,         /* Parser context */
@@ -509,6 +516,7 @@ static void pushOntoSorter(
     int nExpr = pOrderBy->nExpr;
     int regBase = sqlite3GetTempRange(pParse, nExpr + 2);
     int regRecord = sqlite3GetTempReg(pParse);
+    int iLimit;            /* Register holding LIMIT+OFFSET, or 0 */
     int op;
     sqlite3ExprCacheClear(pParse);
     sqlite3ExprCodeExprList(pParse, pOrderBy, regBase, 0);
@@ -516,6 +524,14 @@ static void pushOntoSorter(
     sqlite3ExprCodeMove(pParse, regData, regBase + nExpr + 1, 1);
     /* 创建一条记录 */
     sqlite3VdbeAddOp3(v, OP_MakeRecord, regBase, nExpr + 2, regRecord);
+    if (pSelect->iOffset)
+    {
+        iLimit = pSelect->iOffset + 1;
+    }
+    else
+    {
+        iLimit = pSelect->iLimit;
+    }
     if (pSelect->selFlags & SF_UseSorter)
     {
         op = OP_SorterInsert;
@@ -524,28 +540,27 @@ static void pushOntoSorter(
     {
         op = OP_IdxInsert; /* 往临时表中插入一条记录 */
     }
-    sqlite3VdbeAddOp2(v, op, pOrderBy->iECursor, regRecord);
+    sqlite3VdbeAddOp3(v, op, pOrderBy->iECursor, regRecord,
+                      op == OP_SorterInsert ? iLimit : 0);
     sqlite3ReleaseTempReg(pParse, regRecord);
     sqlite3ReleaseTempRange(pParse, regBase, nExpr + 2);
-    if (pSelect->iLimit)
+    if (iLimit)
     {
         int addr1, addr2;
-        int iLimit;
-        if (pSelect->iOffset)
+        addr1 = sqlite3VdbeAddOp1(v, OP_IfZero, iLimit);
+        sqlite3VdbeAddOp2(v, OP_AddImm, iLimit, -1);
+        if (op == OP_IdxInsert)
         {
-            iLimit = pSelect->iOffset + 1;
+            addr2 = sqlite3VdbeAddOp0(v, OP_Goto);
+            sqlite3VdbeJumpHere(v, addr1);
+            sqlite3VdbeAddOp1(v, OP_Last, pOrderBy->iECursor);
+            sqlite3VdbeAddOp1(v, OP_Delete, pOrderBy->iECursor);
+            sqlite3VdbeJumpHere(v, addr2);
         }
         else
         {
-            iLimit = pSelect->iLimit;
+            sqlite3VdbeJumpHere(v, addr1);
         }
-        addr1 = sqlite3VdbeAddOp1(v, OP_IfZero, iLimit);
-        sqlite3VdbeAddOp2(v, OP_AddImm, iLimit, -1);
-        addr2 = sqlite3VdbeAddOp0(v, OP_Goto);
-        sqlite3VdbeJumpHere(v, addr1);
-        sqlite3VdbeAddOp1(v, OP_Last, pOrderBy->iECursor);
-        sqlite3VdbeAddOp1(v, OP_Delete, pOrderBy->iECursor);
-        sqlite3VdbeJumpHere(v, addr2);
     }
 }
 
@@ -4582,7 +4597,11 @@ int sqlite3Select(
     iEnd = sqlite3VdbeMakeLabel(v);
     p->nSelectRow = (double)LARGEST_INT64;
     computeLimitRegisters(pParse, p, iEnd);
+#ifdef SQLITE_OMIT_MERGE_SORT
     if (p->iLimit == 0 && addrSortIndex >= 0)
+#else
+    if (addrSortIndex >= 0)
+#endif
     {
         sqlite3VdbeGetOp(v, addrSortIndex)->opcode = OP_SorterOpen;
         p->selFlags |= SF_UseSorter;
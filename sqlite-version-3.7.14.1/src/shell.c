@@ -1292,6 +1292,8 @@ static int display_stats(
         fprintf(pArg->out, "Sort Operations:                     %d\n", iCur);
         iCur = sqlite3_stmt_status(pArg->pStmt, SQLITE_STMTSTATUS_AUTOINDEX, bReset);
         fprintf(pArg->out, "Autoindex Inserts:                   %d\n", iCur);
+        iCur = sqlite3_stmt_status(pArg->pStmt, SQLITE_STMTSTATUS_RESEEK, bReset);
+        fprintf(pArg->out, "Re-seek Descents Saved:              %d\n", iCur);
     }
 
     return 0;
@@ -478,6 +478,7 @@ SQLITE_API int sqlite3_exec(
 #define SQLITE_IOERR_SEEK              (SQLITE_IOERR | (22<<8))
 #define SQLITE_LOCKED_SHAREDCACHE      (SQLITE_LOCKED |  (1<<8))
 #define SQLITE_BUSY_RECOVERY           (SQLITE_BUSY   |  (1<<8))
+#define SQLITE_BUSY_SNAPSHOT           (SQLITE_BUSY   |  (2<<8))
 #define SQLITE_CANTOPEN_NOTEMPDIR      (SQLITE_CANTOPEN | (1<<8))
 #define SQLITE_CANTOPEN_ISDIR          (SQLITE_CANTOPEN | (2<<8))
 #define SQLITE_CORRUPT_VTAB            (SQLITE_CORRUPT | (1<<8))
@@ -697,6 +698,24 @@ struct sqlite3_file /* sqlite对文件的抽象 */
 ** information is written to disk in the same order as calls
 ** to xWrite().
 **
+** The xFetch() method, available when iVersion is 3 or more, requests
+** a pointer directly into a memory mapping of iAmt bytes of the file
+** starting at offset iOfst.  ^If the requested range cannot be mapped,
+** xFetch() sets *pp to NULL and returns SQLITE_OK, and SQLite falls back
+** to reading the content with xRead().  Each non-NULL pointer returned by
+** xFetch() must eventually be released by a call to xUnfetch() with the
+** same offset.  ^Calling xUnfetch() with a NULL pointer asks the VFS to
+** discard its mapping of the file; SQLite only does this when it holds
+** no outstanding xFetch() references.
+**
+** The xReadv() method, available when iVersion is 4 or more, fills the
+** nBuf buffers in apBuf[], each szBuf bytes in size, with consecutive
+** data read from the file starting at offset iOfst, using a single
+** vectored read where the operating system provides one.  ^SQLite uses
+** xReadv() only to read database pages ahead of need, so a VFS may return
+** [SQLITE_NOTFOUND] for any request it prefers not to handle.  ^Short
+** reads are reported and zero-filled as for xRead().
+**
 ** If xRead() returns SQLITE_IOERR_SHORT_READ it must also fill
 ** in the unread portions of the buffer with zeros.  A VFS that
 ** fails to zero-fill short reads might seem to work.  However,
@@ -725,6 +744,12 @@ struct sqlite3_io_methods /* io的操作方法 */
     void (*xShmBarrier)(sqlite3_file*);
     int (*xShmUnmap)(sqlite3_file*, int deleteFlag);
     /* Methods above are valid for version 2 */
+    int (*xFetch)(sqlite3_file*, sqlite3_int64 iOfst, int iAmt, void **pp);
+    int (*xUnfetch)(sqlite3_file*, sqlite3_int64 iOfst, void *p);
+    /* Methods above are valid for version 3 */
+  int (*xReadv)(sqlite3_file*, sqlite3_int64 iOfst, int szBuf, int nBuf,
+                void **apBuf);
+  /* Methods above are valid for version 4 */
     /* Additional methods may be added in future releases */
 };
 
@@ -859,6 +884,53 @@ struct sqlite3_io_methods /* io的操作方法 */
 ** compilation of the PRAGMA fails with an error.  ^The [SQLITE_FCNTL_PRAGMA]
 ** file control occurs at the beginning of pragma statement analysis and so
 ** it is able to override built-in [PRAGMA] statements.
+**
+** <li>[[SQLITE_FCNTL_MMAP_SIZE]]
+** ^The [SQLITE_FCNTL_MMAP_SIZE] file control is used to query or set the
+** maximum number of bytes of the database file that the VFS may map into
+** memory to satisfy xFetch() requests.  ^The argument is a pointer to a
+** value of type sqlite3_int64.  ^If that value is non-negative it becomes
+** the new limit, capped at the ceiling set by [SQLITE_CONFIG_MMAP_SIZE].
+** ^In all cases the previous limit is written back into the
+** sqlite3_int64 before returning.  Applications normally adjust the limit
+** with the [PRAGMA mmap_size] statement rather than with this opcode.
+**
+** <li>[[SQLITE_FCNTL_WRITE_BATCH_BEGIN]]
+** [[SQLITE_FCNTL_WRITE_BATCH_END]]
+** ^The [SQLITE_FCNTL_WRITE_BATCH_BEGIN] and [SQLITE_FCNTL_WRITE_BATCH_END]
+** file controls bracket a run of xWrite() calls that SQLite issues back to
+** back, such as the pages written to the database file at commit or the
+** frames appended to a WAL file.  ^A VFS may hold writes made between the
+** two calls and submit them together, provided that data written is
+** visible to any subsequent xRead(), xSync(), xTruncate() or xFileSize()
+** on the same file and reaches the file no later than the
+** [SQLITE_FCNTL_WRITE_BATCH_END] call.  ^Errors from writes that were
+** deferred are reported by whichever of those calls submits them.  ^For
+** [SQLITE_FCNTL_WRITE_BATCH_END], the argument is either NULL or a pointer
+** to an integer into which the VFS writes the result code of the final
+** submission.  ^SQLite passes both opcodes as hints, so a VFS that does
+** not batch writes can simply return [SQLITE_NOTFOUND].
+**
+** <li>[[SQLITE_FCNTL_WAL_SYNC_BEGIN]]
+** [[SQLITE_FCNTL_WAL_SYNC_END]]
+** ^In [PRAGMA wal_group_commit | WAL group-commit mode], SQLite sends the
+** [SQLITE_FCNTL_WAL_SYNC_BEGIN] file control to the database file before
+** syncing the WAL file at the end of a transaction, so that the VFS can
+** let several connections share a single sync.  ^The argument is an
+** array of two integers.  ^The first holds the flags that would be passed
+** to xSync() and the second is set to -1 by SQLite.  ^If the VFS can
+** guarantee that a sync of the WAL file begun after the call has already
+** completed, it stores the result code of that sync in the second integer
+** and SQLite does not sync the WAL file itself.  ^Otherwise SQLite syncs
+** the WAL file and then sends [SQLITE_FCNTL_WAL_SYNC_END] to the database
+** file, with a pointer to the integer result code of the sync as the
+** argument.  ^A VFS that does not coordinate syncs can ignore both opcodes.
+**
+** ^In group-commit mode the WAL file is synced after the write lock is
+** released, so a new transaction is visible to other connections before
+** it is durable.  ^If the sync fails, COMMIT returns an [SQLITE_IOERR]
+** error code even though the transaction is committed and may already
+** have been read by other connections.
 ** </ul>
 */
 #define SQLITE_FCNTL_LOCKSTATE               1
@@ -875,6 +947,11 @@ struct sqlite3_io_methods /* io的操作方法 */
 #define SQLITE_FCNTL_VFSNAME                12
 #define SQLITE_FCNTL_POWERSAFE_OVERWRITE    13
 #define SQLITE_FCNTL_PRAGMA                 14
+#define SQLITE_FCNTL_MMAP_SIZE              15
+#define SQLITE_FCNTL_WRITE_BATCH_BEGIN      16
+#define SQLITE_FCNTL_WRITE_BATCH_END        17
+#define SQLITE_FCNTL_WAL_SYNC_BEGIN         18
+#define SQLITE_FCNTL_WAL_SYNC_END           19
 
 /*
 ** CAPI3REF: Mutex Handle
@@ -1573,6 +1650,80 @@ struct sqlite3_mem_methods
 ** disabled. The default value may be changed by compiling with the
 ** [SQLITE_USE_URI] symbol defined.
 **
+** [[SQLITE_CONFIG_MMAP_SIZE]] <dt>SQLITE_CONFIG_MMAP_SIZE
+** <dd> This option takes two arguments of type sqlite3_int64.  ^The first
+** is the default number of bytes of each database file that may be
+** memory mapped and read directly, without copying, by new database
+** connections.  ^The second is the hard upper limit on that value; no
+** connection may raise its limit above it using [PRAGMA mmap_size].
+** ^A negative value for either argument selects its compile-time default.
+** ^If the default is larger than the upper limit, it is silently reduced
+** to the upper limit.  ^The compile-time defaults are
+** [SQLITE_DEFAULT_MMAP_SIZE] and [SQLITE_MAX_MMAP_SIZE].  ^Memory mapped
+** reads are disabled by default.
+**
+** [[SQLITE_CONFIG_PCACHE_SHARDS]] <dt>SQLITE_CONFIG_PCACHE_SHARDS
+** <dd> This option takes a single argument of type int, N.  ^If N is
+** greater than zero, all page caches created by the default page cache
+** implementation share their unpinned pages, as they do in builds with
+** [SQLITE_ENABLE_MEMORY_MANAGEMENT], but the shared pool is split into N
+** shards, each with its own mutex and LRU list.  ^Each page cache belongs
+** to a single shard, so connections using different shards do not contend
+** for a mutex when fetching or releasing pages.  ^The sum of the
+** [PRAGMA cache_size | cache_size] limits remains the bound on the total
+** number of pages held, and [sqlite3_release_memory()] frees pages from
+** every shard.  ^If N is zero the page cache behaves as it does by default.
+** ^A negative N selects the compile-time default, which is zero unless
+** SQLITE_DEFAULT_PCACHE_SHARDS is defined.  ^N is silently reduced to
+** SQLITE_MAX_PCACHE_SHARDS (default 16) if it is larger.
+**
+** [[SQLITE_CONFIG_PCACHE_POLICY]] <dt>SQLITE_CONFIG_PCACHE_POLICY
+** <dd> This option takes a single argument of type int, which selects the
+** page replacement policy used by the default page cache implementation.
+** ^With [SQLITE_PCACHE_POLICY_LRU], the default, the least recently used
+** unpinned page is recycled first.  ^With [SQLITE_PCACHE_POLICY_2Q], a
+** page read into the cache is only considered hot if it is needed again
+** soon after being recycled, and pages that are not hot are recycled
+** first, so that a scan of a large table does not displace the working
+** set of other queries.  ^The [SQLITE_STATUS_PAGECACHE_HIT] and
+** [SQLITE_STATUS_PAGECACHE_MISS] counters may be used to compare the
+** policies under the same workload.
+**
+** [[SQLITE_CONFIG_PAGECACHE_HUGEPAGE]] <dt>SQLITE_CONFIG_PAGECACHE_HUGEPAGE
+** <dd> This option is like [SQLITE_CONFIG_PAGECACHE], except that instead
+** of using a buffer supplied by the application, the default page cache
+** implementation maps an arena for the N page buffers of sz bytes each
+** when SQLite is initialized, and unmaps it when SQLite is shut down.
+** ^There are two arguments of type int: the size of each page buffer (sz)
+** and the number of page buffers (N).  ^If N is zero or negative, the
+** arena holds [SQLITE_DEFAULT_CACHE_SIZE] pages.  The arena is made up
+** of whole 2MiB huge pages.  ^Explicit huge pages (MAP_HUGETLB) are used
+** if the system has any available.  ^Otherwise the arena is mapped with
+** ordinary pages, aligned so that transparent huge pages may be used for
+** it.  ^If the arena cannot be mapped at all, or on systems without
+** mmap(), page buffers are obtained from [sqlite3_malloc()] as usual.
+** ^As with [SQLITE_CONFIG_PAGECACHE], the arena is used for the first N
+** pages added to the cache, freed page buffers are reused, and it is
+** reported by the SQLITE_STATUS_PAGECACHE_* values of [sqlite3_status()].
+** ^This option is ignored if a buffer has also been supplied using
+** [SQLITE_CONFIG_PAGECACHE].  ^Passing an sz of zero disables it.
+**
+** [[SQLITE_CONFIG_PCACHE_TIER]] <dt>SQLITE_CONFIG_PCACHE_TIER
+** <dd> This option takes a single argument of type int, N.  ^If N is
+** greater than zero, each page cache created by the default page cache
+** implementation keeps a second, compressed tier of up to N percent of
+** the memory used by [PRAGMA cache_size | cache_size] pages.  ^Clean
+** pages recycled from the cache are compressed into the tier, and a page
+** that is not in the cache is restored from the tier, if it is there,
+** rather than read from the database file.  ^When the tier is full, the
+** pages compressed into it longest ago are discarded.  ^Pages that do not
+** compress to less than 7/8 of their size are not kept.  ^The tier is
+** allocated when the cache_size of a cache is set.  ^The
+** [SQLITE_STATUS_PAGECACHE_TIER_USED] and [SQLITE_STATUS_PAGECACHE_TIER_HIT]
+** values of [sqlite3_status()] report its use.  ^If N is zero, the
+** default, there is no compressed tier.  ^A negative N selects the
+** compile-time default, SQLITE_DEFAULT_PCACHE_TIER.
+**
 ** [[SQLITE_CONFIG_PCACHE]] [[SQLITE_CONFIG_GETPCACHE]]
 ** <dt>SQLITE_CONFIG_PCACHE and SQLITE_CONFIG_GETPCACHE
 ** <dd> These options are obsolete and should not be used by new code.
@@ -1598,6 +1749,20 @@ struct sqlite3_mem_methods
 #define SQLITE_CONFIG_URI          17  /* int */
 #define SQLITE_CONFIG_PCACHE2      18  /* sqlite3_pcache_methods2* */
 #define SQLITE_CONFIG_GETPCACHE2   19  /* sqlite3_pcache_methods2* */
+#define SQLITE_CONFIG_MMAP_SIZE    20  /* sqlite3_int64, sqlite3_int64 */
+#define SQLITE_CONFIG_PCACHE_SHARDS 21 /* int */
+#define SQLITE_CONFIG_PCACHE_POLICY 22 /* int */
+#define SQLITE_CONFIG_PAGECACHE_HUGEPAGE 23 /* int sz, int N */
+#define SQLITE_CONFIG_PCACHE_TIER  24  /* int */
+
+/*
+** CAPI3REF: Page Cache Replacement Policies
+**
+** These constants are the page replacement policies that may be selected
+** for the default page cache using [SQLITE_CONFIG_PCACHE_POLICY].
+*/
+#define SQLITE_PCACHE_POLICY_LRU   0
+#define SQLITE_PCACHE_POLICY_2Q    1
 
 /*
 ** CAPI3REF: Database Connection Configuration Options
@@ -5992,6 +6157,30 @@ SQLITE_API int sqlite3_status(int op, int *pCurrent, int *pHighwater, int resetF
 ** [[SQLITE_STATUS_PARSER_STACK]] ^(<dt>SQLITE_STATUS_PARSER_STACK</dt>
 ** <dd>This parameter records the deepest parser stack.  It is only
 ** meaningful if SQLite is compiled with [YYTRACKMAXSTACKDEPTH].</dd>)^
+**
+** [[SQLITE_STATUS_PAGECACHE_HIT]] ^(<dt>SQLITE_STATUS_PAGECACHE_HIT</dt>
+** <dd>This parameter returns the number of times a page was found in the
+** default page cache.</dd>)^
+**
+** [[SQLITE_STATUS_PAGECACHE_MISS]] ^(<dt>SQLITE_STATUS_PAGECACHE_MISS</dt>
+** <dd>This parameter returns the number of pages added to the default
+** page cache because they were not already in it.</dd>)^
+**
+** [[SQLITE_STATUS_PAGECACHE_TIER_USED]] ^(<dt>SQLITE_STATUS_PAGECACHE_TIER_USED</dt>
+** <dd>This parameter returns the number of bytes of compressed page images
+** held in the compressed tiers of the default page cache.  See
+** [SQLITE_CONFIG_PCACHE_TIER].</dd>)^
+**
+** [[SQLITE_STATUS_PAGECACHE_TIER_HIT]] ^(<dt>SQLITE_STATUS_PAGECACHE_TIER_HIT</dt>
+** <dd>This parameter returns the number of pages added to the default
+** page cache that were restored from its compressed tier rather than
+** read from the database file.  It is a subset of the
+** SQLITE_STATUS_PAGECACHE_MISS count.</dd>)^
+**
+** ^For SQLITE_STATUS_PAGECACHE_HIT, SQLITE_STATUS_PAGECACHE_MISS and
+** SQLITE_STATUS_PAGECACHE_TIER_HIT the highwater mark is always zero, and
+** the resetFlag resets the count itself to zero.  ^These counts are reset
+** when the library is [sqlite3_initialize | initialized].
 ** </dl>
 **
 ** New status parameters may be added from time to time.
@@ -6006,6 +6195,10 @@ SQLITE_API int sqlite3_status(int op, int *pCurrent, int *pHighwater, int resetF
 #define SQLITE_STATUS_PAGECACHE_SIZE       7
 #define SQLITE_STATUS_SCRATCH_SIZE         8
 #define SQLITE_STATUS_MALLOC_COUNT         9
+#define SQLITE_STATUS_PAGECACHE_HIT       10
+#define SQLITE_STATUS_PAGECACHE_MISS      11
+#define SQLITE_STATUS_PAGECACHE_TIER_USED 12
+#define SQLITE_STATUS_PAGECACHE_TIER_HIT  13
 
 /*
 ** CAPI3REF: Database Connection Status
@@ -6113,6 +6306,26 @@ SQLITE_API int sqlite3_db_status(sqlite3*, int op, int *pCur, int *pHiwtr, int r
 ** on subsequent SQLITE_DBSTATUS_CACHE_WRITE requests is undefined.)^ ^The
 ** highwater mark associated with SQLITE_DBSTATUS_CACHE_WRITE is always 0.
 ** </dd>
+**
+** [[SQLITE_DBSTATUS_WAL_WRITE]] ^(<dt>SQLITE_DBSTATUS_WAL_WRITE</dt>
+** <dd>This parameter returns the number of write operations used to append
+** frames to wal files.)^ Frames are staged in memory and appended several
+** at a time, so this is normally much smaller than the number of frames
+** written. ^The highwater value associated with SQLITE_DBSTATUS_WAL_WRITE
+** is not a highwater mark but the total number of frames appended by
+** those write operations, so that dividing it by the current value gives
+** the average number of frames per write.
+** </dd>
+**
+** [[SQLITE_DBSTATUS_WAL_CHECKPOINT]] ^(<dt>SQLITE_DBSTATUS_WAL_CHECKPOINT</dt>
+** <dd>This parameter returns the number of pages that checkpoints run by
+** the database connection have copied from wal files back into database
+** files.)^ ^The highwater mark associated with
+** SQLITE_DBSTATUS_WAL_CHECKPOINT is the throughput of the most recent of
+** those checkpoints, in pages per second.  Checkpoints run by a
+** [sqlite3_wal_checkpoint_thread | background checkpointer] are not
+** counted.
+** </dd>
 ** </dl>
 */
 #define SQLITE_DBSTATUS_LOOKASIDE_USED       0
@@ -6125,7 +6338,9 @@ SQLITE_API int sqlite3_db_status(sqlite3*, int op, int *pCur, int *pHiwtr, int r
 #define SQLITE_DBSTATUS_CACHE_HIT            7
 #define SQLITE_DBSTATUS_CACHE_MISS           8
 #define SQLITE_DBSTATUS_CACHE_WRITE          9
-#define SQLITE_DBSTATUS_MAX                  9   /* Largest defined DBSTATUS */
+#define SQLITE_DBSTATUS_WAL_WRITE           10
+#define SQLITE_DBSTATUS_WAL_CHECKPOINT      11
+#define SQLITE_DBSTATUS_MAX                 11   /* Largest defined DBSTATUS */
 
 
 /*
@@ -6179,11 +6394,19 @@ SQLITE_API int sqlite3_stmt_status(sqlite3_stmt*, int op, int resetFlg);
 ** A non-zero value in this counter may indicate an opportunity to
 ** improvement performance by adding permanent indices that do not
 ** need to be reinitialized each time the statement is run.</dd>
+**
+** [[SQLITE_STMTSTATUS_RESEEK]] <dt>SQLITE_STMTSTATUS_RESEEK</dt>
+** <dd>^This is the number of b-tree page descents saved by seeks that
+** started from the page a cursor was already on, or one of its parents,
+** rather than from the root page.  It is updated as each cursor of the
+** statement is closed.  A large value shows that lookups are made in
+** nearly sorted order.</dd>
 ** </dl>
 */
 #define SQLITE_STMTSTATUS_FULLSCAN_STEP     1
 #define SQLITE_STMTSTATUS_SORT              2
 #define SQLITE_STMTSTATUS_AUTOINDEX         3
+#define SQLITE_STMTSTATUS_RESEEK            4
 
 /*
 ** CAPI3REF: Custom Page Cache Object
@@ -6952,6 +7175,51 @@ SQLITE_API int sqlite3_wal_checkpoint_v2(
 #define SQLITE_CHECKPOINT_FULL    1
 #define SQLITE_CHECKPOINT_RESTART 2
 
+/*
+** CAPI3REF: Background Checkpoints
+**
+** ^The sqlite3_wal_checkpoint_thread(D,S,N,R,F) interface hands
+** checkpointing of database S on [database connection] D over to a
+** background thread. ^If S is NULL or a zero-length string, all attached
+** databases are configured.
+**
+** ^When N is greater than zero, a thread is started for the database file
+** if one is not already running in the same process. ^Whenever a
+** transaction committed through D leaves N or more frames in the WAL file
+** that have not yet been copied back into the database, the thread runs a
+** [sqlite3_wal_checkpoint_v2|PASSIVE checkpoint]. ^The checkpoint writes
+** no more than R pages per second to the database file, or is not rate
+** limited if R is zero or less, and syncs the database file according to F,
+** which must be 0 (no sync), [SQLITE_SYNC_NORMAL] or [SQLITE_SYNC_FULL].
+** ^While the thread is active, the checkpoint that would otherwise be run
+** by the committing connection (see [sqlite3_wal_autocheckpoint()]) is
+** skipped, so commits do not wait for checkpoints.
+**
+** ^All connections in the same process that enable background checkpoints
+** on the same database file share a single thread, which uses the
+** settings most recently passed to this interface. ^The thread holds a
+** read lock on the database file, like any other connection, and stops
+** once no connection is using it. ^Passing N as zero or less detaches
+** connection D from the thread.
+**
+** ^The settings are retained while the database is not in WAL mode and
+** take effect when it is next switched to WAL mode. ^Background
+** checkpoints are not available for databases in [locking_mode|exclusive
+** locking mode].
+**
+** ^SQLITE_ERROR is returned if S is not the name of an attached database,
+** or if N is greater than zero and the library was built or configured
+** without thread support. ^SQLITE_MISUSE is returned if F is not one of
+** the values listed above.
+*/
+SQLITE_API int sqlite3_wal_checkpoint_thread(
+  sqlite3 *db,                    /* Database handle */
+  const char *zDb,                /* Name of attached database (or NULL) */
+  int nFrame,                     /* Checkpoint threshold, or 0 to disable */
+  int nPagePerSec,                /* Maximum pages written per second */
+  int eSync                       /* 0, SQLITE_SYNC_NORMAL or SQLITE_SYNC_FULL */
+);
+
 /*
 ** CAPI3REF: Virtual Table Interface Configuration
 **
@@ -368,8 +368,12 @@ void sqlite3Coverage(int);
 ** the VDBE-level file format changes.  The following macros define the
 ** the default file format for new databases and the maximum file format
 ** that the library can read.
+**
+** File format 5 is only written when PRAGMA prefix_compression is on.  It
+** is format 4 plus index b-tree pages that may be prefix-compressed.
 */
-#define SQLITE_MAX_FILE_FORMAT 4
+#define SQLITE_MAX_FILE_FORMAT 5
+#define SQLITE_PREFIX_FILE_FORMAT 5
 #ifndef SQLITE_DEFAULT_FILE_FORMAT
 # define SQLITE_DEFAULT_FILE_FORMAT 4
 #endif
@@ -382,6 +386,79 @@ void sqlite3Coverage(int);
 # define SQLITE_DEFAULT_RECURSIVE_TRIGGERS 0
 #endif
 
+/*
+** Default and maximum number of bytes of each database file that may be
+** read through a memory mapping (see SQLITE_CONFIG_MMAP_SIZE and
+** PRAGMA mmap_size).  Memory mapped reads are only compiled in on
+** platforms known to support them, and are disabled at run-time unless
+** SQLITE_DEFAULT_MMAP_SIZE is set or the application enables them.
+*/
+#ifndef SQLITE_MAX_MMAP_SIZE
+# if defined(__linux__) || (defined(__APPLE__) && defined(__MACH__)) \
+     || defined(__sun) || defined(__FreeBSD__)
+#   define SQLITE_MAX_MMAP_SIZE 0x7fff0000  /* 2147418112 */
+# else
+#   define SQLITE_MAX_MMAP_SIZE 0
+# endif
+#endif
+#ifndef SQLITE_DEFAULT_MMAP_SIZE
+# define SQLITE_DEFAULT_MMAP_SIZE 0
+#endif
+#if SQLITE_DEFAULT_MMAP_SIZE>SQLITE_MAX_MMAP_SIZE
+# undef SQLITE_DEFAULT_MMAP_SIZE
+# define SQLITE_DEFAULT_MMAP_SIZE SQLITE_MAX_MMAP_SIZE
+#endif
+
+/*
+** Default and maximum number of shards the global page-cache group is
+** split into (see SQLITE_CONFIG_PCACHE_SHARDS).  A default of zero means
+** the page cache picks between private and shared groups as it always
+** has.
+*/
+#ifndef SQLITE_MAX_PCACHE_SHARDS
+# define SQLITE_MAX_PCACHE_SHARDS 16
+#endif
+#ifndef SQLITE_DEFAULT_PCACHE_SHARDS
+# define SQLITE_DEFAULT_PCACHE_SHARDS 0
+#endif
+#if SQLITE_DEFAULT_PCACHE_SHARDS>SQLITE_MAX_PCACHE_SHARDS
+# undef SQLITE_DEFAULT_PCACHE_SHARDS
+# define SQLITE_DEFAULT_PCACHE_SHARDS SQLITE_MAX_PCACHE_SHARDS
+#endif
+
+/*
+** Default page replacement policy of the page cache (see
+** SQLITE_CONFIG_PCACHE_POLICY).
+*/
+#ifndef SQLITE_DEFAULT_PCACHE_POLICY
+# define SQLITE_DEFAULT_PCACHE_POLICY SQLITE_PCACHE_POLICY_LRU
+#endif
+
+/*
+** Default size of the compressed tier of each page cache, as a percentage
+** of the memory used by its cache_size pages (see SQLITE_CONFIG_PCACHE_TIER).
+*/
+#ifndef SQLITE_DEFAULT_PCACHE_TIER
+# define SQLITE_DEFAULT_PCACHE_TIER 0
+#endif
+
+/*
+** Number of read-mark slots in the wal-index, and so the number of
+** different snapshots that readers of a WAL database may be using at
+** once.  The default of 5 gives the standard wal-index layout.  Larger
+** values select an extended layout with a different version number, which
+** builds using any other value refuse to open, so every process that
+** opens a database must be built with the same value.  SQLITE_WAL_NLOCK
+** is the number of shared-memory locks (see xShmLock) this requires.
+*/
+#ifndef SQLITE_WAL_NREADER
+# define SQLITE_WAL_NREADER 5
+#endif
+#if SQLITE_WAL_NREADER<5 || SQLITE_WAL_NREADER>29
+# error "SQLITE_WAL_NREADER must be between 5 and 29"
+#endif
+#define SQLITE_WAL_NLOCK (SQLITE_WAL_NREADER+3)
+
 /*
 ** Provide a default value for SQLITE_TEMP_STORE in case it is not specified
 ** on the command-line
@@ -664,6 +741,9 @@ typedef struct RowSet RowSet;
 typedef struct Savepoint Savepoint;
 typedef struct Select Select;
 typedef struct SrcList SrcList;
+typedef struct SQLiteCond SQLiteCond;
+typedef struct SQLiteThread SQLiteThread;
+typedef struct SQLiteThreadPool SQLiteThreadPool;
 typedef struct StrAccum StrAccum;
 typedef struct Table Table;
 typedef struct TableLock TableLock;
@@ -692,6 +772,14 @@ typedef struct WhereLevel WhereLevel;
 #include "os.h"
 #include "mutex.h"
 
+/*
+** The thread, condition variable and worker pool interfaces of threads.c
+** are only implemented for threadsafe builds that use pthreads.
+*/
+#if SQLITE_OS_UNIX && defined(SQLITE_MUTEX_PTHREADS) && SQLITE_THREADSAFE>0
+# define SQLITE_THREADS_IMPLEMENTED 1
+#endif
+
 
 /*
 ** Each database file to be accessed by the system is an instance
@@ -835,6 +923,7 @@ struct sqlite3
     int errCode;                  /* Most recent error code (SQLITE_*) */
     int errMask;                  /* & result codes with this before returning */
     u8 autoCommit;                /* The auto-commit flag. */
+    u8 bConcurrent;               /* Last BEGIN was BEGIN CONCURRENT */
     u8 temp_store;                /* 1: file 2: memory 0: default */
     u8 mallocFailed;              /* True if we have seen a malloc failure */
     u8 dfltLockMode;              /* Default locking-mode for attached dbs */
@@ -843,6 +932,7 @@ struct sqlite3
     u8 vtabOnConflict;            /* Value to return for s3_vtab_on_conflict() */
     u8 isTransactionSavepoint;    /* True if the outermost savepoint is a TS */
     int nextPagesize;             /* Pagesize after VACUUM if >0 */
+    i64 szMmap;                   /* Default mmap_size setting */
     u32 magic;                    /* Magic number for detect library misuse */
     int nChange;                  /* Value returned by sqlite3_changes() */
     int nTotalChange;             /* Value returned by sqlite3_total_changes() */
@@ -957,7 +1047,7 @@ struct sqlite3
 #define SQLITE_SqlTrace       0x00004000  /* Debug print SQL as it executes */
 #define SQLITE_VdbeListing    0x00008000  /* Debug listings of VDBE programs */
 #define SQLITE_WriteSchema    0x00010000  /* OK to update SQLITE_MASTER */
-/*   0x00020000  Unused */
+#define SQLITE_PrefixIndex    0x00020000  /* Create databases in format 5 */
 #define SQLITE_IgnoreChecks   0x00040000  /* Do not enforce check constraints */
 #define SQLITE_ReadUncommitted 0x0080000  /* For shared-cache mode */
 #define SQLITE_LegacyFileFmt  0x00100000  /* Create new databases in format 1 */
@@ -2445,6 +2535,7 @@ struct AuthContext
 #define OPFLAG_TYPEOFARG     0x80    /* OP_Column only used for typeof() */
 #define OPFLAG_BULKCSR       0x01    /* OP_Open** used to open bulk cursor */
 #define OPFLAG_P2ISREG       0x02    /* P2 to OP_Open** is a register number */
+#define OPFLAG_BULKINSERT    0x01    /* OP_IdxInsert keys arrive in order */
 
 /*
  * Each trigger present in the database schema is stored as an instance of
@@ -2609,6 +2700,13 @@ struct Sqlite3Config
     int nPage;                        /* Number of pages in pPage[] */
     int mxParserStack;                /* maximum depth of the parser stack */
     int sharedCacheEnabled;           /* true if shared-cache mode enabled */
+    sqlite3_int64 szMmap;             /* mmap() space per open file */
+    sqlite3_int64 mxMmap;             /* Maximum value for szMmap */
+    int nPcacheShard;                 /* Shards in the global page-cache group */
+    int ePcachePolicy;                /* SQLITE_PCACHE_POLICY_* value */
+    int szHugePage;                   /* Size of each page in the huge-page arena */
+    int nHugePage;                    /* Number of pages in the huge-page arena */
+    int nPcacheTier;                  /* Compressed tier size, percent of cache */
     /* The above might be initialized to non-zero.  The following need to always
     ** initially be zero, however. */
     int isInit;                       /* True after initialization has finished */
@@ -2785,6 +2883,26 @@ int sqlite3MutexInit(void);
 int sqlite3MutexEnd(void);
 #endif
 
+#ifdef SQLITE_THREADS_IMPLEMENTED
+int sqlite3ThreadCreate(SQLiteThread**, void*(*)(void*), void*);
+int sqlite3ThreadJoin(SQLiteThread*, void**);
+SQLiteCond *sqlite3CondAlloc(void);
+void sqlite3CondFree(SQLiteCond*);
+void sqlite3CondEnter(SQLiteCond*);
+void sqlite3CondLeave(SQLiteCond*);
+void sqlite3CondWait(SQLiteCond*, int);
+void sqlite3CondSignal(SQLiteCond*);
+void sqlite3CondBroadcast(SQLiteCond*);
+int sqlite3ThreadPoolCreate(SQLiteThreadPool**, int, int,
+                            void(*)(void*, int, void**), void*);
+void sqlite3ThreadPoolFree(SQLiteThreadPool*);
+int sqlite3ThreadPoolThreads(SQLiteThreadPool*);
+int sqlite3ThreadPoolJobs(SQLiteThreadPool*);
+int sqlite3ThreadPoolNext(SQLiteThreadPool*);
+void sqlite3ThreadPoolSubmit(SQLiteThreadPool*);
+int sqlite3ThreadPoolRetire(SQLiteThreadPool*, int);
+#endif
+
 int sqlite3StatusValue(int);
 void sqlite3StatusAdd(int, int);
 void sqlite3StatusSet(int, int);
@@ -3137,6 +3255,7 @@ const char *sqlite3ErrStr(int);
 int sqlite3ReadSchema(Parse *pParse);
 CollSeq *sqlite3FindCollSeq(sqlite3*, u8 enc, const char*, int);
 CollSeq *sqlite3LocateCollSeq(Parse *pParse, const char*zName);
+int sqlite3IsBinary(const CollSeq*);
 CollSeq *sqlite3ExprCollSeq(Parse *pParse, Expr *pExpr);
 Expr *sqlite3ExprSetColl(Expr*, CollSeq*);
 Expr *sqlite3ExprSetCollByToken(Parse *pParse, Expr*, Token*);
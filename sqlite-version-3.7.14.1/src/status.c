@@ -22,8 +22,8 @@
 typedef struct sqlite3StatType sqlite3StatType;
 static SQLITE_WSD struct sqlite3StatType
 {
-    int nowValue[10];         /* Current value */
-    int mxValue[10];          /* Maximum value */
+    int nowValue[13];         /* Current value */
+    int mxValue[13];          /* Maximum value */
 } sqlite3Stat = { {0,}, {0,} };
 
 
@@ -90,6 +90,14 @@ void sqlite3StatusSet(int op, int X)
 int sqlite3_status(int op, int *pCurrent, int *pHighwater, int resetFlag)
 {
     wsdStatInit;
+    if (op == SQLITE_STATUS_PAGECACHE_HIT || op == SQLITE_STATUS_PAGECACHE_MISS
+            || op == SQLITE_STATUS_PAGECACHE_TIER_HIT)
+    {
+        /* These are counted by the page cache itself */
+        sqlite3PcacheCounters(op, pCurrent, resetFlag);
+        *pHighwater = 0;
+        return SQLITE_OK;
+    }
     if (op < 0 || op >= ArraySize(wsdStat.nowValue))
     {
         return SQLITE_MISUSE_BKPT;
@@ -270,6 +278,52 @@ int sqlite3_db_status(
             break;
         }
 
+        /*
+        ** Set *pCurrent to the number of writes used to append frames to
+        ** the WAL files of all attached databases, and *pHighwater to the
+        ** number of frames appended by those writes.
+        */
+        case SQLITE_DBSTATUS_WAL_WRITE:
+        {
+            int i;
+            int nWrite = 0;
+            int nFrame = 0;
+            for (i = 0; i < db->nDb; i++)
+            {
+                if (db->aDb[i].pBt)
+                {
+                    Pager *pPager = sqlite3BtreePager(db->aDb[i].pBt);
+                    sqlite3PagerWalWriteStat(pPager, resetFlag, &nWrite, &nFrame);
+                }
+            }
+            *pHighwater = nFrame;
+            *pCurrent = nWrite;
+            break;
+        }
+
+        /*
+        ** Set *pCurrent to the number of pages that checkpoints run by this
+        ** connection have written back into database files, and *pHighwater
+        ** to the rate in pages per second of the most recent one.
+        */
+        case SQLITE_DBSTATUS_WAL_CHECKPOINT:
+        {
+            int i;
+            int nPage = 0;
+            int nPageSec = 0;
+            for (i = 0; i < db->nDb; i++)
+            {
+                if (db->aDb[i].pBt)
+                {
+                    Pager *pPager = sqlite3BtreePager(db->aDb[i].pBt);
+                    sqlite3PagerWalCkptStat(pPager, resetFlag, &nPage, &nPageSec);
+                }
+            }
+            *pHighwater = nPageSec;
+            *pCurrent = nPage;
+            break;
+        }
+
         default:
         {
             rc = SQLITE_ERROR;
@@ -135,7 +135,7 @@ struct SqliteDb
     int maxStmt;               /* The next maximum number of stmtList */
     int nStmt;                 /* Number of statements in stmtList */
     IncrblobChannel *pIncrblob;/* Linked list of open incrblob channels */
-    int nStep, nSort, nIndex;  /* Statistics for most recent operation */
+    int nStep, nSort, nIndex, nReseek;  /* Statistics for most recent operation */
     int nTransaction;          /* Number of nested [transaction] methods */
 #ifdef SQLITE_TEST
     int bLegacyPrepare;        /* True to use sqlite3_prepare() */
@@ -1669,6 +1669,7 @@ static int dbEvalStep(DbEvalContext *p)
             pDb->nStep = sqlite3_stmt_status(pStmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
             pDb->nSort = sqlite3_stmt_status(pStmt, SQLITE_STMTSTATUS_SORT, 1);
             pDb->nIndex = sqlite3_stmt_status(pStmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+            pDb->nReseek = sqlite3_stmt_status(pStmt, SQLITE_STMTSTATUS_RESEEK, 1);
             dbReleaseColumnNames(p);
             p->pPreStmt = 0;
 
@@ -3105,10 +3106,11 @@ static int DbObjCmd(void *cd, Tcl_Interp *interp, int objc, Tcl_Obj *const*objv)
         }
 
         /*
-        **     $db status (step|sort|autoindex)
+        **     $db status (step|sort|autoindex|reseek)
         **
-        ** Display SQLITE_STMTSTATUS_FULLSCAN_STEP or
-        ** SQLITE_STMTSTATUS_SORT for the most recent eval.
+        ** Display SQLITE_STMTSTATUS_FULLSCAN_STEP, SQLITE_STMTSTATUS_SORT,
+        ** SQLITE_STMTSTATUS_AUTOINDEX or SQLITE_STMTSTATUS_RESEEK for the
+        ** most recent eval.
         */
         case DB_STATUS:
         {
@@ -3116,7 +3118,7 @@ static int DbObjCmd(void *cd, Tcl_Interp *interp, int objc, Tcl_Obj *const*objv)
             const char *zOp;
             if (objc != 3)
             {
-                Tcl_WrongNumArgs(interp, 2, objv, "(step|sort|autoindex)");
+                Tcl_WrongNumArgs(interp, 2, objv, "(step|sort|autoindex|reseek)");
                 return TCL_ERROR;
             }
             zOp = Tcl_GetString(objv[2]);
@@ -3132,10 +3134,14 @@ static int DbObjCmd(void *cd, Tcl_Interp *interp, int objc, Tcl_Obj *const*objv)
             {
                 v = pDb->nIndex;
             }
+            else if (strcmp(zOp, "reseek") == 0)
+            {
+                v = pDb->nReseek;
+            }
             else
             {
                 Tcl_AppendResult(interp,
-                                 "bad argument: should be autoindex, step, or sort",
+                                 "bad argument: should be autoindex, reseek, step, or sort",
                                  (char*)0);
                 return TCL_ERROR;
             }
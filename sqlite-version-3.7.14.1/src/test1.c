@@ -158,6 +158,9 @@ const char *sqlite3TestErrorName(int rc)
         case SQLITE_BUSY:
             zName = "SQLITE_BUSY";
             break;
+        case SQLITE_BUSY_SNAPSHOT:
+            zName = "SQLITE_BUSY_SNAPSHOT";
+            break;
         case SQLITE_LOCKED:
             zName = "SQLITE_LOCKED";
             break;
@@ -2638,6 +2641,7 @@ static int test_stmt_status(
         { "SQLITE_STMTSTATUS_FULLSCAN_STEP",   SQLITE_STMTSTATUS_FULLSCAN_STEP   },
         { "SQLITE_STMTSTATUS_SORT",            SQLITE_STMTSTATUS_SORT            },
         { "SQLITE_STMTSTATUS_AUTOINDEX",       SQLITE_STMTSTATUS_AUTOINDEX       },
+        { "SQLITE_STMTSTATUS_RESEEK",          SQLITE_STMTSTATUS_RESEEK          },
     };
     if (objc != 4)
     {
@@ -6314,6 +6318,52 @@ static int test_wal_checkpoint_v2(
     return TCL_OK;
 }
 
+/*
+** Usage: sqlite3_wal_checkpoint_thread DB NFRAME RATE SYNC ?NAME?
+**
+** Invoke sqlite3_wal_checkpoint_thread() on connection DB. SYNC must be
+** one of "off", "normal" or "full". Return the result code as a string.
+*/
+static int test_wal_checkpoint_thread(
+    ClientData clientData, /* Unused */
+    Tcl_Interp *interp,    /* The TCL interpreter that invoked this command */
+    int objc,              /* Number of arguments */
+    Tcl_Obj *CONST objv[]  /* Command arguments */
+)
+{
+    char *zDb = 0;
+    sqlite3 *db;
+    int nFrame;
+    int nRate;
+    int iSync;
+    int rc;
+
+    const char * aSync[] = { "off", "normal", "full", 0 };
+    const int aFlag[] = { 0, SQLITE_SYNC_NORMAL, SQLITE_SYNC_FULL };
+
+    if (objc != 5 && objc != 6)
+    {
+        Tcl_WrongNumArgs(interp, 1, objv, "DB NFRAME RATE SYNC ?NAME?");
+        return TCL_ERROR;
+    }
+    if (objc == 6)
+    {
+        zDb = Tcl_GetString(objv[5]);
+    }
+    if (getDbPointer(interp, Tcl_GetString(objv[1]), &db)
+        || Tcl_GetIntFromObj(interp, objv[2], &nFrame)
+        || Tcl_GetIntFromObj(interp, objv[3], &nRate)
+        || Tcl_GetIndexFromObj(interp, objv[4], aSync, "sync", 0, &iSync)
+       )
+    {
+        return TCL_ERROR;
+    }
+
+    rc = sqlite3_wal_checkpoint_thread(db, zDb, nFrame, nRate, aFlag[iSync]);
+    Tcl_SetResult(interp, (char *)t1ErrorName(rc), TCL_STATIC);
+    return TCL_OK;
+}
+
 /*
 ** tclcmd:  test_sqlite3_log ?SCRIPT?
 */
@@ -6931,6 +6981,7 @@ int Sqlitetest1_Init(Tcl_Interp *interp)
 #endif
         { "sqlite3_wal_checkpoint",   test_wal_checkpoint, 0  },
         { "sqlite3_wal_checkpoint_v2", test_wal_checkpoint_v2, 0  },
+        { "sqlite3_wal_checkpoint_thread", test_wal_checkpoint_thread, 0  },
         { "test_sqlite3_log",         test_sqlite3_log, 0  },
 #ifndef SQLITE_OMIT_EXPLAIN
         { "print_explain_query_plan", test_print_eqp, 0  },
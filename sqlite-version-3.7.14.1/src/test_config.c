@@ -617,6 +617,7 @@ static void set_options(Tcl_Interp *interp)
     LINKVAR(DEFAULT_FILE_FORMAT);
     LINKVAR(MAX_ATTACHED);
     LINKVAR(MAX_DEFAULT_PAGE_SIZE);
+    LINKVAR(WAL_NREADER);
 
     {
         static const int cv_TEMP_STORE = SQLITE_TEMP_STORE;
@@ -1094,6 +1094,32 @@ static int test_config_pagecache(
     return TCL_OK;
 }
 
+/*
+** Usage:    sqlite3_config_pagecache_hugepage SIZE N
+**
+** Set the page-cache arena mapped by the library using
+** SQLITE_CONFIG_PAGECACHE_HUGEPAGE. A SIZE of 0 disables it.
+*/
+static int test_config_pagecache_hugepage(
+    void * clientData,
+    Tcl_Interp *interp,
+    int objc,
+    Tcl_Obj *CONST objv[]
+)
+{
+    int sz, N, rc;
+    if (objc != 3)
+    {
+        Tcl_WrongNumArgs(interp, 1, objv, "SIZE N");
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIntFromObj(interp, objv[1], &sz)) return TCL_ERROR;
+    if (Tcl_GetIntFromObj(interp, objv[2], &N)) return TCL_ERROR;
+    rc = sqlite3_config(SQLITE_CONFIG_PAGECACHE_HUGEPAGE, sz, N);
+    Tcl_SetResult(interp, (char *)sqlite3TestErrorName(rc), TCL_VOLATILE);
+    return TCL_OK;
+}
+
 /*
 ** Usage:    sqlite3_config_alt_pcache INSTALL_FLAG DISCARD_CHANCE PRNG_SEED
 **
@@ -1370,6 +1396,97 @@ static int test_config_uri(
     return TCL_OK;
 }
 
+/*
+** Usage:    sqlite3_config_pcache_shards N
+**
+** Set the number of shards the global page-cache group is split into
+** using SQLITE_CONFIG_PCACHE_SHARDS.
+*/
+static int test_config_pcache_shards(
+    void * clientData,
+    Tcl_Interp *interp,
+    int objc,
+    Tcl_Obj *CONST objv[]
+)
+{
+    int rc;
+    int nShard;
+
+    if (objc != 2)
+    {
+        Tcl_WrongNumArgs(interp, 1, objv, "N");
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIntFromObj(interp, objv[1], &nShard))
+    {
+        return TCL_ERROR;
+    }
+
+    rc = sqlite3_config(SQLITE_CONFIG_PCACHE_SHARDS, nShard);
+    Tcl_SetResult(interp, (char *)sqlite3TestErrorName(rc), TCL_VOLATILE);
+
+    return TCL_OK;
+}
+
+/*
+** Usage:    sqlite3_config_pcache_policy POLICY
+**
+** Select the page replacement policy of the default page cache using
+** SQLITE_CONFIG_PCACHE_POLICY. POLICY is "lru" or "2q".
+*/
+static int test_config_pcache_policy(
+    void * clientData,
+    Tcl_Interp *interp,
+    int objc,
+    Tcl_Obj *CONST objv[]
+)
+{
+    static const char *azPolicy[] = { "lru", "2q", 0 };
+    int rc;
+    int ePolicy;
+
+    if (objc != 2)
+    {
+        Tcl_WrongNumArgs(interp, 1, objv, "POLICY");
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp, objv[1], azPolicy, "policy", 0, &ePolicy))
+    {
+        return TCL_ERROR;
+    }
+
+    rc = sqlite3_config(SQLITE_CONFIG_PCACHE_POLICY,
+                        ePolicy ? SQLITE_PCACHE_POLICY_2Q : SQLITE_PCACHE_POLICY_LRU);
+    Tcl_SetResult(interp, (char *)sqlite3TestErrorName(rc), TCL_VOLATILE);
+
+    return TCL_OK;
+}
+
+/*
+** Usage:    sqlite3_config_pcache_tier PERCENT
+**
+** Set the size of the compressed tier of each page cache using
+** SQLITE_CONFIG_PCACHE_TIER. A PERCENT of 0 disables it.
+*/
+static int test_config_pcache_tier(
+    void * clientData,
+    Tcl_Interp *interp,
+    int objc,
+    Tcl_Obj *CONST objv[]
+)
+{
+    int nPercent, rc;
+    if (objc != 2)
+    {
+        Tcl_WrongNumArgs(interp, 1, objv, "PERCENT");
+        return TCL_ERROR;
+    }
+    if (Tcl_GetIntFromObj(interp, objv[1], &nPercent)) return TCL_ERROR;
+    rc = sqlite3_config(SQLITE_CONFIG_PCACHE_TIER, nPercent);
+    Tcl_SetResult(interp, (char *)sqlite3TestErrorName(rc), TCL_VOLATILE);
+    return TCL_OK;
+}
+
 /*
 ** Usage:
 **
@@ -1445,6 +1562,10 @@ static int test_status(
         { "SQLITE_STATUS_SCRATCH_SIZE",        SQLITE_STATUS_SCRATCH_SIZE        },
         { "SQLITE_STATUS_PARSER_STACK",        SQLITE_STATUS_PARSER_STACK        },
         { "SQLITE_STATUS_MALLOC_COUNT",        SQLITE_STATUS_MALLOC_COUNT        },
+        { "SQLITE_STATUS_PAGECACHE_HIT",       SQLITE_STATUS_PAGECACHE_HIT       },
+        { "SQLITE_STATUS_PAGECACHE_MISS",      SQLITE_STATUS_PAGECACHE_MISS      },
+        { "SQLITE_STATUS_PAGECACHE_TIER_USED", SQLITE_STATUS_PAGECACHE_TIER_USED },
+        { "SQLITE_STATUS_PAGECACHE_TIER_HIT",  SQLITE_STATUS_PAGECACHE_TIER_HIT  },
     };
     Tcl_Obj *pResult;
     if (objc != 3)
@@ -1510,7 +1631,9 @@ static int test_db_status(
         { "LOOKASIDE_MISS_FULL", SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL },
         { "CACHE_HIT",           SQLITE_DBSTATUS_CACHE_HIT           },
         { "CACHE_MISS",          SQLITE_DBSTATUS_CACHE_MISS          },
-        { "CACHE_WRITE",         SQLITE_DBSTATUS_CACHE_WRITE         }
+        { "CACHE_WRITE",         SQLITE_DBSTATUS_CACHE_WRITE         },
+        { "WAL_WRITE",           SQLITE_DBSTATUS_WAL_WRITE           },
+        { "WAL_CHECKPOINT",      SQLITE_DBSTATUS_WAL_CHECKPOINT      }
     };
     Tcl_Obj *pResult;
     if (objc != 4)
@@ -1643,6 +1766,7 @@ int Sqlitetest_malloc_Init(Tcl_Interp *interp)
         { "sqlite3_memdebug_log",       test_memdebug_log, 0 },
         { "sqlite3_config_scratch",     test_config_scratch, 0 },
         { "sqlite3_config_pagecache",   test_config_pagecache, 0 },
+        { "sqlite3_config_pagecache_hugepage", test_config_pagecache_hugepage, 0 },
         { "sqlite3_config_alt_pcache",  test_alt_pcache, 0 },
         { "sqlite3_status",             test_status, 0 },
         { "sqlite3_db_status",          test_db_status, 0 },
@@ -1652,6 +1776,9 @@ int Sqlitetest_malloc_Init(Tcl_Interp *interp)
         { "sqlite3_config_lookaside",   test_config_lookaside, 0 },
         { "sqlite3_config_error",       test_config_error, 0 },
         { "sqlite3_config_uri",         test_config_uri, 0 },
+        { "sqlite3_config_pcache_shards", test_config_pcache_shards, 0 },
+        { "sqlite3_config_pcache_policy", test_config_pcache_policy, 0 },
+        { "sqlite3_config_pcache_tier",   test_config_pcache_tier,   0 },
         { "sqlite3_db_config_lookaside", test_db_config_lookaside, 0 },
         { "sqlite3_dump_memsys3",       test_dump_memsys3, 3 },
         { "sqlite3_dump_memsys5",       test_dump_memsys3, 5 },
@@ -350,6 +350,9 @@ static void vfstrace_print_errcode(
         case SQLITE_BUSY_RECOVERY:
             zVal = "SQLITE_BUSY_RECOVERY";
             break;
+        case SQLITE_BUSY_SNAPSHOT:
+            zVal = "SQLITE_BUSY_SNAPSHOT";
+            break;
         case SQLITE_CANTOPEN_NOTEMPDIR:
             zVal = "SQLITE_CANTOPEN_NOTEMPDIR";
             break;
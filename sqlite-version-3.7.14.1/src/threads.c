@@ -0,0 +1,375 @@
+/*
+** 2026 October 16
+**
+** The author disclaims copyright to this source code.  In place of
+** a legal notice, here is a blessing:
+**
+**    May you do good and not evil.
+**    May you find forgiveness for yourself and forgive others.
+**    May you share freely, never taking more than you give.
+**
+*************************************************************************
+**
+** This file presents a simple cross-platform threading interface for
+** use internally by SQLite. There are three objects:
+**
+**   SQLiteThread       A thread, started by sqlite3ThreadCreate() and
+**                      waited for by sqlite3ThreadJoin().
+**
+**   SQLiteCond         A condition variable and the mutex that protects
+**                      the state it signals changes to.
+**
+**   SQLiteThreadPool   A set of worker threads that run jobs from a ring
+**                      of slots. The jobs are retired by the thread that
+**                      submitted them, in the order they were submitted.
+**
+** All three are only available if SQLITE_THREADS_IMPLEMENTED is defined
+** (see sqliteInt.h). Code that uses them must do all of its work on the
+** calling thread otherwise, and also if a thread cannot be started.
+**
+** The SQLiteCond and SQLiteThreadPool objects are allocated from the
+** heap, so they may only be used while the memory allocator is
+** threadsafe, i.e. while sqlite3GlobalConfig.bCoreMutex is set.
+*/
+#include "sqliteInt.h"
+
+#ifdef SQLITE_THREADS_IMPLEMENTED
+/******************************** Unix Pthreads *************************/
+#include <pthread.h>
+#include <sys/time.h>
+
+/* A running thread */
+struct SQLiteThread
+{
+    pthread_t tid;                  /* Thread ID */
+};
+
+/*
+** Start a thread that runs xTask(pIn). Return SQLITE_OK and set *ppThread
+** if successful, or an error code if the thread cannot be started, in
+** which case xTask is not called.
+*/
+int sqlite3ThreadCreate(
+    SQLiteThread **ppThread,        /* OUT: Write the thread object here */
+    void *(*xTask)(void*),          /* Routine to run in a separate thread */
+    void *pIn                       /* Argument passed into xTask() */
+)
+{
+    SQLiteThread *p;
+
+    assert(ppThread != 0);
+    assert(xTask != 0);
+    *ppThread = 0;
+    p = (SQLiteThread *)sqlite3Malloc(sizeof(*p));
+    if (p == 0) return SQLITE_NOMEM;
+    if (pthread_create(&p->tid, 0, xTask, pIn))
+    {
+        sqlite3_free(p);
+        return SQLITE_ERROR;
+    }
+    *ppThread = p;
+    return SQLITE_OK;
+}
+
+/*
+** Wait for thread p to finish, and free it. The value returned by its
+** xTask is written to *ppOut, if ppOut is not NULL.
+*/
+int sqlite3ThreadJoin(SQLiteThread *p, void **ppOut)
+{
+    int rc;
+
+    assert(p != 0);
+    rc = pthread_join(p->tid, ppOut) ? SQLITE_ERROR : SQLITE_OK;
+    sqlite3_free(p);
+    return rc;
+}
+
+/* A condition variable and its mutex */
+struct SQLiteCond
+{
+    pthread_mutex_t mutex;          /* Mutex protecting the condition */
+    pthread_cond_t cond;            /* Signalled when the condition changes */
+};
+
+/*
+** Allocate a new condition variable. Return NULL if the memory cannot
+** be had.
+*/
+SQLiteCond *sqlite3CondAlloc(void)
+{
+    SQLiteCond *p = (SQLiteCond *)sqlite3Malloc(sizeof(*p));
+    if (p)
+    {
+        pthread_mutex_init(&p->mutex, 0);
+        pthread_cond_init(&p->cond, 0);
+    }
+    return p;
+}
+
+/*
+** Free a condition variable. No thread may be holding its mutex.
+*/
+void sqlite3CondFree(SQLiteCond *p)
+{
+    if (p)
+    {
+        pthread_cond_destroy(&p->cond);
+        pthread_mutex_destroy(&p->mutex);
+        sqlite3_free(p);
+    }
+}
+
+/*
+** Obtain or release the mutex of condition variable p.
+*/
+void sqlite3CondEnter(SQLiteCond *p)
+{
+    pthread_mutex_lock(&p->mutex);
+}
+void sqlite3CondLeave(SQLiteCond *p)
+{
+    pthread_mutex_unlock(&p->mutex);
+}
+
+/*
+** Release the mutex of condition variable p, which the caller holds, and
+** wait for p to be signalled, or for us microseconds to pass if us is not
+** negative. The mutex is held again when this returns. As with any
+** condition variable, this may also return early for no reason at all,
+** so the caller must check the condition it is waiting for.
+*/
+void sqlite3CondWait(SQLiteCond *p, int us)
+{
+    if (us < 0)
+    {
+        pthread_cond_wait(&p->cond, &p->mutex);
+    }
+    else
+    {
+        struct timeval now;
+        struct timespec t;
+        gettimeofday(&now, 0);
+        t.tv_sec = now.tv_sec + us / 1000000;
+        t.tv_nsec = (now.tv_usec + (long)(us % 1000000)) * 1000;
+        if (t.tv_nsec >= 1000000000)
+        {
+            t.tv_sec++;
+            t.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&p->cond, &p->mutex, &t);
+    }
+}
+
+/*
+** Wake one, or all, of the threads waiting on condition variable p. The
+** caller must hold its mutex.
+*/
+void sqlite3CondSignal(SQLiteCond *p)
+{
+    pthread_cond_signal(&p->cond);
+}
+void sqlite3CondBroadcast(SQLiteCond *p)
+{
+    pthread_cond_broadcast(&p->cond);
+}
+
+/*
+** A pool of worker threads.
+**
+** Each job occupies one of the nSlot slots of a ring until it is retired.
+** The caller keeps the inputs and results of its jobs in an array of its
+** own, indexed by slot number. Workers take the jobs in the order they
+** were submitted and run xWork(pArg, iSlot, &pScratch) for each. pScratch
+** is NULL to begin with, and may be set by xWork to memory that the worker
+** thread uses for every job it runs. It is freed with sqlite3_free() when
+** the thread exits.
+**
+** iHead and nJob are only written by the thread that owns the pool, so
+** it may read them without holding the mutex. The other fields below the
+** mutex are protected by it.
+*/
+struct SQLiteThreadPool
+{
+    int nThread;                    /* Number of threads started */
+    int nSlot;                      /* Number of slots in the ring */
+    void (*xWork)(void*, int, void**);  /* Routine that runs a job */
+    void *pArg;                     /* First argument passed to xWork */
+    SQLiteThread **apThread;        /* The nThread worker threads */
+    pthread_mutex_t mutex;          /* Mutex protecting the fields below */
+    pthread_cond_t cWork;           /* Signalled when a job is submitted */
+    pthread_cond_t cDone;           /* Signalled when a job is done */
+    int iHead;                      /* Slot of the oldest job not retired */
+    int nJob;                       /* Number of jobs not yet retired */
+    int nQueued;                    /* Jobs not yet taken by a worker */
+    u8 bStop;                       /* True to make the workers exit */
+    u8 *aDone;                      /* aDone[i] is true if slot i is done */
+};
+
+/*
+** Main routine of a worker thread.
+*/
+static void *threadPoolMain(void *pArg)
+{
+    SQLiteThreadPool *p = (SQLiteThreadPool *)pArg;
+    void *pScratch = 0;
+
+    pthread_mutex_lock(&p->mutex);
+    for (;;)
+    {
+        int iSlot;
+        while (p->nQueued == 0 && !p->bStop)
+        {
+            pthread_cond_wait(&p->cWork, &p->mutex);
+        }
+        if (p->nQueued == 0) break;
+        iSlot = (p->iHead + p->nJob - p->nQueued) % p->nSlot;
+        p->nQueued--;
+        pthread_mutex_unlock(&p->mutex);
+
+        p->xWork(p->pArg, iSlot, &pScratch);
+
+        pthread_mutex_lock(&p->mutex);
+        p->aDone[iSlot] = 1;
+        pthread_cond_signal(&p->cDone);
+    }
+    pthread_mutex_unlock(&p->mutex);
+    sqlite3_free(pScratch);
+    return 0;
+}
+
+/*
+** Start a pool of up to nThread worker threads with a ring of nSlot job
+** slots, which run jobs by calling xWork (see SQLiteThreadPool). Return
+** SQLITE_OK and set *ppPool if at least one thread is started. Otherwise
+** set *ppPool to NULL and return an error code.
+*/
+int sqlite3ThreadPoolCreate(
+    SQLiteThreadPool **ppPool,      /* OUT: The new pool */
+    int nThread,                    /* Number of threads wanted */
+    int nSlot,                      /* Number of job slots */
+    void (*xWork)(void*, int, void**),  /* Routine that runs a job */
+    void *pArg                      /* First argument passed to xWork */
+)
+{
+    SQLiteThreadPool *p;
+    int i;
+
+    assert(nThread > 0 && nSlot > 0);
+    *ppPool = 0;
+    p = (SQLiteThreadPool *)sqlite3MallocZero(
+            sizeof(*p) + nThread * sizeof(SQLiteThread *) + nSlot);
+    if (p == 0) return SQLITE_NOMEM;
+    p->nSlot = nSlot;
+    p->xWork = xWork;
+    p->pArg = pArg;
+    p->apThread = (SQLiteThread **)&p[1];
+    p->aDone = (u8 *)&p->apThread[nThread];
+    pthread_mutex_init(&p->mutex, 0);
+    pthread_cond_init(&p->cWork, 0);
+    pthread_cond_init(&p->cDone, 0);
+    for (i = 0; i < nThread; i++)
+    {
+        if (sqlite3ThreadCreate(&p->apThread[i], threadPoolMain, p)) break;
+        p->nThread++;
+    }
+    if (p->nThread == 0)
+    {
+        sqlite3ThreadPoolFree(p);
+        return SQLITE_ERROR;
+    }
+    *ppPool = p;
+    return SQLITE_OK;
+}
+
+/*
+** Stop the worker threads of pool p, once they have run the jobs already
+** submitted, and free the pool. Jobs need not have been retired.
+*/
+void sqlite3ThreadPoolFree(SQLiteThreadPool *p)
+{
+    int i;
+
+    if (p == 0) return;
+    pthread_mutex_lock(&p->mutex);
+    p->bStop = 1;
+    pthread_cond_broadcast(&p->cWork);
+    pthread_mutex_unlock(&p->mutex);
+    for (i = 0; i < p->nThread; i++)
+    {
+        sqlite3ThreadJoin(p->apThread[i], 0);
+    }
+    pthread_cond_destroy(&p->cDone);
+    pthread_cond_destroy(&p->cWork);
+    pthread_mutex_destroy(&p->mutex);
+    sqlite3_free(p);
+}
+
+/*
+** Return the number of worker threads of pool p.
+*/
+int sqlite3ThreadPoolThreads(SQLiteThreadPool *p)
+{
+    return p->nThread;
+}
+
+/*
+** Return the number of jobs submitted to pool p that have not yet been
+** retired.
+*/
+int sqlite3ThreadPoolJobs(SQLiteThreadPool *p)
+{
+    return p->nJob;
+}
+
+/*
+** Return the slot that the next job submitted to pool p will occupy. Its
+** inputs must be written to the caller's array before the job is
+** submitted. There must be a free slot.
+*/
+int sqlite3ThreadPoolNext(SQLiteThreadPool *p)
+{
+    assert(p->nJob < p->nSlot);
+    return (p->iHead + p->nJob) % p->nSlot;
+}
+
+/*
+** Submit the job in slot sqlite3ThreadPoolNext(p) to the workers.
+*/
+void sqlite3ThreadPoolSubmit(SQLiteThreadPool *p)
+{
+    pthread_mutex_lock(&p->mutex);
+    assert(p->nJob < p->nSlot);
+    p->aDone[(p->iHead + p->nJob) % p->nSlot] = 0;
+    p->nJob++;
+    p->nQueued++;
+    pthread_cond_signal(&p->cWork);
+    pthread_mutex_unlock(&p->mutex);
+}
+
+/*
+** Wait until no more than nMax jobs submitted to pool p remain to be
+** retired, or the oldest of them is done. Then, if the oldest job is
+** done, retire it and return its slot, the results of which may be read
+** from the caller's array. Otherwise return -1.
+*/
+int sqlite3ThreadPoolRetire(SQLiteThreadPool *p, int nMax)
+{
+    int iSlot = -1;
+
+    pthread_mutex_lock(&p->mutex);
+    while (p->nJob > nMax && !p->aDone[p->iHead])
+    {
+        pthread_cond_wait(&p->cDone, &p->mutex);
+    }
+    if (p->nJob > 0 && p->aDone[p->iHead])
+    {
+        iSlot = p->iHead;
+        p->iHead = (p->iHead + 1) % p->nSlot;
+        p->nJob--;
+    }
+    pthread_mutex_unlock(&p->mutex);
+    return iSlot;
+}
+/******************************** End Unix Pthreads *********************/
+#endif /* SQLITE_THREADS_IMPLEMENTED */
@@ -550,6 +550,63 @@ static void registerTrace(FILE *out, int iReg, Mem *p)
 #define CHECK_FOR_INTERRUPT \
    if( db->u1.isInterrupted ) goto abort_due_to_interrupt;
 
+/*
+** If SQLITE_ENABLE_COMPUTED_GOTO is defined and the compiler supports
+** the "labels as values" extension of GCC and clang, sqlite3VdbeExec()
+** jumps to the case for each opcode through a table of label addresses
+** instead of through the switch statement.  OPLABEL() adds the label
+** "op_X" to the case for opcode OP_X, and the table is the
+** OPDISPATCH_INITIALIZER macro that mkopcodeh.awk generates from the same
+** case lines as the opcode numbers.
+**
+** With NEXT_OPCODE below, each opcode then ends in an indirect jump of its
+** own, which the branch predictor can learn the likely successors of
+** (OP_Next to OP_Column, say), rather than in a jump back to the single
+** indirect jump of the switch.
+*/
+#if defined(SQLITE_ENABLE_COMPUTED_GOTO) && defined(__GNUC__)
+# define VDBE_COMPUTED_GOTO 1
+# define OPLABEL(X) op_##X:
+#else
+# define OPLABEL(X)
+#endif
+
+/*
+** NEXT_OPCODE ends the case for an opcode.  With computed gotos, and if
+** none of the work that the top of the loop in sqlite3VdbeExec() does
+** between two opcodes is needed (no error, no progress callback, and so
+** on), it goes on to the next opcode by itself.  Otherwise, and in debug
+** and VDBE_PROFILE builds, which trace or time every opcode in that loop,
+** it breaks out of the switch statement.
+*/
+#if defined(VDBE_COMPUTED_GOTO) && !defined(SQLITE_DEBUG) \
+ && !defined(VDBE_PROFILE)
+# ifndef SQLITE_OMIT_PROGRESS_CALLBACK
+#  define NO_PROGRESS_CHECK (checkProgress==0)
+# else
+#  define NO_PROGRESS_CHECK 1
+# endif
+# ifdef SQLITE_TEST
+#  define NO_TEST_INTERRUPT (sqlite3_interrupt_count==0)
+# else
+#  define NO_TEST_INTERRUPT 1
+# endif
+# define NEXT_OPCODE \
+   if( rc==SQLITE_OK && !db->mallocFailed && NO_PROGRESS_CHECK \
+    && NO_TEST_INTERRUPT ){ \
+     pOp = &aOp[++pc]; \
+     if( pOp->opflags & OPFLG_OUT2_PRERELEASE ){ \
+       pOut = &aMem[pOp->p2]; \
+       VdbeMemRelease(pOut); \
+       pOut->flags = MEM_Int; \
+     } \
+     goto *aDispatch[pOp->opcode]; \
+   } \
+   break
+#else
+# define NEXT_OPCODE break
+#endif
+
 
 #ifndef NDEBUG
 /*
@@ -666,6 +723,9 @@ int sqlite3VdbeExec(
 #ifdef VDBE_PROFILE
     u64 start;                 /* CPU clock count at start of opcode */
     int origPc;                /* Program counter at start of opcode */
+#endif
+#ifdef VDBE_COMPUTED_GOTO
+    static const void *const aDispatch[] = OPDISPATCH_INITIALIZER;
 #endif
     /*** INSERT STACK UNION HERE ***/
 
@@ -820,6 +880,9 @@ int sqlite3VdbeExec(
         }
 #endif
 
+#ifdef VDBE_COMPUTED_GOTO
+        goto *aDispatch[pOp->opcode];
+#endif
         switch (pOp->opcode) /* 接下来开始正式执行指令 */
         {
 
@@ -869,11 +932,11 @@ int sqlite3VdbeExec(
             ** the program.
             ** 无条件跳转到P2
             */
-            case OP_Goto:               /* jump */
+            case OP_Goto: OPLABEL(Goto) /* jump */
             {
                 CHECK_FOR_INTERRUPT;
                 pc = pOp->p2 - 1;
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode:  Gosub P1 P2 * * *
@@ -882,7 +945,7 @@ int sqlite3VdbeExec(
             ** and then jump to address P2.
             ** 将当前的地址(pc)写入寄存器P1,然后跳转到P2
             */
-            case OP_Gosub:              /* jump */
+            case OP_Gosub: OPLABEL(Gosub) /* jump */
             {
                 assert(pOp->p1 > 0 && pOp->p1 <= p->nMem);
                 pIn1 = &aMem[pOp->p1];
@@ -892,7 +955,7 @@ int sqlite3VdbeExec(
                 pIn1->u.i = pc;
                 REGISTER_TRACE(pOp->p1, pIn1);
                 pc = pOp->p2 - 1; /* 跳转到p2,继续执行 */
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode:  Return P1 * * * *
@@ -900,12 +963,12 @@ int sqlite3VdbeExec(
             ** Jump to the next instruction after the address in register P1.
             ** 跳转到p1指向地址的下一条指令继续运行
             */
-            case OP_Return:             /* in1 */
+            case OP_Return: OPLABEL(Return) /* in1 */
             {
                 pIn1 = &aMem[pOp->p1];
                 assert(pIn1->flags & MEM_Int);
                 pc = (int)pIn1->u.i;
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode:  Yield P1 * * * *
@@ -913,7 +976,7 @@ int sqlite3VdbeExec(
             ** Swap the program counter with the value in register P1.
             ** 交换pc以及register P1中的值
             */
-            case OP_Yield:              /* in1 */
+            case OP_Yield: OPLABEL(Yield) /* in1 */
             {
                 int pcDest;
                 pIn1 = &aMem[pOp->p1];
@@ -923,7 +986,7 @@ int sqlite3VdbeExec(
                 pIn1->u.i = pc;
                 REGISTER_TRACE(pOp->p1, pIn1);
                 pc = pcDest;
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode:  HaltIfNull  P1 P2 P3 P4 *
@@ -934,7 +997,7 @@ int sqlite3VdbeExec(
             ** 检查寄存器P3中的值,如果为NULL,使用参数p1, p2,p4作为halt指令的参数,如果halt指令存在
             ** 的话.如果P3非空,此条指令什么也不做.
             */
-            case OP_HaltIfNull:        /* in3 */
+            case OP_HaltIfNull: OPLABEL(HaltIfNull) /* in3 */
             {
                 pIn3 = &aMem[pOp->p3];
                 if ((pIn3->flags & MEM_Null) == 0) break;
@@ -967,7 +1030,7 @@ int sqlite3VdbeExec(
             ** every program.  So a jump past the last instruction of the program
             ** is the same as executing Halt.
             */
-            case OP_Halt:
+            case OP_Halt: OPLABEL(Halt)
             {
                 if (pOp->p1 == SQLITE_OK && p->pFrame)
                 {
@@ -1027,10 +1090,10 @@ int sqlite3VdbeExec(
             ** The 32-bit integer value P1 is written into register P2.
             ** 将P1(整数)的值,写入寄存器P2
             */
-            case OP_Integer:           /* out2-prerelease */
+            case OP_Integer: OPLABEL(Integer) /* out2-prerelease */
             {
                 pOut->u.i = pOp->p1;
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Int64 * P2 * P4 *
@@ -1039,11 +1102,11 @@ int sqlite3VdbeExec(
             ** Write that value into register P2.
             ** P4是一个指向64-bit的整数值,将值写入寄存器P2
             */
-            case OP_Int64:             /* out2-prerelease */
+            case OP_Int64: OPLABEL(Int64) /* out2-prerelease */
             {
                 assert(pOp->p4.pI64 != 0);
                 pOut->u.i = *pOp->p4.pI64;
-                break;
+                NEXT_OPCODE;
             }
 
 #ifndef SQLITE_OMIT_FLOATING_POINT
@@ -1052,12 +1115,12 @@ int sqlite3VdbeExec(
             ** P4 is a pointer to a 64-bit floating point value.
             ** Write that value into register P2.
             */
-            case OP_Real:              /* same as TK_FLOAT, out2-prerelease */
+            case OP_Real: OPLABEL(Real) /* same as TK_FLOAT, out2-prerelease */
             {
                 pOut->flags = MEM_Real;
                 assert(!sqlite3IsNaN(*pOp->p4.pReal));
                 pOut->r = *pOp->p4.pReal;
-                break;
+                NEXT_OPCODE;
             }
 #endif
 
@@ -1067,7 +1130,7 @@ int sqlite3VdbeExec(
             ** into an OP_String before it is executed for the first time.
             ** P4指向一个非空的字符串,将P4指向的字符串,放入P2指向的寄存器
             */
-            case OP_String8:           /* same as TK_STRING, out2-prerelease */
+            case OP_String8: OPLABEL(String8) /* same as TK_STRING, out2-prerelease */
             {
                 assert(pOp->p4.z != 0);
                 pOp->opcode = OP_String;
@@ -1105,7 +1168,7 @@ int sqlite3VdbeExec(
             ** The string value P4 of length P1 (bytes) is stored in register P2.
             ** 将P4的值,长度为P1, 存入寄存器P2,
             */
-            case OP_String:            /* out2-prerelease */
+            case OP_String: OPLABEL(String) /* out2-prerelease */
             {
                 assert(pOp->p4.z != 0);
                 pOut->flags = MEM_Str | MEM_Static | MEM_Term;
@@ -1113,7 +1176,7 @@ int sqlite3VdbeExec(
                 pOut->n = pOp->p1;
                 pOut->enc = encoding;
                 UPDATE_MAX_BLOBSIZE(pOut);
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Null * P2 P3 * *
@@ -1125,7 +1188,7 @@ int sqlite3VdbeExec(
             ** 将Null写入寄存器P2,如果P3比P2要大,同时将Null写入P3,以及P2~P3之间的寄存器.
             ** 如果P3小于P2(通常P3为0),那么只有P2寄存器被设置为NULL.
             */
-            case OP_Null:             /* out2-prerelease */
+            case OP_Null: OPLABEL(Null) /* out2-prerelease */
             {
                 int cnt;
                 cnt = pOp->p3 - pOp->p2;
@@ -1139,7 +1202,7 @@ int sqlite3VdbeExec(
                     pOut->flags = MEM_Null;
                     cnt--;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
 
@@ -1149,13 +1212,13 @@ int sqlite3VdbeExec(
             ** blob in register P2.
             ** P4指向一个blob数据,长度为P1字节,将这个blob存储在寄存器P2中
             */
-            case OP_Blob:                  /* out2-prerelease */
+            case OP_Blob: OPLABEL(Blob)    /* out2-prerelease */
             {
                 assert(pOp->p1 <= SQLITE_MAX_LENGTH);
                 sqlite3VdbeMemSetStr(pOut, pOp->p4.z, pOp->p1, 0, 0);
                 pOut->enc = encoding;
                 UPDATE_MAX_BLOBSIZE(pOut);
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Variable P1 P2 * P4 *
@@ -1165,7 +1228,7 @@ int sqlite3VdbeExec(
             ** If the parameter is named, then its name appears in P4 and P3==1.
             ** The P4 value is used by sqlite3_bind_parameter_name().
             */
-            case OP_Variable:              /* out2-prerelease */
+            case OP_Variable: OPLABEL(Variable) /* out2-prerelease */
             {
                 Mem *pVar;       /* Value being transferred */
 
@@ -1178,7 +1241,7 @@ int sqlite3VdbeExec(
                 }
                 sqlite3VdbeMemShallowCopy(pOut, pVar, MEM_Static);
                 UPDATE_MAX_BLOBSIZE(pOut);
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Move P1 P2 P3 * *
@@ -1191,7 +1254,7 @@ int sqlite3VdbeExec(
             ** 寄存器P1 ... P1+P1-1 中的值移动之后,为Null.如果寄存器P1 ... P1+P3-1 
             ** 以及 P2 ... P2+P3-1重叠,那是一个错误.
             */
-            case OP_Move:
+            case OP_Move: OPLABEL(Move)
             {
                 char *zMalloc;   /* Holding variable for allocated memory */
                 int n;           /* Number of registers left to copy */
@@ -1226,7 +1289,7 @@ int sqlite3VdbeExec(
                     pIn1++;
                     pOut++;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Copy P1 P2 * * *
@@ -1238,7 +1301,7 @@ int sqlite3VdbeExec(
             ** is made of any string or blob constant.  See also OP_SCopy.
             ** 这条指令做深度拷贝
             */
-            case OP_Copy:               /* in1, out2 */
+            case OP_Copy: OPLABEL(Copy) /* in1, out2 */
             {
                 pIn1 = &aMem[pOp->p1];
                 pOut = &aMem[pOp->p2];
@@ -1246,7 +1309,7 @@ int sqlite3VdbeExec(
                 sqlite3VdbeMemShallowCopy(pOut, pIn1, MEM_Ephem);
                 Deephemeralize(pOut);
                 REGISTER_TRACE(pOp->p2, pOut);
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: SCopy P1 P2 * * *
@@ -1261,7 +1324,7 @@ int sqlite3VdbeExec(
             ** during the lifetime of the copy.  Use OP_Copy to make a complete
             ** copy.
             */
-            case OP_SCopy:              /* in1, out2 */
+            case OP_SCopy: OPLABEL(SCopy) /* in1, out2 */
             {
                 pIn1 = &aMem[pOp->p1];
                 pOut = &aMem[pOp->p2];
@@ -1271,7 +1334,7 @@ int sqlite3VdbeExec(
                 if (pOut->pScopyFrom == 0) pOut->pScopyFrom = pIn1;
 #endif
                 REGISTER_TRACE(pOp->p2, pOut);
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: ResultRow P1 P2 * * *
@@ -1282,7 +1345,7 @@ int sqlite3VdbeExec(
             ** structure to provide access to the top P1 values as the result
             ** row.
             */
-            case OP_ResultRow:
+            case OP_ResultRow: OPLABEL(ResultRow)
             {
                 Mem *pMem;
                 int i;
@@ -1361,7 +1424,7 @@ int sqlite3VdbeExec(
             ** if P3 is the same register as P2, the implementation is able
             ** to avoid a memcpy().
             */
-            case OP_Concat:             /* same as TK_CONCAT, in1, in2, out3 */
+            case OP_Concat: OPLABEL(Concat) /* same as TK_CONCAT, in1, in2, out3 */
             {
                 i64 nByte;
 
@@ -1398,7 +1461,7 @@ int sqlite3VdbeExec(
                 pOut->n = (int)nByte;
                 pOut->enc = encoding;
                 UPDATE_MAX_BLOBSIZE(pOut);
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Add P1 P2 P3 * *
@@ -1434,11 +1497,11 @@ int sqlite3VdbeExec(
             ** If the value in register P2 is zero the result is NULL.
             ** If either operand is NULL, the result is NULL.
             */
-            case OP_Add:                   /* same as TK_PLUS, in1, in2, out3 */
-            case OP_Subtract:              /* same as TK_MINUS, in1, in2, out3 */
-            case OP_Multiply:              /* same as TK_STAR, in1, in2, out3 */
-            case OP_Divide:                /* same as TK_SLASH, in1, in2, out3 */
-            case OP_Remainder:             /* same as TK_REM, in1, in2, out3 */
+            case OP_Add: OPLABEL(Add)      /* same as TK_PLUS, in1, in2, out3 */
+            case OP_Subtract: OPLABEL(Subtract) /* same as TK_MINUS, in1, in2, out3 */
+            case OP_Multiply: OPLABEL(Multiply) /* same as TK_STAR, in1, in2, out3 */
+            case OP_Divide: OPLABEL(Divide) /* same as TK_SLASH, in1, in2, out3 */
+            case OP_Remainder: OPLABEL(Remainder) /* same as TK_REM, in1, in2, out3 */
             {
                 int flags;      /* Combined MEM_* flags from both inputs */
                 i64 iA;         /* Integer value of left operand */
@@ -1539,7 +1602,7 @@ int sqlite3VdbeExec(
 
             arithmetic_result_is_null:
                 sqlite3VdbeMemSetNull(pOut);
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: CollSeq P1 * * P4
@@ -1561,14 +1624,14 @@ int sqlite3VdbeExec(
             ** to retrieve the collation sequence set by this opcode is not available
             ** publicly, only to user functions defined in func.c.
             */
-            case OP_CollSeq:
+            case OP_CollSeq: OPLABEL(CollSeq)
             {
                 assert(pOp->p4type == P4_COLLSEQ);
                 if (pOp->p1)
                 {
                     sqlite3VdbeMemSetInt64(&aMem[pOp->p1], 0);
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Function P1 P2 P3 P4 P5
@@ -1587,7 +1650,7 @@ int sqlite3VdbeExec(
             **
             ** See also: AggStep and AggFinal
             */
-            case OP_Function:
+            case OP_Function: OPLABEL(Function)
             {
                 int i;
                 Mem *pArg;
@@ -1696,7 +1759,7 @@ int sqlite3VdbeExec(
 
                 REGISTER_TRACE(pOp->p3, pOut);
                 UPDATE_MAX_BLOBSIZE(pOut);
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: BitAnd P1 P2 P3 * *
@@ -1725,10 +1788,10 @@ int sqlite3VdbeExec(
             ** Store the result in register P3.
             ** If either input is NULL, the result is NULL.
             */
-            case OP_BitAnd:                 /* same as TK_BITAND, in1, in2, out3 */
-            case OP_BitOr:                  /* same as TK_BITOR, in1, in2, out3 */
-            case OP_ShiftLeft:              /* same as TK_LSHIFT, in1, in2, out3 */
-            case OP_ShiftRight:             /* same as TK_RSHIFT, in1, in2, out3 */
+            case OP_BitAnd: OPLABEL(BitAnd) /* same as TK_BITAND, in1, in2, out3 */
+            case OP_BitOr: OPLABEL(BitOr)   /* same as TK_BITOR, in1, in2, out3 */
+            case OP_ShiftLeft: OPLABEL(ShiftLeft) /* same as TK_LSHIFT, in1, in2, out3 */
+            case OP_ShiftRight: OPLABEL(ShiftRight) /* same as TK_RSHIFT, in1, in2, out3 */
             {
                 i64 iA;
                 u64 uA;
@@ -1788,7 +1851,7 @@ int sqlite3VdbeExec(
                 }
                 pOut->u.i = iA;
                 MemSetTypeFlag(pOut, MEM_Int);
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: AddImm  P1 P2 * * *
@@ -1799,13 +1862,13 @@ int sqlite3VdbeExec(
             **
             ** To force any register to be an integer, just add 0.
             */
-            case OP_AddImm:              /* in1 */
+            case OP_AddImm: OPLABEL(AddImm) /* in1 */
             {
                 pIn1 = &aMem[pOp->p1];
                 memAboutToChange(p, pIn1);
                 sqlite3VdbeMemIntegerify(pIn1);
                 pIn1->u.i += pOp->p2;
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: MustBeInt P1 P2 * * *
@@ -1816,7 +1879,7 @@ int sqlite3VdbeExec(
             ** raise an SQLITE_MISMATCH exception.
             ** 将寄存器P1中的值强制转换为一个整数,如果P1中的值不是整数,并且不能做转换,那么跳转到P2
             */
-            case OP_MustBeInt:              /* jump, in1 */
+            case OP_MustBeInt: OPLABEL(MustBeInt) /* jump, in1 */
             {
                 pIn1 = &aMem[pOp->p1];
                 applyAffinity(pIn1, SQLITE_AFF_NUMERIC, encoding);
@@ -1836,7 +1899,7 @@ int sqlite3VdbeExec(
                 {
                     MemSetTypeFlag(pIn1, MEM_Int);
                 }
-                break;
+                NEXT_OPCODE;
             }
 
 #ifndef SQLITE_OMIT_FLOATING_POINT
@@ -1849,14 +1912,14 @@ int sqlite3VdbeExec(
             ** integers, for space efficiency, but after extraction we want them
             ** to have only a real value.
             */
-            case OP_RealAffinity:                    /* in1 */
+            case OP_RealAffinity: OPLABEL(RealAffinity) /* in1 */
             {
                 pIn1 = &aMem[pOp->p1];
                 if (pIn1->flags & MEM_Int)
                 {
                     sqlite3VdbeMemRealify(pIn1);
                 }
-                break;
+                NEXT_OPCODE;
             }
 #endif
 
@@ -1870,7 +1933,7 @@ int sqlite3VdbeExec(
             **
             ** A NULL value is not changed by this routine.  It remains NULL.
             */
-            case OP_ToText:                    /* same as TK_TO_TEXT, in1 */
+            case OP_ToText: OPLABEL(ToText)    /* same as TK_TO_TEXT, in1 */
             {
                 pIn1 = &aMem[pOp->p1];
                 memAboutToChange(p, pIn1);
@@ -1882,7 +1945,7 @@ int sqlite3VdbeExec(
                 assert(pIn1->flags & MEM_Str || db->mallocFailed);
                 pIn1->flags &= ~(MEM_Int | MEM_Real | MEM_Blob | MEM_Zero);
                 UPDATE_MAX_BLOBSIZE(pIn1);
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: ToBlob P1 * * * *
@@ -1894,7 +1957,7 @@ int sqlite3VdbeExec(
             **
             ** A NULL value is not changed by this routine.  It remains NULL.
             */
-            case OP_ToBlob:                    /* same as TK_TO_BLOB, in1 */
+            case OP_ToBlob: OPLABEL(ToBlob)    /* same as TK_TO_BLOB, in1 */
             {
                 pIn1 = &aMem[pOp->p1];
                 if (pIn1->flags & MEM_Null) break;
@@ -1909,7 +1972,7 @@ int sqlite3VdbeExec(
                     pIn1->flags &= ~(MEM_TypeMask & ~MEM_Blob);
                 }
                 UPDATE_MAX_BLOBSIZE(pIn1);
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: ToNumeric P1 * * * *
@@ -1922,11 +1985,11 @@ int sqlite3VdbeExec(
             **
             ** A NULL value is not changed by this routine.  It remains NULL.
             */
-            case OP_ToNumeric:                    /* same as TK_TO_NUMERIC, in1 */
+            case OP_ToNumeric: OPLABEL(ToNumeric) /* same as TK_TO_NUMERIC, in1 */
             {
                 pIn1 = &aMem[pOp->p1];
                 sqlite3VdbeMemNumerify(pIn1);
-                break;
+                NEXT_OPCODE;
             }
 #endif /* SQLITE_OMIT_CAST */
 
@@ -1941,14 +2004,14 @@ int sqlite3VdbeExec(
             **
             ** A NULL value is not changed by this routine.  It remains NULL.
             */
-            case OP_ToInt:                    /* same as TK_TO_INT, in1 */
+            case OP_ToInt: OPLABEL(ToInt)     /* same as TK_TO_INT, in1 */
             {
                 pIn1 = &aMem[pOp->p1];
                 if ((pIn1->flags & MEM_Null) == 0)
                 {
                     sqlite3VdbeMemIntegerify(pIn1);
                 }
-                break;
+                NEXT_OPCODE;
             }
 
 #if !defined(SQLITE_OMIT_CAST) && !defined(SQLITE_OMIT_FLOATING_POINT)
@@ -1961,7 +2024,7 @@ int sqlite3VdbeExec(
             **
             ** A NULL value is not changed by this routine.  It remains NULL.
             */
-            case OP_ToReal:                    /* same as TK_TO_REAL, in1 */
+            case OP_ToReal: OPLABEL(ToReal)    /* same as TK_TO_REAL, in1 */
             {
                 pIn1 = &aMem[pOp->p1];
                 memAboutToChange(p, pIn1);
@@ -1969,7 +2032,7 @@ int sqlite3VdbeExec(
                 {
                     sqlite3VdbeMemRealify(pIn1);
                 }
-                break;
+                NEXT_OPCODE;
             }
 #endif /* !defined(SQLITE_OMIT_CAST) && !defined(SQLITE_OMIT_FLOATING_POINT) */
 
@@ -2047,12 +2110,12 @@ int sqlite3VdbeExec(
             ** the content of register P3 is greater than or equal to the content of
             ** register P1.  See the Lt opcode for additional information.
             */
-            case OP_Eq:               /* same as TK_EQ, jump, in1, in3 */
-            case OP_Ne:               /* same as TK_NE, jump, in1, in3 */
-            case OP_Lt:               /* same as TK_LT, jump, in1, in3 */
-            case OP_Le:               /* same as TK_LE, jump, in1, in3 */
-            case OP_Gt:               /* same as TK_GT, jump, in1, in3 */
-            case OP_Ge:               /* same as TK_GE, jump, in1, in3 */
+            case OP_Eq: OPLABEL(Eq)   /* same as TK_EQ, jump, in1, in3 */
+            case OP_Ne: OPLABEL(Ne)   /* same as TK_NE, jump, in1, in3 */
+            case OP_Lt: OPLABEL(Lt)   /* same as TK_LT, jump, in1, in3 */
+            case OP_Le: OPLABEL(Le)   /* same as TK_LE, jump, in1, in3 */
+            case OP_Gt: OPLABEL(Gt)   /* same as TK_GT, jump, in1, in3 */
+            case OP_Ge: OPLABEL(Ge)   /* same as TK_GE, jump, in1, in3 */
             {
                 int res;            /* Result of the comparison of pIn1 against pIn3 */
                 char affinity;      /* Affinity to use for comparison */
@@ -2148,7 +2211,7 @@ int sqlite3VdbeExec(
                 /* Undo any changes made by applyAffinity() to the input registers. */
                 pIn1->flags = (pIn1->flags & ~MEM_TypeMask) | (flags1 & MEM_TypeMask);
                 pIn3->flags = (pIn3->flags & ~MEM_TypeMask) | (flags3 & MEM_TypeMask);
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Permutation * * * P4 *
@@ -2160,12 +2223,12 @@ int sqlite3VdbeExec(
             ** OP_Halt, or OP_ResultRow.  Typically the OP_Permutation should occur
             ** immediately prior to the OP_Compare.
             */
-            case OP_Permutation:
+            case OP_Permutation: OPLABEL(Permutation)
             {
                 assert(pOp->p4type == P4_INTARRAY);
                 assert(pOp->p4.ai);
                 aPermute = pOp->p4.ai;
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Compare P1 P2 P3 P4 *
@@ -2185,7 +2248,7 @@ int sqlite3VdbeExec(
             ** NULLs are less than numbers, numbers are less than strings,
             ** and strings are less than blobs.
             */
-            case OP_Compare:
+            case OP_Compare: OPLABEL(Compare)
             {
                 int n;
                 int i;
@@ -2234,7 +2297,7 @@ int sqlite3VdbeExec(
                     }
                 }
                 aPermute = 0;
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Jump P1 P2 P3 * *
@@ -2244,7 +2307,7 @@ int sqlite3VdbeExec(
             ** equal to, or greater than the P2 vector, respectively.
             ** 根据上次比较的结果决定要跳转的指令,如果<0,跳转到P1, 等于0,跳转到P2,否则跳转到P3
             */
-            case OP_Jump:               /* jump */
+            case OP_Jump: OPLABEL(Jump) /* jump */
             {
                 if (iCompare < 0)
                 {
@@ -2258,7 +2321,7 @@ int sqlite3VdbeExec(
                 {
                     pc = pOp->p3 - 1;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: And P1 P2 P3 * *
@@ -2279,8 +2342,8 @@ int sqlite3VdbeExec(
             ** even if the other input is NULL.  A NULL and false or two NULLs
             ** give a NULL output.
             */
-            case OP_And:              /* same as TK_AND, in1, in2, out3 */
-            case OP_Or:               /* same as TK_OR, in1, in2, out3 */
+            case OP_And: OPLABEL(And) /* same as TK_AND, in1, in2, out3 */
+            case OP_Or: OPLABEL(Or)   /* same as TK_OR, in1, in2, out3 */
             {
                 int v1;    /* Left operand:  0==FALSE, 1==TRUE, 2==UNKNOWN or NULL */
                 int v2;    /* Right operand: 0==FALSE, 1==TRUE, 2==UNKNOWN or NULL */
@@ -2323,7 +2386,7 @@ int sqlite3VdbeExec(
                     pOut->u.i = v1;
                     MemSetTypeFlag(pOut, MEM_Int);
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Not P1 P2 * * *
@@ -2332,7 +2395,7 @@ int sqlite3VdbeExec(
             ** boolean complement in register P2.  If the value in register P1 is
             ** NULL, then a NULL is stored in P2.
             */
-            case OP_Not:                  /* same as TK_NOT, in1, out2 */
+            case OP_Not: OPLABEL(Not)     /* same as TK_NOT, in1, out2 */
             {
                 pIn1 = &aMem[pOp->p1];
                 pOut = &aMem[pOp->p2];
@@ -2344,7 +2407,7 @@ int sqlite3VdbeExec(
                 {
                     sqlite3VdbeMemSetInt64(pOut, !sqlite3VdbeIntValue(pIn1));
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: BitNot P1 P2 * * *
@@ -2353,7 +2416,7 @@ int sqlite3VdbeExec(
             ** ones-complement of the P1 value into register P2.  If P1 holds
             ** a NULL then store a NULL in P2.
             */
-            case OP_BitNot:               /* same as TK_BITNOT, in1, out2 */
+            case OP_BitNot: OPLABEL(BitNot) /* same as TK_BITNOT, in1, out2 */
             {
                 pIn1 = &aMem[pOp->p1];
                 pOut = &aMem[pOp->p2];
@@ -2365,7 +2428,7 @@ int sqlite3VdbeExec(
                 {
                     sqlite3VdbeMemSetInt64(pOut, ~sqlite3VdbeIntValue(pIn1));
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Once P1 P2 * * *
@@ -2376,7 +2439,7 @@ int sqlite3VdbeExec(
             **
             ** See also: JumpOnce
             */
-            case OP_Once:               /* jump */
+            case OP_Once: OPLABEL(Once) /* jump */
             {
                 assert(pOp->p1 < p->nOnceFlag);
                 if (p->aOnceFlag[pOp->p1])
@@ -2387,7 +2450,7 @@ int sqlite3VdbeExec(
                 {
                     p->aOnceFlag[pOp->p1] = 1;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: If P1 P2 P3 * *
@@ -2403,8 +2466,8 @@ int sqlite3VdbeExec(
             ** is considered false if it has a numeric value of zero.  If the value
             ** in P1 is NULL then take the jump if P3 is zero.
             */
-            case OP_If:                 /* jump, in1 */
-            case OP_IfNot:              /* jump, in1 */
+            case OP_If: OPLABEL(If)     /* jump, in1 */
+            case OP_IfNot: OPLABEL(IfNot) /* jump, in1 */
             {
                 int c;
                 pIn1 = &aMem[pOp->p1];
@@ -2425,7 +2488,7 @@ int sqlite3VdbeExec(
                 {
                     pc = pOp->p2 - 1; /* 跳转到p2 */
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: IsNull P1 P2 * * *
@@ -2433,28 +2496,28 @@ int sqlite3VdbeExec(
             ** Jump to P2 if the value in register P1 is NULL.
             ** 如果寄存器P1的值为NULL的话,跳转到指令P2处运行.
             */
-            case OP_IsNull:              /* same as TK_ISNULL, jump, in1 */
+            case OP_IsNull: OPLABEL(IsNull) /* same as TK_ISNULL, jump, in1 */
             {
                 pIn1 = &aMem[pOp->p1];
                 if ((pIn1->flags & MEM_Null) != 0)
                 {
                     pc = pOp->p2 - 1;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: NotNull P1 P2 * * *
             **
             ** Jump to P2 if the value in register P1 is not NULL.
             */
-            case OP_NotNull:              /* same as TK_NOTNULL, jump, in1 */
+            case OP_NotNull: OPLABEL(NotNull) /* same as TK_NOTNULL, jump, in1 */
             {
                 pIn1 = &aMem[pOp->p1];
                 if ((pIn1->flags & MEM_Null) == 0)
                 {
                     pc = pOp->p2 - 1;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Column P1 P2 P3 P4 P5
@@ -2486,7 +2549,7 @@ int sqlite3VdbeExec(
             ** or typeof() function, respectively.  The loading of large blobs can be
             ** skipped for length() and all content loading can be skipped for typeof().
             */
-            case OP_Column:
+            case OP_Column: OPLABEL(Column)
             {
                 u32 payloadSize;   /* Number of bytes in the record */
                 i64 payloadSize64; /* Number of bytes in the record */
@@ -2855,7 +2918,7 @@ int sqlite3VdbeExec(
             op_column_out:
                 UPDATE_MAX_BLOBSIZE(pDest);
                 REGISTER_TRACE(pOp->p3, pDest);
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Affinity P1 P2 * P4 *
@@ -2869,7 +2932,7 @@ int sqlite3VdbeExec(
             ** memory cell in the range.
             ** P4是一个字符串,长度为P2,第n个字符代表从寄存器P1开始的第n个寄存器列的affinity编码.
             */
-            case OP_Affinity:
+            case OP_Affinity: OPLABEL(Affinity)
             {
                 const char *zAffinity;   /* The affinity to be applied */
                 char cAff;               /* A single character of affinity */
@@ -2886,7 +2949,7 @@ int sqlite3VdbeExec(
                     applyAffinity(pIn1, cAff, encoding);
                     pIn1++;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: MakeRecord P1 P2 P3 P4 *
@@ -2907,7 +2970,7 @@ int sqlite3VdbeExec(
             **
             ** If P4 is NULL then all index fields have the affinity NONE.
             */
-            case OP_MakeRecord:
+            case OP_MakeRecord: OPLABEL(MakeRecord)
             {
                 /* 记录新的record */
                 u8 *zNewRecord;        /* A buffer to hold the data for the new record */
@@ -3040,7 +3103,7 @@ int sqlite3VdbeExec(
                 pOut->enc = SQLITE_UTF8;  /* In case the blob is ever converted to text */
                 REGISTER_TRACE(pOp->p3, pOut);
                 UPDATE_MAX_BLOBSIZE(pOut);
-                break;
+                NEXT_OPCODE;
             }
 
                 /* Opcode: Count P1 P2 * * *
@@ -3049,7 +3112,7 @@ int sqlite3VdbeExec(
                 ** opened by cursor P1 in register P2
                 */
 #ifndef SQLITE_OMIT_BTREECOUNT
-            case OP_Count:           /* out2-prerelease */
+            case OP_Count: OPLABEL(Count) /* out2-prerelease */
             {
                 i64 nEntry;
                 BtCursor *pCrsr;
@@ -3064,7 +3127,7 @@ int sqlite3VdbeExec(
                     nEntry = 0;
                 }
                 pOut->u.i = nEntry;
-                break;
+                NEXT_OPCODE;
             }
 #endif
 
@@ -3078,7 +3141,7 @@ int sqlite3VdbeExec(
             ** P1==1, 释放一个savepoint
             ** P1==2, 回滚一个savepoint
             */
-            case OP_Savepoint:
+            case OP_Savepoint: OPLABEL(Savepoint)
             {
                 int p1;                         /* Value of P1 operand */
                 char *zName;                    /* Name of savepoint */
@@ -3272,20 +3335,23 @@ int sqlite3VdbeExec(
                     }
                 }
 
-                break;
+                NEXT_OPCODE;
             }
 
-            /* Opcode: AutoCommit P1 P2 * * *
+            /* Opcode: AutoCommit P1 P2 P3 * *
             **
             ** Set the database auto-commit flag to P1 (1 or 0). If P2 is true, roll
             ** back any currently active btree transactions. If there are any active
             ** VMs (apart from this one), then a ROLLBACK fails.  A COMMIT fails if
             ** there are active writing VMs or active VMs that use shared cache.
+            **
+            ** When a transaction is begun (P1 is 0), P3 is true for BEGIN
+            ** CONCURRENT.
             ** 给数据库打上或者去掉auto-commit标记,(取决于P1的值),P2为true的话,回滚掉所有的事务.
             **
             ** This instruction causes the VM to halt.
             */
-            case OP_AutoCommit:
+            case OP_AutoCommit: OPLABEL(AutoCommit)
             {
                 int desiredAutoCommit;
                 int iRollback;
@@ -3335,6 +3401,7 @@ int sqlite3VdbeExec(
                         else
                         {
                             db->autoCommit = (u8)desiredAutoCommit;
+                            if (desiredAutoCommit == 0) db->bConcurrent = (u8)pOp->p3;
                             if (sqlite3VdbeHalt(p) == SQLITE_BUSY)
                             {
                                 p->pc = pc;
@@ -3364,7 +3431,7 @@ int sqlite3VdbeExec(
 
                         rc = SQLITE_ERROR;
                     }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Transaction P1 P2 * * *
@@ -3405,7 +3472,7 @@ int sqlite3VdbeExec(
             **
             ** If P2 is zero, then a read-lock is obtained on the database file.
             */
-            case OP_Transaction:
+            case OP_Transaction: OPLABEL(Transaction)
             {
                 Btree *pBt;
 
@@ -3451,7 +3518,7 @@ int sqlite3VdbeExec(
                         p->nStmtDefCons = db->nDeferredCons;
                     }
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: ReadCookie P1 P2 P3 * *
@@ -3470,7 +3537,7 @@ int sqlite3VdbeExec(
             ** must be started or there must be an open cursor) before
             ** executing this instruction.
             */
-            case OP_ReadCookie:                 /* out2-prerelease */
+            case OP_ReadCookie: OPLABEL(ReadCookie) /* out2-prerelease */
             {
                 int iMeta;
                 int iDb;
@@ -3485,7 +3552,7 @@ int sqlite3VdbeExec(
 
                 sqlite3BtreeGetMeta(db->aDb[iDb].pBt, iCookie, (u32 *)&iMeta);
                 pOut->u.i = iMeta;
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: SetCookie P1 P2 P3 * *
@@ -3504,7 +3571,7 @@ int sqlite3VdbeExec(
             **
             ** A transaction must be started before executing this opcode.
             */
-            case OP_SetCookie:         /* in3 */
+            case OP_SetCookie: OPLABEL(SetCookie) /* in3 */
             {
                 Db *pDb;
                 assert(pOp->p2 < SQLITE_N_BTREE_META);
@@ -3535,7 +3602,7 @@ int sqlite3VdbeExec(
                     sqlite3ExpirePreparedStatements(db);
                     p->expired = 0;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: VerifyCookie P1 P2 P3 * *
@@ -3561,7 +3628,7 @@ int sqlite3VdbeExec(
             ** to be executed (to establish a read lock) before this opcode is
             ** invoked.
             */
-            case OP_VerifyCookie:
+            case OP_VerifyCookie: OPLABEL(VerifyCookie)
             {
                 int iMeta;
                 int iGen;
@@ -3606,7 +3673,7 @@ int sqlite3VdbeExec(
                     p->expired = 1;
                     rc = SQLITE_SCHEMA;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: OpenRead P1 P2 P3 P4 P5
@@ -3672,8 +3739,8 @@ int sqlite3VdbeExec(
             **
             ** See also OpenRead.
             */
-            case OP_OpenRead:
-            case OP_OpenWrite:
+            case OP_OpenRead: OPLABEL(OpenRead)
+            case OP_OpenWrite: OPLABEL(OpenWrite)
             {
                 int nField;
                 KeyInfo *pKeyInfo;
@@ -3765,7 +3832,7 @@ int sqlite3VdbeExec(
                 ** since moved into the btree layer.  */
                 pCur->isTable = pOp->p4type != P4_KEYINFO;
                 pCur->isIndex = !pCur->isTable;
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: OpenEphemeral P1 P2 * P4 P5
@@ -3806,8 +3873,8 @@ int sqlite3VdbeExec(
             ** 此操作码和Op_OpenEphemera一样.仅仅是换了一个名称.通过此操作码创建的表将会
             ** 被用于joins中的临时索引.
             */
-            case OP_OpenAutoindex:
-            case OP_OpenEphemeral:
+            case OP_OpenAutoindex: OPLABEL(OpenAutoindex)
+            case OP_OpenEphemeral: OPLABEL(OpenEphemeral)
             {
                 VdbeCursor *pCx;
                 static const int vfsFlags =
@@ -3861,7 +3928,7 @@ int sqlite3VdbeExec(
                 }
                 pCx->isOrdered = (pOp->p5 != BTREE_UNORDERED);
                 pCx->isIndex = !pCx->isTable;
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: OpenSorter P1 P2 * P4 *
@@ -3871,7 +3938,7 @@ int sqlite3VdbeExec(
             ** tables using an external merge-sort algorithm.
             ** 此操作符类似于OP_OpenEphemeral,它打开一个临时的索引
             */
-            case OP_SorterOpen:
+            case OP_SorterOpen: OPLABEL(SorterOpen)
             {
                 VdbeCursor *pCx;
 #ifndef SQLITE_OMIT_MERGE_SORT
@@ -3885,7 +3952,7 @@ int sqlite3VdbeExec(
                 pOp->opcode = OP_OpenEphemeral;
                 pc--;
 #endif
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: OpenPseudo P1 P2 P3 * *
@@ -3908,7 +3975,7 @@ int sqlite3VdbeExec(
             ** the pseudo-table.
             ** P3寄存器中记录了记录中列的个数
             */
-            case OP_OpenPseudo:
+            case OP_OpenPseudo: OPLABEL(OpenPseudo)
             {
                 VdbeCursor *pCx;
 
@@ -3919,7 +3986,7 @@ int sqlite3VdbeExec(
                 pCx->pseudoTableReg = pOp->p2;
                 pCx->isTable = 1;
                 pCx->isIndex = 0;
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Close P1 * * * *
@@ -3928,12 +3995,12 @@ int sqlite3VdbeExec(
             ** currently open, this instruction is a no-op.
             ** 关闭P1指向的游标.
             */
-            case OP_Close:
+            case OP_Close: OPLABEL(Close)
             {
                 assert(pOp->p1 >= 0 && pOp->p1 < p->nCursor);
                 sqlite3VdbeFreeCursor(p, p->apCsr[pOp->p1]);
                 p->apCsr[pOp->p1] = 0;
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: SeekGe P1 P2 P3 P4 *
@@ -3999,10 +4066,10 @@ int sqlite3VdbeExec(
             ** 如果没有满足条件的记录,那么跳转到P2执行.
             ** See also: Found, NotFound, Distinct, SeekGt, SeekGe, SeekLt
             */
-            case OP_SeekLt:         /* jump, in3 */
-            case OP_SeekLe:         /* jump, in3 */
-            case OP_SeekGe:         /* jump, in3 */
-            case OP_SeekGt:         /* jump, in3 */
+            case OP_SeekLt: OPLABEL(SeekLt) /* jump, in3 */
+            case OP_SeekLe: OPLABEL(SeekLe) /* jump, in3 */
+            case OP_SeekGe: OPLABEL(SeekGe) /* jump, in3 */
+            case OP_SeekGt: OPLABEL(SeekGt) /* jump, in3 */
             {
                 int res;
                 int oc;
@@ -4187,7 +4254,7 @@ int sqlite3VdbeExec(
                     */
                     pc = pOp->p2 - 1;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Seek P1 P2 * * *
@@ -4202,7 +4269,7 @@ int sqlite3VdbeExec(
             ** 这实际是一个延迟移动,直到游标开始读记录之前,什么也不会发生.这意味着,如果没有读发生.
             ** 也不会有IO产生.
             */
-            case OP_Seek:      /* in2 */
+            case OP_Seek: OPLABEL(Seek) /* in2 */
             {
                 VdbeCursor *pC;
 
@@ -4218,7 +4285,7 @@ int sqlite3VdbeExec(
                     pC->rowidIsValid = 0;
                     pC->deferredMoveto = 1; /* 游标需要延迟移动 */
                 }
-                break;
+                NEXT_OPCODE;
             }
 
 
@@ -4251,8 +4318,8 @@ int sqlite3VdbeExec(
             **
             ** See also: Found, NotExists, IsUnique
             */
-            case OP_NotFound:       /* jump, in3 */
-            case OP_Found:          /* jump, in3 */
+            case OP_NotFound: OPLABEL(NotFound) /* jump, in3 */
+            case OP_Found: OPLABEL(Found) /* jump, in3 */
             {
                 int alreadyExists;
                 VdbeCursor *pC;
@@ -4323,7 +4390,7 @@ int sqlite3VdbeExec(
                 {
                     if (!alreadyExists) pc = pOp->p2 - 1; /* 不存在,跳转到P2指令执行 */
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: IsUnique P1 P2 P3 P4 *
@@ -4352,7 +4419,7 @@ int sqlite3VdbeExec(
             **
             ** See also: NotFound, NotExists, Found
             */
-            case OP_IsUnique:          /* jump, in3 */
+            case OP_IsUnique: OPLABEL(IsUnique) /* jump, in3 */
             {
                 u16 ii;
                 VdbeCursor *pCx;
@@ -4420,7 +4487,7 @@ int sqlite3VdbeExec(
                         pIn3->u.i = r.rowid;
                     }
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: NotExists P1 P2 P3 * *
@@ -4439,7 +4506,7 @@ int sqlite3VdbeExec(
             **
             ** See also: Found, NotFound, IsUnique
             */
-            case OP_NotExists:          /* jump, in3 */
+            case OP_NotExists: OPLABEL(NotExists) /* jump, in3 */
             {
                 VdbeCursor *pC;
                 BtCursor *pCrsr;
@@ -4480,7 +4547,7 @@ int sqlite3VdbeExec(
                     assert(pC->rowidIsValid == 0);
                     pC->seekResult = 0;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Sequence P1 P2 * * *
@@ -4492,12 +4559,12 @@ int sqlite3VdbeExec(
             ** instruction.
             ** 游标的序列值在这条指令之后,会增加
             */
-            case OP_Sequence:             /* out2-prerelease */
+            case OP_Sequence: OPLABEL(Sequence) /* out2-prerelease */
             {
                 assert(pOp->p1 >= 0 && pOp->p1 < p->nCursor);
                 assert(p->apCsr[pOp->p1] != 0);
                 pOut->u.i = p->apCsr[pOp->p1]->seqCount++;
-                break;
+                NEXT_OPCODE;
             }
 
 
@@ -4520,7 +4587,7 @@ int sqlite3VdbeExec(
             ** 如果P3>0,那么P3是VDBE root frame中的一个寄存器,它记录了先前生成的最大的record number.
             ** 新生成的record number要大于这个值.P3的值帮助实现AUTOINCREMENT特性.
             */
-            case OP_NewRowid:             /* out2-prerelease */
+            case OP_NewRowid: OPLABEL(NewRowid) /* out2-prerelease */
             {
                 /* 新的rowid */
                 i64 v;                 /* The new rowid */
@@ -4679,7 +4746,7 @@ int sqlite3VdbeExec(
                     pC->cacheStatus = CACHE_STALE;
                 }
                 pOut->u.i = v;
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Insert P1 P2 P3 P4 P5
@@ -4737,8 +4804,8 @@ int sqlite3VdbeExec(
             ** This works exactly like OP_Insert except that the key is the
             ** integer value P3, not the value of the integer stored in register P3.
             */
-            case OP_Insert:
-            case OP_InsertInt:
+            case OP_Insert: OPLABEL(Insert)
+            case OP_InsertInt: OPLABEL(InsertInt)
             {
                 /* pData指向需要插入的数据 */
                 Mem *pData;       /* MEM cell holding data for the record to be inserted */
@@ -4815,7 +4882,7 @@ int sqlite3VdbeExec(
                     db->xUpdateCallback(db->pUpdateArg, op, zDb, zTbl, iKey);
                     assert(pC->iDb >= 0);
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Delete P1 P2 * P4 *
@@ -4843,7 +4910,7 @@ int sqlite3VdbeExec(
             ** using OP_NotFound prior to invoking this opcode.
             ** 如果P4不为NULL,那么它应是P1所指向表的名称.update回调将会被调用,如果有的话.
             */
-            case OP_Delete:
+            case OP_Delete: OPLABEL(Delete)
             {
                 i64 iKey;
                 VdbeCursor *pC;
@@ -4892,7 +4959,7 @@ int sqlite3VdbeExec(
                     assert(pC->iDb >= 0);
                 }
                 if (pOp->p2 & OPFLAG_NCHANGE) p->nChange++;
-                break;
+                NEXT_OPCODE;
             }
             /* Opcode: ResetCount * * * * *
             **
@@ -4901,11 +4968,11 @@ int sqlite3VdbeExec(
             ** Then the VMs internal change counter resets to 0.
             ** This is used by trigger programs.
             */
-            case OP_ResetCount:
+            case OP_ResetCount: OPLABEL(ResetCount)
             {
                 sqlite3VdbeSetChanges(db, p->nChange);
                 p->nChange = 0;
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: SorterCompare P1 P2 P3
@@ -4917,7 +4984,7 @@ int sqlite3VdbeExec(
             ** 游标P1用于排序,此条指令比较排序游标当前指向的记录以及寄存器P3中的blob类型的记录.
             ** 如果在排除了rowid这一列之后,两个记录匹配,跳转到下一条指令,否则跳转到指令P2处执行.
             */
-            case OP_SorterCompare:
+            case OP_SorterCompare: OPLABEL(SorterCompare)
             {
                 VdbeCursor *pC;
                 int res;
@@ -4938,7 +5005,7 @@ int sqlite3VdbeExec(
             ** Write into register P2 the current sorter data for sorter cursor P1.
             ** 将当前排序游标P1指向的值写入P2寄存器
             */
-            case OP_SorterData:
+            case OP_SorterData: OPLABEL(SorterData)
             {
                 VdbeCursor *pC;
 #ifndef SQLITE_OMIT_MERGE_SORT
@@ -4950,7 +5017,7 @@ int sqlite3VdbeExec(
                 pOp->opcode = OP_RowKey;
                 pc--;
 #endif
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: RowData P1 P2 * * *
@@ -4975,8 +5042,8 @@ int sqlite3VdbeExec(
             ** If the P1 cursor must be pointing to a valid row (not a NULL row)
             ** of a real table, not a pseudo-table.
             */
-            case OP_RowKey:
-            case OP_RowData:
+            case OP_RowKey: OPLABEL(RowKey)
+            case OP_RowData: OPLABEL(RowData)
             {
                 VdbeCursor *pC;
                 BtCursor *pCrsr;
@@ -5044,7 +5111,7 @@ int sqlite3VdbeExec(
                 }
                 pOut->enc = SQLITE_UTF8;  /* In case the blob is ever cast to text */
                 UPDATE_MAX_BLOBSIZE(pOut);
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Rowid P1 P2 * * *
@@ -5059,7 +5126,7 @@ int sqlite3VdbeExec(
             ** 游标P1可以指向一个普通的表,也可以是一个虚拟表,对于虚拟表,这里通常会有一个VRowid操作码
             ** 但是这个操作码也适用.
             */
-            case OP_Rowid:                   /* out2-prerelease */
+            case OP_Rowid: OPLABEL(Rowid)    /* out2-prerelease */
             {
                 VdbeCursor *pC;
                 i64 v;
@@ -5105,7 +5172,7 @@ int sqlite3VdbeExec(
                     }
                 }
                 pOut->u.i = v;
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: NullRow P1 * * * *
@@ -5116,7 +5183,7 @@ int sqlite3VdbeExec(
             ** 将游标P1移动到一个空行(null row).当游标在一个空行上时执行Column,将会导致写入
             ** 一个NULL.
             */
-            case OP_NullRow:
+            case OP_NullRow: OPLABEL(NullRow)
             {
                 VdbeCursor *pC;
 
@@ -5130,7 +5197,7 @@ int sqlite3VdbeExec(
                 {
                     sqlite3BtreeClearCursor(pC->pCursor);
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Last P1 P2 * * *
@@ -5144,7 +5211,7 @@ int sqlite3VdbeExec(
             ** 如果表/索引为空,并且P2>0,那么立刻跳转到P2指令处运行.
             ** 如果P2为0,而且表/索引不为空,跳转到下一条指令.
             */
-            case OP_Last:          /* jump */
+            case OP_Last: OPLABEL(Last) /* jump */
             {
                 VdbeCursor *pC;
                 BtCursor *pCrsr;
@@ -5167,7 +5234,7 @@ int sqlite3VdbeExec(
                 {
                     pc = pOp->p2 - 1;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
 
@@ -5186,11 +5253,11 @@ int sqlite3VdbeExec(
             ** 所谓的排序,指的是,将一条记录写入一个sorting index,然后调整游标,重新遍历.
             ** 我们使用OP_Sort而不是OP_Rewind,仅仅是为了测试需要
             */
-            case OP_SorterSort:    /* jump */
+            case OP_SorterSort: OPLABEL(SorterSort) /* jump */
 #ifdef SQLITE_OMIT_MERGE_SORT
                 pOp->opcode = OP_Sort;
 #endif
-            case OP_Sort:          /* jump */
+            case OP_Sort: OPLABEL(Sort) /* jump */
             {
 #ifdef SQLITE_TEST
                 sqlite3_sort_count++; /**/
@@ -5210,7 +5277,7 @@ int sqlite3VdbeExec(
             ** 如果表/索引为空,P2>0,那么立即跳转到指令P2出运行,如果P2为0,或者表/索引不为空
             ** 继续执行下一条指令.
             */
-            case OP_Rewind:          /* jump */
+            case OP_Rewind: OPLABEL(Rewind) /* jump */
             {
                 VdbeCursor *pC;
                 BtCursor *pCrsr;
@@ -5241,7 +5308,7 @@ int sqlite3VdbeExec(
                 {
                     pc = pOp->p2 - 1;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Next P1 P2 * P4 P5
@@ -5285,12 +5352,12 @@ int sqlite3VdbeExec(
             ** number P5-1 in the prepared statement is incremented.
             ** 如果P5为正数,并且跳转发生了,那么在prepared statement中的事件计数器P5-1会递增.
             */
-            case OP_SorterNext:    /* jump */
+            case OP_SorterNext: OPLABEL(SorterNext) /* jump */
 #ifdef SQLITE_OMIT_MERGE_SORT
                 pOp->opcode = OP_Next;
 #endif
-            case OP_Prev:          /* jump */
-            case OP_Next:          /* jump */
+            case OP_Prev: OPLABEL(Prev) /* jump */
+            case OP_Next: OPLABEL(Next) /* jump */
             {
                 VdbeCursor *pC;
                 int res;
@@ -5329,7 +5396,7 @@ int sqlite3VdbeExec(
 #endif
                 }
                 pC->rowidIsValid = 0;
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: IdxInsert P1 P2 P3 * P5
@@ -5344,14 +5411,24 @@ int sqlite3VdbeExec(
             ** insert is likely to be an append.
             ** P3是一个标记,用于给b-tree层提供信息,插入很可能是追加.
             **
+            ** For OP_SorterInsert, P3 is instead either zero or a register
+            ** that holds, when the first key is inserted, the number of keys
+            ** that will be read from the sorter: the sum of the LIMIT and
+            ** OFFSET of a SELECT. Keys that would not be among them are
+            ** discarded (see sqlite3VdbeSorterLimit()).
+            **
+            ** If P5 has the OPFLAG_BULKINSERT bit set, the keys are written
+            ** to P1 in sorted order and the index is built by a bulk load.
+            ** The load is completed by an OP_IdxBulkEnd on P1.
+            **
             ** This instruction only works for indices.  The equivalent instruction
             ** for tables is OP_Insert.
             */
-            case OP_SorterInsert:       /* in2 */
+            case OP_SorterInsert: OPLABEL(SorterInsert) /* in2 */
 #ifdef SQLITE_OMIT_MERGE_SORT
                 pOp->opcode = OP_IdxInsert;
 #endif
-            case OP_IdxInsert:          /* in2 */
+            case OP_IdxInsert: OPLABEL(IdxInsert) /* in2 */
             {
                 VdbeCursor *pC;
                 BtCursor *pCrsr;
@@ -5373,6 +5450,11 @@ int sqlite3VdbeExec(
                     {
                         if (isSorter(pC))
                         {
+                            if (pOp->p3)
+                            {
+                                assert(pOp->p3 > 0 && pOp->p3 <= p->nMem);
+                                sqlite3VdbeSorterLimit(pC, sqlite3VdbeIntValue(&aMem[pOp->p3]));
+                            }
                             rc = sqlite3VdbeSorterWrite(db, pC, pIn2);
                         }
                         else
@@ -5380,15 +5462,40 @@ int sqlite3VdbeExec(
                             nKey = pIn2->n;
                             zKey = pIn2->z;
                             /* 插入数据,仅有key,没有data */
-                            rc = sqlite3BtreeInsert(pCrsr, zKey, nKey, "", 0, 0, pOp->p3,
-                                                    ((pOp->p5 & OPFLAG_USESEEKRESULT) ? pC->seekResult : 0)
-                                                   );
+                            if (pOp->p5 & OPFLAG_BULKINSERT)
+                            {
+                                rc = sqlite3BtreeBulkInsert(pCrsr, zKey, nKey);
+                            }
+                            else
+                            {
+                                rc = sqlite3BtreeInsert(pCrsr, zKey, nKey, "", 0, 0, pOp->p3,
+                                                        ((pOp->p5 & OPFLAG_USESEEKRESULT) ? pC->seekResult : 0)
+                                                       );
+                            }
                             assert(pC->deferredMoveto == 0);
                             pC->cacheStatus = CACHE_STALE;
                         }
                     }
                 }
-                break;
+                NEXT_OPCODE;
+            }
+
+            /* Opcode: IdxBulkEnd P1 * * * *
+            **
+            ** Complete the bulk load of index P1 started by OP_IdxInsert
+            ** instructions with the OPFLAG_BULKINSERT flag.  This is a no-op if
+            ** no keys were inserted.
+            */
+            case OP_IdxBulkEnd: OPLABEL(IdxBulkEnd)
+            {
+                VdbeCursor *pC;
+
+                assert(pOp->p1 >= 0 && pOp->p1 < p->nCursor);
+                pC = p->apCsr[pOp->p1];
+                assert(pC != 0 && pC->pCursor != 0);
+                rc = sqlite3BtreeBulkEnd(pC->pCursor);
+                pC->cacheStatus = CACHE_STALE;
+                NEXT_OPCODE;
             }
 
             /* Opcode: IdxDelete P1 P2 P3 * *
@@ -5399,7 +5506,7 @@ int sqlite3VdbeExec(
             ** 从寄存器P2到寄存器P3中的值构成一个unpacked index key,此操作码移除游标P1
             ** 指向的entry
             */
-            case OP_IdxDelete:
+            case OP_IdxDelete: OPLABEL(IdxDelete)
             {
                 VdbeCursor *pC;
                 BtCursor *pCrsr;
@@ -5433,7 +5540,7 @@ int sqlite3VdbeExec(
                     assert(pC->deferredMoveto == 0);
                     pC->cacheStatus = CACHE_STALE;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: IdxRowid P1 P2 * * *
@@ -5446,7 +5553,7 @@ int sqlite3VdbeExec(
             **
             ** See also: Rowid, MakeRecord.
             */
-            case OP_IdxRowid:                /* out2-prerelease */
+            case OP_IdxRowid: OPLABEL(IdxRowid) /* out2-prerelease */
             {
                 BtCursor *pCrsr;
                 VdbeCursor *pC;
@@ -5474,7 +5581,7 @@ int sqlite3VdbeExec(
                         pOut->flags = MEM_Int;
                     }
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: IdxGE P1 P2 P3 P4 P5
@@ -5513,8 +5620,8 @@ int sqlite3VdbeExec(
             ** to the comparison.  This makes the opcode work like IdxLE.
             ** 如果P5非0,那么在开始比较之前,key值将会减少一个epsilon,这会使得操作码很像IdxLE
             */
-            case OP_IdxLT:          /* jump */
-            case OP_IdxGE:          /* jump */
+            case OP_IdxLT: OPLABEL(IdxLT) /* jump */
+            case OP_IdxGE: OPLABEL(IdxGE) /* jump */
             {
                 VdbeCursor *pC;
                 int res;
@@ -5561,7 +5668,7 @@ int sqlite3VdbeExec(
                         pc = pOp->p2 - 1 ;
                     }
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Destroy P1 P2 P3 * *
@@ -5587,7 +5694,7 @@ int sqlite3VdbeExec(
             **
             ** See also: Clear
             */
-            case OP_Destroy:       /* out2-prerelease */
+            case OP_Destroy: OPLABEL(Destroy) /* out2-prerelease */
             {
                 int iMoved;
                 int iCnt;
@@ -5629,7 +5736,7 @@ int sqlite3VdbeExec(
                     }
 #endif
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Clear P1 P2 P3
@@ -5657,7 +5764,7 @@ int sqlite3VdbeExec(
             **
             ** See also: Destroy
             */
-            case OP_Clear:
+            case OP_Clear: OPLABEL(Clear)
             {
                 int nChange;
 
@@ -5676,7 +5783,7 @@ int sqlite3VdbeExec(
                         aMem[pOp->p3].u.i += nChange;
                     }
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: CreateTable P1 P2 * * *
@@ -5704,8 +5811,8 @@ int sqlite3VdbeExec(
             **
             ** See documentation on OP_CreateTable for additional information.
             */
-            case OP_CreateIndex:            /* out2-prerelease */
-            case OP_CreateTable:            /* out2-prerelease */
+            case OP_CreateIndex: OPLABEL(CreateIndex) /* out2-prerelease */
+            case OP_CreateTable: OPLABEL(CreateTable) /* out2-prerelease */
             {
                 int pgno;
                 int flags;
@@ -5727,7 +5834,7 @@ int sqlite3VdbeExec(
                 }
                 rc = sqlite3BtreeCreateTable(pDb->pBt, &pgno, flags); /* 创建表 */
                 pOut->u.i = pgno;
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: ParseSchema P1 * * P4 *
@@ -5740,7 +5847,7 @@ int sqlite3VdbeExec(
             ** This opcode invokes the parser to create a new virtual machine,
             ** then runs the new virtual machine.  It is thus a re-entrant opcode.
             */
-            case OP_ParseSchema:
+            case OP_ParseSchema: OPLABEL(ParseSchema)
             {
                 int iDb;
                 const char *zMaster;
@@ -5792,7 +5899,7 @@ int sqlite3VdbeExec(
                 {
                     goto no_mem;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
 #if !defined(SQLITE_OMIT_ANALYZE)
@@ -5802,11 +5909,11 @@ int sqlite3VdbeExec(
             ** of that table into the internal index hash table.  This will cause
             ** the analysis to be used when preparing all subsequent queries.
             */
-            case OP_LoadAnalysis:
+            case OP_LoadAnalysis: OPLABEL(LoadAnalysis)
             {
                 assert(pOp->p1 >= 0 && pOp->p1 < db->nDb);
                 rc = sqlite3AnalysisLoad(db, pOp->p1);
-                break;
+                NEXT_OPCODE;
             }
 #endif /* !defined(SQLITE_OMIT_ANALYZE) */
 
@@ -5817,10 +5924,10 @@ int sqlite3VdbeExec(
             ** is dropped in order to keep the internal representation of the
             ** schema consistent with what is on disk.
             */
-            case OP_DropTable:
+            case OP_DropTable: OPLABEL(DropTable)
             {
                 sqlite3UnlinkAndDeleteTable(db, pOp->p1, pOp->p4.z);
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: DropIndex P1 * * P4 *
@@ -5830,10 +5937,10 @@ int sqlite3VdbeExec(
             ** is dropped in order to keep the internal representation of the
             ** schema consistent with what is on disk.
             */
-            case OP_DropIndex:
+            case OP_DropIndex: OPLABEL(DropIndex)
             {
                 sqlite3UnlinkAndDeleteIndex(db, pOp->p1, pOp->p4.z);
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: DropTrigger P1 * * P4 *
@@ -5843,10 +5950,10 @@ int sqlite3VdbeExec(
             ** is dropped in order to keep the internal representation of the
             ** schema consistent with what is on disk.
             */
-            case OP_DropTrigger:
+            case OP_DropTrigger: OPLABEL(DropTrigger)
             {
                 sqlite3UnlinkAndDeleteTrigger(db, pOp->p1, pOp->p4.z);
-                break;
+                NEXT_OPCODE;
             }
 
 
@@ -5871,7 +5978,7 @@ int sqlite3VdbeExec(
             **
             ** This opcode is used to implement the integrity_check pragma.
             */
-            case OP_IntegrityCk:
+            case OP_IntegrityCk: OPLABEL(IntegrityCk)
             {
                 int nRoot;      /* Number of tables to check.  (Number of root pages.) */
                 int *aRoot;     /* Array of rootpage numbers for tables to be checked */
@@ -5915,7 +6022,7 @@ int sqlite3VdbeExec(
                 }
                 UPDATE_MAX_BLOBSIZE(pIn1);
                 sqlite3VdbeChangeEncoding(pIn1, encoding);
-                break;
+                NEXT_OPCODE;
             }
 #endif /* SQLITE_OMIT_INTEGRITY_CHECK */
 
@@ -5926,7 +6033,7 @@ int sqlite3VdbeExec(
             **
             ** An assertion fails if P2 is not an integer.
             */
-            case OP_RowSetAdd:         /* in1, in2 */
+            case OP_RowSetAdd: OPLABEL(RowSetAdd) /* in1, in2 */
             {
                 pIn1 = &aMem[pOp->p1];
                 pIn2 = &aMem[pOp->p2];
@@ -5937,7 +6044,7 @@ int sqlite3VdbeExec(
                     if ((pIn1->flags & MEM_RowSet) == 0) goto no_mem;
                 }
                 sqlite3RowSetInsert(pIn1->u.pRowSet, pIn2->u.i);
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: RowSetRead P1 P2 P3 * *
@@ -5946,7 +6053,7 @@ int sqlite3VdbeExec(
             ** register P3.  Or, if boolean index P1 is initially empty, leave P3
             ** unchanged and jump to instruction P2.
             */
-            case OP_RowSetRead:         /* jump, in1, out3 */
+            case OP_RowSetRead: OPLABEL(RowSetRead) /* jump, in1, out3 */
             {
                 i64 val;
                 CHECK_FOR_INTERRUPT;
@@ -5964,7 +6071,7 @@ int sqlite3VdbeExec(
                     /* A value was pulled from the index */
                     sqlite3VdbeMemSetInt64(&aMem[pOp->p3], val);
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: RowSetTest P1 P2 P3 P4
@@ -5990,7 +6097,7 @@ int sqlite3VdbeExec(
             ** previously inserted as part of set X (only if it was previously
             ** inserted as part of some other set).
             */
-            case OP_RowSetTest:                       /* jump, in1, in3 */
+            case OP_RowSetTest: OPLABEL(RowSetTest)   /* jump, in1, in3 */
             {
                 int iSet;
                 int exists;
@@ -6026,7 +6133,7 @@ int sqlite3VdbeExec(
                 {
                     sqlite3RowSetInsert(pIn1->u.pRowSet, pIn3->u.i);
                 }
-                break;
+                NEXT_OPCODE;
             }
 
 
@@ -6045,7 +6152,7 @@ int sqlite3VdbeExec(
             **
             ** P4 is a pointer to the VM containing the trigger program.
             */
-            case OP_Program:          /* jump */
+            case OP_Program: OPLABEL(Program) /* jump */
             {
                 int nMem;               /* Number of memory registers for sub-program */
                 int nByte;              /* Bytes of runtime space required for sub-program */
@@ -6156,7 +6263,7 @@ int sqlite3VdbeExec(
                 pc = -1;
                 memset(p->aOnceFlag, 0, p->nOnceFlag);
 
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: Param P1 P2 * * *
@@ -6171,14 +6278,14 @@ int sqlite3VdbeExec(
             ** the value of the P1 argument to the value of the P1 argument to the
             ** calling OP_Program instruction.
             */
-            case OP_Param:             /* out2-prerelease */
+            case OP_Param: OPLABEL(Param) /* out2-prerelease */
             {
                 VdbeFrame *pFrame;
                 Mem *pIn;
                 pFrame = p->pFrame;
                 pIn = &pFrame->aMem[pOp->p1 + pFrame->aOp[pFrame->pc].p1];
                 sqlite3VdbeMemShallowCopy(pOut, pIn, MEM_Ephem);
-                break;
+                NEXT_OPCODE;
             }
 
 #endif /* #ifndef SQLITE_OMIT_TRIGGER */
@@ -6191,7 +6298,7 @@ int sqlite3VdbeExec(
             ** (deferred foreign key constraints). Otherwise, if P1 is zero, the
             ** statement counter is incremented (immediate foreign key constraints).
             */
-            case OP_FkCounter:
+            case OP_FkCounter: OPLABEL(FkCounter)
             {
                 if (pOp->p1)
                 {
@@ -6201,7 +6308,7 @@ int sqlite3VdbeExec(
                 {
                     p->nFkConstraint += pOp->p2;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: FkIfZero P1 P2 * * *
@@ -6215,7 +6322,7 @@ int sqlite3VdbeExec(
             ** zero, the jump is taken if the statement constraint-counter is zero
             ** (immediate foreign key constraint violations).
             */
-            case OP_FkIfZero:           /* jump */
+            case OP_FkIfZero: OPLABEL(FkIfZero) /* jump */
             {
                 if (pOp->p1)
                 {
@@ -6225,7 +6332,7 @@ int sqlite3VdbeExec(
                 {
                     if (p->nFkConstraint == 0) pc = pOp->p2 - 1;
                 }
-                break;
+                NEXT_OPCODE;
             }
 #endif /* #ifndef SQLITE_OMIT_FOREIGN_KEY */
 
@@ -6240,7 +6347,7 @@ int sqlite3VdbeExec(
             ** This instruction throws an error if the memory cell is not initially
             ** an integer.
             */
-            case OP_MemMax:          /* in2 */
+            case OP_MemMax: OPLABEL(MemMax) /* in2 */
             {
                 Mem *pIn1;
                 VdbeFrame *pFrame;
@@ -6261,7 +6368,7 @@ int sqlite3VdbeExec(
                 {
                     pIn1->u.i = pIn2->u.i;
                 }
-                break;
+                NEXT_OPCODE;
             }
 #endif /* SQLITE_OMIT_AUTOINCREMENT */
 
@@ -6273,7 +6380,7 @@ int sqlite3VdbeExec(
             ** It is illegal to use this instruction on a register that does
             ** not contain an integer.  An assertion fault will result if you try.
             */
-            case OP_IfPos:          /* jump, in1 */
+            case OP_IfPos: OPLABEL(IfPos) /* jump, in1 */
             {
                 pIn1 = &aMem[pOp->p1];
                 assert(pIn1->flags & MEM_Int);
@@ -6281,7 +6388,7 @@ int sqlite3VdbeExec(
                 {
                     pc = pOp->p2 - 1;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: IfNeg P1 P2 * * *
@@ -6291,7 +6398,7 @@ int sqlite3VdbeExec(
             ** It is illegal to use this instruction on a register that does
             ** not contain an integer.  An assertion fault will result if you try.
             */
-            case OP_IfNeg:          /* jump, in1 */
+            case OP_IfNeg: OPLABEL(IfNeg) /* jump, in1 */
             {
                 pIn1 = &aMem[pOp->p1];
                 assert(pIn1->flags & MEM_Int);
@@ -6299,7 +6406,7 @@ int sqlite3VdbeExec(
                 {
                     pc = pOp->p2 - 1;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: IfZero P1 P2 P3 * *
@@ -6310,7 +6417,7 @@ int sqlite3VdbeExec(
             ** It is illegal to use this instruction on a register that does
             ** not contain an integer.  An assertion fault will result if you try.
             */
-            case OP_IfZero:          /* jump, in1 */
+            case OP_IfZero: OPLABEL(IfZero) /* jump, in1 */
             {
                 pIn1 = &aMem[pOp->p1];
                 assert(pIn1->flags & MEM_Int);
@@ -6319,7 +6426,7 @@ int sqlite3VdbeExec(
                 {
                     pc = pOp->p2 - 1;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: AggStep * P2 P3 P4 P5
@@ -6333,7 +6440,7 @@ int sqlite3VdbeExec(
             ** The P5 arguments are taken from register P2 and its
             ** successors.
             */
-            case OP_AggStep:
+            case OP_AggStep: OPLABEL(AggStep)
             {
                 int n;
                 int i;
@@ -6388,7 +6495,7 @@ int sqlite3VdbeExec(
 
                 sqlite3VdbeMemRelease(&ctx.s);
 
-                break;
+                NEXT_OPCODE;
             }
 
             /* Opcode: AggFinal P1 P2 * P4 *
@@ -6403,7 +6510,7 @@ int sqlite3VdbeExec(
             ** P4 argument is only needed for the degenerate case where
             ** the step function was not previously called.
             */
-            case OP_AggFinal:
+            case OP_AggFinal: OPLABEL(AggFinal)
             {
                 Mem *pMem;
                 assert(pOp->p1 > 0 && pOp->p1 <= p->nMem);
@@ -6420,7 +6527,7 @@ int sqlite3VdbeExec(
                 {
                     goto too_big;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
 #ifndef SQLITE_OMIT_WAL
@@ -6435,7 +6542,7 @@ int sqlite3VdbeExec(
             ** completes into mem[P3+2].  However on an error, mem[P3+1] and
             ** mem[P3+2] are initialized to -1.
             */
-            case OP_Checkpoint:
+            case OP_Checkpoint: OPLABEL(Checkpoint)
             {
                 int i;                          /* Loop counter */
                 int aRes[3];                    /* Results */
@@ -6473,7 +6580,7 @@ int sqlite3VdbeExec(
             **
             ** Write a string containing the final journal-mode to register P2.
             */
-            case OP_JournalMode:      /* out2-prerelease */
+            case OP_JournalMode: OPLABEL(JournalMode) /* out2-prerelease */
             {
                 Btree *pBt;                     /* Btree to change journal mode of */
                 Pager *pPager;                  /* Pager associated with pBt */
@@ -6583,10 +6690,10 @@ int sqlite3VdbeExec(
             ** machines to be created and run.  It may not be called from within
             ** a transaction.
             */
-            case OP_Vacuum:
+            case OP_Vacuum: OPLABEL(Vacuum)
             {
                 rc = sqlite3RunVacuum(&p->zErrMsg, db);
-                break;
+                NEXT_OPCODE;
             }
 #endif
 
@@ -6597,7 +6704,7 @@ int sqlite3VdbeExec(
             ** the P1 database. If the vacuum has finished, jump to instruction
             ** P2. Otherwise, fall through to the next instruction.
             */
-            case OP_IncrVacuum:          /* jump */
+            case OP_IncrVacuum: OPLABEL(IncrVacuum) /* jump */
             {
                 Btree *pBt;
 
@@ -6610,7 +6717,7 @@ int sqlite3VdbeExec(
                     pc = pOp->p2 - 1;
                     rc = SQLITE_OK;
                 }
-                break;
+                NEXT_OPCODE;
             }
 #endif
 
@@ -6623,7 +6730,7 @@ int sqlite3VdbeExec(
             ** If P1 is 0, then all SQL statements become expired. If P1 is non-zero,
             ** then only the currently executing statement is affected.
             */
-            case OP_Expire:
+            case OP_Expire: OPLABEL(Expire)
             {
                 if (!pOp->p1)
                 {
@@ -6633,7 +6740,7 @@ int sqlite3VdbeExec(
                 {
                     p->expired = 1;
                 }
-                break;
+                NEXT_OPCODE;
             }
 
 #ifndef SQLITE_OMIT_SHARED_CACHE
@@ -6655,7 +6762,7 @@ int sqlite3VdbeExec(
             ** used to generate an error message if the lock cannot be obtained.
             ** P4包含了一个指向被锁定表名的指针,这只是用于在无法获取锁的时候,生成错误信息.
             */
-            case OP_TableLock:
+            case OP_TableLock: OPLABEL(TableLock)
             {
                 u8 isWriteLock = (u8)pOp->p3;
                 if (isWriteLock || 0 == (db->flags & SQLITE_ReadUncommitted))
@@ -6671,7 +6778,7 @@ int sqlite3VdbeExec(
                         sqlite3SetString(&p->zErrMsg, db, "database table is locked: %s", z);
                     }
                 }
-                break;
+                NEXT_OPCODE;
             }
 #endif /* SQLITE_OMIT_SHARED_CACHE */
 
@@ -6685,13 +6792,13 @@ int sqlite3VdbeExec(
             ** within a callback to a virtual table xSync() method. If it is, the error
             ** code will be set to SQLITE_LOCKED.
             */
-            case OP_VBegin:
+            case OP_VBegin: OPLABEL(VBegin)
             {
                 VTable *pVTab;
                 pVTab = pOp->p4.pVtab;
                 rc = sqlite3VtabBegin(db, pVTab);
                 if (pVTab) importVtabErrMsg(p, pVTab->pVtab);
-                break;
+                NEXT_OPCODE;
             }
 #endif /* SQLITE_OMIT_VIRTUALTABLE */
 
@@ -6701,10 +6808,10 @@ int sqlite3VdbeExec(
             ** P4 is the name of a virtual table in database P1. Call the xCreate method
             ** for that table.
             */
-            case OP_VCreate:
+            case OP_VCreate: OPLABEL(VCreate)
             {
                 rc = sqlite3VtabCallCreate(db, pOp->p1, pOp->p4.z, &p->zErrMsg);
-                break;
+                NEXT_OPCODE;
             }
 #endif /* SQLITE_OMIT_VIRTUALTABLE */
 
@@ -6714,12 +6821,12 @@ int sqlite3VdbeExec(
             ** P4 is the name of a virtual table in database P1.  Call the xDestroy method
             ** of that table.
             */
-            case OP_VDestroy:
+            case OP_VDestroy: OPLABEL(VDestroy)
             {
                 p->inVtabMethod = 2;
                 rc = sqlite3VtabCallDestroy(db, pOp->p1, pOp->p4.z);
                 p->inVtabMethod = 0;
-                break;
+                NEXT_OPCODE;
             }
 #endif /* SQLITE_OMIT_VIRTUALTABLE */
 
@@ -6730,7 +6837,7 @@ int sqlite3VdbeExec(
             ** P1 is a cursor number.  This opcode opens a cursor to the virtual
             ** table and stores that cursor in P1.
             */
-            case OP_VOpen:
+            case OP_VOpen: OPLABEL(VOpen)
             {
                 VdbeCursor *pCur;
                 sqlite3_vtab_cursor *pVtabCursor;
@@ -6762,7 +6869,7 @@ int sqlite3VdbeExec(
                         pModule->xClose(pVtabCursor);
                     }
                 }
-                break;
+                NEXT_OPCODE;
             }
 #endif /* SQLITE_OMIT_VIRTUALTABLE */
 
@@ -6785,7 +6892,7 @@ int sqlite3VdbeExec(
             **
             ** A jump is made to P2 if the result set after filtering would be empty.
             */
-            case OP_VFilter:     /* jump */
+            case OP_VFilter: OPLABEL(VFilter) /* jump */
             {
                 int nArg;
                 int iQuery;
@@ -6840,7 +6947,7 @@ int sqlite3VdbeExec(
                 }
                 pCur->nullRow = 0;
 
-                break;
+                NEXT_OPCODE;
             }
 #endif /* SQLITE_OMIT_VIRTUALTABLE */
 
@@ -6851,7 +6958,7 @@ int sqlite3VdbeExec(
             ** the row of the virtual-table that the
             ** P1 cursor is pointing to into register P3.
             */
-            case OP_VColumn:
+            case OP_VColumn: OPLABEL(VColumn)
             {
                 sqlite3_vtab *pVtab;
                 const sqlite3_module *pModule;
@@ -6901,7 +7008,7 @@ int sqlite3VdbeExec(
                 {
                     goto too_big;
                 }
-                break;
+                NEXT_OPCODE;
             }
 #endif /* SQLITE_OMIT_VIRTUALTABLE */
 
@@ -6912,7 +7019,7 @@ int sqlite3VdbeExec(
             ** jump to instruction P2.  Or, if the virtual table has reached
             ** the end of its result set, then fall through to the next instruction.
             */
-            case OP_VNext:     /* jump */
+            case OP_VNext: OPLABEL(VNext) /* jump */
             {
                 sqlite3_vtab *pVtab;
                 const sqlite3_module *pModule;
@@ -6950,7 +7057,7 @@ int sqlite3VdbeExec(
                     /* If there is data, jump to P2 */
                     pc = pOp->p2 - 1;
                 }
-                break;
+                NEXT_OPCODE;
             }
 #endif /* SQLITE_OMIT_VIRTUALTABLE */
 
@@ -6961,7 +7068,7 @@ int sqlite3VdbeExec(
             ** This opcode invokes the corresponding xRename method. The value
             ** in register P1 is passed as the zName argument to the xRename method.
             */
-            case OP_VRename:
+            case OP_VRename: OPLABEL(VRename)
             {
                 sqlite3_vtab *pVtab;
                 Mem *pName;
@@ -6982,7 +7089,7 @@ int sqlite3VdbeExec(
                     importVtabErrMsg(p, pVtab);
                     p->expired = 0;
                 }
-                break;
+                NEXT_OPCODE;
             }
 #endif
 
@@ -7010,7 +7117,7 @@ int sqlite3VdbeExec(
             ** is successful, then the value returned by sqlite3_last_insert_rowid()
             ** is set to the value of the rowid for the row just inserted.
             */
-            case OP_VUpdate:
+            case OP_VUpdate: OPLABEL(VUpdate)
             {
                 sqlite3_vtab *pVtab;
                 sqlite3_module *pModule;
@@ -7065,7 +7172,7 @@ int sqlite3VdbeExec(
                         p->nChange++;
                     }
                 }
-                break;
+                NEXT_OPCODE;
             }
 #endif /* SQLITE_OMIT_VIRTUALTABLE */
 
@@ -7074,10 +7181,10 @@ int sqlite3VdbeExec(
             **
             ** Write the current number of pages in database P1 to memory cell P2.
             */
-            case OP_Pagecount:              /* out2-prerelease */
+            case OP_Pagecount: OPLABEL(Pagecount) /* out2-prerelease */
             {
                 pOut->u.i = sqlite3BtreeLastPage(db->aDb[pOp->p1].pBt);
-                break;
+                NEXT_OPCODE;
             }
 #endif
 
@@ -7091,7 +7198,7 @@ int sqlite3VdbeExec(
             **
             ** Store the maximum page count after the change in register P2.
             */
-            case OP_MaxPgcnt:              /* out2-prerelease */
+            case OP_MaxPgcnt: OPLABEL(MaxPgcnt) /* out2-prerelease */
             {
                 unsigned int newMax;
                 Btree *pBt;
@@ -7104,7 +7211,7 @@ int sqlite3VdbeExec(
                     if (newMax < (unsigned)pOp->p3) newMax = (unsigned)pOp->p3;
                 }
                 pOut->u.i = sqlite3BtreeMaxPageCount(pBt, newMax);
-                break;
+                NEXT_OPCODE;
             }
 #endif
 
@@ -7116,7 +7223,7 @@ int sqlite3VdbeExec(
             ** the UTF-8 string contained in P4 is emitted on the trace callback.
             ** 如果tracing功能开启,那么P4中UTF-8字符串在跟踪回调中发出(emit)
             */
-            case OP_Trace:
+            case OP_Trace: OPLABEL(Trace)
             {
                 char *zTrace; /* 字符串 */
                 char *z;
@@ -7135,7 +7242,7 @@ int sqlite3VdbeExec(
                     sqlite3DebugPrintf("SQL-trace: %s\n", zTrace);
                 }
 #endif /* SQLITE_DEBUG */
-                break;
+                NEXT_OPCODE;
             }
 #endif
 
@@ -7151,7 +7258,7 @@ int sqlite3VdbeExec(
             ** This opcode records information from the optimizer.  It is the
             ** the same as a no-op.  This opcodesnever appears in a real VM program.
             */
-            default:            /* This is really OP_Noop and OP_Explain */
+            default: OPLABEL(default)  /* This is really OP_Noop and OP_Explain */
             {
                 assert(pOp->opcode == OP_Noop || pOp->opcode == OP_Explain);
                 break;
@@ -223,6 +223,7 @@ char *sqlite3VdbeExpandSql(Vdbe*, const char*);
 
 void sqlite3VdbeRecordUnpack(KeyInfo*, int, const void*, UnpackedRecord*);
 int sqlite3VdbeRecordCompare(int, const void*, UnpackedRecord*);
+int sqlite3VdbeRecordIntKey(UnpackedRecord*, i64*);
 UnpackedRecord *sqlite3VdbeAllocUnpackedRecord(KeyInfo *, char *, int, char **);
 
 #ifndef SQLITE_OMIT_TRIGGER
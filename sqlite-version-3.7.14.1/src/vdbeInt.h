@@ -353,7 +353,7 @@ struct Vdbe
     yDbMask btreeMask;      /* Bitmask of db->aDb[] entries referenced */
     yDbMask lockMask;       /* Subset of btreeMask that requires a lock */
     int iStatement;         /* Statement number (or 0 if has not opened stmt) */
-    int aCounter[3];        /* Counters used by sqlite3_stmt_status() */
+    int aCounter[4];        /* Counters used by sqlite3_stmt_status() */
 #ifndef SQLITE_OMIT_TRACE
     i64 startTime;          /* Time when query started - used for profiling */
 #endif
@@ -450,6 +450,7 @@ int sqlite3VdbeTransferError(Vdbe *p);
 #ifdef SQLITE_OMIT_MERGE_SORT
 # define sqlite3VdbeSorterInit(Y,Z)      SQLITE_OK
 # define sqlite3VdbeSorterWrite(X,Y,Z)   SQLITE_OK
+# define sqlite3VdbeSorterLimit(Y,Z)
 # define sqlite3VdbeSorterClose(Y,Z)
 # define sqlite3VdbeSorterRowkey(Y,Z)    SQLITE_OK
 # define sqlite3VdbeSorterRewind(X,Y,Z)  SQLITE_OK
@@ -462,6 +463,7 @@ int sqlite3VdbeSorterRowkey(const VdbeCursor *, Mem *);
 int sqlite3VdbeSorterNext(sqlite3 *, const VdbeCursor *, int *);
 int sqlite3VdbeSorterRewind(sqlite3 *, const VdbeCursor *, int *);
 int sqlite3VdbeSorterWrite(sqlite3 *, const VdbeCursor *, Mem *);
+void sqlite3VdbeSorterLimit(const VdbeCursor *, i64);
 int sqlite3VdbeSorterCompare(const VdbeCursor *, Mem *, int *);
 #endif
 
@@ -1817,6 +1817,10 @@ void sqlite3VdbeFreeCursor(Vdbe *p, VdbeCursor *pCx)
         return;
     }
     sqlite3VdbeSorterClose(p->db, pCx);
+    if (pCx->pCursor)
+    {
+        p->aCounter[SQLITE_STMTSTATUS_RESEEK - 1] += sqlite3BtreeSeekSaved(pCx->pCursor);
+    }
     if (pCx->pBt)
     {
         sqlite3BtreeClose(pCx->pBt);
@@ -3526,6 +3530,29 @@ int sqlite3VdbeRecordCompare(
     return rc;
 }
 
+/*
+** If the first field of unpacked record pPKey2 is an integer, write it
+** to *piVal and return non-zero. The b-tree layer uses this to compare
+** pPKey2 with a record on the integer in its first field, without calling
+** sqlite3VdbeRecordCompare(), when the two differ in that field.
+**
+** Zero is returned if the comparison would have side effects that such a
+** shortcut would miss: an UNPACKED_PREFIX_SEARCH key with one field.
+*/
+int sqlite3VdbeRecordIntKey(UnpackedRecord *pPKey2, i64 *piVal)
+{
+    Mem *pMem = pPKey2->aMem;
+    if (pPKey2->nField < 1
+        || (pPKey2->nField == 1 && (pPKey2->flags & UNPACKED_PREFIX_SEARCH))
+        || (pMem->flags & (MEM_Int | MEM_Real | MEM_Null | MEM_Str | MEM_Blob)) != MEM_Int
+       )
+    {
+        return 0;
+    }
+    *piVal = pMem->u.i;
+    return 1;
+}
+
 
 /*
 ** pCur points at an index entry created using the OP_MakeRecord opcode.
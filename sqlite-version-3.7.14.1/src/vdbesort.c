@@ -20,9 +20,31 @@
 
 #ifndef SQLITE_OMIT_MERGE_SORT
 
+/*
+** The number of worker threads used by each sorter. The in-memory lists
+** are sorted, and all but the last level of a multi-level merge are
+** merged, on these threads (see SorterPool) in builds that implement
+** threads (see threads.c). If it is 0, or elsewhere, all of the work is
+** done by the calling thread.
+*/
+#ifndef SQLITE_SORTER_THREADS
+# define SQLITE_SORTER_THREADS 4
+#endif
+#if defined(SQLITE_THREADS_IMPLEMENTED) && SQLITE_SORTER_THREADS>0
+# define SORTER_THREADS 1
+#endif
+
 typedef struct VdbeSorterIter VdbeSorterIter;
 typedef struct SorterRecord SorterRecord;
+typedef struct SorterEntry SorterEntry;
+typedef struct SorterChunk SorterChunk;
+typedef struct SorterList SorterList;
+typedef struct SorterPma SorterPma;
 typedef struct FileWriter FileWriter;
+typedef struct SorterCmp SorterCmp;
+typedef struct SorterMerger SorterMerger;
+typedef struct SorterJob SorterJob;
+typedef struct SorterPool SorterPool;
 
 /*
 ** NOTES ON DATA STRUCTURE USED FOR N-WAY MERGES:
@@ -52,8 +74,8 @@ typedef struct FileWriter FileWriter;
 ** 我们假定数组实际包含N个元素.(每一个迭代器每一次迭代都可以产生一个元素,迭代器产生的元素是有序的.)
 **
 ** The aTree[] array is also N elements in size. The value of N is stored in
-** the VdbeSorter.nTree variable.
-** aTree[]数组也是N个元素,N存储在VdbeSorter.nTree变量中.
+** the SorterMerger.nTree variable.
+** aTree[]数组也是N个元素,N存储在SorterMerger.nTree变量中.
 **
 ** The final (N/2) elements of aTree[] contain the results of comparing
 ** pairs of iterator keys together. Element i contains the result of
@@ -124,30 +146,122 @@ typedef struct FileWriter FileWriter;
 ** being merged (rounded up to the next power of 2).
 ** 也就是说,我们每次前进到sorter的下一个元素时,需要做log2(N)次key比较,这里的N是要合并的段的个数.
 */
+struct SorterMerger
+{
+    int nTree;                      /* Used size of aTree/aIter (power of 2) */
+    /* 要合并的迭代器构成的数组 */
+    VdbeSorterIter *aIter;          /* Array of iterators to merge */
+    int *aTree;                     /* Current state of incremental merge */
+};
+
+/*
+** The key information used to compare two records, and space to unpack
+** one of them into. Each thread that compares records has its own.
+*/
+struct SorterCmp
+{
+    KeyInfo *pKeyInfo;              /* How to compare records */
+    UnpackedRecord *pUnpacked;      /* Used to unpack keys */
+};
+
+/*
+** A structure to store a single record. The nVal bytes of the record
+** itself follow it, at SRVAL(p). Records are allocated from the chunks
+** of the arena of a SorterList.
+** 用于存储单条记录的结构,记录的内容紧跟在结构之后
+*/
+struct SorterRecord
+{
+    int nVal;                       /* Size of the record in bytes */
+};
+#define SRVAL(p) ((void *)&((SorterRecord *)(p))[1])
+
+/*
+** An entry in the array of records held in memory. iPrefix is derived
+** from the first field of the record (see vdbeSorterPrefix()), so that
+** most pairs of entries may be ordered by comparing iPrefix alone.
+*/
+struct SorterEntry
+{
+    u64 iPrefix;                    /* Normalized prefix of the key */
+    SorterRecord *pRec;             /* The record */
+};
+
+/*
+** A chunk of the arena that records are allocated from. The nAlloc bytes
+** of space follow it.
+*/
+struct SorterChunk
+{
+    SorterChunk *pNext;             /* Next chunk of the arena */
+    int nAlloc;                     /* Bytes of space in this chunk */
+    int nUsed;                      /* Bytes of that space in use */
+};
+
+/*
+** The records held in memory: an array of entries, sorted in place, and
+** the arena their records are allocated from. Nothing here is allocated
+** from the database handle, so a list may be handed to a worker thread
+** to sort, and freed on any thread.
+*/
+struct SorterList
+{
+    SorterEntry *aEntry;            /* Array of entries */
+    int nEntry;                     /* Number of entries in aEntry[] */
+    int nAlloc;                     /* Allocated size of aEntry[] */
+    SorterChunk *pChunk;            /* Chunk new records are allocated from */
+};
+
+/*
+** The extent of a PMA in a temp file. The keys of a PMA are compressed as
+** they are written (see fileWriterWriteKey()), so a PMA may take up fewer
+** than the nMax bytes it would take up uncompressed. If the merges of a
+** level are run on worker threads, each is given nMax bytes of the file
+** it writes to, so that they may be run in any order, or all at once.
+*/
+struct SorterPma
+{
+    i64 iOff;                       /* Offset of the PMA in its file */
+    i64 nByte;                      /* Size of the PMA in bytes */
+    i64 nMax;                       /* Size of the PMA uncompressed */
+};
+
 struct VdbeSorter
 {
     /* 当前pTemp1文件的写偏移 */
     i64 iWriteOff;                  /* Current write offset within file pTemp1 */
-    /* 当前pTemp1文件的读偏移 */
-    i64 iReadOff;                   /* Current read offset within file pTemp1 */
-    int nInMemory;                  /* Current size of pRecord list as PMA */
-    int nTree;                      /* Used size of aTree/aIter (power of 2) */
+    int nInMemory;                  /* Current size of list as PMA */
+    int nInFlight;                  /* Size of lists queued for workers */
     /* 存储在pTemp1文件中的PMA的个数 */
     int nPMA;                       /* Number of PMAs stored in pTemp1 */
+    int nPmaAlloc;                  /* Allocated size of aPma[] */
+    SorterPma *aPma;                /* Extent of each PMA in pTemp1 */
     int mnPmaSize;                  /* Minimum PMA size, in bytes */
     int mxPmaSize;                  /* Maximum PMA size, in bytes.  0==no limit */
-    /* 要合并的迭代器构成的数组 */
-    VdbeSorterIter *aIter;          /* Array of iterators to merge */
-    int *aTree;                     /* Current state of incremental merge */
+    int pgsz;                       /* Size of the PMA I/O buffers */
+    SorterMerger merger;            /* Merge of the PMAs in pTemp1 */
     sqlite3_file *pTemp1;           /* PMA file 1 */
-    SorterRecord *pRecord;          /* Head of in-memory record list */
-    UnpackedRecord *pUnpacked;      /* Used to unpack keys */
+    SorterList list;                /* Records held in memory */
+    int iList;                      /* Current entry of list, once sorted */
+    i64 nLimit;                     /* Records to return, or 0 for all */
+    i64 nRead;                      /* Records returned so far */
+    int nGarbage;                   /* Bytes of discarded records in list */
+    u8 bTextPrefix;                 /* True if text is ordered by its prefix */
+    u8 bDescPrefix;                 /* True if the first field is DESC */
+    SorterCmp cmp;                  /* Comparison context of the VDBE */
+    SorterPool *pPool;              /* Worker threads, or NULL */
 };
 
 /*
 ** The following type is an iterator for a PMA. It caches the current key in
 ** variables nKey/aKey. If the iterator is at EOF, pFile==0.
 ** PMA的一个迭代器,它缓存着当前的key
+**
+** If the PMA lies within a memory mapping of pFile (see sqlite3OsFetch()),
+** aMap points to the start of the mapping, and aKey points into it for
+** each key that is stored whole. Otherwise the PMA is read into aBuffer.
+** Keys that share a prefix with the key before them are rebuilt in
+** aKeyAlloc in either case.
 */
 struct VdbeSorterIter
 {
@@ -159,10 +273,14 @@ struct VdbeSorterIter
     int nAlloc;                     /* Bytes of space at aAlloc */
     int nKey;                       /* Number of bytes in key */
     sqlite3_file *pFile;            /* File iterator is reading from */
+    SorterPool *pPool;              /* Pool to serialize reads with, or NULL */
     u8 *aAlloc;                     /* Allocated space */
     u8 *aKey;                       /* Pointer to current key */
     u8 *aBuffer;                    /* Current read buffer */
     int nBuffer;                    /* Size of read buffer in bytes */
+    u8 *aMap;                       /* Mapping of pFile, or NULL */
+    int nKeyAlloc;                  /* Bytes of space at aKeyAlloc */
+    u8 *aKeyAlloc;                  /* Space to rebuild keys in */
 };
 
 /*
@@ -185,35 +303,151 @@ struct FileWriter
     int iBufEnd;                    /* Last byte of buffer to write */
     i64 iWriteOff;                  /* Offset of start of buffer in file */
     sqlite3_file *pFile;            /* File to write to */
+    SorterPool *pPool;              /* Pool to serialize writes with, or NULL */
+    const u8 *aPrev;                /* Previous key written */
+    int nPrev;                      /* Size of aPrev[] in bytes */
+    int nPrevAlloc;                 /* Bytes of space at aPrevAlloc */
+    u8 *aPrevAlloc;                 /* Copy of the previous key, if required */
 };
 
+/* Minimum allowable value for the VdbeSorter.nWorking variable */
+#define SORTER_MIN_WORKING 10
+
+/* Minimum size of a chunk of the record arena, in bytes. */
+#define SORTER_CHUNK_SIZE 16384
+
+/* Maximum number of segments to merge in a single pass. */
+#define SORTER_MAX_MERGE_COUNT 16
+
+/* Minimum prefix a key must share with the key before it in a PMA for
+** the prefix to be left out. */
+#define SORTER_MIN_SHARED 4
+
+/* Size of the record of an nKey byte key in a PMA, uncompressed. */
+#define SORTER_PMA_RECORD_SIZE(nKey) (sqlite3VarintLen((u64)(nKey) * 2) + (nKey))
+
 /*
-** A structure to store a single record. All in-memory records are connected
-** together into a linked list headed at VdbeSorter.pRecord using the
-** SorterRecord.pNext pointer.
-** 用于存储单条记录的结果,所有内存中的记录都被连接在一起,构成链表,链表头部位VdbeSorter.pRecord
+** A unit of work that may be handed to a worker thread. It is either
+** a sort job, which sorts list, or a merge job, which merges the nPma
+** PMAs of pIn at aIn[] into a single PMA written to pOut.
 */
-struct SorterRecord
+struct SorterJob
 {
-    void *pVal;
-    int nVal;
-    SorterRecord *pNext;
+    SorterList list;                /* List to sort (sort jobs only) */
+    int nPma;                       /* Number of PMAs to merge, or 0 */
+    sqlite3_file *pIn;              /* File containing the PMAs to merge */
+    const SorterPma *aIn;           /* Extents of the PMAs to merge */
+    sqlite3_file *pOut;             /* File to write the merged PMA to */
+    SorterPma *pNew;                /* IN/OUT: Extent of the merged PMA */
+    int nInMemory;                  /* Size of list as PMA (sort jobs only) */
+    int rc;                         /* Result of the job */
 };
 
-/* Minimum allowable value for the VdbeSorter.nWorking variable */
-#define SORTER_MIN_WORKING 10
+#ifdef SORTER_THREADS
+/*
+** The worker threads of a sorter, started when its first PMA is spilled.
+**
+** Jobs are queued in the ring of pThreads, and retired by the thread that
+** queued them in the order they were queued, so the PMAs are written, and
+** so read back, in the same order as when the work is all done on one
+** thread. Only the thread that queued the sort jobs writes their lists to
+** disk. Merge jobs read and write the temp files themselves, so any I/O
+** done while they run holds the ioMutex.
+*/
+struct SorterPool
+{
+    SQLiteThreadPool *pThreads;     /* The worker threads */
+    int nThread;                    /* Number of threads started */
+    int nBuf;                       /* Size of the PMA I/O buffers */
+    KeyInfo *pKeyInfo;              /* Copy of the key info with db==0 */
+    sqlite3_mutex *ioMutex;         /* Serializes I/O on the temp files */
+    SorterJob aJob[SQLITE_SORTER_THREADS];  /* Jobs, indexed by slot */
+};
+#endif
 
-/* Maximum number of segments to merge in a single pass. */
-#define SORTER_MAX_MERGE_COUNT 16
+/*
+** Read or write nByte bytes at offset iOff of temp file pFile, holding
+** the I/O mutex of pPool if it is not NULL.
+*/
+static int vdbeSorterOsRead(
+    SorterPool *pPool, sqlite3_file *pFile, void *aBuf, int nByte, i64 iOff
+)
+{
+    int rc;
+#ifdef SORTER_THREADS
+    if (pPool) sqlite3_mutex_enter(pPool->ioMutex);
+#endif
+    rc = sqlite3OsRead(pFile, aBuf, nByte, iOff);
+#ifdef SORTER_THREADS
+    if (pPool) sqlite3_mutex_leave(pPool->ioMutex);
+#endif
+    return rc;
+}
+static int vdbeSorterOsWrite(
+    SorterPool *pPool, sqlite3_file *pFile, const void *aBuf, int nByte, i64 iOff
+)
+{
+    int rc;
+#ifdef SORTER_THREADS
+    if (pPool) sqlite3_mutex_enter(pPool->ioMutex);
+#endif
+    rc = sqlite3OsWrite(pFile, aBuf, nByte, iOff);
+#ifdef SORTER_THREADS
+    if (pPool) sqlite3_mutex_leave(pPool->ioMutex);
+#endif
+    return rc;
+}
+
+/*
+** Obtain a pointer to a memory mapping of the first nByte bytes of temp
+** file pFile, or set *ppMap to NULL if there is none, or release such a
+** pointer, holding the I/O mutex of pPool if it is not NULL. Memory
+** mapped reads are only used if the VFS supports xFetch().
+*/
+static int vdbeSorterOsFetch(
+    SorterPool *pPool, sqlite3_file *pFile, i64 nByte, u8 **ppMap
+)
+{
+    int rc = SQLITE_OK;
+    *ppMap = 0;
+    if (pFile->pMethods->iVersion >= 3 && nByte <= SQLITE_MAX_MMAP_SIZE)
+    {
+        void *pMap = 0;
+#ifdef SORTER_THREADS
+        if (pPool) sqlite3_mutex_enter(pPool->ioMutex);
+#endif
+        rc = sqlite3OsFetch(pFile, 0, (int)nByte, &pMap);
+#ifdef SORTER_THREADS
+        if (pPool) sqlite3_mutex_leave(pPool->ioMutex);
+#endif
+        *ppMap = (u8 *)pMap;
+    }
+    return rc;
+}
+static void vdbeSorterOsUnfetch(SorterPool *pPool, sqlite3_file *pFile, u8 *aMap)
+{
+#ifdef SORTER_THREADS
+    if (pPool) sqlite3_mutex_enter(pPool->ioMutex);
+#endif
+    sqlite3OsUnfetch(pFile, 0, aMap);
+#ifdef SORTER_THREADS
+    if (pPool) sqlite3_mutex_leave(pPool->ioMutex);
+#endif
+}
 
 /*
 ** Free all memory belonging to the VdbeSorterIter object passed as the second
 ** argument. All structure fields are set to zero before returning.
 */
-static void vdbeSorterIterZero(sqlite3 *db, VdbeSorterIter *pIter)
+static void vdbeSorterIterZero(VdbeSorterIter *pIter)
 {
-    sqlite3DbFree(db, pIter->aAlloc);
-    sqlite3DbFree(db, pIter->aBuffer);
+    if (pIter->aMap)
+    {
+        vdbeSorterOsUnfetch(pIter->pPool, pIter->pFile, pIter->aMap);
+    }
+    sqlite3_free(pIter->aAlloc);
+    sqlite3_free(pIter->aBuffer);
+    sqlite3_free(pIter->aKeyAlloc);
     memset(pIter, 0, sizeof(VdbeSorterIter));
 }
 
@@ -230,9 +464,11 @@ static void vdbeSorterIterZero(sqlite3 *db, VdbeSorterIter *pIter)
 ** *ppOut指向的缓冲区会一直有效,直到下一次调用此函数
 ** @param nByte 要读取的字节数
 ** @param **ppout 指向缓冲区
+**
+** Iterators may be used by worker threads, so their buffers are allocated
+** with sqlite3_malloc() rather than from the database handle.
 */
 static int vdbeSorterIterRead(
-    sqlite3 *db,                    /* Database handle (for malloc) */
     VdbeSorterIter *p,              /* Iterator */
     int nByte,                      /* Bytes of data to read */
     u8 **ppOut                      /* OUT: Pointer to buffer containing data */
@@ -240,6 +476,13 @@ static int vdbeSorterIterRead(
 {
     int iBuf;                       /* Offset within buffer to read from */
     int nAvail;                     /* Bytes of data available in buffer */
+
+    if (p->aMap)
+    {
+        *ppOut = &p->aMap[p->iReadOff];
+        p->iReadOff += nByte;
+        return SQLITE_OK;
+    }
     assert(p->aBuffer);
 
     /* If there is no more data to be read from the buffer, read the next
@@ -261,7 +504,7 @@ static int vdbeSorterIterRead(
 
         /* Read data from the file. Return early if an error occurs. */
         /* 读取nRead个字节的数据 */
-        rc = sqlite3OsRead(p->pFile, p->aBuffer, nRead, p->iReadOff);
+        rc = vdbeSorterOsRead(p->pPool, p->pFile, p->aBuffer, nRead, p->iReadOff);
         assert(rc != SQLITE_IOERR_SHORT_READ);
         if (rc != SQLITE_OK) return rc;
     }
@@ -286,9 +529,11 @@ static int vdbeSorterIterRead(
         if (p->nAlloc < nByte)
         {
             int nNew = p->nAlloc * 2;
+            u8 *aNew;
             while (nByte > nNew) nNew = nNew * 2;
-            p->aAlloc = sqlite3DbReallocOrFree(db, p->aAlloc, nNew);
-            if (!p->aAlloc) return SQLITE_NOMEM;
+            aNew = (u8 *)sqlite3_realloc(p->aAlloc, nNew);
+            if (!aNew) return SQLITE_NOMEM;
+            p->aAlloc = aNew;
             p->nAlloc = nNew;
         }
 
@@ -308,7 +553,7 @@ static int vdbeSorterIterRead(
 
             nCopy = nRem;
             if (nRem > p->nBuffer) nCopy = p->nBuffer;
-            rc = vdbeSorterIterRead(db, p, nCopy, &aNext);
+            rc = vdbeSorterIterRead(p, nCopy, &aNext);
             if (rc != SQLITE_OK) return rc;
             assert(aNext != p->aAlloc);
             memcpy(&p->aAlloc[nByte - nRem], aNext, nCopy);
@@ -326,10 +571,15 @@ static int vdbeSorterIterRead(
 ** the value read.
 ** 从数据流中读取一个可变大小的int(varint), 将*pnOut设置为读取到的数据
 */
-static int vdbeSorterIterVarint(sqlite3 *db, VdbeSorterIter *p, u64 *pnOut)
+static int vdbeSorterIterVarint(VdbeSorterIter *p, u64 *pnOut)
 {
     int iBuf;
 
+    if (p->aMap)
+    {
+        p->iReadOff += sqlite3GetVarint(&p->aMap[p->iReadOff], pnOut);
+        return SQLITE_OK;
+    }
     iBuf = p->iReadOff % p->nBuffer;
     if (iBuf && (p->nBuffer - iBuf) >= 9) /* 长度足够存储一个varint */
     {
@@ -341,7 +591,7 @@ static int vdbeSorterIterVarint(sqlite3 *db, VdbeSorterIter *p, u64 *pnOut)
         int i = 0, rc;
         do
         {
-            rc = vdbeSorterIterRead(db, p, 1, &a);
+            rc = vdbeSorterIterRead(p, 1, &a);
             if (rc) return rc;
             aVarint[(i++) & 0xf] = a[0];
         }
@@ -353,103 +603,156 @@ static int vdbeSorterIterVarint(sqlite3 *db, VdbeSorterIter *p, u64 *pnOut)
 }
 
 
+/*
+** Make sure that there are at least nByte bytes of space at
+** pIter->aKeyAlloc, keeping the bytes already there. Return SQLITE_OK
+** if successful, or SQLITE_NOMEM otherwise.
+*/
+static int vdbeSorterIterKeyAlloc(VdbeSorterIter *pIter, int nByte)
+{
+    if (pIter->nKeyAlloc < nByte)
+    {
+        int nNew = pIter->nKeyAlloc ? pIter->nKeyAlloc * 2 : 128;
+        u8 *aNew;
+        while (nByte > nNew) nNew = nNew * 2;
+        aNew = (u8 *)sqlite3_realloc(pIter->aKeyAlloc, nNew);
+        if (!aNew) return SQLITE_NOMEM;
+        if (pIter->aKey == pIter->aKeyAlloc) pIter->aKey = aNew;
+        pIter->aKeyAlloc = aNew;
+        pIter->nKeyAlloc = nNew;
+    }
+    return SQLITE_OK;
+}
+
 /*
 ** Advance iterator pIter to the next key in its PMA. Return SQLITE_OK if
 ** no error occurs, or an SQLite error code if one does.
 ** 移动迭代器到下一个元素
+**
+** A key that shares a prefix with the key before it is rebuilt from that
+** prefix and the rest of the key read from the PMA. The current key is
+** saved first if it is in the read buffer and the buffer may be refilled
+** before the size of the prefix is known.
 */
 static int vdbeSorterIterNext(
-    sqlite3 *db,                    /* Database handle (for sqlite3DbMalloc() ) */
     VdbeSorterIter *pIter           /* Iterator to advance */
 )
 {
-    int rc;                         /* Return Code */
-    u64 nRec = 0;                   /* Size of record in bytes */
+    int rc = SQLITE_OK;             /* Return Code */
+    u64 iVal = 0;                   /* Size of key suffix, and shared flag */
+    u64 nShared = 0;                /* Bytes shared with the previous key */
+    int nSuffix;                    /* Bytes of the key in the PMA */
 
     if (pIter->iReadOff >= pIter->iEof)
     {
         /* This is an EOF condition */
-        vdbeSorterIterZero(db, pIter); /* 迭代器迭代完毕 */
+        vdbeSorterIterZero(pIter); /* 迭代器迭代完毕 */
         return SQLITE_OK;
     }
 
-    rc = vdbeSorterIterVarint(db, pIter, &nRec);
-    if (rc == SQLITE_OK)
+    if (pIter->aMap == 0 && pIter->aKey
+            && pIter->aKey != pIter->aAlloc && pIter->aKey != pIter->aKeyAlloc)
+    {
+        int iBuf = pIter->iReadOff % pIter->nBuffer;
+        if (iBuf == 0 || pIter->nBuffer - iBuf < 18)
+        {
+            rc = vdbeSorterIterKeyAlloc(pIter, pIter->nKey);
+            if (rc != SQLITE_OK) return rc;
+            memcpy(pIter->aKeyAlloc, pIter->aKey, pIter->nKey);
+            pIter->aKey = pIter->aKeyAlloc;
+        }
+    }
+
+    rc = vdbeSorterIterVarint(pIter, &iVal);
+    if (rc == SQLITE_OK && (iVal & 1))
+    {
+        rc = vdbeSorterIterVarint(pIter, &nShared);
+    }
+    if (rc != SQLITE_OK) return rc;
+    nSuffix = (int)(iVal >> 1);
+
+    if (nShared == 0)
+    {
+        pIter->nKey = nSuffix; /* key所占的字节数目 */
+        rc = vdbeSorterIterRead(pIter, nSuffix, &pIter->aKey); /* 读取key的值 */
+    }
+    else
     {
-        pIter->nKey = (int)nRec; /* key所占的字节数目 */
-        rc = vdbeSorterIterRead(db, pIter, (int)nRec, &pIter->aKey); /* 读取key的值 */
+        u8 *aPrev = pIter->aKey;    /* Previous key, unless in aKeyAlloc */
+        u8 *aSuffix;
+        assert((int)nShared <= pIter->nKey);
+        if (aPrev == pIter->aKeyAlloc) aPrev = 0;
+        rc = vdbeSorterIterKeyAlloc(pIter, (int)nShared + nSuffix);
+        if (rc == SQLITE_OK)
+        {
+            if (aPrev) memcpy(pIter->aKeyAlloc, aPrev, (int)nShared);
+            pIter->aKey = pIter->aKeyAlloc;
+            pIter->nKey = (int)nShared + nSuffix;
+            if (nSuffix > 0)
+            {
+                rc = vdbeSorterIterRead(pIter, nSuffix, &aSuffix);
+                if (rc == SQLITE_OK) memcpy(&pIter->aKey[nShared], aSuffix, nSuffix);
+            }
+        }
     }
 
     return rc;
 }
 
 /*
-** Initialize iterator pIter to scan through the PMA stored in file pFile
-** starting at offset iStart and ending at offset iEof-1. This function
-** leaves the iterator pointing to the first key in the PMA (or EOF if the
-** PMA is empty).
-** 初始化一个迭代器pIter,用来扫描存储在文件pFile中的PMA, 文件偏移量为iStart,结尾为iEof-1
+** Initialize iterator pIter to scan through PMA pPma of file pFile. This
+** function leaves the iterator pointing to the first key in the PMA (or
+** EOF if the PMA is empty).
+** 初始化一个迭代器pIter,用来扫描存储在文件pFile中的PMA
 ** 此函数让迭代器指向第一个key.
 */
 static int vdbeSorterIterInit(
-    sqlite3 *db,                    /* Database handle */
-    const VdbeSorter *pSorter,      /* Sorter object */
-    /* 从文件的偏移量iStart处开始读取 */
-    i64 iStart,                     /* Start offset in pFile */
-    VdbeSorterIter *pIter,          /* Iterator to populate */
-    i64 *pnByte                     /* IN/OUT: Increment this value by PMA size */
+    SorterPool *pPool,              /* Pool to serialize reads with, or NULL */
+    sqlite3_file *pFile,            /* File containing the PMA */
+    const SorterPma *pPma,          /* Extent of the PMA in pFile */
+    int nBuf,                       /* Size of read buffer in bytes */
+    VdbeSorterIter *pIter           /* Iterator to populate */
 )
 {
-    int rc = SQLITE_OK;
-    int nBuf;
-
-    nBuf = sqlite3BtreeGetPageSize(db->aDb[0].pBt);
+    int rc;
+    i64 iStart = pPma->iOff;        /* Start offset in pFile */
 
-    assert(pSorter->iWriteOff > iStart);
+    assert(pPma->nByte > 0);
     assert(pIter->aAlloc == 0);
     assert(pIter->aBuffer == 0);
-    pIter->pFile = pSorter->pTemp1;
+    pIter->pFile = pFile;
+    pIter->pPool = pPool;
     pIter->iReadOff = iStart; /* 记录下偏移量 */
-    pIter->nAlloc = 128;
-    pIter->aAlloc = (u8 *)sqlite3DbMallocRaw(db, pIter->nAlloc); /* 128字节的缓冲区 */
-    pIter->nBuffer = nBuf;
-    pIter->aBuffer = (u8 *)sqlite3DbMallocRaw(db, nBuf);
+    pIter->iEof = iStart + pPma->nByte;
 
-    if (!pIter->aBuffer)
-    {
-        rc = SQLITE_NOMEM;
-    }
-    else
+    rc = vdbeSorterOsFetch(pPool, pFile, pIter->iEof, &pIter->aMap);
+    if (rc == SQLITE_OK && pIter->aMap == 0)
     {
         int iBuf;
+        pIter->nAlloc = 128;
+        pIter->aAlloc = (u8 *)sqlite3Malloc(pIter->nAlloc); /* 128字节的缓冲区 */
+        pIter->nBuffer = nBuf;
+        pIter->aBuffer = (u8 *)sqlite3Malloc(nBuf);
+        if (!pIter->aBuffer || !pIter->aAlloc) return SQLITE_NOMEM;
 
         iBuf = iStart % nBuf;
         if (iBuf)
         {
             int nRead = nBuf - iBuf;
-            if ((iStart + nRead) > pSorter->iWriteOff)
+            if ((iStart + nRead) > pIter->iEof)
             {
-                nRead = (int)(pSorter->iWriteOff - iStart);
+                nRead = (int)(pIter->iEof - iStart);
             }
-            rc = sqlite3OsRead(
-                     pSorter->pTemp1, &pIter->aBuffer[iBuf], nRead, iStart
+            rc = vdbeSorterOsRead(
+                     pPool, pFile, &pIter->aBuffer[iBuf], nRead, iStart
                  );
             assert(rc != SQLITE_IOERR_SHORT_READ);
         }
-
-        if (rc == SQLITE_OK)
-        {
-            u64 nByte;                       /* Size of PMA in bytes */
-            pIter->iEof = pSorter->iWriteOff;
-            rc = vdbeSorterIterVarint(db, pIter, &nByte);
-            pIter->iEof = pIter->iReadOff + nByte;
-            *pnByte += nByte;
-        }
     }
 
     if (rc == SQLITE_OK)
     {
-        rc = vdbeSorterIterNext(db, pIter);
+        rc = vdbeSorterIterNext(pIter);
     }
     return rc;
 }
@@ -472,21 +775,20 @@ static int vdbeSorterIterInit(
 ** 如果bOmitRowid参数为非零,假定keys以一个rowid结尾.出于比较的目的,忽略它,如果bOmitRowid为true
 ** 并且key1包含了只有单个NULL值,
 **
-** If pKey2 is passed a NULL pointer, then it is assumed that the pCsr->aSpace
-** has been allocated and contains an unpacked record that is used as key2.
-** 如果pKey2为NULL,那么pCsr->aSpace肯定不为空,而且包含了一个unpacked record,那么将其作为key2
+** If pKey2 is passed a NULL pointer, then it is assumed that pCmp->pUnpacked
+** already contains the unpacked record that is used as key2.
+** 如果pKey2为NULL,那么pCmp->pUnpacked中已经包含了一个unpacked record,那么将其作为key2
 */
 static void vdbeSorterCompare(
-    const VdbeCursor *pCsr,         /* Cursor object (for pKeyInfo) */
+    const SorterCmp *pCmp,          /* Key info and space to unpack key2 */
     int bOmitRowid,                 /* Ignore rowid field at end of keys */
     const void *pKey1, int nKey1,   /* Left side of comparison */
     const void *pKey2, int nKey2,   /* Right side of comparison */
     int *pRes                       /* OUT: Result of comparison */
 )
 {
-    KeyInfo *pKeyInfo = pCsr->pKeyInfo;
-    VdbeSorter *pSorter = pCsr->pSorter;
-    UnpackedRecord *r2 = pSorter->pUnpacked;
+    KeyInfo *pKeyInfo = pCmp->pKeyInfo;
+    UnpackedRecord *r2 = pCmp->pUnpacked;
     int i;
 
     if (pKey2)
@@ -519,31 +821,34 @@ static void vdbeSorterCompare(
 ** 此函数用于比较两个迭代器的key,当合并多个b-tree segments的时候,参数iOut是aTree[]数组
 ** 的下标
 */
-static int vdbeSorterDoCompare(const VdbeCursor *pCsr, int iOut)
+static int vdbeSorterDoCompare(
+    const SorterCmp *pCmp,          /* Comparison context */
+    SorterMerger *pMerger,          /* Merge to update */
+    int iOut                        /* Index of aTree[] entry to recalculate */
+)
 {
-    VdbeSorter *pSorter = pCsr->pSorter;
     int i1;
     int i2;
     int iRes;
     VdbeSorterIter *p1;
     VdbeSorterIter *p2;
 
-    assert(iOut < pSorter->nTree && iOut > 0);
+    assert(iOut < pMerger->nTree && iOut > 0);
     /* i1以及i2表示要比较的两个迭代器 */
 
-    if (iOut >= (pSorter->nTree / 2))
+    if (iOut >= (pMerger->nTree / 2))
     {
-        i1 = (iOut - pSorter->nTree / 2) * 2;
+        i1 = (iOut - pMerger->nTree / 2) * 2;
         i2 = i1 + 1;
     }
     else /* 二路合并 */
     {
-        i1 = pSorter->aTree[iOut * 2];
-        i2 = pSorter->aTree[iOut * 2 + 1];
+        i1 = pMerger->aTree[iOut * 2];
+        i2 = pMerger->aTree[iOut * 2 + 1];
     }
 
-    p1 = &pSorter->aIter[i1];
-    p2 = &pSorter->aIter[i2];
+    p1 = &pMerger->aIter[i1];
+    p2 = &pMerger->aIter[i2];
 
     if (p1->pFile == 0)
     {
@@ -556,9 +861,9 @@ static int vdbeSorterDoCompare(const VdbeCursor *pCsr, int iOut)
     else /*  */
     {
         int res;
-        assert(pCsr->pSorter->pUnpacked != 0);  /* allocated in vdbeSorterMerge() */
+        assert(pCmp->pUnpacked != 0);
         vdbeSorterCompare(
-            pCsr, 0, p1->aKey, p1->nKey, p2->aKey, p2->nKey, &res
+            pCmp, 0, p1->aKey, p1->nKey, p2->aKey, p2->nKey, &res
         );
         if (res <= 0)
         {
@@ -570,10 +875,72 @@ static int vdbeSorterDoCompare(const VdbeCursor *pCsr, int iOut)
         }
     }
 
-    pSorter->aTree[iOut] = iRes; /* 记录下比较的结果,也就是迭代器的下标 */
+    pMerger->aTree[iOut] = iRes; /* 记录下比较的结果,也就是迭代器的下标 */
     return SQLITE_OK;
 }
 
+/*
+** Initialize merge pMerger, whose iterators are all at EOF, to merge the
+** nPma PMAs of pFile at aPma[].
+*/
+static int vdbeSorterMergerInit(
+    const SorterCmp *pCmp,          /* Comparison context */
+    SorterMerger *pMerger,          /* Merge to initialize */
+    SorterPool *pPool,              /* Pool to serialize reads with, or NULL */
+    sqlite3_file *pFile,            /* File containing the PMAs */
+    const SorterPma *aPma,          /* Extents of the PMAs */
+    int nPma,                       /* Number of PMAs to merge */
+    int nBuf                        /* Size of read buffers in bytes */
+)
+{
+    int rc = SQLITE_OK;             /* Return code */
+    int i;                          /* Used to iterator through aIter[] */
+
+    assert(nPma <= pMerger->nTree);
+
+    /* Initialize the iterators.
+    ** 初始化迭代器
+    */
+    for (i = 0; rc == SQLITE_OK && i < nPma; i++)
+    {
+        /* 从文件中读取出PMA */
+        rc = vdbeSorterIterInit(pPool, pFile, &aPma[i], nBuf, &pMerger->aIter[i]);
+    }
+
+    /* Initialize the aTree[] array.
+    ** 初始化aTree[]数组
+    */
+    for (i = pMerger->nTree - 1; rc == SQLITE_OK && i > 0; i--)
+    {
+        rc = vdbeSorterDoCompare(pCmp, pMerger, i);
+    }
+
+    return rc;
+}
+
+/*
+** Advance merge pMerger to its next key. Set *pbEof if there is none.
+*/
+static int vdbeSorterMergerNext(
+    const SorterCmp *pCmp,          /* Comparison context */
+    SorterMerger *pMerger,          /* Merge to advance */
+    int *pbEof                      /* OUT: True if the merge is at EOF */
+)
+{
+    int iPrev = pMerger->aTree[1];  /* Index of iterator to advance */
+    int i;                          /* Index of aTree[] to recalculate */
+    int rc;                         /* Return code */
+
+    rc = vdbeSorterIterNext(&pMerger->aIter[iPrev]);
+    for (i = (pMerger->nTree + iPrev) / 2; rc == SQLITE_OK && i > 0; i = i / 2)
+    {
+        rc = vdbeSorterDoCompare(pCmp, pMerger, i);
+    }
+
+    *pbEof = (pMerger->aIter[pMerger->aTree[1]].pFile == 0);
+    return rc;
+}
+
 /*
 ** Initialize the temporary index cursor just opened as a sorter cursor.
 ** 初始化一个临时的sorter游标
@@ -592,13 +959,26 @@ int sqlite3VdbeSorterInit(sqlite3 *db, VdbeCursor *pCsr)
         return SQLITE_NOMEM;
     }
 
-    pSorter->pUnpacked = sqlite3VdbeAllocUnpackedRecord(pCsr->pKeyInfo, 0, 0, &d);
-    if (pSorter->pUnpacked == 0) return SQLITE_NOMEM;
-    assert(pSorter->pUnpacked == (UnpackedRecord *)d);
+    pSorter->cmp.pKeyInfo = pCsr->pKeyInfo;
+    pSorter->cmp.pUnpacked = sqlite3VdbeAllocUnpackedRecord(pCsr->pKeyInfo, 0, 0, &d);
+    if (pSorter->cmp.pUnpacked == 0) return SQLITE_NOMEM;
+    assert(pSorter->cmp.pUnpacked == (UnpackedRecord *)d);
 
+    /* Text in the first field of a key may be ordered by its leading bytes
+    ** only if it is compared with memcmp(), in the encoding of the key. */
+    if (pCsr->pKeyInfo->nField > 0)
+    {
+        CollSeq *pColl = pCsr->pKeyInfo->aColl[0];
+        pSorter->bTextPrefix = sqlite3IsBinary(pColl)
+                               && (pColl == 0 || pColl->enc == pCsr->pKeyInfo->enc);
+        pSorter->bDescPrefix = pCsr->pKeyInfo->aSortOrder != 0
+                               && pCsr->pKeyInfo->aSortOrder[0] != 0;
+    }
+
+    pgsz = sqlite3BtreeGetPageSize(db->aDb[0].pBt); /* 页的大小 */
+    pSorter->pgsz = pgsz;
     if (!sqlite3TempInMemory(db))
     {
-        pgsz = sqlite3BtreeGetPageSize(db->aDb[0].pBt); /* 页的大小 */
         pSorter->mnPmaSize = SORTER_MIN_WORKING * pgsz;
         mxCache = db->aDb[0].pSchema->cache_size;
         if (mxCache < SORTER_MIN_WORKING) mxCache = SORTER_MIN_WORKING;
@@ -609,171 +989,429 @@ int sqlite3VdbeSorterInit(sqlite3 *db, VdbeCursor *pCsr)
 }
 
 /*
-** Free the list of sorted records starting at pRecord.
+** Free the entries of list pList, and the arena its records were
+** allocated from, and zero it.
 */
-static void vdbeSorterRecordFree(sqlite3 *db, SorterRecord *pRecord)
+static void vdbeSorterListFree(SorterList *pList)
 {
-    SorterRecord *p;
-    SorterRecord *pNext;
-    for (p = pRecord; p; p = pNext)
+    SorterChunk *p;
+    SorterChunk *pNext;
+    for (p = pList->pChunk; p; p = pNext)
     {
         pNext = p->pNext;
-        sqlite3DbFree(db, p);
+        sqlite3_free(p);
     }
+    sqlite3_free(pList->aEntry);
+    memset(pList, 0, sizeof(SorterList));
 }
 
 /*
-** Free any cursor components allocated by sqlite3VdbeSorterXXX routines.
+** Return the normalized prefix of the nKey byte record aKey, to be added
+** to the sorter pSorter.
+**
+** The prefix is derived from the first field of the record alone. If the
+** prefix of record A is less than that of record B, then A sorts before B.
+** If the prefixes are equal, the records must be compared in full. The two
+** most significant bits hold the storage class of the field, in the order
+** in which the classes sort (NULL, numeric, text, blob). The rest hold the
+** leading bits of an order-preserving encoding of its value:
+**
+**   * Numeric values are converted to doubles. The IEEE bit pattern of a
+**     double is made to sort as an unsigned integer by inverting it if it
+**     is negative and setting its sign bit otherwise. As integers larger
+**     than 2^53 may share a double, they may share a prefix too.
+**
+**   * The first 8 bytes of blobs are used, as big-endian integers, zero
+**     padded. So is text, provided that the first field of the key is
+**     compared using memcmp() (see VdbeSorter.bTextPrefix). Otherwise all
+**     text values share a prefix.
+**
+** If the first field is sorted in descending order, the prefix is inverted.
 */
-void sqlite3VdbeSorterClose(sqlite3 *db, VdbeCursor *pCsr)
+static u64 vdbeSorterPrefix(const VdbeSorter *pSorter, const u8 *aKey, int nKey)
 {
-    VdbeSorter *pSorter = pCsr->pSorter;
-    if (pSorter)
+    u32 szHdr;                      /* Size of record header in bytes */
+    u32 iType;                      /* Serial type of the first field */
+    int iOff;                       /* Offset of serial type in aKey[] */
+    u64 iClass;                     /* Storage class of the first field */
+    u64 iVal = 0;                   /* Encoding of the first field */
+    Mem mem;                        /* The first field */
+    u64 iPrefix;
+
+    iOff = getVarint32(aKey, szHdr);
+    if (iOff >= (int)szHdr || szHdr > (u32)nKey) return 0;
+    getVarint32(&aKey[iOff], iType);
+    if (szHdr + sqlite3VdbeSerialTypeLen(iType) > (u32)nKey) return 0;
+    sqlite3VdbeSerialGet(&aKey[szHdr], iType, &mem);
+
+    if (mem.flags & MEM_Null)
+    {
+        iClass = 0;
+    }
+    else if (mem.flags & (MEM_Int | MEM_Real))
     {
-        if (pSorter->aIter)
+        iClass = 1;
+#if !defined(SQLITE_OMIT_FLOATING_POINT) && !defined(SQLITE_MIXED_ENDIAN_64BIT_FLOAT)
         {
-            int i;
-            for (i = 0; i < pSorter->nTree; i++)
+            double r = (mem.flags & MEM_Int) ? (double)mem.u.i : mem.r;
+            if (r == 0.0) r = 0.0;      /* -0.0 and 0.0 compare equal */
+            assert(sizeof(r) == sizeof(iVal));
+            memcpy(&iVal, &r, sizeof(iVal));
+            if (iVal & (((u64)1) << 63))
+            {
+                iVal = ~iVal;
+            }
+            else
             {
-                vdbeSorterIterZero(db, &pSorter->aIter[i]);
+                iVal |= (((u64)1) << 63);
             }
-            sqlite3DbFree(db, pSorter->aIter);
         }
-        if (pSorter->pTemp1)
+#endif
+    }
+    else
+    {
+        iClass = (mem.flags & MEM_Str) ? 2 : 3;
+        if (iClass == 3 || pSorter->bTextPrefix)
         {
-            sqlite3OsCloseFree(pSorter->pTemp1);
+            const u8 *z = (const u8 *)mem.z;
+            int n = mem.n < 8 ? mem.n : 8;
+            int i;
+            for (i = 0; i < n; i++)
+            {
+                iVal |= ((u64)z[i]) << (56 - 8 * i);
+            }
         }
-        vdbeSorterRecordFree(db, pSorter->pRecord);
-        sqlite3DbFree(db, pSorter->pUnpacked);
-        sqlite3DbFree(db, pSorter);
-        pCsr->pSorter = 0;
     }
-}
 
-/*
-** Allocate space for a file-handle and open a temporary file. If successful,
-** set *ppFile to point to the malloc'd file-handle and return SQLITE_OK.
-** Otherwise, set *ppFile to 0 and return an SQLite error code.
-*/
-static int vdbeSorterOpenTempFile(sqlite3 *db, sqlite3_file **ppFile)
-{
-    int dummy;
-    return sqlite3OsOpenMalloc(db->pVfs, 0, ppFile,
-                               SQLITE_OPEN_TEMP_JOURNAL |
-                               SQLITE_OPEN_READWRITE    | SQLITE_OPEN_CREATE |
-                               SQLITE_OPEN_EXCLUSIVE    | SQLITE_OPEN_DELETEONCLOSE, &dummy
-                              );
+    iPrefix = (iClass << 62) | (iVal >> 2);
+    return pSorter->bDescPrefix ? ~iPrefix : iPrefix;
 }
 
 /*
-** Merge the two sorted lists p1 and p2 into a single list.
-** Set *ppOut to the head of the new list.
-** 将两个有序链表p1以及p2合并成单个链表,将*ppOut设置为新链表的头部
+** Allocate a copy of the nVal byte record pVal from the arena of list
+** pList. Return a pointer to it, or NULL if a malloc fails.
+**
+** Records are allocated from chunks of at least SORTER_CHUNK_SIZE bytes.
+** A record too large to share a chunk is given one of its own, which is
+** linked in after the current chunk, so that the space left in the current
+** chunk is still used.
 */
-static void vdbeSorterMerge(
-    const VdbeCursor *pCsr,         /* For pKeyInfo */
-    SorterRecord *p1,               /* First list to merge */
-    SorterRecord *p2,               /* Second list to merge */
-    SorterRecord **ppOut            /* OUT: Head of merged list */
+static SorterRecord *vdbeSorterListAlloc(
+    SorterList *pList,              /* List to allocate from */
+    const void *pVal,               /* Record to copy */
+    int nVal                        /* Size of pVal in bytes */
 )
 {
-    SorterRecord *pFinal = 0;
-    SorterRecord **pp = &pFinal;
-    void *pVal2 = p2 ? p2->pVal : 0;
-    /* 举一个例子:
-    ** p1-\
-    **     1 --> 3 --> 5
-    ** p2-\
-    **     2 --> 4 --> 6
-    ** 排序完成之后:
-    ** pFinal--\
-    **         1 --> 2 --> 3 --> 4 --> 5 --> 6
-    **
-    */
-    while (p1 && p2)
+    SorterChunk *pChunk = pList->pChunk;
+    SorterRecord *pRec;
+    int nByte = ROUND8(sizeof(SorterRecord) + nVal);
+
+    if (pChunk == 0 || pChunk->nAlloc - pChunk->nUsed < nByte)
     {
-        int res;
-        vdbeSorterCompare(pCsr, 0, p1->pVal, p1->nVal, pVal2, p2->nVal, &res);
-        if (res <= 0)
+        int nAlloc = nByte > SORTER_CHUNK_SIZE / 4 ? nByte : SORTER_CHUNK_SIZE;
+        SorterChunk *pNew = (SorterChunk *)sqlite3Malloc(sizeof(SorterChunk) + nAlloc);
+        if (pNew == 0) return 0;
+        pNew->nAlloc = nAlloc;
+        pNew->nUsed = 0;
+        if (pChunk && nAlloc == nByte)
         {
-            *pp = p1; /* p1指向值比较小 */
-            pp = &p1->pNext;
-            p1 = p1->pNext; /* p1移动到下一个记录 */
-            pVal2 = 0;
+            pNew->pNext = pChunk->pNext;
+            pChunk->pNext = pNew;
         }
         else
         {
-            *pp = p2; /* p2指向的值比较小 */
-            pp = &p2->pNext;
-            p2 = p2->pNext;
-            if (p2 == 0) break;
-            pVal2 = p2->pVal;
+            pNew->pNext = pChunk;
+            pList->pChunk = pNew;
         }
+        pChunk = pNew;
     }
-    *pp = p1 ? p1 : p2;
-    *ppOut = pFinal;
+
+    pRec = (SorterRecord *)&((u8 *)&pChunk[1])[pChunk->nUsed];
+    pChunk->nUsed += nByte;
+    pRec->nVal = nVal;
+    memcpy(SRVAL(pRec), pVal, nVal);
+    return pRec;
 }
 
 /*
-** Sort the linked list of records headed at pCsr->pRecord. Return SQLITE_OK
-** if successful, or an SQLite error code (i.e. SQLITE_NOMEM) if an error
-** occurs.
-** 对链表进行排序操作.链表头部记录在pCsr->pRecord中,如果成功了,返回SQLite_OK
+** Append a copy of the nVal byte record pVal, with prefix iPrefix, to
+** list pList. Return SQLITE_OK if successful, or SQLITE_NOMEM otherwise.
 */
-static int vdbeSorterSort(const VdbeCursor *pCsr)
+static int vdbeSorterListAppend(
+    SorterList *pList,              /* List to append to */
+    const void *pVal,               /* Record to copy */
+    int nVal,                       /* Size of pVal in bytes */
+    u64 iPrefix                     /* Normalized prefix of pVal */
+)
 {
-    int i;
-    SorterRecord **aSlot;
-    SorterRecord *p;
-    VdbeSorter *pSorter = pCsr->pSorter;
-    /* 这里一共分配了64个slot */
-    aSlot = (SorterRecord **)sqlite3MallocZero(64 * sizeof(SorterRecord *));
-    if (!aSlot)
-    {
-        return SQLITE_NOMEM;
-    }
-
-    p = pSorter->pRecord;
-    while (p)
-    {
-        SorterRecord *pNext = p->pNext;
-        p->pNext = 0; /* 这里等同于将p从链表中移除 */
-        for (i = 0; aSlot[i]; i++)
-        {
-            /* 将p与Slot[i]链表合并,p指向排序后的链表首部 */
-            vdbeSorterMerge(pCsr, p, aSlot[i], &p); 
-            aSlot[i] = 0;
-        }
-        aSlot[i] = p; /* 记录下有序链表的第一个元素 */
-        p = pNext; /* 指向下一条记录 */
-    }
+    SorterRecord *pRec;
 
-    p = 0;
-    for (i = 0; i < 64; i++) /* 然后对前后两组链表进行合并 */
+    if (pList->nEntry == pList->nAlloc)
     {
-        vdbeSorterMerge(pCsr, p, aSlot[i], &p);
+        int nNew = pList->nAlloc ? pList->nAlloc * 2 : 64;
+        SorterEntry *aNew;
+        aNew = (SorterEntry *)sqlite3_realloc(pList->aEntry, nNew * sizeof(SorterEntry));
+        if (aNew == 0) return SQLITE_NOMEM;
+        pList->aEntry = aNew;
+        pList->nAlloc = nNew;
     }
-    pSorter->pRecord = p; /* 最终得到有序的链表p */
 
-    sqlite3_free(aSlot);
+    pRec = vdbeSorterListAlloc(pList, pVal, nVal);
+    if (pRec == 0) return SQLITE_NOMEM;
+    pList->aEntry[pList->nEntry].iPrefix = iPrefix;
+    pList->aEntry[pList->nEntry].pRec = pRec;
+    pList->nEntry++;
     return SQLITE_OK;
 }
 
 /*
-** Initialize a file-writer object.
-** 构建一个file-writer
+** Allocate space for a file-handle and open a temporary file. If successful,
+** set *ppFile to point to the malloc'd file-handle and return SQLITE_OK.
+** Otherwise, set *ppFile to 0 and return an SQLite error code.
 */
-static void fileWriterInit(
-    sqlite3 *db,                    /* Database (for malloc) */
-    sqlite3_file *pFile,            /* File to write to */
-    FileWriter *p,                  /* Object to populate */
-    i64 iStart                      /* Offset of pFile to begin writing at */
-)
+static int vdbeSorterOpenTempFile(sqlite3 *db, sqlite3_file **ppFile)
+{
+    int dummy;
+    int rc = sqlite3OsOpenMalloc(db->pVfs, 0, ppFile,
+                                 SQLITE_OPEN_TEMP_JOURNAL |
+                                 SQLITE_OPEN_READWRITE    | SQLITE_OPEN_CREATE |
+                                 SQLITE_OPEN_EXCLUSIVE    | SQLITE_OPEN_DELETEONCLOSE, &dummy
+                                );
+#if SQLITE_MAX_MMAP_SIZE>0
+    /* The PMAs are read through a memory mapping of no more than the
+    ** mmap_size of the connection, as the database file is. */
+    if (rc == SQLITE_OK && (*ppFile)->pMethods->iVersion >= 3)
+    {
+        sqlite3_int64 sz = db->szMmap;
+        sqlite3OsFileControlHint(*ppFile, SQLITE_FCNTL_MMAP_SIZE, &sz);
+    }
+#endif
+    return rc;
+}
+
+/*
+** Merge the n1 sorted entries at a1 with the n2 sorted entries at a2,
+** writing the result to aOut. Where two entries are equal, the one from
+** a1 is written first.
+** 将两组有序的记录a1以及a2合并,写入aOut
+**
+** Entries are ordered by their prefixes, and only compared in full if the
+** prefixes are equal. Since an entry of a2 is often compared with several
+** entries of a1 in a row, it is only unpacked the first time.
+*/
+static void vdbeSorterMergeRuns(
+    const SorterCmp *pCmp,          /* Comparison context */
+    const SorterEntry *a1, int n1,  /* First run to merge */
+    const SorterEntry *a2, int n2,  /* Second run to merge */
+    SorterEntry *aOut               /* OUT: Merged run */
+)
 {
-    int nBuf = sqlite3BtreeGetPageSize(db->aDb[0].pBt);
+    const SorterRecord *pUnpacked = 0;  /* Record in pCmp->pUnpacked */
 
+    while (n1 > 0 && n2 > 0)
+    {
+        int res;
+        if (a1->iPrefix != a2->iPrefix)
+        {
+            res = (a1->iPrefix < a2->iPrefix) ? -1 : 1;
+        }
+        else
+        {
+            const SorterRecord *p2 = a2->pRec;
+            vdbeSorterCompare(pCmp, 0, SRVAL(a1->pRec), a1->pRec->nVal,
+                              (p2 == pUnpacked ? 0 : SRVAL(p2)), p2->nVal, &res);
+            pUnpacked = p2;
+        }
+        if (res <= 0)
+        {
+            *aOut++ = *a1++;
+            n1--;
+        }
+        else
+        {
+            *aOut++ = *a2++;
+            n2--;
+        }
+    }
+    if (n1 > 0) memcpy(aOut, a1, n1 * sizeof(SorterEntry));
+    if (n2 > 0) memcpy(aOut, a2, n2 * sizeof(SorterEntry));
+}
+
+/*
+** Sort the entries of list pList. Return SQLITE_OK if successful, or an
+** SQLite error code (i.e. SQLITE_NOMEM) if an error occurs.
+** 对记录进行排序操作.如果成功了,返回SQLite_OK
+**
+** This is a bottom-up merge sort, so entries that compare equal remain
+** in the order they were added in. It may be called by a worker thread,
+** with a comparison context of its own.
+*/
+static int vdbeSorterSort(const SorterCmp *pCmp, SorterList *pList)
+{
+    int nEntry = pList->nEntry;
+    SorterEntry *aIn = pList->aEntry;   /* Runs to merge */
+    SorterEntry *aOut;                  /* Merged runs */
+    SorterEntry *aTmp;                  /* Second array */
+    int nRun;                           /* Size of runs in aIn[] */
+
+    if (nEntry < 2) return SQLITE_OK;
+    aTmp = (SorterEntry *)sqlite3Malloc(nEntry * sizeof(SorterEntry));
+    if (!aTmp)
+    {
+        return SQLITE_NOMEM;
+    }
+
+    aOut = aTmp;
+    for (nRun = 1; nRun < nEntry; nRun *= 2)
+    {
+        SorterEntry *aSwap;
+        int i;
+        for (i = 0; i < nEntry; i += 2 * nRun)
+        {
+            int iMid = (nEntry - i > nRun) ? i + nRun : nEntry;
+            int iEnd = (nEntry - iMid > nRun) ? iMid + nRun : nEntry;
+            vdbeSorterMergeRuns(pCmp, &aIn[i], iMid - i, &aIn[iMid], iEnd - iMid, &aOut[i]);
+        }
+        aSwap = aIn;
+        aIn = aOut;
+        aOut = aSwap;
+    }
+
+    /* The sorted entries are in aIn[]. Keep whichever array that is. */
+    if (aIn == aTmp)
+    {
+        sqlite3_free(pList->aEntry);
+        pList->aEntry = aTmp;
+        pList->nAlloc = nEntry;
+    }
+    else
+    {
+        sqlite3_free(aTmp);
+    }
+    return SQLITE_OK;
+}
+
+/*
+** Compare entries p1 and p2. Return a negative, zero or positive value if
+** p1 sorts before, with or after p2.
+*/
+static int vdbeSorterEntryCompare(
+    const SorterCmp *pCmp,          /* Comparison context */
+    const SorterEntry *p1,          /* Left side of comparison */
+    const SorterEntry *p2           /* Right side of comparison */
+)
+{
+    int res;
+    if (p1->iPrefix != p2->iPrefix)
+    {
+        return (p1->iPrefix < p2->iPrefix) ? -1 : 1;
+    }
+    vdbeSorterCompare(pCmp, 0, SRVAL(p1->pRec), p1->pRec->nVal,
+                      SRVAL(p2->pRec), p2->pRec->nVal, &res);
+    return res;
+}
+
+/*
+** The entries of a sorter with a limit (see sqlite3VdbeSorterLimit()) are
+** kept as a binary max-heap: no entry sorts after its parent, so aEntry[0]
+** is the last of them in sort order.
+**
+** Restore the heap property of the n entries of aEntry[], all of which
+** but aEntry[i] already have it, by moving aEntry[i] up towards the root
+** (if bUp is true) or down towards the leaves (if it is false).
+*/
+static void vdbeSorterHeapFix(
+    const SorterCmp *pCmp,          /* Comparison context */
+    SorterEntry *aEntry,            /* The heap */
+    int n,                          /* Number of entries in the heap */
+    int i,                          /* Entry to move */
+    int bUp                         /* True to move up, false to move down */
+)
+{
+    SorterEntry x = aEntry[i];
+    if (bUp)
+    {
+        while (i > 0)
+        {
+            int iParent = (i - 1) / 2;
+            if (vdbeSorterEntryCompare(pCmp, &aEntry[iParent], &x) >= 0) break;
+            aEntry[i] = aEntry[iParent];
+            i = iParent;
+        }
+    }
+    else
+    {
+        for (;;)
+        {
+            int iChild = i * 2 + 1;
+            if (iChild >= n) break;
+            if (iChild + 1 < n
+                    && vdbeSorterEntryCompare(pCmp, &aEntry[iChild + 1], &aEntry[iChild]) > 0)
+            {
+                iChild++;
+            }
+            if (vdbeSorterEntryCompare(pCmp, &aEntry[iChild], &x) <= 0) break;
+            aEntry[i] = aEntry[iChild];
+            i = iChild;
+        }
+    }
+    aEntry[i] = x;
+}
+
+/*
+** Copy the records of list pList into a single new chunk, and free the
+** chunks they were in, so that the space of the records discarded from
+** the heap of a sorter with a limit is reclaimed. Return SQLITE_OK if
+** successful, or SQLITE_NOMEM, in which case the list is unchanged.
+*/
+static int vdbeSorterListCompact(SorterList *pList)
+{
+    SorterChunk *pNew;
+    SorterChunk *pOld = pList->pChunk;
+    int nAlloc = 0;
+    int i;
+
+    for (i = 0; i < pList->nEntry; i++)
+    {
+        nAlloc += ROUND8(sizeof(SorterRecord) + pList->aEntry[i].pRec->nVal);
+    }
+    pNew = (SorterChunk *)sqlite3Malloc(sizeof(SorterChunk) + nAlloc);
+    if (pNew == 0) return SQLITE_NOMEM;
+    pNew->pNext = 0;
+    pNew->nAlloc = nAlloc;
+    pNew->nUsed = 0;
+    pList->pChunk = pNew;
+    for (i = 0; i < pList->nEntry; i++)
+    {
+        SorterRecord *pRec = pList->aEntry[i].pRec;
+        pList->aEntry[i].pRec = vdbeSorterListAlloc(pList, SRVAL(pRec), pRec->nVal);
+        assert(pList->aEntry[i].pRec != 0);
+    }
+    assert(pNew->nUsed == nAlloc && pList->pChunk == pNew);
+
+    while (pOld)
+    {
+        SorterChunk *pNext = pOld->pNext;
+        sqlite3_free(pOld);
+        pOld = pNext;
+    }
+    return SQLITE_OK;
+}
+
+/*
+** Initialize a file-writer object.
+** 构建一个file-writer
+*/
+static void fileWriterInit(
+    SorterPool *pPool,              /* Pool to serialize writes with, or NULL */
+    sqlite3_file *pFile,            /* File to write to */
+    int nBuf,                       /* Size of write buffer in bytes */
+    FileWriter *p,                  /* Object to populate */
+    i64 iStart                      /* Offset of pFile to begin writing at */
+)
+{
     memset(p, 0, sizeof(FileWriter));
-    p->aBuffer = (u8 *)sqlite3DbMallocRaw(db, nBuf);
+    p->aBuffer = (u8 *)sqlite3Malloc(nBuf);
     if (!p->aBuffer)
     {
         p->eFWErr = SQLITE_NOMEM;
@@ -784,6 +1422,7 @@ static void fileWriterInit(
         p->iWriteOff = iStart - p->iBufStart;
         p->nBuffer = nBuf;
         p->pFile = pFile;
+        p->pPool = pPool;
     }
 }
 
@@ -806,10 +1445,10 @@ static void fileWriterWrite(FileWriter *p, u8 *pData, int nData)
         p->iBufEnd += nCopy;
         if (p->iBufEnd == p->nBuffer)
         {
-            p->eFWErr = sqlite3OsWrite(p->pFile,
-                                       &p->aBuffer[p->iBufStart], p->iBufEnd - p->iBufStart,
-                                       p->iWriteOff + p->iBufStart
-                                      );
+            p->eFWErr = vdbeSorterOsWrite(p->pPool, p->pFile,
+                                          &p->aBuffer[p->iBufStart], p->iBufEnd - p->iBufStart,
+                                          p->iWriteOff + p->iBufStart
+                                         );
             p->iBufStart = p->iBufEnd = 0;
             p->iWriteOff += p->nBuffer;
         }
@@ -828,18 +1467,19 @@ static void fileWriterWrite(FileWriter *p, u8 *pData, int nData)
 ** Before returning, set *piEof to the offset immediately following the
 ** last byte written to the file.
 */
-static int fileWriterFinish(sqlite3 *db, FileWriter *p, i64 *piEof)
+static int fileWriterFinish(FileWriter *p, i64 *piEof)
 {
     int rc;
     if (p->eFWErr == 0 && ALWAYS(p->aBuffer) && p->iBufEnd > p->iBufStart)
     {
-        p->eFWErr = sqlite3OsWrite(p->pFile,
-                                   &p->aBuffer[p->iBufStart], p->iBufEnd - p->iBufStart,
-                                   p->iWriteOff + p->iBufStart
-                                  );
+        p->eFWErr = vdbeSorterOsWrite(p->pPool, p->pFile,
+                                      &p->aBuffer[p->iBufStart], p->iBufEnd - p->iBufStart,
+                                      p->iWriteOff + p->iBufStart
+                                     );
     }
     *piEof = (p->iWriteOff + p->iBufEnd);
-    sqlite3DbFree(db, p->aBuffer);
+    sqlite3_free(p->aBuffer);
+    sqlite3_free(p->aPrevAlloc);
     rc = p->eFWErr;
     memset(p, 0, sizeof(FileWriter));
     return rc;
@@ -858,41 +1498,90 @@ static void fileWriterWriteVarint(FileWriter *p, u64 iVal)
 }
 
 /*
-** Write the current contents of the in-memory linked-list to a PMA. Return
-** SQLITE_OK if successful, or an SQLite error code otherwise.
-** 将内存中链表中的内容写入一个PMA,如果成功的话,返回SQLITE_OK,否则的话返回SQLite错误.
+** Write the nKey byte key aKey[] as the next record of a PMA. If it shares
+** at least SORTER_MIN_SHARED leading bytes with the previous key written,
+** those bytes are left out.
+**
+** If bCopy is false, the caller guarantees that aKey[] is not changed
+** before the next key is written. Otherwise a copy of it is kept, to
+** compare the next key with.
+*/
+static void fileWriterWriteKey(FileWriter *p, const u8 *aKey, int nKey, int bCopy)
+{
+    int nShared = 0;                /* Bytes shared with the previous key */
+    int nMax = (nKey < p->nPrev ? nKey : p->nPrev);
+
+    if (p->eFWErr) return;
+    while (nShared < nMax && aKey[nShared] == p->aPrev[nShared]) nShared++;
+    if (nShared < SORTER_MIN_SHARED)
+    {
+        fileWriterWriteVarint(p, (u64)nKey * 2);
+        fileWriterWrite(p, (u8 *)aKey, nKey);
+    }
+    else
+    {
+        fileWriterWriteVarint(p, (u64)(nKey - nShared) * 2 + 1);
+        fileWriterWriteVarint(p, nShared);
+        fileWriterWrite(p, (u8 *)&aKey[nShared], nKey - nShared);
+    }
+
+    p->aPrev = aKey;
+    p->nPrev = nKey;
+    if (bCopy)
+    {
+        if (p->nPrevAlloc < nKey)
+        {
+            int nNew = p->nPrevAlloc ? p->nPrevAlloc * 2 : 128;
+            while (nKey > nNew) nNew = nNew * 2;
+            sqlite3_free(p->aPrevAlloc);
+            p->aPrevAlloc = (u8 *)sqlite3Malloc(nNew);
+            if (p->aPrevAlloc == 0)
+            {
+                p->eFWErr = SQLITE_NOMEM;
+                p->nPrevAlloc = p->nPrev = 0;
+                return;
+            }
+            p->nPrevAlloc = nNew;
+        }
+        memcpy(p->aPrevAlloc, aKey, nKey);
+        p->aPrev = p->aPrevAlloc;
+    }
+}
+
+/*
+** Write the sorted list pList to a new PMA at the end of pTemp1. The list
+** is freed whether or not this succeeds. Return SQLITE_OK if successful,
+** or an SQLite error code otherwise.
 **
 ** The format of a PMA is:
 ** PMA的格式如下:
 **
-**     * A varint. This varint contains the total number of bytes of content
-**       in the PMA (not including the varint itself).
-**     * 一个变长变量,用于表示PMA内容所占的字节数(不包含变量本身)
-**
 **     * One or more records packed end-to-end in order of ascending keys.
-**       Each record consists of a varint followed by a blob of data (the
-**       key). The varint is the number of bytes in the blob of data.
-**     * 一个或者多个记录,按照key升序一个接着一个存储,每条记录包含一个变长变量,然后是blob类型的数据
-**       变长变量记录了blob类型数据的所占用的字节数
+**       Each record consists of a varint, then another varint if the
+**       first is odd, followed by a blob of data. The first varint is
+**       twice the number of bytes in the blob of data, plus one if the
+**       blob is only the end of the key. In that case the second varint
+**       is the number of leading bytes the key shares with the key of
+**       the previous record, which are left out.
+**     * 一个或者多个记录,按照key升序一个接着一个存储,每条记录包含一个或两个变长变量,然后是blob类型的数据
+**       第一个变长变量记录了blob类型数据的所占用的字节数的两倍,如果key与前一条记录的key共享前缀,则再加一,
+**       并由第二个变长变量记录共享前缀的字节数
+**
+** The size of each PMA is not stored in the file, but kept in aPma[].
 */
-static int vdbeSorterListToPMA(sqlite3 *db, const VdbeCursor *pCsr)
+static int vdbeSorterWritePMA(
+    sqlite3 *db,                    /* Database handle */
+    VdbeSorter *pSorter,            /* Sorter object */
+    SorterList *pList               /* Sorted list of records to write */
+)
 {
     int rc = SQLITE_OK;             /* Return code */
-    VdbeSorter *pSorter = pCsr->pSorter;
     FileWriter writer;
 
     memset(&writer, 0, sizeof(FileWriter));
 
-    if (pSorter->nInMemory == 0)
-    {
-        assert(pSorter->pRecord == 0);
-        return rc;
-    }
-
-    rc = vdbeSorterSort(pCsr);
-
     /* If the first temporary PMA file has not been opened, open it now. */
-    if (rc == SQLITE_OK && pSorter->pTemp1 == 0)
+    if (pSorter->pTemp1 == 0)
     {
         /* 打开文件 */
         rc = vdbeSorterOpenTempFile(db, &pSorter->pTemp1);
@@ -901,28 +1590,393 @@ static int vdbeSorterListToPMA(sqlite3 *db, const VdbeCursor *pCsr)
         assert(pSorter->nPMA == 0);
     }
 
+    /* Make room to record the extent of the new PMA. */
+    if (rc == SQLITE_OK && pSorter->nPMA == pSorter->nPmaAlloc)
+    {
+        int nNew = pSorter->nPmaAlloc ? pSorter->nPmaAlloc * 2 : 16;
+        SorterPma *aNew = (SorterPma *)sqlite3_realloc(
+                              pSorter->aPma, nNew * sizeof(SorterPma));
+        if (aNew == 0)
+        {
+            rc = SQLITE_NOMEM;
+        }
+        else
+        {
+            pSorter->aPma = aNew;
+            pSorter->nPmaAlloc = nNew;
+        }
+    }
+
     if (rc == SQLITE_OK)
     {
-        SorterRecord *p;
-        SorterRecord *pNext = 0;
+        SorterPma *pPma = &pSorter->aPma[pSorter->nPMA];
+        int i;
 
-        fileWriterInit(db, pSorter->pTemp1, &writer, pSorter->iWriteOff);
-        pSorter->nPMA++;
-        fileWriterWriteVarint(&writer, pSorter->nInMemory);
-        for (p = pSorter->pRecord; p; p = pNext) /* 将排序后的每一条记录都写入磁盘 */
+        pPma->iOff = pSorter->iWriteOff;
+        pPma->nMax = 0;
+        fileWriterInit(0, pSorter->pTemp1, pSorter->pgsz, &writer, pSorter->iWriteOff);
+        for (i = 0; i < pList->nEntry; i++) /* 将排序后的每一条记录都写入磁盘 */
         {
-            pNext = p->pNext;
-            fileWriterWriteVarint(&writer, p->nVal);
-            fileWriterWrite(&writer, p->pVal, p->nVal);
-            sqlite3DbFree(db, p);
+            SorterRecord *p = pList->aEntry[i].pRec;
+            fileWriterWriteKey(&writer, SRVAL(p), p->nVal, 0);
+            pPma->nMax += SORTER_PMA_RECORD_SIZE(p->nVal);
         }
-        pSorter->pRecord = p;
-        rc = fileWriterFinish(db, &writer, &pSorter->iWriteOff);
+        rc = fileWriterFinish(&writer, &pSorter->iWriteOff);
+        pPma->nByte = pSorter->iWriteOff - pPma->iOff;
+        assert(rc != SQLITE_OK || (pPma->nByte > 0 && pPma->nByte <= pPma->nMax));
+        if (rc == SQLITE_OK) pSorter->nPMA++;
     }
 
+    vdbeSorterListFree(pList);
+    return rc;
+}
+
+/*
+** Run merge job pJob: merge the pJob->nPma PMAs of pJob->pIn at pJob->aIn
+** into a single PMA at offset pJob->pNew->iOff of pJob->pOut, and set
+** pJob->pNew->nByte to its size. The caller has already set aside the
+** pJob->pNew->nMax bytes it may need, so that the merge jobs of a level
+** may be run in any order, or all at once.
+**
+** This may be called by a worker thread, with a comparison context of
+** its own, in which case pPool is the pool it belongs to.
+*/
+static int vdbeSorterMergeJob(
+    const SorterCmp *pCmp,          /* Comparison context */
+    SorterPool *pPool,              /* Pool to serialize I/O with, or NULL */
+    int nBuf,                       /* Size of the I/O buffers */
+    const SorterJob *pJob           /* Merge to do */
+)
+{
+    VdbeSorterIter aIter[SORTER_MAX_MERGE_COUNT];
+    int aTree[SORTER_MAX_MERGE_COUNT];
+    SorterMerger merger;
+    FileWriter writer;              /* Object used to write to disk */
+    SorterPma *pNew = pJob->pNew;   /* Extent of the new PMA */
+    i64 iEof;                       /* End of new PMA */
+    int rc;                         /* Return code */
+    int rc2;                        /* Return code from fileWriterFinish() */
+    int i;
+
+    memset(aIter, 0, sizeof(aIter));
+    memset(aTree, 0, sizeof(aTree));
+    merger.nTree = SORTER_MAX_MERGE_COUNT;
+    merger.aIter = aIter;
+    merger.aTree = aTree;
+
+    rc = vdbeSorterMergerInit(pCmp, &merger, pPool, pJob->pIn, pJob->aIn,
+                              pJob->nPma, nBuf);
+    if (rc == SQLITE_OK)
+    {
+        int bEof = 0;
+        fileWriterInit(pPool, pJob->pOut, nBuf, &writer, pNew->iOff);
+        while (rc == SQLITE_OK && bEof == 0)
+        {
+            VdbeSorterIter *pIter = &aIter[ aTree[1] ];
+            assert(pIter->pFile);
+            /* 将记录写入文件 */
+            fileWriterWriteKey(&writer, pIter->aKey, pIter->nKey, 1);
+            rc = vdbeSorterMergerNext(pCmp, &merger, &bEof);
+        }
+        rc2 = fileWriterFinish(&writer, &iEof);
+        if (rc == SQLITE_OK) rc = rc2;
+        pNew->nByte = iEof - pNew->iOff;
+        assert(rc != SQLITE_OK || pNew->nByte <= pNew->nMax);
+    }
+
+    for (i = 0; i < SORTER_MAX_MERGE_COUNT; i++)
+    {
+        vdbeSorterIterZero(&aIter[i]);
+    }
     return rc;
 }
 
+#ifdef SORTER_THREADS
+/*
+** Run the job in slot iSlot of the sorter pool pArg on a worker thread.
+** *ppScratch holds the unpacked record the thread compares keys with.
+*/
+static void vdbeSorterWork(void *pArg, int iSlot, void **ppScratch)
+{
+    SorterPool *pPool = (SorterPool *)pArg;
+    SorterJob *pJob = &pPool->aJob[iSlot];
+    SorterCmp cmp;                  /* Comparison context of this thread */
+
+    cmp.pKeyInfo = pPool->pKeyInfo;
+    if (*ppScratch == 0)
+    {
+        char *d;                    /* Dummy */
+        *ppScratch = sqlite3VdbeAllocUnpackedRecord(cmp.pKeyInfo, 0, 0, &d);
+    }
+    cmp.pUnpacked = (UnpackedRecord *)*ppScratch;
+
+    if (cmp.pUnpacked == 0)
+    {
+        pJob->rc = SQLITE_NOMEM;
+    }
+    else if (pJob->nPma == 0)
+    {
+        pJob->rc = vdbeSorterSort(&cmp, &pJob->list);
+    }
+    else
+    {
+        pJob->rc = vdbeSorterMergeJob(&cmp, pPool, pPool->nBuf, pJob);
+    }
+}
+
+/*
+** Stop the worker threads of pSorter, once they have finished the jobs
+** queued for them, and free the pool. The lists of any sort jobs that
+** have not been retired are freed without being written.
+*/
+static void vdbeSorterStopPool(sqlite3 *db, VdbeSorter *pSorter)
+{
+    SorterPool *pPool = pSorter->pPool;
+    int i;
+
+    if (pPool == 0) return;
+    sqlite3ThreadPoolFree(pPool->pThreads);
+    sqlite3_mutex_free(pPool->ioMutex);
+    for (i = 0; i < SQLITE_SORTER_THREADS; i++)
+    {
+        vdbeSorterListFree(&pPool->aJob[i].list);
+    }
+    sqlite3_free(pPool);
+    pSorter->pPool = 0;
+    pSorter->nInFlight = 0;
+}
+
+/*
+** Start the worker threads of the sorter opened by pCsr, if the memory
+** allocator may be used by more than one thread at a time. If they
+** cannot be started, the sorter does all of its work on this thread.
+*/
+static void vdbeSorterStartPool(const VdbeCursor *pCsr)
+{
+    VdbeSorter *pSorter = pCsr->pSorter;
+    KeyInfo *pKeyInfo = pCsr->pKeyInfo;
+    SorterPool *pPool;
+    int nKey;
+
+    assert(pSorter->pPool == 0);
+    if (!sqlite3GlobalConfig.bCoreMutex) return;
+
+    /* The workers compare records using a copy of the key info with no
+    ** database handle, so that any memory they need is not allocated
+    ** from the handle's lookaside buffers. */
+    nKey = sizeof(KeyInfo);
+    if (pKeyInfo->nField > 1) nKey += (pKeyInfo->nField - 1) * sizeof(CollSeq *);
+    pPool = (SorterPool *)sqlite3MallocZero(sizeof(SorterPool) + nKey);
+    if (pPool == 0) return;
+    pPool->pKeyInfo = (KeyInfo *)&pPool[1];
+    memcpy(pPool->pKeyInfo, pKeyInfo, nKey);
+    pPool->pKeyInfo->db = 0;
+    pPool->nBuf = pSorter->pgsz;
+    pSorter->pPool = pPool;
+
+    pPool->ioMutex = sqlite3_mutex_alloc(SQLITE_MUTEX_FAST);
+    if (pPool->ioMutex == 0
+        || sqlite3ThreadPoolCreate(&pPool->pThreads, SQLITE_SORTER_THREADS,
+                                   SQLITE_SORTER_THREADS, vdbeSorterWork, pPool)
+       )
+    {
+        vdbeSorterStopPool(0, pSorter);
+        return;
+    }
+    pPool->nThread = sqlite3ThreadPoolThreads(pPool->pThreads);
+}
+
+/*
+** Retire the jobs of the worker pool of pSorter in the order they were
+** queued, until no more than nMax remain, waiting for workers as required.
+** Then retire any further jobs that are already finished. Retiring a sort
+** job writes its list to pTemp1.
+**
+** Return the first error encountered by a retired job, if any. Once
+** there has been an error, the lists of sort jobs are freed unwritten.
+*/
+static int vdbeSorterRetire(sqlite3 *db, VdbeSorter *pSorter, int nMax)
+{
+    SorterPool *pPool = pSorter->pPool;
+    int rc = SQLITE_OK;
+    int iSlot;
+    while ((iSlot = sqlite3ThreadPoolRetire(pPool->pThreads, nMax)) >= 0)
+    {
+        SorterJob *pJob = &pPool->aJob[iSlot];
+        if (rc == SQLITE_OK) rc = pJob->rc;
+        pSorter->nInFlight -= pJob->nInMemory;
+        if (pJob->list.nEntry)
+        {
+            if (rc == SQLITE_OK)
+            {
+                rc = vdbeSorterWritePMA(db, pSorter, &pJob->list);
+            }
+            vdbeSorterListFree(&pJob->list);
+        }
+    }
+    return rc;
+}
+
+/*
+** Queue a copy of job pNew for the worker threads of pSorter, which must
+** have fewer than nThread jobs outstanding.
+*/
+static void vdbeSorterQueue(VdbeSorter *pSorter, const SorterJob *pNew)
+{
+    SorterPool *pPool = pSorter->pPool;
+    SorterJob *pJob;
+
+    assert(sqlite3ThreadPoolJobs(pPool->pThreads) < pPool->nThread);
+    pJob = &pPool->aJob[sqlite3ThreadPoolNext(pPool->pThreads)];
+    assert(pJob->list.nEntry == 0);
+    *pJob = *pNew;
+    pJob->rc = SQLITE_OK;
+    sqlite3ThreadPoolSubmit(pPool->pThreads);
+}
+#else
+# define vdbeSorterStopPool(x,y)
+#endif
+
+/*
+** Free any cursor components allocated by sqlite3VdbeSorterXXX routines.
+*/
+void sqlite3VdbeSorterClose(sqlite3 *db, VdbeCursor *pCsr)
+{
+    VdbeSorter *pSorter = pCsr->pSorter;
+    if (pSorter)
+    {
+        vdbeSorterStopPool(db, pSorter);
+        if (pSorter->merger.aIter)
+        {
+            int i;
+            for (i = 0; i < pSorter->merger.nTree; i++)
+            {
+                vdbeSorterIterZero(&pSorter->merger.aIter[i]);
+            }
+            sqlite3DbFree(db, pSorter->merger.aIter);
+        }
+        if (pSorter->pTemp1)
+        {
+            sqlite3OsCloseFree(pSorter->pTemp1);
+        }
+        sqlite3_free(pSorter->aPma);
+        vdbeSorterListFree(&pSorter->list);
+        sqlite3DbFree(db, pSorter->cmp.pUnpacked);
+        sqlite3DbFree(db, pSorter);
+        pCsr->pSorter = 0;
+    }
+}
+
+/*
+** Write the current contents of the in-memory list to a PMA. Return
+** SQLITE_OK if successful, or an SQLite error code otherwise.
+** 将内存中记录的内容写入一个PMA,如果成功的话,返回SQLITE_OK,否则的话返回SQLite错误.
+**
+** If the sorter has worker threads, the list is instead handed to one of
+** them to sort, and is written once it and the lists handed over before
+** it have been sorted (see vdbeSorterRetire()).
+*/
+static int vdbeSorterListToPMA(sqlite3 *db, const VdbeCursor *pCsr)
+{
+    int rc = SQLITE_OK;             /* Return code */
+    VdbeSorter *pSorter = pCsr->pSorter;
+
+    if (pSorter->nInMemory == 0)
+    {
+        assert(pSorter->list.nEntry == 0);
+        return rc;
+    }
+
+#ifdef SORTER_THREADS
+    if (pSorter->pPool)
+    {
+        rc = vdbeSorterRetire(db, pSorter, pSorter->pPool->nThread - 1);
+        if (rc == SQLITE_OK)
+        {
+            SorterJob job;
+            memset(&job, 0, sizeof(SorterJob));
+            job.list = pSorter->list;
+            job.nInMemory = pSorter->nInMemory;
+            pSorter->nInFlight += pSorter->nInMemory;
+            vdbeSorterQueue(pSorter, &job);
+            memset(&pSorter->list, 0, sizeof(SorterList));
+        }
+        return rc;
+    }
+#endif
+
+    rc = vdbeSorterSort(&pSorter->cmp, &pSorter->list);
+    if (rc == SQLITE_OK)
+    {
+        rc = vdbeSorterWritePMA(db, pSorter, &pSorter->list);
+    }
+    vdbeSorterListFree(&pSorter->list);
+    return rc;
+}
+
+/*
+** Only the first nLimit records of the output of the sorter opened by pCsr
+** in sort order are required. If nLimit is not positive, all of them are.
+** This is called before each record is added, but only the value passed
+** before the first one is used.
+**
+** The sorter then keeps the records it holds in memory as a heap of no
+** more than nLimit entries. Once the heap is full, a new record that sorts
+** after all of them is discarded, and one that does not replaces the last
+** of them. Whether or not records are also written to PMAs, no more than
+** nLimit are returned.
+*/
+void sqlite3VdbeSorterLimit(const VdbeCursor *pCsr, i64 nLimit)
+{
+    VdbeSorter *pSorter = pCsr->pSorter;
+    assert(pSorter->merger.aTree == 0);
+    if (pSorter->nLimit == 0 && nLimit > 0 && pSorter->list.nEntry == 0
+            && pSorter->nPMA == 0 && pSorter->pTemp1 == 0)
+    {
+        pSorter->nLimit = nLimit;
+    }
+}
+
+/*
+** Add record pVal, with prefix iPrefix, to the full heap of pSorter, or
+** discard it. Return SQLITE_OK if successful, or SQLITE_NOMEM otherwise.
+*/
+static int vdbeSorterHeapReplace(VdbeSorter *pSorter, Mem *pVal, u64 iPrefix)
+{
+    SorterList *pList = &pSorter->list;
+    SorterEntry *pTop = &pList->aEntry[0];
+    int res;
+
+    assert(pSorter->nLimit > 0 && pList->nEntry == pSorter->nLimit);
+    if (iPrefix != pTop->iPrefix)
+    {
+        res = (iPrefix < pTop->iPrefix) ? -1 : 1;
+    }
+    else
+    {
+        vdbeSorterCompare(&pSorter->cmp, 0, pVal->z, pVal->n,
+                          SRVAL(pTop->pRec), pTop->pRec->nVal, &res);
+    }
+    if (res < 0)
+    {
+        SorterRecord *pRec = vdbeSorterListAlloc(pList, pVal->z, pVal->n);
+        int nOld = pTop->pRec->nVal;
+        if (pRec == 0) return SQLITE_NOMEM;
+        pSorter->nInMemory += sqlite3VarintLen(pVal->n) + pVal->n;
+        pSorter->nInMemory -= sqlite3VarintLen(nOld) + nOld;
+        pSorter->nGarbage += ROUND8(sizeof(SorterRecord) + nOld);
+        pTop->iPrefix = iPrefix;
+        pTop->pRec = pRec;
+        vdbeSorterHeapFix(&pSorter->cmp, pList->aEntry, pList->nEntry, 0, 0);
+        if (pSorter->nGarbage > pSorter->nInMemory + SORTER_CHUNK_SIZE)
+        {
+            if (vdbeSorterListCompact(pList)) return SQLITE_NOMEM;
+            pSorter->nGarbage = 0;
+        }
+    }
+    return SQLITE_OK;
+}
+
 /*
 ** Add a record to the sorter.
 ** 添加一条记录到sorter之中
@@ -934,24 +1988,28 @@ int sqlite3VdbeSorterWrite(
 )
 {
     VdbeSorter *pSorter = pCsr->pSorter;
-    int rc = SQLITE_OK;             /* Return Code */
-    SorterRecord *pNew;             /* New list element */
+    int rc;                         /* Return Code */
+    u64 iPrefix;                    /* Normalized prefix of the new record */
 
     assert(pSorter);
-    pSorter->nInMemory += sqlite3VarintLen(pVal->n) + pVal->n;
-
-    pNew = (SorterRecord *)sqlite3DbMallocRaw(db, pVal->n + sizeof(SorterRecord));
-    if (pNew == 0)
+    iPrefix = vdbeSorterPrefix(pSorter, (const u8 *)pVal->z, pVal->n);
+    if (pSorter->nLimit > 0 && pSorter->list.nEntry == pSorter->nLimit)
     {
-        rc = SQLITE_NOMEM;
+        rc = vdbeSorterHeapReplace(pSorter, pVal, iPrefix);
     }
     else
     {
-        pNew->pVal = (void *)&pNew[1];
-        memcpy(pNew->pVal, pVal->z, pVal->n);
-        pNew->nVal = pVal->n;
-        pNew->pNext = pSorter->pRecord;
-        pSorter->pRecord = pNew;
+        pSorter->nInMemory += sqlite3VarintLen(pVal->n) + pVal->n;
+        rc = vdbeSorterListAppend(&pSorter->list, pVal->z, pVal->n, iPrefix);
+        if (rc == SQLITE_OK && pSorter->nLimit > 0)
+        {
+            SorterList *pList = &pSorter->list;
+            vdbeSorterHeapFix(&pSorter->cmp, pList->aEntry, pList->nEntry, pList->nEntry - 1, 1);
+        }
+    }
+    if (rc != SQLITE_OK)
+    {
+        db->mallocFailed = 1;
     }
 
     /* See if the contents of the sorter should now be written out. They
@@ -965,62 +2023,130 @@ int sqlite3VdbeSorterWrite(
     **   * The total memory allocated for the in-memory list is greater
     **     than (page-size * 10) and sqlite3HeapNearlyFull() returns true.
     **   * 内存中链表的分配总数大于 page-size * 10并且sqlite3HeapNearlyFull()返回真.
+    **
+    ** Lists handed to worker threads and not yet written out count towards
+    ** the first limit.
     */
     if (rc == SQLITE_OK && pSorter->mxPmaSize > 0 && (
-            (pSorter->nInMemory > pSorter->mxPmaSize)
+            (pSorter->nInMemory + pSorter->nInFlight > pSorter->mxPmaSize)
             || (pSorter->nInMemory > pSorter->mnPmaSize && sqlite3HeapNearlyFull())
         ))
     {
-#ifdef SQLITE_DEBUG
-        i64 nExpect = pSorter->iWriteOff
-                      + sqlite3VarintLen(pSorter->nInMemory)
-                      + pSorter->nInMemory;
+#ifdef SORTER_THREADS
+        /* The worker threads are started when the first PMA is spilled. */
+        if (pSorter->pTemp1 == 0 && pSorter->pPool == 0)
+        {
+            vdbeSorterStartPool(pCsr);
+        }
+
+        /* If the lists held by the workers leave less than an equal share
+        ** of the limit for this one, wait for the oldest of them to be
+        ** written out instead of handing over another short list. */
+        if (pSorter->nInFlight > 0
+            && pSorter->nInMemory < pSorter->mxPmaSize / (pSorter->pPool->nThread + 1))
+        {
+            int nJob = sqlite3ThreadPoolJobs(pSorter->pPool->pThreads);
+            return vdbeSorterRetire(db, pSorter, nJob - 1);
+        }
 #endif
         rc = vdbeSorterListToPMA(db, pCsr);
         pSorter->nInMemory = 0;
-        assert(rc != SQLITE_OK || (nExpect == pSorter->iWriteOff));
+        pSorter->nGarbage = 0;
     }
 
     return rc;
 }
 
 /*
-** Helper function for sqlite3VdbeSorterRewind().
-** sqlite3VdbeSorterRewind()的辅助函数
+** Merge the PMAs in pTemp1, SORTER_MAX_MERGE_COUNT at a time, into
+** PMAs written to file *ppTemp2, opening it if it is not already open.
+** Then swap the two files, so that pTemp1 holds the merged PMAs.
+**
+** The merges are independent of each other. If the sorter has worker
+** threads, they are run on them, as many at once as there are threads,
+** each writing to the nMax bytes of *ppTemp2 set aside for it. Otherwise
+** each new PMA is written directly after the one before it.
 */
-static int vdbeSorterInitMerge(
+static int vdbeSorterMergeLevel(
     sqlite3 *db,                    /* Database handle */
-    const VdbeCursor *pCsr,         /* Cursor handle for this sorter */
-    i64 *pnByte                     /* Sum of bytes in all opened PMAs */
+    VdbeSorter *pSorter,            /* Sorter object */
+    sqlite3_file **ppTemp2          /* IN/OUT: Second temp file to use */
 )
 {
-    VdbeSorter *pSorter = pCsr->pSorter;
     int rc = SQLITE_OK;             /* Return code */
-    int i;                          /* Used to iterator through aIter[] */
-    i64 nByte = 0;                  /* Total bytes in all opened PMAs */
+    int nNew;                       /* Number of PMAs after the merges */
+    int iNew;                       /* Index of new, merged, PMA */
+    SorterPma *aNew;                /* Extent of each new PMA */
+    i64 iOut = 0;                   /* Offset of next new PMA in *ppTemp2 */
+
+    nNew = (pSorter->nPMA + SORTER_MAX_MERGE_COUNT - 1) / SORTER_MAX_MERGE_COUNT;
+    aNew = (SorterPma *)sqlite3_malloc(nNew * sizeof(SorterPma));
+    if (aNew == 0) return SQLITE_NOMEM;
+
+    /* Open the second temp file, if it is not already open. */
+    /* 打开第2个临时文件 */
+    if (*ppTemp2 == 0)
+    {
+        rc = vdbeSorterOpenTempFile(db, ppTemp2);
+    }
 
-    /* Initialize the iterators.
-    ** 初始化迭代器
-    */
-    for (i = 0; i < SORTER_MAX_MERGE_COUNT; i++)
+    for (iNew = 0; rc == SQLITE_OK && iNew < nNew; iNew++)
     {
-        VdbeSorterIter *pIter = &pSorter->aIter[i];
-        /* 从文件中读取出PMA */
-        rc = vdbeSorterIterInit(db, pSorter, pSorter->iReadOff, pIter, &nByte);
-        pSorter->iReadOff = pIter->iEof;
-        assert(rc != SQLITE_OK || pSorter->iReadOff <= pSorter->iWriteOff);
-        if (rc != SQLITE_OK || pSorter->iReadOff >= pSorter->iWriteOff) break;
+        SorterJob job;              /* Merge of the PMAs of new PMA iNew */
+        int iFirst = iNew * SORTER_MAX_MERGE_COUNT;
+        int i;
+
+        memset(&job, 0, sizeof(SorterJob));
+        job.nPma = pSorter->nPMA - iFirst;
+        if (job.nPma > SORTER_MAX_MERGE_COUNT) job.nPma = SORTER_MAX_MERGE_COUNT;
+        job.pIn = pSorter->pTemp1;
+        job.aIn = &pSorter->aPma[iFirst];
+        job.pOut = *ppTemp2;
+        job.pNew = &aNew[iNew];
+        job.pNew->iOff = iOut;
+        job.pNew->nByte = 0;
+        job.pNew->nMax = 0;
+        for (i = 0; i < job.nPma; i++)
+        {
+            job.pNew->nMax += job.aIn[i].nMax;
+        }
+
+#ifdef SORTER_THREADS
+        if (pSorter->pPool)
+        {
+            iOut += job.pNew->nMax;
+            rc = vdbeSorterRetire(db, pSorter, pSorter->pPool->nThread - 1);
+            if (rc == SQLITE_OK) vdbeSorterQueue(pSorter, &job);
+            continue;
+        }
+#endif
+        rc = vdbeSorterMergeJob(&pSorter->cmp, 0, pSorter->pgsz, &job);
+        iOut += job.pNew->nByte;
     }
 
-    /* Initialize the aTree[] array. 
-    ** 初始化aTree[]数组 
-    */
-    for (i = pSorter->nTree - 1; rc == SQLITE_OK && i > 0; i--)
+#ifdef SORTER_THREADS
+    if (pSorter->pPool)
     {
-        rc = vdbeSorterDoCompare(pCsr, i);
+        int rc2 = vdbeSorterRetire(db, pSorter, 0);
+        if (rc == SQLITE_OK) rc = rc2;
     }
+#endif
 
-    *pnByte = nByte;
+    if (rc == SQLITE_OK)
+    {
+        sqlite3_file *pTmp = pSorter->pTemp1;
+        pSorter->pTemp1 = *ppTemp2;
+        *ppTemp2 = pTmp;
+        sqlite3_free(pSorter->aPma);
+        pSorter->aPma = aNew;
+        pSorter->nPmaAlloc = nNew;
+        pSorter->nPMA = nNew;
+        pSorter->iWriteOff = iOut;
+    }
+    else
+    {
+        sqlite3_free(aNew);
+    }
     return rc;
 }
 
@@ -1032,122 +2158,79 @@ static int vdbeSorterInitMerge(
 int sqlite3VdbeSorterRewind(sqlite3 *db, const VdbeCursor *pCsr, int *pbEof)
 {
     VdbeSorter *pSorter = pCsr->pSorter;
+    SorterMerger *pMerger = &pSorter->merger;
     int rc;                         /* Return code */
     sqlite3_file *pTemp2 = 0;       /* Second temp file to use */
-    i64 iWrite2 = 0;                /* Write offset for pTemp2 */
     int nIter;                      /* Number of iterators used */
     int nByte;                      /* Bytes of space required for aIter/aTree */
     int N = 2;                      /* Power of 2 >= nIter */
 
     assert(pSorter);
+    pSorter->nRead = 1;
+
+    /* Write the current in-memory list to a PMA, if any have already been
+    ** written, and wait for the worker threads to finish sorting. */
+    if (pSorter->pPool || pSorter->nPMA)
+    {
+        rc = vdbeSorterListToPMA(db, pCsr);
+#ifdef SORTER_THREADS
+        if (pSorter->pPool)
+        {
+            int rc2 = vdbeSorterRetire(db, pSorter, 0);
+            if (rc == SQLITE_OK) rc = rc2;
+        }
+#endif
+        if (rc != SQLITE_OK) return rc;
+    }
 
     /* If no data has been written to disk, then do not do so now. Instead,
-    ** sort the VdbeSorter.pRecord list. The vdbe layer will read data directly
+    ** sort the VdbeSorter.list entries. The vdbe layer will read data directly
     ** from the in-memory list.  */
     /* 如果还没有任何数据被写入磁盘,那么不要现在写
     */
     if (pSorter->nPMA == 0)
     {
-        *pbEof = !pSorter->pRecord;
-        assert(pSorter->aTree == 0);
-        return vdbeSorterSort(pCsr);
+        *pbEof = (pSorter->list.nEntry == 0);
+        assert(pMerger->aTree == 0);
+        vdbeSorterStopPool(db, pSorter);
+        pSorter->iList = 0;
+        return vdbeSorterSort(&pSorter->cmp, &pSorter->list);
     }
 
-    /* Write the current in-memory list to a PMA. */
-    rc = vdbeSorterListToPMA(db, pCsr);
-    if (rc != SQLITE_OK) return rc;
-
     /* Allocate space for aIter[] and aTree[]. */
     nIter = pSorter->nPMA;
     if (nIter > SORTER_MAX_MERGE_COUNT) nIter = SORTER_MAX_MERGE_COUNT;
     assert(nIter > 0);
     while (N < nIter) N += N;
     nByte = N * (sizeof(int) + sizeof(VdbeSorterIter));
-    pSorter->aIter = (VdbeSorterIter *)sqlite3DbMallocZero(db, nByte);
-    if (!pSorter->aIter) return SQLITE_NOMEM;
-    pSorter->aTree = (int *)&pSorter->aIter[N];
-    pSorter->nTree = N;
-
-    do
+    pMerger->aIter = (VdbeSorterIter *)sqlite3DbMallocZero(db, nByte);
+    if (!pMerger->aIter) return SQLITE_NOMEM;
+    pMerger->aTree = (int *)&pMerger->aIter[N];
+    pMerger->nTree = N;
+
+    /* If there are more than SORTER_MAX_MERGE_COUNT PMAs in file pTemp1,
+    ** merge them, SORTER_MAX_MERGE_COUNT at a time, into a second file,
+    ** until there are not. Then initialize an iterator for each of the
+    ** remaining PMAs. These iterators will be incrementally merged as the
+    ** VDBE layer calls sqlite3VdbeSorterNext().  */
+    rc = SQLITE_OK;
+    while (rc == SQLITE_OK && pSorter->nPMA > SORTER_MAX_MERGE_COUNT)
     {
-        int iNew;                     /* Index of new, merged, PMA */
-
-        for (iNew = 0;
-             rc == SQLITE_OK && iNew * SORTER_MAX_MERGE_COUNT < pSorter->nPMA;
-             iNew++
-            )
-        {
-            int rc2;                    /* Return code from fileWriterFinish() */
-            FileWriter writer;          /* Object used to write to disk */
-            i64 nWrite;                 /* Number of bytes in new PMA */
-
-            memset(&writer, 0, sizeof(FileWriter));
-
-            /* If there are SORTER_MAX_MERGE_COUNT or less PMAs in file pTemp1,
-            ** initialize an iterator for each of them and break out of the loop.
-            ** These iterators will be incrementally merged as the VDBE layer calls
-            ** sqlite3VdbeSorterNext().
-            **
-            ** Otherwise, if pTemp1 contains more than SORTER_MAX_MERGE_COUNT PMAs,
-            ** initialize interators for SORTER_MAX_MERGE_COUNT of them. These PMAs
-            ** are merged into a single PMA that is written to file pTemp2.
-            */
-            rc = vdbeSorterInitMerge(db, pCsr, &nWrite);
-            assert(rc != SQLITE_OK || pSorter->aIter[ pSorter->aTree[1] ].pFile);
-            if (rc != SQLITE_OK || pSorter->nPMA <= SORTER_MAX_MERGE_COUNT)
-            {
-                break;
-            }
-
-            /* Open the second temp file, if it is not already open. */
-            /* 打开第2个临时文件 */
-            if (pTemp2 == 0)
-            {
-                assert(iWrite2 == 0);
-                rc = vdbeSorterOpenTempFile(db, &pTemp2);
-            }
-
-            if (rc == SQLITE_OK)
-            {
-                int bEof = 0;
-                fileWriterInit(db, pTemp2, &writer, iWrite2);
-                fileWriterWriteVarint(&writer, nWrite);
-                while (rc == SQLITE_OK && bEof == 0)
-                {
-                    VdbeSorterIter *pIter = &pSorter->aIter[ pSorter->aTree[1] ];
-                    assert(pIter->pFile);
-                    /* 将记录写入文件 */
-                    fileWriterWriteVarint(&writer, pIter->nKey);
-                    fileWriterWrite(&writer, pIter->aKey, pIter->nKey);
-                    rc = sqlite3VdbeSorterNext(db, pCsr, &bEof);
-                }
-                rc2 = fileWriterFinish(db, &writer, &iWrite2);
-                if (rc == SQLITE_OK) rc = rc2;
-            }
-        }
-
-        if (pSorter->nPMA <= SORTER_MAX_MERGE_COUNT)
-        {
-            break;
-        }
-        else
-        {
-            sqlite3_file *pTmp = pSorter->pTemp1;
-            pSorter->nPMA = iNew;
-            pSorter->pTemp1 = pTemp2;
-            pTemp2 = pTmp;
-            pSorter->iWriteOff = iWrite2;
-            pSorter->iReadOff = 0;
-            iWrite2 = 0;
-        }
+        rc = vdbeSorterMergeLevel(db, pSorter, &pTemp2);
+    }
+    vdbeSorterStopPool(db, pSorter);
+    if (rc == SQLITE_OK)
+    {
+        rc = vdbeSorterMergerInit(&pSorter->cmp, pMerger, 0, pSorter->pTemp1,
+                                  pSorter->aPma, pSorter->nPMA, pSorter->pgsz);
+        assert(rc != SQLITE_OK || pMerger->aIter[ pMerger->aTree[1] ].pFile);
     }
-    while (rc == SQLITE_OK);
 
     if (pTemp2)
     {
         sqlite3OsCloseFree(pTemp2);
     }
-    *pbEof = (pSorter->aIter[pSorter->aTree[1]].pFile == 0);
+    *pbEof = (pMerger->aIter[pMerger->aTree[1]].pFile == 0);
     return rc;
 }
 
@@ -1160,26 +2243,19 @@ int sqlite3VdbeSorterNext(sqlite3 *db, const VdbeCursor *pCsr, int *pbEof)
     VdbeSorter *pSorter = pCsr->pSorter;
     int rc;                         /* Return code */
 
-    if (pSorter->aTree) /* 存在aTree数组,则表示已经排过序了 */
+    if (pSorter->nLimit > 0 && pSorter->nRead++ >= pSorter->nLimit)
     {
-        int iPrev = pSorter->aTree[1];/* Index of iterator to advance */
-        int i;                        /* Index of aTree[] to recalculate */
-
-        rc = vdbeSorterIterNext(db, &pSorter->aIter[iPrev]);
-        for (i = (pSorter->nTree + iPrev) / 2; rc == SQLITE_OK && i > 0; i = i / 2)
-        {
-            rc = vdbeSorterDoCompare(pCsr, i);
-        }
-
-        *pbEof = (pSorter->aIter[pSorter->aTree[1]].pFile == 0);
+        *pbEof = 1;
+        rc = SQLITE_OK;
+    }
+    else if (pSorter->merger.aTree) /* 存在aTree数组,则表示已经排过序了 */
+    {
+        rc = vdbeSorterMergerNext(&pSorter->cmp, &pSorter->merger, pbEof);
     }
     else
     {
-        SorterRecord *pFree = pSorter->pRecord;
-        pSorter->pRecord = pFree->pNext;
-        pFree->pNext = 0;
-        vdbeSorterRecordFree(db, pFree);
-        *pbEof = !pSorter->pRecord;
+        pSorter->iList++;
+        *pbEof = (pSorter->iList >= pSorter->list.nEntry);
         rc = SQLITE_OK;
     }
     return rc;
@@ -1196,17 +2272,18 @@ static void *vdbeSorterRowkey(
 )
 {
     void *pKey;
-    if (pSorter->aTree)
+    if (pSorter->merger.aTree)
     {
         VdbeSorterIter *pIter;
-        pIter = &pSorter->aIter[ pSorter->aTree[1] ];
+        pIter = &pSorter->merger.aIter[ pSorter->merger.aTree[1] ];
         *pnKey = pIter->nKey;
         pKey = pIter->aKey;
     }
     else
     {
-        *pnKey = pSorter->pRecord->nVal;
-        pKey = pSorter->pRecord->pVal;
+        SorterRecord *pRec = pSorter->list.aEntry[pSorter->iList].pRec;
+        *pnKey = pRec->nVal;
+        pKey = SRVAL(pRec);
     }
     return pKey;
 }
@@ -1253,7 +2330,7 @@ int sqlite3VdbeSorterCompare(
     int nKey;           /* Sorter key to compare pVal with */
 
     pKey = vdbeSorterRowkey(pSorter, &nKey);
-    vdbeSorterCompare(pCsr, 1, pVal->z, pVal->n, pKey, nKey, pRes);
+    vdbeSorterCompare(&pSorter->cmp, 1, pVal->z, pVal->n, pKey, nKey, pRes);
     return SQLITE_OK;
 }
 
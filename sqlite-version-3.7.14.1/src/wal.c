@@ -309,9 +309,18 @@ int sqlite3WalTrace = 0;
 ** checksum test is successful) and finds that the version field is not
 ** WALINDEX_MAX_VERSION, then no read-transaction is opened and SQLite
 ** returns SQLITE_CANTOPEN.
+**
+** Builds with more than the standard 5 read-mark slots (SQLITE_WAL_NREADER)
+** use a larger wal-index header, and a version number that includes the
+** number of slots, so that builds with different layouts cannot share a
+** wal-index.
 */
 #define WAL_MAX_VERSION      3007000
-#define WALINDEX_MAX_VERSION 3007000
+#if SQLITE_WAL_NREADER==5
+# define WALINDEX_MAX_VERSION 3007000
+#else
+# define WALINDEX_MAX_VERSION (3007100 + SQLITE_WAL_NREADER)
+#endif
 
 /*
 ** Indices of various locking bytes.   WAL_NREADER is the number
@@ -322,13 +331,23 @@ int sqlite3WalTrace = 0;
 #define WAL_CKPT_LOCK          1
 #define WAL_RECOVER_LOCK       2
 #define WAL_READ_LOCK(I)       (3+(I))
-#define WAL_NREADER            (SQLITE_SHM_NLOCK-3)
+#define WAL_NREADER            SQLITE_WAL_NREADER
+#define WAL_NLOCK              SQLITE_WAL_NLOCK
 
 
 /* Object declarations */
 typedef struct WalIndexHdr WalIndexHdr;
 typedef struct WalIterator WalIterator;
 typedef struct WalCkptInfo WalCkptInfo;
+typedef struct WalCkptThread WalCkptThread;
+
+/*
+** Background checkpointing (see sqlite3WalCkptThread()) needs threads.
+** It is only available in builds that implement them (see threads.c).
+*/
+#ifdef SQLITE_THREADS_IMPLEMENTED
+# define WAL_CKPT_THREAD 1
+#endif
 
 
 /*
@@ -433,6 +452,14 @@ struct WalCkptInfo
 /* #define WAL_HDRSIZE 24 */
 #define WAL_HDRSIZE 32
 
+/* Frames written by sqlite3WalFrames() are assembled in a staging buffer
+** of up to this many bytes and appended to the WAL file with one write
+** each time the buffer fills. See walWriteOneFrame().
+*/
+#ifndef SQLITE_WAL_WRITE_BUFFER
+# define SQLITE_WAL_WRITE_BUFFER 262144
+#endif
+
 /* WAL magic value. Either this value, or the same value with the least
 ** significant bit also set (WAL_MAGIC | 0x00000001) is stored in 32-bit
 ** big-endian format in the first 4 bytes of a WAL file.
@@ -479,9 +506,22 @@ struct Wal
     u8 truncateOnCommit;       /* True to truncate WAL file on commit */
     u8 syncHeader;             /* Fsync the WAL header if true */
     u8 padToSectorBoundary;    /* Pad transactions out to the next sector */
+    u8 groupCommit;            /* Sync commits after dropping the write lock */
+    u8 pendingSync;            /* Sync flags for a deferred commit sync, or 0 */
     WalIndexHdr hdr;           /* Wal-index header for current transaction */
     const char *zWalName;      /* Name of WAL file */
     u32 nCkpt;                 /* Checkpoint sequence counter in the wal-header */
+    u8 *aWriteBuf;             /* Staging buffer for frames being written */
+    int nWriteBuf;             /* Allocated size of aWriteBuf[] in bytes */
+    int nFrameWrite;           /* Number of writes used to append frames */
+    int nFrameAppend;          /* Number of frames appended by those writes */
+    WalCkptThread *pCkptThread; /* Background checkpointer, or NULL */
+    WalCkptThread *pCkptOwner; /* Checkpointer this connection belongs to */
+    int nCkptRate;             /* Max pages/second, set by pCkptOwner thread */
+    int nCkptPage;             /* Pages written back by checkpoints */
+    int nCkptPageSec;          /* Pages/second of the last checkpoint */
+    u8 ckptSignal;             /* Wake pCkptThread when read lock released */
+    u8 iReadClaim;             /* aReadMark[] slot this connection last claimed */
 #ifdef SQLITE_DEBUG
     u8 lockError;              /* True if a locking error has occurred */
 #endif
@@ -1231,7 +1271,7 @@ static int walIndexRecover(Wal *pWal)
     assert(WAL_CKPT_LOCK == WAL_ALL_BUT_WRITE);
     assert(pWal->writeLock);
     iLock = WAL_ALL_BUT_WRITE + pWal->ckptLock;
-    nLock = SQLITE_SHM_NLOCK - iLock;
+    nLock = WAL_NLOCK - iLock;
     rc = walLockExclusive(pWal, iLock, nLock);
     if (rc)
     {
@@ -1441,13 +1481,17 @@ int sqlite3WalOpen(
     /* In the amalgamation, the os_unix.c and os_win.c source files come before
     ** this source file.  Verify that the #defines of the locking byte offsets
     ** in os_unix.c and os_win.c agree with the WALINDEX_LOCK_OFFSET value.
+    ** With the extended layout the header is larger, and the locks are no
+    ** longer in the region reserved for them.
     */
+#if SQLITE_WAL_NREADER==5
 #ifdef WIN_SHM_BASE
     assert(WIN_SHM_BASE == WALINDEX_LOCK_OFFSET);
 #endif
 #ifdef UNIX_SHM_BASE
     assert(UNIX_SHM_BASE == WALINDEX_LOCK_OFFSET);
 #endif
+#endif
 
 
     /* Allocate an instance of struct Wal to return. */
@@ -1838,6 +1882,174 @@ static int walPagesize(Wal *pWal)
     return (pWal->hdr.szPage & 0xfe00) + ((pWal->hdr.szPage & 0x0001) << 16);
 }
 
+/*
+** When Wal.nCkptRate is set, walCheckpoint() copies no more than
+** WAL_CKPT_RATE_STEP pages at a time, and checks whether it is ahead of
+** the rate after each batch. Only the Wal connection of a background
+** checkpointer has a rate set, by the checkpointer thread itself.
+*/
+#define WAL_CKPT_RATE_STEP 8
+
+#ifdef WAL_CKPT_THREAD
+/*
+** A background checkpointer. There is at most one of these per database
+** file in each process, shared by all connections that have enabled it
+** with sqlite3WalCkptThread(). It has its own handle on the database file
+** and its own Wal connection, so it checkpoints exactly as a separate
+** connection would.
+**
+** The thread sleeps until a connection commits a transaction that leaves
+** at least nFrame frames in the WAL that have not been backfilled, then
+** runs a PASSIVE checkpoint, writing no more than nRate pages per second
+** to the database file (if nRate>0) and syncing with syncFlags.
+**
+** All fields except those that are only used by the thread itself are
+** protected by the mutex of pCond. The list of all WalCkptThread objects
+** is protected by the SQLITE_MUTEX_STATIC_MASTER mutex.
+** 后台检查点线程,每个数据库文件一个
+*/
+struct WalCkptThread
+{
+    char *zDb;                      /* Database file name */
+    char *zWal;                     /* WAL file name */
+    sqlite3_vfs *pVfs;              /* VFS used to open the database */
+    sqlite3_file *pDbFd;            /* Database file handle used by thread */
+    Wal *pWal;                      /* Wal connection used by thread */
+    u8 *aBuf;                       /* Checkpoint buffer of SQLITE_MAX_PAGE_SIZE */
+    int nRef;                       /* Number of Wal objects using this */
+    int nFrame;                     /* Checkpoint at this many frames */
+    int nRate;                      /* Max pages per second, or 0 */
+    int syncFlags;                  /* Sync flags for checkpoints, or 0 */
+    int szPage;                     /* Database page size */
+    u8 bPending;                    /* True if a checkpoint has been requested */
+    u8 bStop;                       /* True to make the thread exit */
+    SQLiteThread *pThread;          /* The background thread */
+    SQLiteCond *pCond;              /* Signalled when bPending or bStop is set */
+    WalCkptThread *pNext;           /* Next in list of all checkpointers */
+};
+
+static WalCkptThread *walCkptList = 0;
+
+/*
+** Wait for long enough that writing nWrite pages since time iStart (as
+** returned by sqlite3OsCurrentTimeInt64()) does not exceed the rate of
+** nRate pages per second. pWal is the Wal connection of a background
+** checkpointer.
+**
+** The wait ends early if the checkpointer is told to stop, in which case
+** SQLITE_INTERRUPT is returned so that the checkpoint is abandoned.
+** Otherwise SQLITE_OK is returned.
+*/
+static int walCkptThrottle(
+    Wal *pWal,                      /* Wal connection of the checkpointer */
+    int nRate,                      /* Max pages per second */
+    int nWrite,                     /* Pages written so far */
+    sqlite3_int64 iStart            /* Time the writing started, in ms */
+)
+{
+    WalCkptThread *p = pWal->pCkptOwner;
+    sqlite3_int64 nDue = ((sqlite3_int64)nWrite * 1000) / nRate;
+    int rc = SQLITE_OK;
+
+    assert(p && nRate > 0);
+    sqlite3CondEnter(p->pCond);
+    while (p->bStop == 0)
+    {
+        sqlite3_int64 iNow = 0;
+        sqlite3OsCurrentTimeInt64(pWal->pVfs, &iNow);
+        if (iNow - iStart >= nDue) break;
+        sqlite3CondWait(p->pCond, (int)(nDue - (iNow - iStart)) * 1000);
+    }
+    if (p->bStop) rc = SQLITE_INTERRUPT;
+    sqlite3CondLeave(p->pCond);
+    return rc;
+}
+#else
+# define walCkptThrottle(w,r,n,t) SQLITE_OK
+#endif /* WAL_CKPT_THREAD */
+
+/*
+** Make sure pWal->aWriteBuf[] is large enough to stage at least one, and
+** up to SQLITE_WAL_WRITE_BUFFER bytes worth of, frames of szPage bytes.
+** If the buffer cannot be allocated, frames are written one at a time
+** instead, so a malloc failure here is not an error.
+*/
+static void walAllocWriteBuffer(Wal *pWal, int szPage)
+{
+    int szFrame = szPage + WAL_FRAME_HDRSIZE;
+    int nByte = (SQLITE_WAL_WRITE_BUFFER / szFrame) * szFrame;
+    if (nByte < szFrame) nByte = szFrame;
+    if (pWal->nWriteBuf != nByte)
+    {
+        sqlite3_free(pWal->aWriteBuf);
+        sqlite3BeginBenignMalloc();
+        pWal->aWriteBuf = (u8 *)sqlite3_malloc(nByte);
+        sqlite3EndBenignMalloc();
+        pWal->nWriteBuf = pWal->aWriteBuf ? nByte : 0;
+    }
+}
+
+/*
+** Copy nFrame consecutive frames, starting with frame iFrame, from the WAL
+** into the database file. The frames are read with a single read into
+** pWal->aWriteBuf[]. The frame headers are then squeezed out, so that
+** pages with consecutive page numbers end up next to each other, and each
+** such run of pages is written with a single write. If aWriteBuf[] could
+** not be allocated, nFrame is always 1 and zBuf is used instead.
+*/
+static int walCheckpointRun(
+    Wal *pWal,                      /* Wal connection */
+    u32 iFrame,                     /* First frame to copy */
+    int nFrame,                     /* Number of frames to copy */
+    int szPage,                     /* Database page size */
+    u8 *zBuf                        /* Page buffer, if there is no aWriteBuf */
+)
+{
+    int szFrame = szPage + WAL_FRAME_HDRSIZE;
+    u8 *aBuf = pWal->aWriteBuf;
+    u32 iFirst = 0;                 /* First page of current run */
+    int iRun = 0;                   /* Index in aBuf[] of current run */
+    int i;
+    int rc;
+
+    if (aBuf == 0)
+    {
+        u32 iDbpage = walFramePgno(pWal, iFrame);
+        assert(nFrame == 1);
+        rc = sqlite3OsRead(pWal->pWalFd, zBuf, szPage,
+                           walFrameOffset(iFrame, szPage) + WAL_FRAME_HDRSIZE);
+        if (rc == SQLITE_OK)
+        {
+            rc = sqlite3OsWrite(pWal->pDbFd, zBuf, szPage, (iDbpage - 1) * (i64)szPage);
+        }
+        return rc;
+    }
+
+    assert(nFrame * szFrame <= pWal->nWriteBuf);
+    rc = sqlite3OsRead(pWal->pWalFd, aBuf, nFrame * szFrame, walFrameOffset(iFrame, szPage));
+    for (i = 0; rc == SQLITE_OK && i < nFrame; i++)
+    {
+        /* Page i moves down over its own header, so the headers of the
+        ** frames that follow are still intact. */
+        u32 iPg = sqlite3Get4byte(&aBuf[i * szFrame]);
+        assert(iPg == walFramePgno(pWal, iFrame + i));
+        memmove(&aBuf[i * szPage], &aBuf[i * szFrame + WAL_FRAME_HDRSIZE], szPage);
+        if (i > 0 && iPg != iFirst + (i - iRun))
+        {
+            rc = sqlite3OsWrite(pWal->pDbFd, &aBuf[iRun * szPage],
+                                (i - iRun) * szPage, (iFirst - 1) * (i64)szPage);
+            iRun = i;
+        }
+        if (i == iRun) iFirst = iPg;
+    }
+    if (rc == SQLITE_OK)
+    {
+        rc = sqlite3OsWrite(pWal->pDbFd, &aBuf[iRun * szPage],
+                            (nFrame - iRun) * szPage, (iFirst - 1) * (i64)szPage);
+    }
+    return rc;
+}
+
 /*
 ** Copy as much content as we can from the WAL back into the database file
 ** in response to an sqlite3_wal_checkpoint() request or the equivalent.
@@ -1861,6 +2073,12 @@ static int walPagesize(Wal *pWal)
 ** it safe to delete the WAL since the new content will persist in the
 ** database file.
 **
+** Frames that are next to each other in the WAL are read together, and
+** pages that are next to each other in the database file are written
+** together. The writes are bracketed by SQLITE_FCNTL_WRITE_BATCH_BEGIN
+** and END, so a VFS that supports it can keep many of them in flight
+** at once. nBackfill is only advanced after the batch has ended.
+**
 ** This routine uses and updates the nBackfill field of the wal-index header.
 ** This is the only routine tha will increase the value of nBackfill.
 ** (A WAL reset or recovery will revert nBackfill to zero, but not increase
@@ -1889,6 +2107,12 @@ static int walCheckpoint(
     int i;                          /* Loop counter */
     volatile WalCkptInfo *pInfo;    /* The checkpoint status information */
     int (*xBusy)(void*) = 0;        /* Function to call when waiting for locks */
+    int nWrite = 0;                 /* Pages written so far */
+    sqlite3_int64 iStart = 0;       /* Time the backfill started, in ms */
+    u32 iFirst = 0;                 /* First frame of the current run */
+    int nRun = 0;                   /* Number of frames in the current run */
+    int nRunMax;                    /* Max frames in one run */
+    int nRate = pWal->nCkptRate;    /* Max pages per second, or 0 */
     /* 页大小 */
     szPage = walPagesize(pWal);
     testcase(szPage <= 32768);
@@ -1964,21 +2188,54 @@ static int walCheckpoint(
         }
 
         /* Iterate through the contents of the WAL, copying data to the db file.
+        ** Consecutive frames are gathered into runs that are copied by
+        ** walCheckpointRun().
         ** 迭代wal的内容,将数据写入数据库文件
         */
-        while (rc == SQLITE_OK && 0 == walIteratorNext(pIter, &iDbpage, &iFrame))
-        {
-            i64 iOffset;
-            assert(walFramePgno(pWal, iFrame) == iDbpage);
-            if (iFrame <= nBackfill || iFrame > mxSafeFrame || iDbpage > mxPage) continue;
-            iOffset = walFrameOffset(iFrame, szPage) + WAL_FRAME_HDRSIZE;
-            /* testcase( IS_BIG_INT(iOffset) ); // requires a 4GiB WAL file */
-            rc = sqlite3OsRead(pWal->pWalFd, zBuf, szPage, iOffset);
-            if (rc != SQLITE_OK) break;
-            iOffset = (iDbpage - 1) * (i64)szPage;
-            testcase(IS_BIG_INT(iOffset));
-            rc = sqlite3OsWrite(pWal->pDbFd, zBuf, szPage, iOffset);
-            if (rc != SQLITE_OK) break;
+        walAllocWriteBuffer(pWal, szPage);
+        nRunMax = pWal->nWriteBuf / (szPage + WAL_FRAME_HDRSIZE);
+        if (nRunMax == 0) nRunMax = 1;
+        if (nRate > 0 && nRunMax > WAL_CKPT_RATE_STEP)
+        {
+            nRunMax = WAL_CKPT_RATE_STEP;
+        }
+        sqlite3OsCurrentTimeInt64(pWal->pVfs, &iStart);
+        if (rc == SQLITE_OK)
+        {
+            int rcBatch = SQLITE_OK;
+            sqlite3OsFileControlHint(pWal->pDbFd, SQLITE_FCNTL_WRITE_BATCH_BEGIN, 0);
+            while (rc == SQLITE_OK && 0 == walIteratorNext(pIter, &iDbpage, &iFrame))
+            {
+                assert(walFramePgno(pWal, iFrame) == iDbpage);
+                if (iFrame <= nBackfill || iFrame > mxSafeFrame || iDbpage > mxPage) continue;
+                if (nRun > 0 && (iFrame != iFirst + nRun || nRun == nRunMax))
+                {
+                    rc = walCheckpointRun(pWal, iFirst, nRun, szPage, zBuf);
+                    nWrite += nRun;
+                    nRun = 0;
+                    if (rc == SQLITE_OK && nRate > 0)
+                    {
+                        rc = walCkptThrottle(pWal, nRate, nWrite, iStart);
+                    }
+                }
+                if (nRun == 0) iFirst = iFrame;
+                nRun++;
+            }
+            if (rc == SQLITE_OK && nRun > 0)
+            {
+                rc = walCheckpointRun(pWal, iFirst, nRun, szPage, zBuf);
+                nWrite += nRun;
+            }
+            sqlite3OsFileControlHint(pWal->pDbFd, SQLITE_FCNTL_WRITE_BATCH_END, &rcBatch);
+            if (rc == SQLITE_OK) rc = rcBatch;
+        }
+        if (rc == SQLITE_OK && nWrite > 0)
+        {
+            sqlite3_int64 iNow = 0;
+            sqlite3OsCurrentTimeInt64(pWal->pVfs, &iNow);
+            pWal->nCkptPage += nWrite;
+            pWal->nCkptPageSec = (int)(((sqlite3_int64)nWrite * 1000)
+                                       / (iNow > iStart ? iNow - iStart : 1));
         }
 
         /* If work was actually accomplished... */
@@ -2060,6 +2317,308 @@ static void walLimitSize(Wal *pWal, i64 nMax)
     }
 }
 
+#ifdef WAL_CKPT_THREAD
+/*
+** Main routine of a background checkpointer thread.
+*/
+static void *walCkptThreadMain(void *pArg)
+{
+    WalCkptThread *p = (WalCkptThread*)pArg;
+    sqlite3CondEnter(p->pCond);
+    while (p->bStop == 0)
+    {
+        int szPage;
+        int syncFlags;
+        if (p->bPending == 0)
+        {
+            sqlite3CondWait(p->pCond, -1);
+            continue;
+        }
+        p->bPending = 0;
+        szPage = p->szPage;
+        syncFlags = p->syncFlags;
+        p->pWal->nCkptRate = p->nRate;
+        sqlite3CondLeave(p->pCond);
+
+        /* Errors, including SQLITE_BUSY if another connection is already
+        ** checkpointing, are ignored. The next commit will try again. */
+        sqlite3WalCheckpoint(p->pWal, SQLITE_CHECKPOINT_PASSIVE, 0, 0,
+                             syncFlags, szPage, p->aBuf, 0, 0);
+
+        sqlite3CondEnter(p->pCond);
+    }
+    sqlite3CondLeave(p->pCond);
+    return 0;
+}
+
+/*
+** Stop the thread belonging to checkpointer p, close its files and free
+** it. The caller must already have removed p from walCkptList.
+*/
+static void walCkptThreadFree(WalCkptThread *p)
+{
+    if (p->pThread)
+    {
+        /* Setting bStop also wakes the thread if it is waiting in
+        ** walCkptThrottle(), which then abandons the checkpoint, so the
+        ** join does not wait for a throttled checkpoint to finish. */
+        sqlite3CondEnter(p->pCond);
+        p->bStop = 1;
+        sqlite3CondSignal(p->pCond);
+        sqlite3CondLeave(p->pCond);
+        sqlite3ThreadJoin(p->pThread, 0);
+    }
+    if (p->pWal)
+    {
+        sqlite3WalClose(p->pWal, p->syncFlags, SQLITE_MAX_PAGE_SIZE, p->aBuf);
+    }
+    if (p->pDbFd)
+    {
+        sqlite3OsUnlock(p->pDbFd, NO_LOCK);
+    }
+    sqlite3OsCloseFree(p->pDbFd);
+    sqlite3CondFree(p->pCond);
+    sqlite3_free(p->aBuf);
+    sqlite3_free(p);
+}
+
+/*
+** Create a new background checkpointer for database zDb, and start its
+** thread. zWal is the name of the WAL file. The new checkpointer has no
+** references.
+*/
+static int walCkptThreadCreate(
+    sqlite3_vfs *pVfs,              /* VFS used to open the database */
+    const char *zDb,                /* Database file name */
+    const char *zWal,               /* WAL file name */
+    WalCkptThread **pp              /* OUT: New checkpointer */
+)
+{
+    WalCkptThread *p;
+    int nDb = sqlite3Strlen30(zDb);
+    int nWal = sqlite3Strlen30(zWal);
+    int rc = SQLITE_OK;
+
+    /* Both names are followed by two nul-terminators, as there may not
+    ** be any URI parameters following them. */
+    *pp = 0;
+    p = (WalCkptThread*)sqlite3MallocZero(sizeof(WalCkptThread) + nDb + nWal + 4);
+    if (p == 0) return SQLITE_NOMEM;
+    p->zDb = (char*)&p[1];
+    p->zWal = &p->zDb[nDb + 2];
+    memcpy(p->zDb, zDb, nDb);
+    memcpy(p->zWal, zWal, nWal);
+    p->pVfs = pVfs;
+
+    /* Open the database file and take a SHARED lock on it, as any other
+    ** connection in WAL mode does. Then open a Wal connection on it. */
+    p->pCond = sqlite3CondAlloc();
+    p->aBuf = (u8*)sqlite3_malloc(SQLITE_MAX_PAGE_SIZE);
+    if (p->pCond == 0 || p->aBuf == 0)
+    {
+        rc = SQLITE_NOMEM;
+    }
+    else
+    {
+        int flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_MAIN_DB;
+        rc = sqlite3OsOpenMalloc(pVfs, p->zDb, &p->pDbFd, flags, &flags);
+    }
+    if (rc == SQLITE_OK)
+    {
+        rc = sqlite3OsLock(p->pDbFd, SHARED_LOCK);
+    }
+    if (rc == SQLITE_OK)
+    {
+        rc = sqlite3WalOpen(pVfs, p->pDbFd, p->zWal, 0, -1, &p->pWal);
+    }
+    if (rc == SQLITE_OK)
+    {
+        /* Map the wal-index now. sqlite3WalCheckpoint() takes locks on it
+        ** before reading it for the first time. */
+        volatile u32 *pDummy;
+        p->pWal->pCkptOwner = p;
+        rc = walIndexPage(p->pWal, 0, &pDummy);
+    }
+    if (rc == SQLITE_OK)
+    {
+        rc = sqlite3ThreadCreate(&p->pThread, walCkptThreadMain, p);
+    }
+    if (rc != SQLITE_OK)
+    {
+        walCkptThreadFree(p);
+        return rc;
+    }
+    *pp = p;
+    return SQLITE_OK;
+}
+
+/*
+** Return the background checkpointer of database zDb opened with VFS
+** pVfs, or NULL if there is none. The caller must hold the
+** SQLITE_MUTEX_STATIC_MASTER mutex.
+*/
+static WalCkptThread *walCkptThreadFind(sqlite3_vfs *pVfs, const char *zDb)
+{
+    WalCkptThread *p;
+    for (p = walCkptList; p; p = p->pNext)
+    {
+        if (p->pVfs == pVfs && strcmp(p->zDb, zDb) == 0) break;
+    }
+    return p;
+}
+
+/*
+** Drop the reference that pWal holds on its background checkpointer, if
+** any. The checkpointer is stopped when the last reference is dropped.
+*/
+static void walCkptThreadRelease(Wal *pWal)
+{
+    WalCkptThread *p = pWal->pCkptThread;
+    if (p)
+    {
+        sqlite3_mutex *mutex = sqlite3MutexAlloc(SQLITE_MUTEX_STATIC_MASTER);
+        pWal->pCkptThread = 0;
+        sqlite3_mutex_enter(mutex);
+        p->nRef--;
+        if (p->nRef == 0)
+        {
+            WalCkptThread **pp;
+            for (pp = &walCkptList; *pp != p; pp = &(*pp)->pNext) {}
+            *pp = p->pNext;
+        }
+        else
+        {
+            p = 0;
+        }
+        sqlite3_mutex_leave(mutex);
+        if (p) walCkptThreadFree(p);
+    }
+}
+
+/*
+** Called when pWal ends the read transaction in which it committed a
+** transaction. Wake the background checkpointer if the WAL now holds
+** enough frames that have not been checkpointed.
+*/
+static void walCkptThreadSignal(Wal *pWal)
+{
+    WalCkptThread *p = pWal->pCkptThread;
+    u32 nFrame = pWal->hdr.mxFrame - walCkptInfo(pWal)->nBackfill;
+    sqlite3CondEnter(p->pCond);
+    if (nFrame >= (u32)p->nFrame)
+    {
+        p->szPage = (int)pWal->szPage;
+        p->bPending = 1;
+        sqlite3CondSignal(p->pCond);
+    }
+    sqlite3CondLeave(p->pCond);
+}
+#else
+# define walCkptThreadRelease(x)
+#endif /* WAL_CKPT_THREAD */
+
+/*
+** Configure background checkpointing for pWal, the WAL of database file
+** zDb.
+**
+** If nFrame is greater than zero, the Wal connection is attached to the
+** background checkpointer of database zDb, which is started if it is not
+** already running in this process. Each time a transaction committed
+** through pWal leaves nFrame or more frames in the WAL that have not yet
+** been checkpointed, the checkpointer is woken up to run a PASSIVE
+** checkpoint. The checkpoint writes at most nRate pages per second to
+** the database file (no limit if nRate is zero or less), and syncs with
+** flags syncFlags (0, SQLITE_SYNC_NORMAL or SQLITE_SYNC_FULL). These
+** settings are shared by all connections to the same database that use
+** the checkpointer. The most recent call takes precedence.
+**
+** If nFrame is zero or less, the Wal connection is detached from the
+** background checkpointer. The checkpointer stops once no connection is
+** attached to it.
+**
+** Background checkpointing is not available in heap-memory mode, if the
+** library was built without thread support, or if it is configured with
+** SQLITE_CONFIG_SINGLETHREAD. In those cases this function returns
+** SQLITE_OK without doing anything.
+*/
+int sqlite3WalCkptThread(
+    Wal *pWal,                      /* Wal connection */
+    const char *zDb,                /* Name of database file */
+    int nFrame,                     /* Checkpoint threshold in frames */
+    int nRate,                      /* Max pages per second written */
+    int syncFlags                   /* Sync flags for checkpoints */
+)
+{
+    int rc = SQLITE_OK;
+#ifdef WAL_CKPT_THREAD
+    sqlite3_mutex *mutex;
+    WalCkptThread *p;
+    WalCkptThread *pNew = 0;
+    if (nFrame <= 0 || pWal->exclusiveMode == WAL_HEAPMEMORY_MODE || pWal->readOnly
+        || !sqlite3GlobalConfig.bCoreMutex)
+    {
+        walCkptThreadRelease(pWal);
+        return SQLITE_OK;
+    }
+
+    mutex = sqlite3MutexAlloc(SQLITE_MUTEX_STATIC_MASTER);
+    sqlite3_mutex_enter(mutex);
+    p = pWal->pCkptThread;
+    if (p == 0)
+    {
+        p = walCkptThreadFind(pWal->pVfs, zDb);
+        if (p == 0)
+        {
+            /* Opening the database file for the new checkpointer requires
+            ** the static mutex (see unixEnterMutex()), so it is created
+            ** without holding it. If another connection starts one for
+            ** the same database meanwhile, that one is used instead. */
+            sqlite3_mutex_leave(mutex);
+            rc = walCkptThreadCreate(pWal->pVfs, zDb, pWal->zWalName, &pNew);
+            if (rc != SQLITE_OK) return rc;
+            sqlite3_mutex_enter(mutex);
+            p = walCkptThreadFind(pWal->pVfs, zDb);
+            if (p == 0)
+            {
+                p = pNew;
+                pNew = 0;
+                p->pNext = walCkptList;
+                walCkptList = p;
+            }
+        }
+        p->nRef++;
+        pWal->pCkptThread = p;
+    }
+    sqlite3CondEnter(p->pCond);
+    p->nFrame = nFrame;
+    p->nRate = nRate > 0 ? nRate : 0;
+    p->syncFlags = syncFlags;
+    sqlite3CondLeave(p->pCond);
+    sqlite3_mutex_leave(mutex);
+    if (pNew) walCkptThreadFree(pNew);
+#else
+    UNUSED_PARAMETER(pWal);
+    UNUSED_PARAMETER(zDb);
+    UNUSED_PARAMETER(nFrame);
+    UNUSED_PARAMETER(nRate);
+    UNUSED_PARAMETER(syncFlags);
+#endif
+    return rc;
+}
+
+/*
+** Return true if a background checkpointer is attached to pWal.
+*/
+int sqlite3WalCkptThreadActive(Wal *pWal)
+{
+#ifdef WAL_CKPT_THREAD
+    return pWal && pWal->pCkptThread != 0;
+#else
+    UNUSED_PARAMETER(pWal);
+    return 0;
+#endif
+}
+
 /*
 ** Close a connection to a log file.
 */
@@ -2075,6 +2634,10 @@ int sqlite3WalClose(
     {
         int isDelete = 0;             /* True to unlink wal and wal-index files */
 
+        /* Stop using the background checkpointer first. Its SHARED lock on
+        ** the database file would prevent the EXCLUSIVE lock below. */
+        walCkptThreadRelease(pWal);
+
         /* If an EXCLUSIVE lock can be obtained on the database file (using the
         ** ordinary, rollback-mode locking methods, this guarantees that the
         ** connection associated with this log file is the only connection to
@@ -2129,6 +2692,7 @@ int sqlite3WalClose(
         }
         WALTRACE(("WAL%p: closed\n", pWal));
         sqlite3_free((void *)pWal->apWiData);
+        sqlite3_free(pWal->aWriteBuf);
         sqlite3_free(pWal);
     }
     return rc;
@@ -2354,6 +2918,7 @@ static int walTryBeginRead(Wal *pWal, int *pChanged, int useWal, int cnt)
     int mxI;                        /* Index of largest aReadMark[] value */
     int i;                          /* Loop counter */
     int rc = SQLITE_OK;             /* Return code  */
+    u32 mTried = 0;                 /* Mask of aReadMark[] slots found busy */
 
     assert(pWal->readLock < 0);     /* Not currently locked */
 
@@ -2486,13 +3051,21 @@ static int walTryBeginRead(Wal *pWal, int *pChanged, int useWal, int cnt)
             && (mxReadMark < pWal->hdr.mxFrame || mxI == 0)
            )
         {
-            for (i = 1; i < WAL_NREADER; i++)
+            /* Start with the slot this connection last had to move to
+            ** because of contention. With many readers this keeps
+            ** connections from all contending for the first slot.
+            ** 从上次发生冲突后占用的槽位开始尝试 */
+            int iStart = pWal->iReadClaim ? pWal->iReadClaim : 1;
+            int j;
+            for (j = 0; j < WAL_NREADER - 1; j++)
             {
+                i = 1 + (iStart - 1 + j) % (WAL_NREADER - 1);
                 rc = walLockExclusive(pWal, WAL_READ_LOCK(i), 1);
                 if (rc == SQLITE_OK)
                 {
                     mxReadMark = pInfo->aReadMark[i] = pWal->hdr.mxFrame;
                     mxI = i;
+                    if (j > 0) pWal->iReadClaim = (u8)i;
                     walUnlockExclusive(pWal, WAL_READ_LOCK(i), 1);
                     break;
                 }
@@ -2508,10 +3081,35 @@ static int walTryBeginRead(Wal *pWal, int *pChanged, int useWal, int cnt)
             return rc == SQLITE_BUSY ? WAL_RETRY : SQLITE_READONLY_CANTLOCK;
         }
 
-        rc = walLockShared(pWal, WAL_READ_LOCK(mxI));
+        /* If the shared lock on the chosen slot is busy, some other
+        ** connection is updating that slot. Rather than retrying from the
+        ** start, fall back to the best of the slots not yet tried. Any
+        ** slot whose mark does not exceed hdr.mxFrame is usable.
+        */
+        while ((rc = walLockShared(pWal, WAL_READ_LOCK(mxI))) == SQLITE_BUSY)
+        {
+            mTried |= ((u32)1 << mxI);
+            mxReadMark = 0;
+            mxI = 0;
+            for (i = 1; i < WAL_NREADER; i++)
+            {
+                u32 thisMark = pInfo->aReadMark[i];
+                if ((mTried & ((u32)1 << i)) == 0
+                    && mxReadMark <= thisMark && thisMark <= pWal->hdr.mxFrame
+                   )
+                {
+                    mxReadMark = thisMark;
+                    mxI = i;
+                }
+            }
+            if (mxI == 0)
+            {
+                return WAL_RETRY;
+            }
+        }
         if (rc)
         {
-            return rc == SQLITE_BUSY ? WAL_RETRY : rc;
+            return rc;
         }
         /* Now that the read-lock has been obtained, check that neither the
         ** value in the aReadMark[] array or the contents of the wal-index
@@ -2594,25 +3192,31 @@ void sqlite3WalEndReadTransaction(Wal *pWal)
         walUnlockShared(pWal, WAL_READ_LOCK(pWal->readLock));
         pWal->readLock = -1;
     }
+#ifdef WAL_CKPT_THREAD
+    /* Wake the background checkpointer only now that the read lock is
+    ** released, as it cannot backfill frames past this reader's mark. */
+    if (pWal->ckptSignal)
+    {
+        pWal->ckptSignal = 0;
+        if (pWal->pCkptThread) walCkptThreadSignal(pWal);
+    }
+#endif
 }
 
 /*
-** Read a page from the WAL, if it is present in the WAL and if the
-** current read transaction is configured to use the WAL.
-** 从WAL中读取一个页
+** Search the wal file for page pgno. If found, set *piRead to the frame that
+** contains the page. Otherwise, if pgno is not in the wal file, set *piRead
+** to zero.
+** 在WAL中查找页pgno所在的帧
 **
-** The *pInWal is set to 1 if the requested page is in the WAL and
-** has been loaded.  Or *pInWal is set to 0 if the page was not in
-** the WAL and needs to be read out of the database.
+** Return SQLITE_OK if successful, or an error code if an error occurs. If an
+** error does occur, the final value of *piRead is undefined.
 */
-int sqlite3WalRead(
+int sqlite3WalFindFrame(
     Wal *pWal,                      /* WAL handle */
     /* 页号 */
     Pgno pgno,                      /* Database page number to read data for */
-    /* 如果能从WAL中读取到的话,设置为true */
-    int *pInWal,                    /* OUT: True if data is read from WAL */
-    int nOut,                       /* Size of buffer pOut in bytes */
-    u8 *pOut                        /* Buffer to write page data to */
+    u32 *piRead                     /* OUT: Frame number (or zero) */
 )
 {
     u32 iRead = 0;                  /* If !=0, WAL frame to return data from */
@@ -2631,7 +3235,7 @@ int sqlite3WalRead(
     */
     if (iLast == 0 || pWal->readLock == 0)
     {
-        *pInWal = 0;
+        *piRead = 0;
         return SQLITE_OK;
     }
 
@@ -2715,27 +3319,33 @@ int sqlite3WalRead(
     }
 #endif
 
-    /* If iRead is non-zero, then it is the log frame number that contains the
-    ** required page. Read and return data from the log file.
-    */
-    if (iRead)
-    {
-        int sz;
-        i64 iOffset;
-        sz = pWal->hdr.szPage;
-        sz = (sz & 0xfe00) + ((sz & 0x0001) << 16);
-        testcase(sz <= 32768);
-        testcase(sz >= 65536);
-        iOffset = walFrameOffset(iRead, sz) + WAL_FRAME_HDRSIZE;
-        *pInWal = 1;
-        /* testcase( IS_BIG_INT(iOffset) ); // requires a 4GiB WAL */
-        return sqlite3OsRead(pWal->pWalFd, pOut, (nOut > sz ? sz : nOut), iOffset);
-    }
-
-    *pInWal = 0;
+    *piRead = iRead;
     return SQLITE_OK;
 }
 
+/*
+** Read the contents of frame iRead from the wal file into buffer pOut
+** (which is nOut bytes in size). Return SQLITE_OK if successful, or an
+** error code otherwise.
+*/
+int sqlite3WalReadFrame(
+    Wal *pWal,                      /* WAL handle */
+    u32 iRead,                      /* Frame to read */
+    int nOut,                       /* Size of buffer pOut in bytes */
+    u8 *pOut                        /* Buffer to write page data to */
+)
+{
+    int sz;
+    i64 iOffset;
+    sz = pWal->hdr.szPage;
+    sz = (sz & 0xfe00) + ((sz & 0x0001) << 16);
+    testcase(sz <= 32768);
+    testcase(sz >= 65536);
+    iOffset = walFrameOffset(iRead, sz) + WAL_FRAME_HDRSIZE;
+    /* testcase( IS_BIG_INT(iOffset) ); // requires a 4GiB WAL */
+    return sqlite3OsRead(pWal->pWalFd, pOut, (nOut > sz ? sz : nOut), iOffset);
+}
+
 
 /*
 ** Return the size of the database in pages (or zero, if unknown).
@@ -2800,19 +3410,185 @@ int sqlite3WalBeginWriteTransaction(Wal *pWal)
     return rc;
 }
 
+/*
+** Return the first frame of the WAL that was not part of this
+** connection's snapshot, according to wal-index header pHdr. If the WAL
+** has been restarted since the snapshot was taken, that is frame 1. The
+** caller must hold the write lock.
+*/
+static u32 walFirstNewFrame(Wal *pWal, WalIndexHdr *pHdr)
+{
+    if (memcmp(pHdr->aSalt, pWal->hdr.aSalt, sizeof(pHdr->aSalt)) != 0)
+    {
+        /* The log can only have been restarted if this connection is
+        ** reading from the database file alone. */
+        assert(pWal->readLock == 0);
+        return 1;
+    }
+    return pWal->hdr.mxFrame + 1;
+}
+
+/*
+** This function is called by a connection with a BEGIN CONCURRENT
+** transaction open, just before its changes are written to the log. It
+** takes the write lock, which the transaction did not hold while its
+** changes were being made, and validates the transaction.
+**
+** pReadSet is the set of pages read by the transaction, not including
+** page 1. If any frame appended to the log since this connection's
+** snapshot was taken is for a page in pReadSet, the transaction
+** conflicts with the one that wrote the frame. In that case the write lock
+** is released and SQLITE_BUSY_SNAPSHOT returned. SQLITE_BUSY is returned if
+** the write lock cannot be obtained.
+**
+** Otherwise SQLITE_OK is returned with the write lock held. Page 1 is left
+** for the caller to deal with: *piPage1 is set to the last of the new
+** frames that holds page 1, or to 0 if there is no such frame. The caller
+** should then call either sqlite3WalUpgradeSnapshot() or
+** sqlite3WalEndWriteTransaction().
+** 在提交前检查并发事务读过的页是否已被其他连接修改
+*/
+int sqlite3WalLockForCommit(Wal *pWal, Bitvec *pReadSet, u32 *piPage1)
+{
+    int rc;
+    WalIndexHdr head;               /* Current wal-index header */
+    u32 iFrame;
+
+    assert(pWal->readLock >= 0);
+    assert(pWal->writeLock == 0);
+    *piPage1 = 0;
+
+    if (pWal->readOnly)
+    {
+        return SQLITE_READONLY;
+    }
+    rc = walLockExclusive(pWal, WAL_WRITE_LOCK, 1);
+    if (rc)
+    {
+        return rc;
+    }
+    pWal->writeLock = 1;
+
+    /* No other connection can modify the wal-index header while this one
+    ** holds the write lock, so a simple copy is consistent. */
+    memcpy(&head, (void *)walIndexHdr(pWal), sizeof(WalIndexHdr));
+    if (memcmp(&head, &pWal->hdr, sizeof(WalIndexHdr)) == 0)
+    {
+        return SQLITE_OK;
+    }
+
+    for (iFrame = walFirstNewFrame(pWal, &head);
+         rc == SQLITE_OK && iFrame <= head.mxFrame;
+         iFrame++
+        )
+    {
+        volatile u32 *pDummy;
+        rc = walIndexPage(pWal, walFramePage(iFrame), &pDummy);
+        if (rc == SQLITE_OK)
+        {
+            u32 pgno = walFramePgno(pWal, iFrame);
+            if (pgno == 1)
+            {
+                *piPage1 = iFrame;
+            }
+            else if (sqlite3BitvecTest(pReadSet, pgno))
+            {
+                rc = SQLITE_BUSY_SNAPSHOT;
+            }
+        }
+    }
+
+    if (rc != SQLITE_OK)
+    {
+        walUnlockExclusive(pWal, WAL_WRITE_LOCK, 1);
+        pWal->writeLock = 0;
+    }
+    return rc;
+}
+
+/*
+** Called after a successful sqlite3WalLockForCommit() to move this
+** connection's snapshot to the end of the log, so that the BEGIN
+** CONCURRENT transaction is appended after those committed since the
+** snapshot was taken. xUndo is invoked for the page written by each of
+** those frames, so that the caller may discard out of date cached copies.
+*/
+int sqlite3WalUpgradeSnapshot(Wal *pWal, int (*xUndo)(void *, Pgno), void *pUndoCtx)
+{
+    int rc = SQLITE_OK;
+    WalIndexHdr head;
+    u32 iFrame;
+
+    assert(pWal->writeLock);
+    memcpy(&head, (void *)walIndexHdr(pWal), sizeof(WalIndexHdr));
+    iFrame = walFirstNewFrame(pWal, &head);
+    memcpy(&pWal->hdr, &head, sizeof(WalIndexHdr));
+
+    for (; rc == SQLITE_OK && iFrame <= head.mxFrame; iFrame++)
+    {
+        rc = xUndo(pUndoCtx, walFramePgno(pWal, iFrame));
+    }
+    return rc;
+}
+
+/*
+** Sync the WAL file for a transaction committed in group-commit mode.
+**
+** The VFS is given the chance to coordinate the sync with those of other
+** connections to the same database. If another connection syncs the WAL
+** file after this one wrote its frames, that sync is enough and this
+** function just returns its result. Otherwise, this connection syncs the
+** WAL file and the result is reported back to the VFS for the benefit of
+** any connections that were waiting for it.
+*/
+static int walGroupSync(Wal *pWal, int syncFlags)
+{
+    int rc;
+    int aSync[2];
+    aSync[0] = syncFlags;
+    aSync[1] = -1;
+    sqlite3OsFileControlHint(pWal->pDbFd, SQLITE_FCNTL_WAL_SYNC_BEGIN, aSync);
+    if (aSync[1] >= 0) return aSync[1];
+    rc = sqlite3OsSync(pWal->pWalFd, syncFlags);
+    sqlite3OsFileControlHint(pWal->pDbFd, SQLITE_FCNTL_WAL_SYNC_END, &rc);
+    return rc;
+}
+
 /*
 ** End a write transaction.  The commit has already been done.  This
 ** routine merely releases the lock.
 */
 int sqlite3WalEndWriteTransaction(Wal *pWal)
 {
+    int rc = SQLITE_OK;
     if (pWal->writeLock)
     {
         walUnlockExclusive(pWal, WAL_WRITE_LOCK, 1);
         pWal->writeLock = 0;
         pWal->truncateOnCommit = 0;
     }
-    return SQLITE_OK;
+
+    /* In group-commit mode, the sync for a committed transaction is done
+    ** here, after the write lock has been released. Other connections may
+    ** append their own transactions meanwhile, and the VFS may satisfy
+    ** several such syncs with a single fsync(). See sqlite3WalFrames().
+    **
+    ** By now the transaction is committed and may have been read, so it
+    ** cannot be rolled back if the sync fails. Instead the error is
+    ** reported as an SQLITE_IOERR, which puts the pager into the error
+    ** state and makes the COMMIT fail even though the transaction may
+    ** have been committed (and is if the WAL file survives).
+    */
+    if (pWal->pendingSync)
+    {
+        rc = walGroupSync(pWal, pWal->pendingSync);
+        pWal->pendingSync = 0;
+        if (rc != SQLITE_OK && (rc & 0xFF) != SQLITE_IOERR)
+        {
+            rc = SQLITE_IOERR_FSYNC;
+        }
+    }
+    return rc;
 }
 
 /*
@@ -2833,7 +3609,10 @@ int sqlite3WalEndWriteTransaction(Wal *pWal)
 int sqlite3WalUndo(Wal *pWal, int (*xUndo)(void *, Pgno), void *pUndoCtx)
 {
     int rc = SQLITE_OK;
-    if (ALWAYS(pWal->writeLock))
+
+    /* A BEGIN CONCURRENT transaction does not hold the write lock until it
+    ** commits, and writes nothing to the log before then. */
+    if (pWal->writeLock)
     {
         Pgno iMax = pWal->hdr.mxFrame;
         Pgno iFrame;
@@ -2877,7 +3656,6 @@ int sqlite3WalUndo(Wal *pWal, int (*xUndo)(void *, Pgno), void *pUndoCtx)
 */
 void sqlite3WalSavepoint(Wal *pWal, u32 *aWalData)
 {
-    assert(pWal->writeLock);
     aWalData[0] = pWal->hdr.mxFrame;
     aWalData[1] = pWal->hdr.aFrameCksum[0];
     aWalData[2] = pWal->hdr.aFrameCksum[1];
@@ -2894,7 +3672,12 @@ int sqlite3WalSavepointUndo(Wal *pWal, u32 *aWalData)
 {
     int rc = SQLITE_OK;
 
-    assert(pWal->writeLock);
+    /* Without the write lock (a BEGIN CONCURRENT transaction) nothing has
+    ** been written to the log, so there is nothing to undo. */
+    if (pWal->writeLock == 0)
+    {
+        return SQLITE_OK;
+    }
     assert(aWalData[3] != pWal->nCkpt || aWalData[0] <= pWal->hdr.mxFrame);
 
     if (aWalData[3] != pWal->nCkpt)
@@ -2997,6 +3780,10 @@ static int walRestartLog(Wal *pWal)
 ** Information about the current state of the WAL file and where
 ** the next fsync should occur - passed from sqlite3WalFrames() into
 ** walWriteToLog().
+**
+** If aBuf is not NULL, frames are not written as they are encoded.
+** Instead they are appended to aBuf[] and written to the WAL file in
+** one piece, starting at offset iBufOfst, by walFlushFrames().
 */
 typedef struct WalWriter
 {
@@ -3005,6 +3792,10 @@ typedef struct WalWriter
     sqlite3_int64 iSyncPoint;    /* Fsync at this offset */
     int syncFlags;               /* Flags for the fsync */
     int szPage;                  /* Size of one page */
+    u8 *aBuf;                    /* Staging buffer, or NULL */
+    int nBuf;                    /* Size of aBuf[] in bytes */
+    int iBuf;                    /* Bytes of aBuf[] currently in use */
+    sqlite3_int64 iBufOfst;      /* WAL file offset of aBuf[0] */
 } WalWriter;
 
 /*
@@ -3027,6 +3818,7 @@ static int walWriteToLog(
     {
         int iFirstAmt = (int)(p->iSyncPoint - iOffset);
         rc = sqlite3OsWrite(p->pFd, pContent, iFirstAmt, iOffset);
+        p->pWal->nFrameWrite++;
         if (rc) return rc;
         iOffset += iFirstAmt;
         iAmt -= iFirstAmt;
@@ -3036,12 +3828,34 @@ static int walWriteToLog(
         if (iAmt == 0 || rc) return rc;
     }
     rc = sqlite3OsWrite(p->pFd, pContent, iAmt, iOffset);
+    p->pWal->nFrameWrite++;
+    return rc;
+}
+
+/*
+** Write the frames accumulated in the staging buffer, if any, to the
+** WAL file and empty the buffer.
+** 将缓冲区中累积的帧一次性写入WAL文件
+*/
+static int walFlushFrames(WalWriter *p)
+{
+    int rc = SQLITE_OK;
+    if (p->iBuf > 0)
+    {
+        int nFrame = p->iBuf / (p->szPage + WAL_FRAME_HDRSIZE);
+        rc = walWriteToLog(p, p->aBuf, p->iBuf, p->iBufOfst);
+        if (rc == SQLITE_OK) p->pWal->nFrameAppend += nFrame;
+        p->iBuf = 0;
+    }
     return rc;
 }
 
 /*
 ** Write out a single frame of the WAL
 ** 在WAL中写入一个帧
+**
+** If the writer has a staging buffer, the frame is appended to it and
+** the buffer is only written out once it is full.
 */
 static int walWriteOneFrame(
     WalWriter *p,               /* Where to write the frame */
@@ -3058,6 +3872,23 @@ static int walWriteOneFrame(
 #else
     pData = pPage->pData;
 #endif
+    if (p->aBuf)
+    {
+        int szFrame = p->szPage + WAL_FRAME_HDRSIZE;
+        u8 *aOut;
+        if (p->iBuf + szFrame > p->nBuf)
+        {
+            rc = walFlushFrames(p);
+            if (rc) return rc;
+        }
+        if (p->iBuf == 0) p->iBufOfst = iOffset;
+        assert(p->iBufOfst + p->iBuf == iOffset);
+        aOut = &p->aBuf[p->iBuf];
+        walEncodeFrame(p->pWal, pPage->pgno, nTruncate, pData, aOut);
+        memcpy(&aOut[WAL_FRAME_HDRSIZE], pData, p->szPage);
+        p->iBuf += szFrame;
+        return SQLITE_OK;
+    }
     /* 先写入首部 */
     walEncodeFrame(p->pWal, pPage->pgno, nTruncate, pData, aFrame);
     rc = walWriteToLog(p, aFrame, sizeof(aFrame), iOffset);
@@ -3065,6 +3896,7 @@ static int walWriteOneFrame(
     /* Write the page data */
     /* 再写入内容 */
     rc = walWriteToLog(p, pData, p->szPage, iOffset + sizeof(aFrame));
+    if (rc == SQLITE_OK) p->pWal->nFrameAppend++;
     return rc;
 }
 
@@ -3173,12 +4005,21 @@ int sqlite3WalFrames(
     w.iSyncPoint = 0;
     w.syncFlags = sync_flags;
     w.szPage = szPage;
+    walAllocWriteBuffer(pWal, szPage);
+    w.aBuf = pWal->aWriteBuf;
+    w.nBuf = pWal->nWriteBuf;
+    w.iBuf = 0;
+    w.iBufOfst = 0;
     iOffset = walFrameOffset(iFrame + 1, szPage);
     szFrame = szPage + WAL_FRAME_HDRSIZE;
 
-    /* Write all frames into the log file exactly once
+    /* Write all frames into the log file exactly once. Frames are staged
+    ** in w.aBuf[] and appended with as few writes as possible. The VFS may
+    ** also submit those writes as a single batch, but all of them must
+    ** have reached the file before the wal-index is updated below.
     ** 一次性写入所有的帧
     */
+    sqlite3OsFileControlHint(w.pFd, SQLITE_FCNTL_WRITE_BATCH_BEGIN, 0);
     for (p = pList; p; p = p->pDirty)
     {
         int nDbSize;   /* 0 normally.  Positive == commit flag */
@@ -3186,7 +4027,7 @@ int sqlite3WalFrames(
         assert(iOffset == walFrameOffset(iFrame, szPage));
         nDbSize = (isCommit && p->pDirty == 0) ? nTruncate : 0;
         rc = walWriteOneFrame(&w, p, nDbSize, iOffset);
-        if (rc) return rc;
+        if (rc) break;
         pLast = p;
         iOffset += szFrame;
     }
@@ -3204,20 +4045,47 @@ int sqlite3WalFrames(
     ** boundary is crossed.  Only the part of the WAL prior to the last
     ** sector boundary is synced; the part of the last frame that extends
     ** past the sector boundary is written after the sync.
+    **
+    ** Padding frames go through the staging buffer along with the rest of
+    ** the transaction. walWriteToLog() splits whichever write crosses
+    ** w.iSyncPoint around the sync.
     */
-    if (isCommit && (sync_flags & WAL_SYNC_TRANSACTIONS) != 0)
+    if (rc == SQLITE_OK && isCommit && (sync_flags & WAL_SYNC_TRANSACTIONS) != 0
+            && pWal->padToSectorBoundary)
     {
-        if (pWal->padToSectorBoundary)
+        int sectorSize = sqlite3OsSectorSize(pWal->pWalFd);
+        w.iSyncPoint = ((iOffset + sectorSize - 1) / sectorSize) * sectorSize;
+        while (iOffset < w.iSyncPoint)
         {
-            int sectorSize = sqlite3OsSectorSize(pWal->pWalFd);
-            w.iSyncPoint = ((iOffset + sectorSize - 1) / sectorSize) * sectorSize;
-            while (iOffset < w.iSyncPoint)
-            {
-                rc = walWriteOneFrame(&w, pLast, nTruncate, iOffset);
-                if (rc) return rc;
-                iOffset += szFrame;
-                nExtra++;
-            }
+            rc = walWriteOneFrame(&w, pLast, nTruncate, iOffset);
+            if (rc) break;
+            iOffset += szFrame;
+            nExtra++;
+        }
+    }
+    if (rc == SQLITE_OK)
+    {
+        rc = walFlushFrames(&w);
+    }
+    {
+        int rcBatch = SQLITE_OK;
+        sqlite3OsFileControlHint(w.pFd, SQLITE_FCNTL_WRITE_BATCH_END, &rcBatch);
+        if (rc == SQLITE_OK) rc = rcBatch;
+        if (rc) return rc;
+    }
+    if (isCommit && (sync_flags & WAL_SYNC_TRANSACTIONS) != 0
+            && !pWal->padToSectorBoundary)
+    {
+        /* In group-commit mode, defer the sync until the write lock has
+        ** been released by sqlite3WalEndWriteTransaction(). The new
+        ** transaction is visible to readers before it is durable, as with
+        ** synchronous=NORMAL, but the committing connection does not
+        ** report success until it has been synced. If the sync fails, the
+        ** commit reports an error although the transaction is committed.
+        */
+        if (pWal->groupCommit)
+        {
+            pWal->pendingSync = (u8)(sync_flags & SQLITE_SYNC_MASK);
         }
         else
         {
@@ -3276,6 +4144,7 @@ int sqlite3WalFrames(
         {
             walIndexWriteHdr(pWal);
             pWal->iCallback = iFrame;
+            pWal->ckptSignal = (pWal->pCkptThread != 0);
         }
     }
 
@@ -3490,6 +4359,72 @@ int sqlite3WalHeapMemory(Wal *pWal)
     return (pWal && pWal->exclusiveMode == WAL_HEAPMEMORY_MODE);
 }
 
+/*
+** Enable or disable group-commit mode if onoff is 0 or 1. Return the
+** current setting.
+**
+** In group-commit mode, a transaction that requires a sync at commit time
+** (synchronous=FULL) is synced after the WAL write lock is released
+** instead of before. This allows other connections to append frames
+** while the sync is in progress. It has no effect if transactions are
+** padded to a sector boundary (no powersafe overwrite), as the padding
+** frames must be synced before the next transaction is written.
+**
+** As the transaction is committed before it is synced, a failed sync
+** cannot roll it back. The commit fails with SQLITE_IOERR and the pager
+** enters the error state, but the transaction may still be in the
+** database when it is next read.
+*/
+int sqlite3WalGroupCommit(Wal *pWal, int onoff)
+{
+    if (pWal && onoff >= 0)
+    {
+        pWal->groupCommit = (u8)(onoff != 0);
+    }
+    return pWal ? pWal->groupCommit : 0;
+}
+
+/*
+** Add the number of writes used to append frames to the WAL file to
+** *pnWrite, and the number of frames appended by those writes to
+** *pnFrame. If the reset parameter is non-zero, both counters are zeroed
+** before returning.
+*/
+void sqlite3WalWriteStat(Wal *pWal, int reset, int *pnWrite, int *pnFrame)
+{
+    if (pWal)
+    {
+        *pnWrite += pWal->nFrameWrite;
+        *pnFrame += pWal->nFrameAppend;
+        if (reset)
+        {
+            pWal->nFrameWrite = 0;
+            pWal->nFrameAppend = 0;
+        }
+    }
+}
+
+/*
+** Add the number of pages written back into the database file by
+** checkpoints run through this connection to *pnPage, and set *pnPageSec
+** to the larger of its current value and the rate, in pages per second,
+** of the most recent such checkpoint. If the reset parameter is non-zero,
+** both counters are zeroed before returning.
+*/
+void sqlite3WalCkptStat(Wal *pWal, int reset, int *pnPage, int *pnPageSec)
+{
+    if (pWal)
+    {
+        *pnPage += pWal->nCkptPage;
+        if (pWal->nCkptPageSec > *pnPageSec) *pnPageSec = pWal->nCkptPageSec;
+        if (reset)
+        {
+            pWal->nCkptPage = 0;
+            pWal->nCkptPageSec = 0;
+        }
+    }
+}
+
 #ifdef SQLITE_ENABLE_ZIPVFS
 /*
 ** If the argument is not NULL, it points to a Wal object that holds a
@@ -31,10 +31,13 @@
 # define sqlite3WalClose(w,x,y,z)                0
 # define sqlite3WalBeginReadTransaction(y,z)     0
 # define sqlite3WalEndReadTransaction(z)
-# define sqlite3WalRead(v,w,x,y,z)               0
+# define sqlite3WalFindFrame(x,y,z)              0
+# define sqlite3WalReadFrame(w,x,y,z)            0
 # define sqlite3WalDbsize(y)                     0
 # define sqlite3WalBeginWriteTransaction(y)      0
 # define sqlite3WalEndWriteTransaction(x)        0
+# define sqlite3WalLockForCommit(x,y,z)          0
+# define sqlite3WalUpgradeSnapshot(x,y,z)        0
 # define sqlite3WalUndo(x,y,z)                   0
 # define sqlite3WalSavepoint(y,z)
 # define sqlite3WalSavepointUndo(y,z)            0
@@ -44,6 +47,11 @@
 # define sqlite3WalExclusiveMode(y,z)            0
 # define sqlite3WalHeapMemory(z)                 0
 # define sqlite3WalFramesize(z)                  0
+# define sqlite3WalWriteStat(w,x,y,z)
+# define sqlite3WalCkptStat(w,x,y,z)
+# define sqlite3WalGroupCommit(y,z)              0
+# define sqlite3WalCkptThread(v,w,x,y,z)         0
+# define sqlite3WalCkptThreadActive(z)           0
 #else
 
 #define WAL_SAVEPOINT_NDATA 4
@@ -71,7 +79,8 @@ int sqlite3WalBeginReadTransaction(Wal *pWal, int *);
 void sqlite3WalEndReadTransaction(Wal *pWal);
 
 /* Read a page from the write-ahead log, if it is present. */
-int sqlite3WalRead(Wal *pWal, Pgno pgno, int *pInWal, int nOut, u8 *pOut);
+int sqlite3WalFindFrame(Wal *, Pgno, u32 *);
+int sqlite3WalReadFrame(Wal *, u32, int, u8 *);
 
 /* If the WAL is not empty, return the size of the database. */
 Pgno sqlite3WalDbsize(Wal *pWal);
@@ -80,6 +89,13 @@ Pgno sqlite3WalDbsize(Wal *pWal);
 int sqlite3WalBeginWriteTransaction(Wal *pWal);
 int sqlite3WalEndWriteTransaction(Wal *pWal);
 
+/* Obtain the WRITER lock for a BEGIN CONCURRENT transaction, checking that
+** no page it read has been modified since its snapshot was taken. Then
+** move the snapshot forward to include the changes made since.
+*/
+int sqlite3WalLockForCommit(Wal *pWal, Bitvec *pReadSet, u32 *piPage1);
+int sqlite3WalUpgradeSnapshot(Wal *pWal, int (*xUndo)(void *, Pgno), void *pUndoCtx);
+
 /* Undo any frames written (but not committed) to the log */
 int sqlite3WalUndo(Wal *pWal, int (*xUndo)(void *, Pgno), void *pUndoCtx);
 
@@ -125,6 +141,23 @@ int sqlite3WalExclusiveMode(Wal *pWal, int op);
 */
 int sqlite3WalHeapMemory(Wal *pWal);
 
+/* Enable or disable syncing commits after the write lock is released. */
+int sqlite3WalGroupCommit(Wal *pWal, int onoff);
+
+/* Return the number of writes used to append frames to the WAL file, and
+** the most frames appended by any one of them.
+*/
+void sqlite3WalWriteStat(Wal *pWal, int reset, int *pnWrite, int *pnFrame);
+
+/* Return the number of pages written back by checkpoints, and the rate
+** of the most recent checkpoint in pages per second.
+*/
+void sqlite3WalCkptStat(Wal *pWal, int reset, int *pnPage, int *pnPageSec);
+
+/* Attach to or detach from the background checkpointer of a database. */
+int sqlite3WalCkptThread(Wal*, const char *zDb, int nFrame, int nRate, int syncFlags);
+int sqlite3WalCkptThreadActive(Wal *pWal);
+
 #ifdef SQLITE_ENABLE_ZIPVFS
 /* If the WAL file is not empty, return the number of bytes of content
 ** stored in each frame (i.e. the db page-size when the WAL was created).
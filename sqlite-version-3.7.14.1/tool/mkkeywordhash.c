@@ -168,6 +168,7 @@ static Keyword aKeywordTable[] =
     { "COLLATE",          "TK_COLLATE",      ALWAYS                 },
     { "COLUMN",           "TK_COLUMNKW",     ALTER                  },
     { "COMMIT",           "TK_COMMIT",       ALWAYS                 },
+    { "CONCURRENT",       "TK_CONCURRENT",   ALWAYS                 },
     { "CONFLICT",         "TK_CONFLICT",     CONFLICT               },
     { "CONSTRAINT",       "TK_CONSTRAINT",   ALWAYS                 },
     { "CREATE",           "TK_CREATE",       ALWAYS                 },
@@ -239,6 +239,7 @@ foreach file {
    mutex_noop.c
    mutex_unix.c
    mutex_w32.c
+   threads.c
    malloc.c
    printf.c
    random.c
@@ -0,0 +1,250 @@
+/*
+** Measure the cost of each VDBE opcode for a handful of statements that
+** spend their time in short OP_Column/OP_Next loops, in order to compare
+** the switch statement that sqlite3VdbeExec() dispatches opcodes with by
+** default against the threaded dispatch of SQLITE_ENABLE_COMPUTED_GOTO.
+**
+** Build the program twice against the same amalgamation, once with and
+** once without computed gotos, and with the same optimization flags:
+**
+**     gcc -O2 -DSQLITE_THREADSAFE=0 -I. vdbe-dispatch.c sqlite3.c \
+**         -o dispatch-switch -ldl
+**     gcc -O2 -DSQLITE_THREADSAFE=0 -DSQLITE_ENABLE_COMPUTED_GOTO -I. \
+**         vdbe-dispatch.c sqlite3.c -o dispatch-goto -ldl
+**
+** Then run both:
+**
+**     ./dispatch-switch ?-rows N? ?-repeat N?
+**
+** For each statement, the program counts the opcodes that one run of it
+** executes, using a progress handler that is invoked for every opcode,
+** then runs it again without the handler N times.  It reports the time
+** per opcode in nanoseconds and, on Linux systems on which the hardware
+** performance counters may be read, the instructions and the mispredicted
+** branches per opcode.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "sqlite3.h"
+
+/*
+** The statements measured.  Table t1 is filled by main().
+*/
+static const char *azSql[] =
+{
+    "SELECT count(a) FROM t1",
+    "SELECT sum(a), max(c), min(b) FROM t1",
+    "SELECT count(*) FROM t1 WHERE a%7=3 AND c<500.0",
+    "SELECT sum(a*2+c/3) FROM t1 WHERE b>'m'",
+    "SELECT count(*) FROM t1 WHERE b LIKE 'ab%'",
+};
+
+/*
+** Hardware counters.  aFd[i] is -1 if counter i cannot be read.
+*/
+#define NCOUNTER 2
+static int aFd[NCOUNTER] = { -1, -1 };
+static const char *azCounter[NCOUNTER] = { "insn/op", "miss/op" };
+
+/*
+** Return the current time in nanoseconds.
+*/
+static double timeNow(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void counterOpen(void)
+{
+#if defined(__linux__) && defined(__NR_perf_event_open)
+    static const unsigned long long aConfig[NCOUNTER] =
+    {
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    int i;
+    for (i = 0; i < NCOUNTER; i++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = aConfig[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        aFd[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+}
+
+static void counterStart(void)
+{
+#if defined(__linux__) && defined(__NR_perf_event_open)
+    int i;
+    for (i = 0; i < NCOUNTER; i++)
+    {
+        if (aFd[i] < 0) continue;
+        ioctl(aFd[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(aFd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+static void counterStop(sqlite3_int64 *aValue)
+{
+    int i;
+    for (i = 0; i < NCOUNTER; i++)
+    {
+        aValue[i] = -1;
+#if defined(__linux__) && defined(__NR_perf_event_open)
+        if (aFd[i] >= 0)
+        {
+            long long v;
+            ioctl(aFd[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(aFd[i], &v, sizeof(v)) == sizeof(v)) aValue[i] = v;
+        }
+#endif
+    }
+}
+
+/*
+** Progress handler invoked for every opcode.  Each call to
+** sqlite3VdbeExec() executes one more opcode than it invokes the handler
+** for, so runOnce() adds the number of calls to sqlite3_step().
+*/
+static int countOps(void *pArg)
+{
+    (*(sqlite3_int64 *)pArg)++;
+    return 0;
+}
+
+/*
+** Run statement pStmt to completion.  Return the number of calls to
+** sqlite3_step().
+*/
+static int runOnce(sqlite3_stmt *pStmt)
+{
+    int nStep = 1;
+    while (sqlite3_step(pStmt) == SQLITE_ROW) nStep++;
+    if (sqlite3_reset(pStmt) != SQLITE_OK)
+    {
+        fprintf(stderr, "error: %s\n",
+                sqlite3_errmsg(sqlite3_db_handle(pStmt)));
+        exit(1);
+    }
+    return nStep;
+}
+
+static void usage(const char *zArgv0)
+{
+    fprintf(stderr, "Usage: %s ?-rows N? ?-repeat N?\n", zArgv0);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    sqlite3 *db;
+    sqlite3_stmt *pStmt;
+    int nRow = 100000;
+    int nRepeat = 20;
+    int i, j;
+    sqlite3_int64 nTotalOp = 0;
+    double rTotal = 0.0;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "-rows") == 0)
+        {
+            nRow = atoi(argv[++i]);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-repeat") == 0)
+        {
+            nRepeat = atoi(argv[++i]);
+        }
+        else
+        {
+            usage(argv[0]);
+        }
+    }
+    if (nRow <= 0 || nRepeat <= 0) usage(argv[0]);
+
+    if (sqlite3_open(":memory:", &db) != SQLITE_OK)
+    {
+        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
+        exit(1);
+    }
+    sqlite3_exec(db,
+                 "CREATE TABLE t1(a INTEGER, b TEXT, c REAL);"
+                 "BEGIN;", 0, 0, 0);
+    sqlite3_prepare_v2(db, "INSERT INTO t1 VALUES(?1, hex(?1*7919), ?1%1000)",
+                       -1, &pStmt, 0);
+    for (i = 0; i < nRow; i++)
+    {
+        sqlite3_bind_int(pStmt, 1, i);
+        sqlite3_step(pStmt);
+        sqlite3_reset(pStmt);
+    }
+    sqlite3_finalize(pStmt);
+    sqlite3_exec(db, "COMMIT;", 0, 0, 0);
+
+    counterOpen();
+    printf("%-48s %10s %10s", "statement", "opcodes", "ns/op");
+    for (j = 0; j < NCOUNTER; j++)
+    {
+        if (aFd[j] >= 0) printf(" %10s", azCounter[j]);
+    }
+    printf("\n");
+
+    for (i = 0; i < (int)(sizeof(azSql) / sizeof(azSql[0])); i++)
+    {
+        sqlite3_int64 nOp = 0;
+        sqlite3_int64 aCount[NCOUNTER];
+        double rStart, rElapse;
+
+        if (sqlite3_prepare_v2(db, azSql[i], -1, &pStmt, 0) != SQLITE_OK)
+        {
+            fprintf(stderr, "error: %s\n", sqlite3_errmsg(db));
+            exit(1);
+        }
+
+        /* Count the opcodes executed, then warm up */
+        sqlite3_progress_handler(db, 1, countOps, (void *)&nOp);
+        nOp += runOnce(pStmt);
+        sqlite3_progress_handler(db, 0, 0, 0);
+        runOnce(pStmt);
+
+        counterStart();
+        rStart = timeNow();
+        for (j = 0; j < nRepeat; j++) runOnce(pStmt);
+        rElapse = timeNow() - rStart;
+        counterStop(aCount);
+        sqlite3_finalize(pStmt);
+
+        nOp *= nRepeat;
+        nTotalOp += nOp;
+        rTotal += rElapse;
+        printf("%-48s %10lld %10.2f", azSql[i], nOp / nRepeat, rElapse / nOp);
+        for (j = 0; j < NCOUNTER; j++)
+        {
+            if (aFd[j] >= 0) printf(" %10.2f", (double)aCount[j] / nOp);
+        }
+        printf("\n");
+    }
+    printf("%-48s %10s %10.2f\n", "total", "", rTotal / nTotalOp);
+
+    sqlite3_close(db);
+    return 0;
+}